@@ -0,0 +1,129 @@
+#include <bench_corpus.h>
+#include <cstdlib>
+#include <random>
+
+namespace ziopp_bench {
+	namespace {
+		const size_t corpus_size = 1024;
+
+		template <size_t N>
+		const char* pick(std::mt19937& random, const char* const (&values)[N])
+		{
+			return values[random() % N];
+		}
+
+		std::vector<std::string> make_normalized_paths()
+		{
+			static const char* const roots[] = { "srv", "var", "opt", "home/deploy", "usr/local" };
+			static const char* const areas[] = { "app", "services/billing", "data/warehouse", "lib", "cache/render", "releases" };
+			static const char* const versions[] = { "2024-05-01T12-00-00", "v1.12.3", "build-48213", "current", "stable" };
+			static const char* const folders[] = { "config", "lib/python3.11/site-packages", "static/assets/img", "logs/archive", "node_modules/@scope/package/dist", "shards/0042" };
+			static const char* const names[] = { "app", "index", "settings.production", "module", "part-00017", "thumbnail_large", "README" };
+			static const char* const extensions[] = { ".json", ".py", ".so", ".log", ".tar.gz", ".txt", ".parquet", "" };
+
+			std::mt19937 random{ 42 };
+			std::vector<std::string> paths;
+			paths.reserve(corpus_size);
+			for (size_t i = 0; i < corpus_size; i++)
+			{
+				std::string path = "/";
+				path += pick(random, roots);
+				path += '/';
+				path += pick(random, areas);
+				path += '/';
+				path += pick(random, versions);
+				path += '/';
+				path += pick(random, folders);
+				path += '/';
+				path += pick(random, names);
+				path += pick(random, extensions);
+				paths.push_back(path);
+			}
+			return paths;
+		}
+
+		std::vector<std::string> make_unnormalized_paths()
+		{
+			std::vector<std::string> paths = normalized_paths();
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				std::string& path = paths[i];
+				size_t separator = path.find('/', 1);
+				switch (i % 4)
+				{
+					case 0:
+						for (char& c : path)
+						{
+							c = c == '/' ? '\\' : c;
+						}
+						break;
+					case 1:
+						path.insert(separator, "/./");
+						break;
+					case 2:
+						path.insert(separator, "/tmp/..");
+						break;
+					default:
+						path.insert(separator, "//");
+						path += '/';
+						break;
+				}
+			}
+			return paths;
+		}
+
+		size_t environment_or(const char* name, size_t fallback)
+		{
+			const char* value = std::getenv(name);
+			return value != nullptr ? static_cast<size_t>(std::strtoull(value, nullptr, 10)) : fallback;
+		}
+
+		void generate_directory(ziopp::filesystem& fs, const ziopp::upath& directory, const tree_shape& shape, size_t depth, const std::vector<uint8_t>& content, std::vector<ziopp::upath>& files)
+		{
+			fs.create_directory(directory);
+			for (size_t i = 0; i < shape.files_per_directory; i++)
+			{
+				ziopp::upath file = ziopp::upath::combine(directory, ziopp::upath{ "file" + std::to_string(i) + ".dat" });
+				fs.write_all_binary(file, content);
+				files.push_back(file);
+			}
+			if (depth < shape.depth)
+			{
+				for (size_t i = 0; i < shape.fanout; i++)
+				{
+					generate_directory(fs, ziopp::upath::combine(directory, ziopp::upath{ "dir" + std::to_string(i) }), shape, depth + 1, content, files);
+				}
+			}
+		}
+	}
+
+	const std::vector<std::string>& normalized_paths()
+	{
+		static const std::vector<std::string> paths = make_normalized_paths();
+		return paths;
+	}
+
+	const std::vector<std::string>& unnormalized_paths()
+	{
+		static const std::vector<std::string> paths = make_unnormalized_paths();
+		return paths;
+	}
+
+	tree_shape configured_tree_shape()
+	{
+		tree_shape shape;
+		shape.depth = environment_or("ZIOPP_BENCH_DEPTH", 3);
+		shape.fanout = environment_or("ZIOPP_BENCH_FANOUT", 4);
+		shape.files_per_directory = environment_or("ZIOPP_BENCH_FILES", 16);
+		shape.file_size = environment_or("ZIOPP_BENCH_FILE_SIZE", 4096);
+		return shape;
+	}
+
+	std::vector<ziopp::upath> generate_tree(ziopp::filesystem& fs, const ziopp::upath& root, const tree_shape& shape)
+	{
+		std::vector<uint8_t> content(shape.file_size, 0x5a);
+		std::vector<ziopp::upath> files;
+		generate_directory(fs, root, shape, 0, content, files);
+		return files;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ziopp/filesystem.h>
+
+namespace ziopp_bench {
+	/**
+	 * @brief Gets already normalized absolute paths shaped like the ones found in deployments (40 to 120 characters).
+	 *
+	 * @return const std::vector<std::string>& The paths, always the same for a given build.
+	 */
+	const std::vector<std::string>& normalized_paths();
+
+	/**
+	 * @brief Gets the normalized_paths() rewritten so that upath has to take its slow normalization path (backslashes, `.` and `..` segments, repeated and trailing separators).
+	 *
+	 * @return const std::vector<std::string>& The paths, in the same order as normalized_paths().
+	 */
+	const std::vector<std::string>& unnormalized_paths();
+
+	/**
+	 * @brief The shape of a generated directory tree.
+	 *
+	 */
+	struct tree_shape {
+		size_t depth;
+		size_t fanout;
+		size_t files_per_directory;
+		size_t file_size;
+	};
+
+	/**
+	 * @brief Gets the tree shape used by the filesystem benchmarks.
+	 *
+	 * Each value can be overridden with the ZIOPP_BENCH_DEPTH, ZIOPP_BENCH_FANOUT, ZIOPP_BENCH_FILES and ZIOPP_BENCH_FILE_SIZE environment variables.
+	 *
+	 * @return tree_shape The tree shape.
+	 */
+	tree_shape configured_tree_shape();
+
+	/**
+	 * @brief Creates a directory tree of the given shape.
+	 *
+	 * @param fs The filesystem to create the tree in.
+	 * @param root The directory to create the tree under.
+	 * @param shape The shape of the tree.
+	 * @return std::vector<ziopp::upath> The paths of the files created.
+	 */
+	std::vector<ziopp::upath> generate_tree(ziopp::filesystem& fs, const ziopp::upath& root, const tree_shape& shape);
+}
\ No newline at end of file
@@ -0,0 +1,498 @@
+#include <benchmark/benchmark.h>
+#include <bench_corpus.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+#include <ziopp/readahead_filesystem.h>
+#include <ziopp/scheduled_filesystem.h>
+#include <ziopp/tiered_filesystem.h>
+#include <ziopp/upath_iterator.h>
+#include <ziopp/writeback_filesystem.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+static void filesystem_enumerate_paths(benchmark::State& state)
+{
+	ziopp::memory_filesystem fs{};
+	ziopp_bench::tree_shape shape = ziopp_bench::configured_tree_shape();
+	shape.file_size = 0;
+	ziopp_bench::generate_tree(fs, ziopp::upath{ "/tree" }, shape);
+
+	size_t count = 0;
+	for (auto _ : state)
+	{
+		ziopp::upath_iterator paths = fs.enumerate_paths(ziopp::upath{ "/tree" }, "*", ziopp::search_options::all_directories, ziopp::search_target::both);
+		for (ziopp::upath_iterator end{}; paths != end; ++paths)
+		{
+			benchmark::DoNotOptimize(*paths);
+			count++;
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(filesystem_enumerate_paths);
+
+static void filesystem_read_all_binary(benchmark::State& state)
+{
+	ziopp::memory_filesystem fs{};
+	ziopp::upath path{ "/file.dat" };
+	fs.write_all_binary(path, std::vector<uint8_t>(static_cast<size_t>(state.range(0)), 0x5a));
+
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> content = fs.read_all_binary(path);
+		benchmark::DoNotOptimize(content.data());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(filesystem_read_all_binary)->Arg(4 * 1024)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+namespace {
+	// Waits before every read, like a remote or compressed backend
+	class slow_handle : public ziopp::file_handle {
+	public:
+		explicit slow_handle(std::unique_ptr<ziopp::file_handle> inner) : inner_(std::move(inner))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+	private:
+		std::unique_ptr<ziopp::file_handle> inner_;
+	};
+
+	class slow_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit slow_filesystem(ziopp::filesystem& next) : ziopp::compose_filesystem(next)
+		{
+		}
+
+		using ziopp::compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			return std::unique_ptr<ziopp::file_handle>(new slow_handle(ziopp::compose_filesystem::open_handle(path, mode, access)));
+		}
+	};
+
+	// Serves one read at a time, taking 25us per 16 KiB, like a disk with a single queue
+	class device_handle : public ziopp::file_handle {
+	public:
+		device_handle(std::unique_ptr<ziopp::file_handle> inner, std::mutex& device) : inner_(std::move(inner)), device_(device)
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock{ device_ };
+			std::this_thread::sleep_for(std::chrono::microseconds(25 * (count / (16 * 1024) + 1)));
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+	private:
+		std::unique_ptr<ziopp::file_handle> inner_;
+		std::mutex& device_;
+	};
+
+	class device_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit device_filesystem(ziopp::filesystem& next) : ziopp::compose_filesystem(next)
+		{
+		}
+
+		using ziopp::compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			return std::unique_ptr<ziopp::file_handle>(new device_handle(ziopp::compose_filesystem::open_handle(path, mode, access), device_));
+		}
+	private:
+		std::mutex device_;
+	};
+
+	// Waits for every write, like a disk committing each one
+	class slow_write_handle : public ziopp::file_handle {
+	public:
+		explicit slow_write_handle(std::unique_ptr<ziopp::file_handle> inner) : inner_(std::move(inner))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+	private:
+		std::unique_ptr<ziopp::file_handle> inner_;
+	};
+
+	class slow_write_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit slow_write_filesystem(ziopp::filesystem& next) : ziopp::compose_filesystem(next)
+		{
+		}
+
+		using ziopp::compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			return std::unique_ptr<ziopp::file_handle>(new slow_write_handle(ziopp::compose_filesystem::open_handle(path, mode, access)));
+		}
+	};
+}
+
+// Arg 0 scans a file of a slow backend directly, 1 through a readahead_filesystem
+static void filesystem_sequential_scan(benchmark::State& state)
+{
+	ziopp::memory_filesystem memory{};
+	ziopp::upath path{ "/file.dat" };
+	const size_t size = 8 * 1024 * 1024;
+	memory.write_all_binary(path, std::vector<uint8_t>(size, 0x5a));
+	slow_filesystem slow{ memory };
+	ziopp::readahead_filesystem readahead{ slow };
+	ziopp::filesystem& fs = state.range(0) == 0 ? static_cast<ziopp::filesystem&>(slow) : readahead;
+
+	std::vector<uint8_t> buffer(64 * 1024);
+	for (auto _ : state)
+	{
+		std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(path, ziopp::file_mode::open, ziopp::file_access::read);
+		uint64_t offset = 0;
+		size_t read;
+		while ((read = handle->read_at(offset, buffer.data(), buffer.size())) > 0)
+		{
+			offset += read;
+		}
+		benchmark::DoNotOptimize(offset);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+BENCHMARK(filesystem_sequential_scan)->Arg(0)->Arg(1)->UseRealTime();
+
+// Small reads of high priority competing with two threads reading 1 MiB at a time in the background,
+// Arg 0 on the device directly, 1 through a scheduled_filesystem. Reports the latency of the small reads.
+static void filesystem_foreground_latency(benchmark::State& state)
+{
+	ziopp::memory_filesystem memory{};
+	ziopp::upath path{ "/file.dat" };
+	const size_t size = 8 * 1024 * 1024;
+	memory.write_all_binary(path, std::vector<uint8_t>(size, 0x5a));
+	device_filesystem device{ memory };
+	ziopp::io_scheduler_options options{};
+	options.max_concurrency = 1;
+	options.reserved_concurrency = 0;
+	options.max_request_size = 64 * 1024;
+	ziopp::io_scheduler scheduler{ options };
+	ziopp::scheduled_filesystem scheduled{ device, scheduler };
+	ziopp::filesystem& fs = state.range(0) == 0 ? static_cast<ziopp::filesystem&>(device) : scheduled;
+
+	std::atomic<bool> stopping{ false };
+	std::vector<std::thread> background;
+	for (int i = 0; i < 2; i++)
+	{
+		background.emplace_back([&fs, &path, &stopping, size]() {
+			ziopp::io_priority_scope scope{ ziopp::io_priority::background };
+			std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(path, ziopp::file_mode::open, ziopp::file_access::read);
+			std::vector<uint8_t> buffer(1024 * 1024);
+			for (uint64_t offset = 0; !stopping; offset = (offset + buffer.size()) % size)
+			{
+				handle->read_at(offset, buffer.data(), buffer.size());
+			}
+		});
+	}
+
+	ziopp::io_priority_scope scope{ ziopp::io_priority::high };
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(path, ziopp::file_mode::open, ziopp::file_access::read);
+	std::vector<uint8_t> buffer(4096);
+	std::vector<double> latencies;
+	uint64_t offset = 0;
+	for (auto _ : state)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		handle->read_at(offset, buffer.data(), buffer.size());
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		offset = (offset + 7 * buffer.size()) % size;
+	}
+	stopping = true;
+	for (std::thread& thread : background)
+	{
+		thread.join();
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	state.counters["p50_us"] = latencies[latencies.size() / 2];
+	state.counters["p99_us"] = latencies[latencies.size() * 99 / 100];
+}
+BENCHMARK(filesystem_foreground_latency)->Arg(0)->Arg(1)->UseRealTime();
+
+// Reads of 200 files of 16 KiB from a slow backend, 80% of them going to 20 of the files,
+// Arg 0 directly, 1 through a tiered_filesystem over a memory_filesystem with room for 32 files
+static void filesystem_tiered_reads(benchmark::State& state)
+{
+	ziopp::memory_filesystem memory{};
+	std::vector<ziopp::upath> paths;
+	for (int i = 0; i < 200; i++)
+	{
+		paths.push_back(ziopp::upath{ "/file" + std::to_string(i) + ".dat" });
+		memory.write_all_binary(paths.back(), std::vector<uint8_t>(16 * 1024, static_cast<uint8_t>(i)));
+	}
+	slow_filesystem slow{ memory };
+	ziopp::memory_filesystem fast{};
+	ziopp::tiered_options options{};
+	options.max_bytes = 32 * 16 * 1024;
+	ziopp::tiered_filesystem tiered{ fast, slow, options };
+	ziopp::filesystem& fs = state.range(0) == 0 ? static_cast<ziopp::filesystem&>(slow) : tiered;
+
+	uint64_t random = 42;
+	for (auto _ : state)
+	{
+		random = random * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t pick = static_cast<uint32_t>(random >> 33);
+		const ziopp::upath& path = paths[pick % 10 < 8 ? pick / 10 % 20 : pick / 10 % paths.size()];
+		std::vector<uint8_t> content = fs.read_all_binary(path);
+		benchmark::DoNotOptimize(content.data());
+	}
+	if (state.range(0) != 0)
+	{
+		ziopp::tiered_statistics statistics = tiered.statistics();
+		state.counters["fast_ratio"] = static_cast<double>(statistics.fast_reads) / static_cast<double>(statistics.fast_reads + statistics.slow_reads);
+	}
+}
+BENCHMARK(filesystem_tiered_reads)->Arg(0)->Arg(1)->UseRealTime();
+
+// Lines of 100 bytes appended to 8 logs, and a status file rewritten after every 4 lines, on a backend taking 200us per write,
+// Arg 0 directly, 1 through a writeback_filesystem
+static void filesystem_bursty_writes(benchmark::State& state)
+{
+	ziopp::memory_filesystem memory{};
+	slow_write_filesystem slow{ memory };
+	ziopp::writeback_filesystem writeback{ slow };
+	ziopp::filesystem& fs = state.range(0) == 0 ? static_cast<ziopp::filesystem&>(slow) : writeback;
+	std::vector<ziopp::upath> logs;
+	for (int i = 0; i < 8; i++)
+	{
+		logs.push_back(ziopp::upath{ "/log" + std::to_string(i) + ".txt" });
+	}
+	ziopp::upath status{ "/status.txt" };
+
+	std::string line(99, 'x');
+	line += '\n';
+	uint64_t lines = 0;
+	for (auto _ : state)
+	{
+		fs.append_all_text(logs[lines % logs.size()], line);
+		if (++lines % 4 == 0)
+		{
+			std::string progress = std::to_string(lines);
+			fs.write_all_text(status, progress);
+		}
+	}
+	writeback.flush();
+	if (state.range(0) != 0)
+	{
+		ziopp::writeback_statistics statistics = writeback.statistics();
+		state.counters["writes_per_flush"] = static_cast<double>(statistics.writes) / static_cast<double>(statistics.flushes);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(lines * line.size()));
+}
+BENCHMARK(filesystem_bursty_writes)->Arg(0)->Arg(1)->UseRealTime();
+
+static void filesystem_copy_file_cross(benchmark::State& state)
+{
+	ziopp::memory_filesystem source{};
+	ziopp::memory_filesystem destination{};
+	ziopp::upath src{ "/file.dat" };
+	ziopp::upath dest{ "/copy.dat" };
+	std::vector<uint8_t> content(static_cast<size_t>(state.range(0)), 0x5a);
+	source.write_all_binary(src, content);
+
+	size_t copies = 0;
+	for (auto _ : state)
+	{
+		source.copy_file_cross(destination, src, dest, true);
+
+		// memory_filesystem keeps every stream opened on a file until the file is deleted
+		if (++copies % 256 == 0)
+		{
+			state.PauseTiming();
+			source.delete_file(src);
+			destination.delete_file(dest);
+			source.write_all_binary(src, content);
+			state.ResumeTiming();
+		}
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(filesystem_copy_file_cross)->Arg(4 * 1024)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+static void filesystem_hash_file(benchmark::State& state)
+{
+	ziopp::memory_filesystem fs{};
+	ziopp::upath path{ "/file.dat" };
+	fs.write_all_binary(path, std::vector<uint8_t>(16 * 1024 * 1024, 0x5a));
+	ziopp::hash_algorithm algorithm = static_cast<ziopp::hash_algorithm>(state.range(0));
+
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> digest = fs.hash_file(path, algorithm);
+		benchmark::DoNotOptimize(digest.data());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * 16 * 1024 * 1024);
+}
+BENCHMARK(filesystem_hash_file)->Arg(static_cast<int>(ziopp::hash_algorithm::xxh64))->Arg(static_cast<int>(ziopp::hash_algorithm::sha256))->Arg(static_cast<int>(ziopp::hash_algorithm::blake3))->UseRealTime();
+
+namespace {
+	class metadata_fixture : public benchmark::Fixture {
+	public:
+		void SetUp(const benchmark::State&) override
+		{
+			ziopp_bench::tree_shape shape = ziopp_bench::configured_tree_shape();
+			shape.file_size = 16;
+			files = ziopp_bench::generate_tree(fs, ziopp::upath{ "/tree" }, shape);
+		}
+
+		void TearDown(const benchmark::State&) override
+		{
+			fs.delete_directory(ziopp::upath{ "/tree" }, true);
+			files.clear();
+		}
+
+		ziopp::memory_filesystem fs;
+		std::vector<ziopp::upath> files;
+	};
+}
+
+BENCHMARK_F(metadata_fixture, file_exists)(benchmark::State& state)
+{
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		bool exists = fs.file_exists(files[i++ % files.size()]);
+		benchmark::DoNotOptimize(exists);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, metrics_file_exists)(benchmark::State& state)
+{
+	ziopp::metrics_filesystem metrics{ fs };
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		bool exists = metrics.file_exists(files[i++ % files.size()]);
+		benchmark::DoNotOptimize(exists);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, file_length)(benchmark::State& state)
+{
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		size_t length = fs.file_length(files[i++ % files.size()]);
+		benchmark::DoNotOptimize(length);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, file_length_missing)(benchmark::State& state)
+{
+	ziopp::upath missing{ "/tree/missing.txt" };
+	for (auto _ : state)
+	{
+		try
+		{
+			size_t length = fs.file_length(missing);
+			benchmark::DoNotOptimize(length);
+		}
+		catch (const std::ios_base::failure&)
+		{
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, file_length_missing_error_code)(benchmark::State& state)
+{
+	ziopp::upath missing{ "/tree/missing.txt" };
+	std::error_code error;
+	for (auto _ : state)
+	{
+		size_t length = fs.file_length(missing, error);
+		benchmark::DoNotOptimize(length);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, write_time)(benchmark::State& state)
+{
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		std::chrono::system_clock::time_point time = fs.write_time(files[i++ % files.size()]);
+		benchmark::DoNotOptimize(time);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK_F(metadata_fixture, stat_many)(benchmark::State& state)
+{
+	std::vector<ziopp::upath> batch(files.begin(), files.begin() + std::min<size_t>(64, files.size()));
+	for (auto _ : state)
+	{
+		std::vector<ziopp::file_stat> stats = fs.stat_many(batch);
+		benchmark::DoNotOptimize(stats.data());
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch.size()));
+}
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include <benchmark/benchmark.h>
+#include <bench_corpus.h>
+#include <algorithm>
+#include <ziopp/path_arena.h>
+#include <ziopp/upath.h>
+#include <ziopp/upath_batch.h>
+
+namespace {
+	std::vector<ziopp::upath> corpus()
+	{
+		const std::vector<std::string>& paths = ziopp_bench::normalized_paths();
+		return std::vector<ziopp::upath>(paths.begin(), paths.end());
+	}
+
+	template <typename Path>
+	void construct(benchmark::State& state, const std::vector<std::string>& paths)
+	{
+		size_t bytes = 0;
+		size_t i = 0;
+		for (auto _ : state)
+		{
+			const std::string& path = paths[i++ % paths.size()];
+			Path result{ path };
+			benchmark::DoNotOptimize(result);
+			bytes += path.size();
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+		state.SetBytesProcessed(static_cast<int64_t>(bytes));
+	}
+
+	// The temporary paths of a request: the directory of one path combined with another
+	template <typename Path>
+	void request(benchmark::State& state, const typename Path::allocator_type& allocator, ziopp::path_arena* arena)
+	{
+		const std::vector<std::string>& paths = ziopp_bench::normalized_paths();
+		size_t i = 0;
+		for (auto _ : state)
+		{
+			{
+				const std::string& path = paths[i % paths.size()];
+				const std::string& relative = paths[(i + 1) % paths.size()];
+				Path directory = Path{ path.data(), path.size(), allocator }.directory();
+				Path result = Path::combine(directory, Path{ relative.data() + 1, relative.size() - 1, allocator });
+				benchmark::DoNotOptimize(result);
+			}
+			// Given back all at once when the request ends
+			if (arena != nullptr)
+			{
+				arena->reset();
+			}
+			i++;
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+	}
+}
+
+static void upath_construct_normalized(benchmark::State& state)
+{
+	construct<ziopp::upath>(state, ziopp_bench::normalized_paths());
+}
+BENCHMARK(upath_construct_normalized);
+
+static void upath_construct_normalized_posix(benchmark::State& state)
+{
+	construct<ziopp::basic_upath<ziopp::posix_path_policy>>(state, ziopp_bench::normalized_paths());
+}
+BENCHMARK(upath_construct_normalized_posix);
+
+static void upath_construct_unnormalized(benchmark::State& state)
+{
+	construct<ziopp::upath>(state, ziopp_bench::unnormalized_paths());
+}
+BENCHMARK(upath_construct_unnormalized);
+
+static void upath_construct_unnormalized_posix(benchmark::State& state)
+{
+	construct<ziopp::basic_upath<ziopp::posix_path_policy>>(state, ziopp_bench::unnormalized_paths());
+}
+BENCHMARK(upath_construct_unnormalized_posix);
+
+static void upath_construct_all(benchmark::State& state)
+{
+	const std::vector<std::string>& paths = ziopp_bench::unnormalized_paths();
+	for (auto _ : state)
+	{
+		std::vector<ziopp::upath> result;
+		result.reserve(paths.size());
+		for (const std::string& path : paths)
+		{
+			result.emplace_back(path);
+		}
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(upath_construct_all);
+
+// Arg is the chunk size, the whole corpus being normalized on the calling thread when it fits in one chunk
+static void upath_batch_normalize(benchmark::State& state)
+{
+	const std::vector<std::string>& paths = ziopp_bench::unnormalized_paths();
+	ziopp::upath_batch_options options{};
+	options.chunk_size = static_cast<size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		ziopp::upath_batch batch{ paths, options };
+		benchmark::DoNotOptimize(batch);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(upath_batch_normalize)->Arg(1 << 20)->Arg(128)->UseRealTime();
+
+static void upath_combine(benchmark::State& state)
+{
+	std::vector<ziopp::upath> paths = corpus();
+	std::vector<ziopp::upath> relatives;
+	for (const ziopp::upath& path : paths)
+	{
+		relatives.push_back(path.to_relative());
+	}
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		ziopp::upath result = ziopp::upath::combine(paths[i % paths.size()].directory(), relatives[(i + 1) % relatives.size()]);
+		benchmark::DoNotOptimize(result);
+		i++;
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(upath_combine);
+
+static void upath_request_heap(benchmark::State& state)
+{
+	request<ziopp::upath>(state, ziopp::upath::allocator_type{}, nullptr);
+}
+BENCHMARK(upath_request_heap);
+
+static void upath_request_arena(benchmark::State& state)
+{
+	ziopp::inline_path_arena<4096> arena{};
+	request<ziopp::arena_upath>(state, arena, &arena);
+	state.counters["overflows"] = static_cast<double>(arena.overflows());
+}
+BENCHMARK(upath_request_arena);
+
+static void upath_split(benchmark::State& state)
+{
+	std::vector<ziopp::upath> paths = corpus();
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		std::vector<std::string> segments = paths[i++ % paths.size()].split();
+		benchmark::DoNotOptimize(segments);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(upath_split);
+
+static void upath_name(benchmark::State& state)
+{
+	std::vector<ziopp::upath> paths = corpus();
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		std::string name = paths[i++ % paths.size()].name();
+		benchmark::DoNotOptimize(name);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(upath_name);
+
+static void upath_in_directory(benchmark::State& state)
+{
+	std::vector<ziopp::upath> paths = corpus();
+	std::vector<ziopp::upath> directories;
+	for (const ziopp::upath& path : paths)
+	{
+		directories.push_back(path.directory().directory());
+	}
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		bool result = paths[i % paths.size()].in_directory(directories[(i * 7) % directories.size()], state.range(0) != 0);
+		benchmark::DoNotOptimize(result);
+		i++;
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(upath_in_directory)->Arg(0)->Arg(1);
+
+static void upath_extension(benchmark::State& state)
+{
+	std::vector<ziopp::upath> paths = corpus();
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		const ziopp::upath& path = paths[i++ % paths.size()];
+		std::string extension = path.extension_with_dot();
+		std::string name = path.name_without_extension();
+		ziopp::upath changed = path.change_extension(".bak");
+		ziopp::upath removed = path.remove_extension();
+		benchmark::DoNotOptimize(extension);
+		benchmark::DoNotOptimize(name);
+		benchmark::DoNotOptimize(changed);
+		benchmark::DoNotOptimize(removed);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(upath_extension);
+// Arg 0 sorts by full_name(), 1 by operator<, 2 with upath::sort, each iteration sorting a fresh copy of the corpus
+static void upath_sort(benchmark::State& state)
+{
+	const std::vector<ziopp::upath> paths = corpus();
+	for (auto _ : state)
+	{
+		std::vector<ziopp::upath> sorted = paths;
+		if (state.range(0) == 0)
+		{
+			std::sort(sorted.begin(), sorted.end(), [](const ziopp::upath& left, const ziopp::upath& right) { return left.full_name() < right.full_name(); });
+		}
+		else if (state.range(0) == 1)
+		{
+			std::sort(sorted.begin(), sorted.end());
+		}
+		else
+		{
+			ziopp::upath::sort(sorted);
+		}
+		benchmark::DoNotOptimize(sorted);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(upath_sort)->Arg(0)->Arg(1)->Arg(2);
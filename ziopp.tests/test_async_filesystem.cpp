@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <ziopp/async_filesystem.h>
+
+#ifdef ZIOPP_HAS_COROUTINES
+
+#include <stdexcept>
+#include <thread>
+#include <ziopp/memory_filesystem.h>
+
+namespace {
+	ziopp::task<int> answer()
+	{
+		co_return 42;
+	}
+
+	ziopp::task<int> twice()
+	{
+		int first = co_await answer();
+		int second = co_await answer();
+		co_return first + second;
+	}
+
+	ziopp::task<> fail()
+	{
+		throw std::runtime_error("failed");
+		co_return;
+	}
+
+	ziopp::task<std::thread::id> thread_after_schedule(ziopp::executor& target)
+	{
+		co_await ziopp::schedule(target);
+		co_return std::this_thread::get_id();
+	}
+
+	ziopp::async_generator<int> count_to(int last, bool throws)
+	{
+		for (int i = 1; i <= last; i++)
+		{
+			co_yield i;
+		}
+		if (throws)
+		{
+			throw std::runtime_error("failed");
+		}
+	}
+
+	ziopp::task<std::vector<int>> collect(ziopp::async_generator<int> values)
+	{
+		std::vector<int> result;
+		while (std::optional<int> value = co_await values.next())
+		{
+			result.push_back(*value);
+		}
+		co_return result;
+	}
+
+	ziopp::task<std::vector<ziopp::upath>> collect(ziopp::async_generator<ziopp::upath> paths)
+	{
+		std::vector<ziopp::upath> result;
+		while (std::optional<ziopp::upath> path = co_await paths.next())
+		{
+			result.push_back(*path);
+		}
+		co_return result;
+	}
+
+	void write_text(ziopp::filesystem& fs, const ziopp::upath& path, std::string content)
+	{
+		fs.write_all_text(path, content);
+	}
+}
+
+TEST(task, sync_wait) {
+	ASSERT_EQ(42, ziopp::sync_wait(answer()));
+	ASSERT_EQ(84, ziopp::sync_wait(twice()));
+	ASSERT_THROW(ziopp::sync_wait(fail()), std::runtime_error);
+}
+
+TEST(task, schedule_and_run_on) {
+	ziopp::thread_pool pool{ 1 };
+	std::thread::id pool_thread = ziopp::sync_wait(thread_after_schedule(pool));
+	ASSERT_NE(std::this_thread::get_id(), pool_thread);
+
+	ziopp::inline_executor inline_runner{};
+	ASSERT_EQ(std::this_thread::get_id(), ziopp::sync_wait(thread_after_schedule(inline_runner)));
+
+	ASSERT_EQ(pool_thread, ziopp::sync_wait(ziopp::run_on(pool, []() { return std::this_thread::get_id(); })));
+}
+
+TEST(task, async_generator) {
+	ASSERT_EQ((std::vector<int>{ 1, 2, 3 }), ziopp::sync_wait(collect(count_to(3, false))));
+	ASSERT_EQ(std::vector<int>{}, ziopp::sync_wait(collect(count_to(0, false))));
+	ASSERT_THROW(ziopp::sync_wait(collect(count_to(2, true))), std::runtime_error);
+}
+
+TEST(async_filesystem, runs_operations_on_the_executor) {
+	ziopp::memory_filesystem memory{};
+	ziopp::memory_filesystem destination{};
+	ziopp::thread_pool pool{ 2 };
+	ziopp::async_filesystem fs{ memory, pool };
+	ASSERT_EQ(&memory, &fs.fs());
+	ASSERT_EQ(&pool, &fs.io_executor());
+
+	memory.create_directory(ziopp::upath{ "/data" });
+	write_text(memory, ziopp::upath{ "/data/a.txt" }, "first");
+	write_text(memory, ziopp::upath{ "/data/b.txt" }, "second");
+
+	ASSERT_EQ("first", ziopp::sync_wait(fs.read_all_text_async(ziopp::upath{ "/data/a.txt" })));
+	ASSERT_EQ((std::vector<uint8_t>{ 's', 'e', 'c', 'o', 'n', 'd' }), ziopp::sync_wait(fs.read_all_binary_async(ziopp::upath{ "/data/b.txt" })));
+	ASSERT_THROW(ziopp::sync_wait(fs.read_all_text_async(ziopp::upath{ "/data/missing.txt" })), std::exception);
+
+	ziopp::sync_wait(fs.copy_file_cross_async(destination, ziopp::upath{ "/data/a.txt" }, ziopp::upath{ "/copy.txt" }, false));
+	ASSERT_EQ("first", destination.read_all_text(ziopp::upath{ "/copy.txt" }));
+
+	std::vector<ziopp::upath> paths = ziopp::sync_wait(collect(fs.enumerate_paths_async(ziopp::upath{ "/data" }, "*", ziopp::search_options::top_directory_only, ziopp::search_target::file)));
+	ASSERT_THAT(paths, ::testing::UnorderedElementsAre(ziopp::upath{ "/data/a.txt" }, ziopp::upath{ "/data/b.txt" }));
+}
+
+#endif
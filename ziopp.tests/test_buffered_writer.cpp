@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <algorithm>
+#include <thread>
+#include <ziopp/buffered_writer.h>
+#include <ziopp/memory_filesystem.h>
+
+#ifdef ZIOPP_POSIX
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace {
+	// Remembers the offset and length of each write
+	class logging_file_handle : public ziopp::file_handle {
+	public:
+		logging_file_handle(std::unique_ptr<ziopp::file_handle> inner, std::vector<std::pair<uint64_t, size_t>>& writes) : inner_(std::move(inner)), writes_(writes)
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			writes_.emplace_back(offset, count);
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+	private:
+		std::unique_ptr<ziopp::file_handle> inner_;
+		std::vector<std::pair<uint64_t, size_t>>& writes_;
+	};
+
+	// Fails the next write once fail is set
+	class failing_file_handle : public ziopp::file_handle {
+	public:
+		explicit failing_file_handle(std::unique_ptr<ziopp::file_handle> inner, bool& fail) : inner_(std::move(inner)), fail_(fail)
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			if (fail_)
+			{
+				fail_ = false;
+				throw std::ios_base::failure("the disk is full", std::make_error_code(std::errc::no_space_on_device));
+			}
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+	private:
+		std::unique_ptr<ziopp::file_handle> inner_;
+		bool& fail_;
+	};
+}
+
+TEST(buffered_writer, gathers_writes) {
+	ziopp::memory_filesystem fs{};
+	std::vector<std::pair<uint64_t, size_t>> writes;
+	std::string expected;
+	{
+		ziopp::write_options options{};
+		options.buffer_size = 4096;
+		ziopp::buffered_writer writer{ std::unique_ptr<ziopp::file_handle>(new logging_file_handle(fs.open_handle(ziopp::upath{ "/log.txt" }, ziopp::file_mode::create, ziopp::file_access::write), writes)), 0, options };
+		for (int i = 0; i < 1000; i++)
+		{
+			std::string line = "line " + std::to_string(i) + "\n";
+			writer.write(line);
+			expected += line;
+		}
+		ASSERT_EQ(expected.size(), writer.position());
+		ASSERT_EQ(expected.size() / 4096, writes.size());
+
+		// Writes as large as the buffer are not copied
+		writer.flush();
+		std::string large(10000, 'x');
+		writer.write(large);
+		expected += large;
+		ASSERT_EQ(std::make_pair(static_cast<uint64_t>(expected.size() - large.size()), large.size()), writes.back());
+		writer.write(std::string{ "tail" });
+		expected += "tail";
+	}
+	ASSERT_EQ(expected, fs.read_all_text(ziopp::upath{ "/log.txt" }));
+}
+
+TEST(buffered_writer, aligned) {
+	ziopp::memory_filesystem fs{};
+	std::string expected(700, 'a');
+	fs.write_all_text(ziopp::upath{ "/data.bin" }, expected);
+
+	std::vector<std::pair<uint64_t, size_t>> writes;
+	{
+		ziopp::write_options options{};
+		options.buffer_size = 1000;
+		options.alignment = 512;
+		ziopp::buffered_writer writer{ std::unique_ptr<ziopp::file_handle>(new logging_file_handle(fs.open_handle(ziopp::upath{ "/data.bin" }, ziopp::file_mode::open, ziopp::file_access::read_write), writes)), 700, options };
+		for (int i = 0; i < 300; i++)
+		{
+			std::string piece = std::to_string(i) + ",";
+			writer.write(piece);
+			expected += piece;
+			if (i % 50 == 0)
+			{
+				writer.flush();
+			}
+		}
+		writer.sync();
+		ASSERT_EQ(expected, fs.read_all_text(ziopp::upath{ "/data.bin" }));
+	}
+	for (const std::pair<uint64_t, size_t>& write : writes)
+	{
+		ASSERT_EQ(0u, write.first % 512);
+		ASSERT_LE(write.second, 1024u);
+		// Only the bytes of the last block of a flush are written alone
+		ASSERT_TRUE(write.second % 512 == 0 || write.second < 512);
+	}
+	ASSERT_EQ(expected, fs.read_all_text(ziopp::upath{ "/data.bin" }));
+	ASSERT_THROW(ziopp::buffered_writer(fs.open_handle(ziopp::upath{ "/data.bin" }, ziopp::file_mode::open, ziopp::file_access::write), 0, ziopp::write_options{ 1024, 100 }), std::invalid_argument);
+}
+
+TEST(buffered_writer, group_appender) {
+	ziopp::memory_filesystem fs{};
+	std::string header{ "header\n" };
+	fs.write_all_text(ziopp::upath{ "/log.txt" }, header);
+
+	std::vector<std::string> expected{ "header" };
+	{
+		ziopp::append_options options{};
+		options.sync = true;
+		ziopp::group_appender appender{ fs.open_handle(ziopp::upath{ "/log.txt" }, ziopp::file_mode::append, ziopp::file_access::write), options };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 8; t++)
+		{
+			for (int i = 0; i < 200; i++)
+			{
+				expected.push_back("thread " + std::to_string(t) + " line " + std::to_string(i));
+			}
+			threads.emplace_back([&appender, t]() {
+				for (int i = 0; i < 200; i++)
+				{
+					appender.append("thread " + std::to_string(t) + " line " + std::to_string(i) + "\n");
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		ASSERT_EQ(1600u, appender.appends());
+		ASSERT_GE(1600u, appender.batches());
+	}
+
+	std::vector<std::string> lines = fs.read_all_lines(ziopp::upath{ "/log.txt" });
+	ASSERT_EQ("header", lines.front());
+	std::sort(lines.begin(), lines.end());
+	std::sort(expected.begin(), expected.end());
+	ASSERT_EQ(expected, lines);
+}
+
+TEST(buffered_writer, group_appender_failures) {
+	ziopp::memory_filesystem fs{};
+	bool fail = false;
+	ziopp::group_appender appender{ std::unique_ptr<ziopp::file_handle>(new failing_file_handle(fs.open_handle(ziopp::upath{ "/log.txt" }, ziopp::file_mode::create, ziopp::file_access::write), fail)) };
+	appender.append(std::string{ "first\n" });
+	fail = true;
+	ASSERT_THROW(appender.append(std::string{ "lost\n" }), std::ios_base::failure);
+
+	// Only the failed append throws, and the next one takes its place
+	appender.append(std::string{ "second\n" });
+	ASSERT_EQ("first\nsecond\n", fs.read_all_text(ziopp::upath{ "/log.txt" }));
+}
+
+#ifdef ZIOPP_POSIX
+TEST(buffered_writer, posix_direct) {
+	char name[] = "/tmp/ziopp-buffered-writer-XXXXXX";
+	int descriptor = mkstemp(name);
+	ASSERT_GE(descriptor, 0);
+	close(descriptor);
+
+	std::string expected;
+	{
+		ziopp::write_options options{};
+		options.buffer_size = 8192;
+		options.alignment = 4096;
+		ziopp::buffered_writer writer{ ziopp::posix_file_handle::open(name, ziopp::file_mode::create, ziopp::file_access::read_write, true), 0, options };
+		for (int i = 0; i < 2000; i++)
+		{
+			std::string line = std::to_string(i) + "\n";
+			writer.write(line);
+			expected += line;
+		}
+		writer.sync();
+	}
+
+	std::unique_ptr<ziopp::posix_file_handle> reopened = ziopp::posix_file_handle::open(name, ziopp::file_mode::open, ziopp::file_access::read);
+	std::string content(static_cast<size_t>(reopened->size()), '\0');
+	reopened->read_at(0, reinterpret_cast<uint8_t*>(&content[0]), content.size());
+	ASSERT_EQ(expected, content);
+	unlink(name);
+}
+#endif
@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <thread>
+#include <ziopp/cas_filesystem.h>
+#include <ziopp/memory_filesystem.h>
+
+namespace {
+	std::string random_content(size_t length, uint32_t seed)
+	{
+		std::string content(length, '\0');
+		uint32_t state = seed;
+		for (char& c : content)
+		{
+			state = state * 1664525 + 1013904223;
+			c = static_cast<char>(state >> 24);
+		}
+		return content;
+	}
+
+	size_t count_files(const ziopp::filesystem& fs, const ziopp::upath& directory)
+	{
+		size_t count = 0;
+		for (ziopp::upath_iterator it = fs.enumerate_paths(directory, "*", ziopp::search_options::all_directories, ziopp::search_target::file); it != ziopp::upath_iterator{}; ++it)
+		{
+			count++;
+		}
+		return count;
+	}
+}
+
+TEST(cas_filesystem, deduplicates_contents) {
+	ziopp::memory_filesystem store{};
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	fs.create_directory(ziopp::upath{ "/data" });
+
+	std::string content = random_content(256 * 1024, 1);
+	fs.write_all_text(ziopp::upath{ "/data/a.bin" }, content);
+	// Uncommitted writes are visible to reads
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/data/a.bin" }));
+	fs.flush();
+	ziopp::cas_statistics first = fs.statistics();
+	ASSERT_EQ(content.size(), first.logical_bytes);
+	ASSERT_EQ(content.size(), first.stored_bytes);
+	ASSERT_GT(first.chunks_written, 4u);
+
+	fs.write_all_text(ziopp::upath{ "/data/b.bin" }, content);
+	fs.flush();
+	ziopp::cas_statistics second = fs.statistics();
+	ASSERT_EQ(first.stored_bytes, second.stored_bytes);
+	ASSERT_EQ(first.chunks_written, second.chunks_deduplicated);
+
+	// An insertion only changes the chunks around it
+	std::string edited = content.substr(0, 100000) + "inserted" + content.substr(100000);
+	fs.write_all_text(ziopp::upath{ "/data/c.bin" }, edited);
+	fs.flush();
+	ASSERT_LT(fs.statistics().stored_bytes - second.stored_bytes, 3u * 64u * 1024u);
+	ASSERT_EQ(edited, fs.read_all_text(ziopp::upath{ "/data/c.bin" }));
+
+	// Copies only copy the manifest
+	ziopp::cas_statistics third = fs.statistics();
+	fs.copy_file(ziopp::upath{ "/data/a.bin" }, ziopp::upath{ "/data/d.bin" }, false);
+	ASSERT_EQ(third.stored_bytes, fs.statistics().stored_bytes);
+	ASSERT_EQ(third.logical_bytes, fs.statistics().logical_bytes);
+	ASSERT_EQ(content.size(), fs.file_length(ziopp::upath{ "/data/d.bin" }));
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/data/d.bin" }));
+	ziopp::cas_statistics fourth = fs.statistics();
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/data/d.bin" }));
+	ASSERT_EQ(fourth.cache_misses, fs.statistics().cache_misses);
+	ASSERT_GT(fs.statistics().cache_hits, fourth.cache_hits);
+
+	std::vector<std::string> names;
+	for (ziopp::upath_iterator it = fs.enumerate_paths(ziopp::upath{ "/data" }, "*", ziopp::search_options::top_directory_only, ziopp::search_target::file); it != ziopp::upath_iterator{}; ++it)
+	{
+		names.push_back(it->full_name());
+	}
+	ASSERT_THAT(names, ::testing::UnorderedElementsAre("/data/a.bin", "/data/b.bin", "/data/c.bin", "/data/d.bin"));
+}
+
+TEST(cas_filesystem, reopens_and_collects_garbage) {
+	ziopp::memory_filesystem store{};
+	std::string content = random_content(64 * 1024, 2);
+	std::string other = random_content(64 * 1024, 3);
+	{
+		ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+		fs.write_all_text(ziopp::upath{ "/a.bin" }, content);
+		fs.write_all_text(ziopp::upath{ "/b.bin" }, other);
+		fs.write_time(ziopp::upath{ "/a.bin" }, std::chrono::system_clock::time_point(std::chrono::hours(1)));
+	}
+
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/a.bin" }));
+	ASSERT_EQ(std::chrono::system_clock::time_point(std::chrono::hours(1)), fs.write_time(ziopp::upath{ "/a.bin" }));
+	ASSERT_EQ(0u, fs.collect_garbage());
+
+	size_t chunks = count_files(store, ziopp::upath{ "/cas/chunks" });
+	fs.delete_file(ziopp::upath{ "/b.bin" });
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/b.bin" }));
+	size_t collected = fs.collect_garbage();
+	ASSERT_GT(collected, 0u);
+	ASSERT_EQ(chunks - collected, count_files(store, ziopp::upath{ "/cas/chunks" }));
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/a.bin" }));
+
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/a.bin" }, ziopp::file_mode::open, ziopp::file_access::read_write);
+	handle->write_at(10, reinterpret_cast<const uint8_t*>("xyz"), 3);
+	handle.reset();
+	ASSERT_EQ("xyz", fs.read_all_text(ziopp::upath{ "/a.bin" }).substr(10, 3));
+	ASSERT_EQ(content.size(), fs.file_length(ziopp::upath{ "/a.bin" }));
+
+	ASSERT_THROW(fs.open_handle(ziopp::upath{ "/missing.bin" }, ziopp::file_mode::open, ziopp::file_access::read), std::ios_base::failure);
+	ASSERT_THROW(fs.open_handle(ziopp::upath{ "/a.bin" }, ziopp::file_mode::create_new, ziopp::file_access::write), std::ios_base::failure);
+}
+
+TEST(cas_filesystem, counts_each_commit_of_a_file_once) {
+	ziopp::memory_filesystem store{};
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	std::string content = random_content(32 * 1024, 4);
+
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/a.bin" }, ziopp::file_mode::create_new, ziopp::file_access::write);
+	handle->write_at(0, reinterpret_cast<const uint8_t*>(content.data()), 16 * 1024);
+	handle->sync();
+	ASSERT_EQ(16u * 1024u, fs.statistics().logical_bytes);
+	handle->write_at(16 * 1024, reinterpret_cast<const uint8_t*>(content.data() + 16 * 1024), 16 * 1024);
+	handle->sync();
+	handle.reset();
+	ASSERT_EQ(content.size(), fs.statistics().logical_bytes);
+	ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/a.bin" }));
+
+	// Chunks are moved into place once written
+	for (ziopp::upath_iterator it = store.enumerate_paths(ziopp::upath{ "/cas/chunks" }, "*", ziopp::search_options::all_directories, ziopp::search_target::file); it != ziopp::upath_iterator{}; ++it)
+	{
+		ASSERT_EQ(std::string::npos, it->name().find(".tmp"));
+	}
+}
+
+TEST(cas_filesystem, detects_corrupt_chunks) {
+	ziopp::memory_filesystem store{};
+	std::string content = random_content(64 * 1024, 3);
+	{
+		ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+		fs.write_all_text(ziopp::upath{ "/a.bin" }, content);
+		fs.flush();
+	}
+
+	// Flip one byte of one chunk, keeping its length
+	ziopp::upath_iterator chunk = store.enumerate_paths(ziopp::upath{ "/cas/chunks" }, "*", ziopp::search_options::all_directories, ziopp::search_target::file);
+	std::unique_ptr<ziopp::file_handle> handle = store.open_handle(*chunk, ziopp::file_mode::open, ziopp::file_access::read_write);
+	uint8_t byte = 0;
+	handle->read_at(0, &byte, 1);
+	byte ^= 0xff;
+	handle->write_at(0, &byte, 1);
+	handle.reset();
+
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	ASSERT_THROW(fs.read_all_text(ziopp::upath{ "/a.bin" }), std::ios_base::failure);
+}
+
+TEST(cas_filesystem, commits_files_sharing_chunks_at_once) {
+	ziopp::memory_filesystem store{};
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	std::string content = random_content(256 * 1024, 4);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&fs, &content, t]() {
+			std::string copy = content;
+			fs.write_all_text(ziopp::upath{ "/" + std::to_string(t) + ".bin" }, copy);
+			fs.flush();
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ziopp::cas_statistics statistics = fs.statistics();
+	ASSERT_EQ(content.size(), statistics.stored_bytes);
+	for (int t = 0; t < 4; t++)
+	{
+		ASSERT_EQ(content, fs.read_all_text(ziopp::upath{ "/" + std::to_string(t) + ".bin" }));
+	}
+	// No temporary is left behind
+	ASSERT_EQ(0u, fs.collect_garbage());
+}
+
+TEST(cas_filesystem, commits_streams_opened_again) {
+	ziopp::memory_filesystem store{};
+	ziopp::cas_filesystem fs{ store, ziopp::upath{ "/cas" } };
+	std::iostream& first = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::create, ziopp::file_access::write);
+	first << "first";
+	ASSERT_EQ(0u, fs.statistics().logical_bytes);
+
+	// Opening the file the same way again closes the earlier stream, which commits what it wrote
+	std::iostream& second = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::create, ziopp::file_access::write);
+	ASSERT_EQ(5u, fs.statistics().logical_bytes);
+	second << "second";
+	second.flush();
+	ASSERT_EQ("second", fs.read_all_text(ziopp::upath{ "/a.txt" }));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <ziopp/content_hash.h>
+#include <ziopp/memory_filesystem.h>
+
+namespace {
+	std::string sequence(size_t length)
+	{
+		std::string content(length, '\0');
+		for (size_t i = 0; i < length; ++i)
+		{
+			content[i] = static_cast<char>(i % 251);
+		}
+		return content;
+	}
+
+	std::string hash_hex(ziopp::hash_algorithm algorithm, const std::string& content)
+	{
+		return ziopp::to_hex(ziopp::content_hasher::hash(algorithm, reinterpret_cast<const uint8_t*>(content.data()), content.size()));
+	}
+
+	struct hash_data {
+		size_t length;
+		std::string xxh64;
+		std::string sha256;
+		std::string blake3;
+	};
+
+	class content_hash_fixture : public ::testing::TestWithParam<hash_data> {
+	};
+}
+
+TEST_P(content_hash_fixture, known_digests) {
+	hash_data data = GetParam();
+	std::string content = sequence(data.length);
+	ASSERT_EQ(data.xxh64, hash_hex(ziopp::hash_algorithm::xxh64, content));
+	ASSERT_EQ(data.sha256, hash_hex(ziopp::hash_algorithm::sha256, content));
+	ASSERT_EQ(data.blake3, hash_hex(ziopp::hash_algorithm::blake3, content));
+
+	// Feeding the content in uneven pieces gives the same digests
+	for (ziopp::hash_algorithm algorithm : { ziopp::hash_algorithm::xxh64, ziopp::hash_algorithm::sha256, ziopp::hash_algorithm::blake3 })
+	{
+		ziopp::content_hasher hasher{ algorithm };
+		for (size_t offset = 0, piece = 1; offset < content.size(); offset += piece, piece = piece * 3 % 1031 + 1)
+		{
+			hasher.update(reinterpret_cast<const uint8_t*>(content.data()) + offset, std::min(piece, content.size() - offset));
+		}
+		ASSERT_EQ(hash_hex(algorithm, content), ziopp::to_hex(hasher.finish()));
+	}
+}
+
+INSTANTIATE_TEST_CASE_P(content_hash, content_hash_fixture, ::testing::Values(
+	hash_data{ 0, "ef46db3751d8e999", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262" },
+	hash_data{ 1, "e934a84adb052768", "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d", "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213" },
+	hash_data{ 33, "0c535d1acafb8ead", "5d8fcfefa9aeeb711fb8ed1e4b7d5c8a9bafa46e8e76e68aa18adce5a10df6ab", "4f4e6c1dffd3a6c9959876d15aa96b5fb0da8632b995f6ca2e30503f2829fa29" },
+	hash_data{ 1024, "138e26c65048ce29", "2bce1ba628720664be4b9fdd77aae0678e5f0f3f02fc6ff641ec879094f6a404", "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7" },
+	hash_data{ 1025, "cfd73aedd2d6a39d", "bc0b6b10b89b9487a12fda2a8cc13194e7091c217aabf8b92846274026f4bcd0", "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444" },
+	hash_data{ 4097, "ba236f554636de5b", "a16560d668b843fb3be99ace41dbd18471f342bd3255a1d21204b35e43f74436", "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995" },
+	hash_data{ 8193, "755e4befd10cccf4", "7e3691790cd64b19d4edb1a80e988214515abeb53aa0f34ffbfe4b4bf405d120", "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b" },
+	hash_data{ 102400, "eb1adcdd9e1369a6", "74588b7f0bcc354ac14d9cf199fa3a20c05f0c7293b9075b2f2e146e718de800", "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085" }
+));
+
+TEST(content_hash, hash_file) {
+	ziopp::memory_filesystem fs{};
+	std::string content = sequence(3158073);
+	fs.write_all_text(ziopp::upath{ "/large.bin" }, content);
+
+	ziopp::thread_pool pool{ 4 };
+	ziopp::hash_options options{};
+	options.work_executor = &pool;
+	options.parallel_threshold = 1024 * 1024;
+	// Hashed in four pieces on the pool, then again in one go
+	ASSERT_EQ("ce1148523b8586723c3fd8b1fe92fe16394888a360c96965bf3b1900421f3e19", ziopp::to_hex(fs.hash_file(ziopp::upath{ "/large.bin" }, ziopp::hash_algorithm::blake3, options)));
+	ASSERT_EQ("ce1148523b8586723c3fd8b1fe92fe16394888a360c96965bf3b1900421f3e19", ziopp::to_hex(fs.hash_file(ziopp::upath{ "/large.bin" }, ziopp::hash_algorithm::blake3)));
+	ASSERT_EQ("1cdde29b8090c73a27338d4ca7cfd64e3a6433439643d9b311b5a8fb424d122b", ziopp::to_hex(fs.hash_file(ziopp::upath{ "/large.bin" }, ziopp::hash_algorithm::sha256, options)));
+	ASSERT_EQ("df2bb9598320e62b", ziopp::to_hex(fs.hash_file(ziopp::upath{ "/large.bin" }, ziopp::hash_algorithm::xxh64, options)));
+}
+
+TEST(content_hash, hash_cache) {
+	ziopp::memory_filesystem fs{};
+	std::string content{ "abc" };
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, content);
+	fs.write_time(ziopp::upath{ "/a.txt" }, std::chrono::system_clock::time_point(std::chrono::hours(1)));
+
+	ziopp::hash_cache cache{ 2 };
+	ziopp::hash_options options{};
+	options.cache = &cache;
+	std::vector<uint8_t> digest = fs.hash_file(ziopp::upath{ "/a.txt" }, ziopp::hash_algorithm::blake3, options);
+	ASSERT_EQ("6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85", ziopp::to_hex(digest));
+	ASSERT_EQ(1u, cache.size());
+
+	// The cache trusts the length and write time, so a change that keeps both is not noticed
+	std::string other{ "xyz" };
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, other);
+	fs.write_time(ziopp::upath{ "/a.txt" }, std::chrono::system_clock::time_point(std::chrono::hours(1)));
+	ASSERT_EQ(digest, fs.hash_file(ziopp::upath{ "/a.txt" }, ziopp::hash_algorithm::blake3, options));
+
+	fs.write_time(ziopp::upath{ "/a.txt" }, std::chrono::system_clock::time_point(std::chrono::hours(2)));
+	ASSERT_NE(digest, fs.hash_file(ziopp::upath{ "/a.txt" }, ziopp::hash_algorithm::blake3, options));
+	ASSERT_EQ(1u, cache.size());
+
+	fs.hash_file(ziopp::upath{ "/a.txt" }, ziopp::hash_algorithm::sha256, options);
+	fs.hash_file(ziopp::upath{ "/a.txt" }, ziopp::hash_algorithm::xxh64, options);
+	ASSERT_EQ(2u, cache.size());
+	cache.invalidate(ziopp::upath{ "/a.txt" });
+	ASSERT_EQ(0u, cache.size());
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <thread>
+#include <ziopp/dentry_cache.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+
+TEST(dentry_cache, generations) {
+	ziopp::dentry_cache cache{};
+	ziopp::dentry_kind kind;
+	ASSERT_FALSE(cache.find(ziopp::upath{ "/etc/app.conf" }, kind));
+
+	cache.insert(ziopp::upath{ "/etc/app.conf" }, cache.stamp(ziopp::upath{ "/etc/app.conf" }), ziopp::dentry_kind::missing);
+	cache.insert(ziopp::upath{ "/etc/other.conf" }, cache.stamp(ziopp::upath{ "/etc/other.conf" }), ziopp::dentry_kind::file);
+	cache.insert(ziopp::upath{ "/etc" }, cache.stamp(ziopp::upath{ "/etc" }), ziopp::dentry_kind::directory);
+	cache.insert_internal(ziopp::upath{ "/etc" }, cache.stamp(ziopp::upath{ "/etc" }), "C:\\etc");
+	ASSERT_TRUE(cache.find(ziopp::upath{ "/etc/app.conf" }, kind));
+	ASSERT_EQ(ziopp::dentry_kind::missing, kind);
+	ASSERT_TRUE(cache.find(ziopp::upath{ "/etc" }, kind));
+	ASSERT_EQ(ziopp::dentry_kind::directory, kind);
+	std::string system_path;
+	ASSERT_TRUE(cache.find_internal(ziopp::upath{ "/etc" }, system_path));
+	ASSERT_EQ("C:\\etc", system_path);
+
+	// A change in /etc invalidates its entries but not /etc itself
+	cache.invalidate(ziopp::upath{ "/etc/app.conf" });
+	ASSERT_FALSE(cache.find(ziopp::upath{ "/etc/app.conf" }, kind));
+	ASSERT_FALSE(cache.find(ziopp::upath{ "/etc/other.conf" }, kind));
+	ASSERT_TRUE(cache.find(ziopp::upath{ "/etc" }, kind));
+
+	// A lookup that started before a change is not remembered
+	ziopp::dentry_stamp stamp = cache.stamp(ziopp::upath{ "/etc/app.conf" });
+	cache.invalidate(ziopp::upath{ "/etc/app.conf" });
+	cache.insert(ziopp::upath{ "/etc/app.conf" }, stamp, ziopp::dentry_kind::missing);
+	ASSERT_FALSE(cache.find(ziopp::upath{ "/etc/app.conf" }, kind));
+
+	cache.invalidate_all();
+	ASSERT_FALSE(cache.find(ziopp::upath{ "/etc" }, kind));
+	ziopp::dentry_cache_statistics statistics = cache.statistics();
+	ASSERT_EQ(0u, statistics.entries);
+	ASSERT_EQ(3u, statistics.hits);
+	ASSERT_EQ(1u, statistics.negative_hits);
+	ASSERT_EQ(5u, statistics.misses);
+}
+
+TEST(dentry_cache, bounded) {
+	ziopp::dentry_cache_options options{};
+	options.shard_count = 3;
+	options.max_entries = 64;
+	ziopp::dentry_cache cache{ options };
+	for (int i = 0; i < 1000; i++)
+	{
+		ziopp::upath path{ "/file" + std::to_string(i) };
+		cache.insert(path, cache.stamp(path), ziopp::dentry_kind::file);
+	}
+	ASSERT_GE(64u, cache.statistics().entries);
+}
+
+TEST(dentry_cache, bounded_generations) {
+	ziopp::dentry_cache_options options{};
+	options.shard_count = 1;
+	options.max_entries = 16;
+	ziopp::dentry_cache cache{ options };
+	ziopp::dentry_kind kind;
+	ziopp::upath kept{ "/a/kept" };
+	cache.insert(kept, cache.stamp(kept), ziopp::dentry_kind::file);
+
+	// Files have no generation of their own, so changing many only changes that of their directory
+	for (int i = 0; i < 100; i++)
+	{
+		cache.invalidate_file(ziopp::upath{ "/b/file" + std::to_string(i) });
+	}
+	ASSERT_TRUE(cache.find(kept, kind));
+
+	// Once a shard has as many generations as entries, they are forgotten with every entry
+	for (int i = 0; i < 20; i++)
+	{
+		cache.invalidate(ziopp::upath{ "/c/directory" + std::to_string(i) });
+	}
+	ASSERT_FALSE(cache.find(kept, kind));
+	cache.insert(kept, cache.stamp(kept), ziopp::dentry_kind::file);
+	ASSERT_TRUE(cache.find(kept, kind));
+}
+
+TEST(dentry_cache, filesystem) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem metrics{ memory };
+	ziopp::dentry_cache_filesystem fs{ metrics };
+	std::string content{ "key=value" };
+	fs.create_directory(ziopp::upath{ "/etc" });
+	fs.write_all_text(ziopp::upath{ "/etc/app.conf" }, content);
+
+	// Probing candidate locations asks the wrapped filesystem once
+	std::vector<ziopp::upath> candidates{ ziopp::upath{ "/home/app.conf" }, ziopp::upath{ "/usr/etc/app.conf" }, ziopp::upath{ "/etc/app.conf" } };
+	for (int i = 0; i < 10; i++)
+	{
+		ASSERT_FALSE(fs.file_exists(candidates[0]));
+		ASSERT_FALSE(fs.file_exists(candidates[1]));
+		ASSERT_TRUE(fs.file_exists(candidates[2]));
+		ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/etc" }));
+		ASSERT_EQ((std::vector<bool>{ false, false, true }), fs.exists_many(candidates));
+	}
+	ziopp::filesystem_metrics counts = metrics.snapshot();
+	ASSERT_EQ(3u, counts[ziopp::filesystem_operation::file_exists].calls);
+	ASSERT_EQ(3u, counts[ziopp::filesystem_operation::directory_exists].calls);
+	ASSERT_EQ(0u, counts[ziopp::filesystem_operation::exists_many].calls);
+
+	// Creating a file at a missing path is seen
+	fs.create_directory(ziopp::upath{ "/usr/etc" });
+	fs.write_all_text(ziopp::upath{ "/usr/etc/app.conf" }, content);
+	ASSERT_TRUE(fs.file_exists(candidates[1]));
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/usr" }));
+
+	fs.delete_directory(ziopp::upath{ "/usr" }, true);
+	ASSERT_FALSE(fs.file_exists(candidates[1]));
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/usr" }));
+}
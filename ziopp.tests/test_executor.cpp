@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <ziopp/executor.h>
+
+namespace {
+	void spawn(ziopp::work_group& group, std::atomic<int>& count, int depth)
+	{
+		count++;
+		if (depth == 0)
+		{
+			return;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			group.run([&group, &count, depth]() { spawn(group, count, depth - 1); });
+		}
+	}
+}
+
+TEST(executor, inline_executor_runs_on_caller) {
+	ziopp::inline_executor executor{};
+	std::thread::id ran_on{};
+	executor.post([&ran_on]() { ran_on = std::this_thread::get_id(); });
+	ASSERT_EQ(std::this_thread::get_id(), ran_on);
+}
+
+TEST(executor, thread_pool_runs_pending_work) {
+	std::mutex mutex;
+	std::set<std::thread::id> threads;
+	std::atomic<int> count{ 0 };
+	{
+		ziopp::thread_pool pool{ 3 };
+		ASSERT_EQ(3u, pool.size());
+		for (int i = 0; i < 100; i++)
+		{
+			pool.post([&mutex, &threads, &count]() {
+				std::lock_guard<std::mutex> lock{ mutex };
+				threads.insert(std::this_thread::get_id());
+				count++;
+			});
+		}
+	}
+	// The destructor runs the work still queued
+	ASSERT_EQ(100, count.load());
+	ASSERT_EQ(0u, threads.count(std::this_thread::get_id()));
+	ASSERT_GE(3u, threads.size());
+	ASSERT_EQ(&ziopp::thread_pool::shared(), &ziopp::thread_pool::shared());
+	ASSERT_LT(0u, ziopp::thread_pool::shared().size());
+}
+
+TEST(executor, thread_pool_nested_work) {
+	ziopp::thread_pool pool{ 4 };
+	std::atomic<int> count{ 0 };
+	ziopp::work_group group{ pool, 0 };
+	group.run([&group, &count]() { spawn(group, count, 5); });
+	group.wait();
+	// 1 + 3 + 9 + 27 + 81 + 243
+	ASSERT_EQ(364, count.load());
+}
+
+TEST(executor, work_group_limits_concurrency) {
+	ziopp::thread_pool pool{ 8 };
+	std::atomic<int> running{ 0 };
+	std::atomic<int> highest{ 0 };
+	ziopp::work_group group{ pool, 2 };
+	for (int i = 0; i < 32; i++)
+	{
+		group.run([&running, &highest]() {
+			int now = ++running;
+			int seen = highest.load();
+			while (now > seen && !highest.compare_exchange_weak(seen, now))
+			{
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			running--;
+		});
+	}
+	group.wait();
+	ASSERT_LE(highest.load(), 2);
+}
+
+TEST(executor, work_group_rethrows) {
+	ziopp::thread_pool pool{ 2 };
+	std::atomic<int> ran{ 0 };
+	ziopp::work_group group{ pool, 1 };
+	group.run([]() { throw std::runtime_error("failed"); });
+	for (int i = 0; i < 10; i++)
+	{
+		group.run([&ran]() { ran++; });
+	}
+	ASSERT_THROW(group.wait(), std::runtime_error);
+	ASSERT_FALSE(group.failed());
+	ASSERT_EQ(0, ran.load());
+}
+
+TEST(executor, work_group_waits_on_pool_threads) {
+	// Every thread of the pool waits for a group of its own, so the waiting threads have to run the work themselves
+	ziopp::thread_pool pool{ 2 };
+	std::atomic<int> count{ 0 };
+	ziopp::work_group outer{ pool, 0 };
+	for (int i = 0; i < 4; i++)
+	{
+		outer.run([&pool, &count]() {
+			ziopp::work_group inner{ pool, 2 };
+			inner.run([&inner, &count]() { spawn(inner, count, 3); });
+			inner.wait();
+		});
+	}
+	outer.wait();
+	// 4 * (1 + 3 + 9 + 27)
+	ASSERT_EQ(160, count.load());
+}
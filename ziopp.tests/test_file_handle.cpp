@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <thread>
+#include <ziopp/file_handle.h>
+#include <ziopp/memory_filesystem.h>
+
+#ifdef ZIOPP_POSIX
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace {
+	void check_read_write(ziopp::file_handle& handle)
+	{
+		const uint8_t data[] = { 'a', 'b', 'c', 'd', 'e', 'f' };
+		ASSERT_EQ(6u, handle.write_at(0, data, sizeof(data)));
+		ASSERT_EQ(2u, handle.write_at(8, data, 2));
+		ASSERT_EQ(10u, handle.size());
+
+		uint8_t buffer[16] = {};
+		ASSERT_EQ(3u, handle.read_at(2, buffer, 3));
+		ASSERT_EQ(std::string("cde"), std::string(buffer, buffer + 3));
+
+		// Reads past the end of the file are short
+		ASSERT_EQ(2u, handle.read_at(8, buffer, sizeof(buffer)));
+		ASSERT_EQ(std::string("ab"), std::string(buffer, buffer + 2));
+		ASSERT_EQ(0u, handle.read_at(20, buffer, sizeof(buffer)));
+
+		handle.sync();
+	}
+}
+
+TEST(file_handle, stream_file_handle) {
+	std::stringstream stream{ std::ios_base::in | std::ios_base::out | std::ios_base::binary };
+	ziopp::stream_file_handle handle{ stream };
+	check_read_write(handle);
+}
+
+TEST(file_handle, stream_file_handle_appends) {
+	std::stringstream stream{ "abc", std::ios_base::in | std::ios_base::out | std::ios_base::binary };
+	ziopp::stream_file_handle first{ stream, true };
+	ziopp::stream_file_handle second{ stream, true };
+	uint64_t stale = first.size();
+	second.write_at(second.size(), reinterpret_cast<const uint8_t*>("de"), 2);
+	first.write_at(stale, reinterpret_cast<const uint8_t*>("fg"), 2);
+	ASSERT_EQ("abcdefg", stream.str());
+}
+
+TEST(file_handle, memory_filesystem) {
+	ziopp::memory_filesystem fs{};
+	ziopp::upath path{ "/file" };
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(path, ziopp::file_mode::create_new, ziopp::file_access::read_write);
+	check_read_write(*handle);
+	ASSERT_EQ(10u, fs.file_length(path));
+
+	std::unique_ptr<ziopp::file_handle> reader = fs.open_handle(path, ziopp::file_mode::open, ziopp::file_access::read);
+	uint8_t buffer[1];
+	ASSERT_THROW(reader->write_at(0, buffer, 1), std::ios_base::failure);
+	ASSERT_THROW(fs.open_handle(ziopp::upath{ "/missing" }, ziopp::file_mode::open, ziopp::file_access::read), std::ios_base::failure);
+}
+
+TEST(file_handle, concurrent_reads) {
+	ziopp::memory_filesystem fs{};
+	std::vector<uint8_t> content(4096);
+	for (size_t i = 0; i < content.size(); i++)
+	{
+		content[i] = static_cast<uint8_t>(i);
+	}
+	fs.write_all_binary(ziopp::upath{ "/file" }, content);
+
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/file" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::vector<std::thread> threads;
+	// Not vector<bool>, whose elements share words so writing them from many threads races
+	std::vector<char> matched(4, 0);
+	for (size_t t = 0; t < matched.size(); t++)
+	{
+		threads.emplace_back([&, t]() {
+			std::vector<uint8_t> buffer(1024);
+			handle->read_at(t * 1024, buffer.data(), buffer.size());
+			matched[t] = std::equal(buffer.begin(), buffer.end(), content.begin() + t * 1024);
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_THAT(matched, ::testing::Each(1));
+}
+
+namespace {
+	class counting_file_handle : public ziopp::stream_file_handle {
+	public:
+		explicit counting_file_handle(std::iostream& stream) : ziopp::stream_file_handle(stream), reads(0)
+		{
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<ziopp::io_segment>& segments) override
+		{
+			reads++;
+			return ziopp::stream_file_handle::read_vectored(offset, segments);
+		}
+
+		size_t reads;
+	};
+
+	std::string sequence(size_t length)
+	{
+		std::string content(length, '\0');
+		for (size_t i = 0; i < length; i++)
+		{
+			content[i] = static_cast<char>('a' + i % 26);
+		}
+		return content;
+	}
+}
+
+TEST(file_handle, read_ranges) {
+	std::string content = sequence(100000);
+	std::stringstream stream{ content, std::ios_base::in | std::ios_base::out | std::ios_base::binary };
+	counting_file_handle handle{ stream };
+
+	std::vector<uint64_t> offsets{ 5000, 10, 50, 60000, 5010, 30, 99990 };
+	std::vector<std::vector<uint8_t>> buffers(offsets.size(), std::vector<uint8_t>(16));
+	std::vector<ziopp::file_range> ranges;
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		ranges.push_back(ziopp::file_range{ offsets[i], buffers[i].size(), buffers[i].data() });
+	}
+
+	std::vector<size_t> filled(ranges.size(), 0);
+	ziopp::read_ranges_options options{};
+	options.max_gap = 64;
+	handle.read_ranges(ranges, [&filled](size_t index, size_t read) { filled[index] = read; }, options);
+
+	// 10, 30 and 50 are combined into one read, 5010 overlaps 5000 so they are read separately
+	ASSERT_EQ(5u, handle.reads);
+	ASSERT_THAT(filled, ::testing::ElementsAre(16, 16, 16, 16, 16, 16, 10));
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		ASSERT_EQ(content.substr(static_cast<size_t>(offsets[i]), filled[i]), std::string(buffers[i].begin(), buffers[i].begin() + filled[i]));
+	}
+}
+
+TEST(file_handle, read_ranges_memory_filesystem) {
+	ziopp::memory_filesystem fs{};
+	std::string content = sequence(1000);
+	fs.write_all_text(ziopp::upath{ "/file" }, content);
+
+	std::vector<uint8_t> first(10);
+	std::vector<uint8_t> second(10);
+	std::vector<ziopp::file_range> ranges{ ziopp::file_range{ 500, second.size(), second.data() }, ziopp::file_range{ 100, first.size(), first.data() } };
+	size_t calls = 0;
+	fs.read_ranges(ziopp::upath{ "/file" }, ranges, [&calls](size_t, size_t read) { calls++; ASSERT_EQ(10u, read); });
+	ASSERT_EQ(2u, calls);
+	ASSERT_EQ(content.substr(100, 10), std::string(first.begin(), first.end()));
+	ASSERT_EQ(content.substr(500, 10), std::string(second.begin(), second.end()));
+}
+
+namespace {
+	// Counts the writes made through it
+	class write_counting_file_handle : public ziopp::stream_file_handle {
+	public:
+		explicit write_counting_file_handle(std::iostream& stream) : ziopp::stream_file_handle(stream), writes(std::make_shared<size_t>(0))
+		{
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			(*writes)++;
+			return ziopp::stream_file_handle::write_at(offset, buffer, count);
+		}
+
+		std::shared_ptr<size_t> writes;
+	};
+}
+
+TEST(file_handle, handle_stream_buffers_writes) {
+	std::stringstream backing{ std::ios_base::in | std::ios_base::out | std::ios_base::binary };
+	write_counting_file_handle* handle = new write_counting_file_handle(backing);
+	std::shared_ptr<size_t> writes = handle->writes;
+	{
+		ziopp::handle_stream stream{ std::unique_ptr<ziopp::file_handle>(handle), false };
+		std::string content = sequence(1000);
+		for (char c : content)
+		{
+			stream.put(c);
+		}
+		ASSERT_EQ(0u, *writes);
+		stream.flush();
+		ASSERT_EQ(1u, *writes);
+		ASSERT_EQ(content, backing.str());
+
+		// Reading writes what is buffered first and shares the position
+		stream << "xyz";
+		stream.seekg(998);
+		char read[5] = {};
+		stream.read(read, 5);
+		ASSERT_EQ(std::string(content.substr(998, 2) + "xyz"), std::string(read, 5));
+		ASSERT_EQ(2u, *writes);
+
+		stream.seekp(0);
+		stream << "AB";
+		ASSERT_EQ(2, static_cast<int>(stream.tellp()));
+	}
+	ASSERT_EQ(3u, *writes);
+	ASSERT_EQ("AB", backing.str().substr(0, 2));
+	ASSERT_EQ(1003u, backing.str().size());
+}
+
+#ifdef ZIOPP_POSIX
+TEST(file_handle, posix_file_handle) {
+	char name[] = "/tmp/ziopp-file-handle-XXXXXX";
+	int descriptor = mkstemp(name);
+	ASSERT_GE(descriptor, 0);
+	{
+		ziopp::posix_file_handle handle{ descriptor };
+		check_read_write(handle);
+	}
+
+	std::unique_ptr<ziopp::posix_file_handle> reopened = ziopp::posix_file_handle::open(name, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(10u, reopened->size());
+
+	uint8_t first[2] = {};
+	uint8_t gap[3] = {};
+	uint8_t second[8] = {};
+	std::vector<ziopp::io_segment> segments{ ziopp::io_segment{ first, 2 }, ziopp::io_segment{ gap, 3 }, ziopp::io_segment{ second, 8 } };
+	ASSERT_EQ(9u, reopened->read_vectored(1, segments));
+	ASSERT_EQ(std::string("bc"), std::string(first, first + 2));
+	ASSERT_EQ(std::string("def"), std::string(gap, gap + 3));
+	ASSERT_EQ('\0', second[1]);
+	ASSERT_EQ(std::string("ab"), std::string(second + 2, second + 4));
+	ASSERT_THROW(ziopp::posix_file_handle::open(name, ziopp::file_mode::create_new, ziopp::file_access::write), std::ios_base::failure);
+	unlink(name);
+}
+
+TEST(file_handle, posix_direct_unaligned_from_many_threads) {
+	char name[] = "/tmp/ziopp-file-handle-XXXXXX";
+	int descriptor = mkstemp(name);
+	ASSERT_GE(descriptor, 0);
+	close(descriptor);
+
+	// Transfers direct I/O rejects as not aligned are made from many threads at once
+	std::unique_ptr<ziopp::posix_file_handle> handle = ziopp::posix_file_handle::open(name, ziopp::file_mode::create, ziopp::file_access::read_write, true);
+	std::vector<char> matched(4, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&handle, &matched, t]() {
+			bool same = true;
+			for (int i = 0; i < 200; i++)
+			{
+				std::string piece = std::to_string(t) + ":" + std::to_string(i) + ";";
+				uint64_t offset = static_cast<uint64_t>(t) * 65536 + static_cast<uint64_t>(i) * 7;
+				handle->write_at(offset, reinterpret_cast<const uint8_t*>(piece.data()), piece.size());
+				std::string read(piece.size(), '\0');
+				handle->read_at(offset, reinterpret_cast<uint8_t*>(&read[0]), read.size());
+				same = same && read == piece;
+			}
+			matched[t] = same ? 1 : 0;
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_THAT(matched, ::testing::Each(1));
+	unlink(name);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <atomic>
+#include <thread>
+#include <ziopp/handle_cache_filesystem.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+
+namespace {
+	void write_text(ziopp::filesystem& fs, const char* path, std::string content)
+	{
+		fs.write_all_text(ziopp::upath{ path }, content);
+	}
+
+	std::string read_handle(ziopp::file_handle& handle)
+	{
+		std::string content(static_cast<size_t>(handle.size()), '\0');
+		content.resize(handle.read_at(0, reinterpret_cast<uint8_t*>(&content[0]), content.size()));
+		return content;
+	}
+
+	// Counts the handles of the wrapped filesystem still open
+	class open_counting_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit open_counting_filesystem(ziopp::filesystem& next) : compose_filesystem(next), open(0)
+		{
+		}
+
+		using compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			return std::unique_ptr<ziopp::file_handle>(new counted_handle(compose_filesystem::open_handle(path, mode, access), open));
+		}
+
+		std::atomic<int> open;
+	private:
+		class counted_handle : public ziopp::file_handle {
+		public:
+			counted_handle(std::unique_ptr<ziopp::file_handle> inner, std::atomic<int>& open) : inner_(std::move(inner)), open_(open)
+			{
+				open_++;
+			}
+
+			~counted_handle()
+			{
+				open_--;
+			}
+
+			size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+			{
+				return inner_->read_at(offset, buffer, count);
+			}
+
+			size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+			{
+				return inner_->write_at(offset, buffer, count);
+			}
+
+			uint64_t size() const override
+			{
+				return inner_->size();
+			}
+
+			void sync() override
+			{
+				inner_->sync();
+			}
+		private:
+			std::unique_ptr<ziopp::file_handle> inner_;
+			std::atomic<int>& open_;
+		};
+	};
+}
+
+TEST(handle_cache_filesystem, shares_handles) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem metrics{ memory };
+	ziopp::handle_cache_filesystem fs{ metrics };
+	write_text(fs, "/a.txt", "alpha");
+
+	for (int i = 0; i < 10; i++)
+	{
+		std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+		ASSERT_EQ("alpha", read_handle(*handle));
+	}
+	ASSERT_EQ("alpha", fs.read_all_text(ziopp::upath{ "/a.txt" }));
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::string word;
+	stream >> word;
+	ASSERT_EQ("alpha", word);
+
+	// One open for the write, one for every read
+	ASSERT_EQ(2u, metrics.snapshot()[ziopp::filesystem_operation::open_handle].calls);
+	ziopp::handle_cache_statistics statistics = fs.statistics();
+	ASSERT_EQ(11u, statistics.hits);
+	ASSERT_EQ(1u, statistics.misses);
+	ASSERT_EQ(1u, statistics.cached_handles);
+
+	// Threads share the handle
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&fs]() {
+			for (int i = 0; i < 100; i++)
+			{
+				std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+				EXPECT_EQ("alpha", read_handle(*handle));
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_EQ(2u, metrics.snapshot()[ziopp::filesystem_operation::open_handle].calls);
+}
+
+TEST(handle_cache_filesystem, invalidates_changed_files) {
+	ziopp::memory_filesystem memory{};
+	ziopp::handle_cache_filesystem fs{ memory };
+	fs.create_directory(ziopp::upath{ "/dir" });
+	write_text(fs, "/dir/a.txt", "first");
+	write_text(fs, "/dir/b.txt", "second");
+	ASSERT_EQ("first", fs.read_all_text(ziopp::upath{ "/dir/a.txt" }));
+	ASSERT_EQ("second", fs.read_all_text(ziopp::upath{ "/dir/b.txt" }));
+	ASSERT_EQ(2u, fs.statistics().cached_handles);
+
+	// A handle in use survives its file being replaced
+	std::unique_ptr<ziopp::file_handle> old = fs.open_handle(ziopp::upath{ "/dir/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+	fs.replace_file(ziopp::upath{ "/dir/b.txt" }, ziopp::upath{ "/dir/a.txt" }, false);
+	ASSERT_EQ("first", read_handle(*old));
+	ASSERT_EQ("second", fs.read_all_text(ziopp::upath{ "/dir/a.txt" }));
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/dir/b.txt" }));
+
+	write_text(fs, "/dir/a.txt", "third");
+	ASSERT_EQ("third", fs.read_all_text(ziopp::upath{ "/dir/a.txt" }));
+
+	fs.copy_file(ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/dir/c.txt" }, false);
+	ASSERT_EQ("third", fs.read_all_text(ziopp::upath{ "/dir/c.txt" }));
+	std::error_code error;
+	fs.move_file(ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/dir/e.txt" }, error);
+	ASSERT_FALSE(error);
+	ASSERT_EQ("third", fs.read_all_text(ziopp::upath{ "/dir/e.txt" }));
+	ASSERT_EQ(nullptr, fs.open_handle(ziopp::upath{ "/dir/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read, error));
+	ASSERT_TRUE(error);
+
+	// Changes made behind the cache are only seen once invalidated
+	memory.move_file(ziopp::upath{ "/dir/c.txt" }, ziopp::upath{ "/dir/d.txt" });
+	ASSERT_EQ("third", fs.read_all_text(ziopp::upath{ "/dir/c.txt" }));
+	fs.invalidate(ziopp::upath{ "/dir" });
+	ASSERT_EQ(0u, fs.statistics().cached_handles);
+	ASSERT_THROW(fs.read_all_text(ziopp::upath{ "/dir/c.txt" }), std::ios_base::failure);
+
+	fs.delete_directory(ziopp::upath{ "/dir" }, true);
+	ASSERT_EQ(0u, fs.statistics().cached_handles);
+}
+
+TEST(handle_cache_filesystem, evicts_least_recently_opened) {
+	ziopp::memory_filesystem memory{};
+	ziopp::handle_cache_options options{};
+	options.max_handles = 2;
+	ziopp::handle_cache_filesystem fs{ memory, options };
+	for (const char* name : { "/a", "/b", "/c" })
+	{
+		write_text(fs, name, name);
+	}
+
+	fs.read_all_text(ziopp::upath{ "/a" });
+	fs.read_all_text(ziopp::upath{ "/b" });
+	fs.read_all_text(ziopp::upath{ "/a" });
+	fs.read_all_text(ziopp::upath{ "/c" });
+	ziopp::handle_cache_statistics statistics = fs.statistics();
+	ASSERT_EQ(1u, statistics.evictions);
+	ASSERT_EQ(2u, statistics.cached_handles);
+
+	// b was evicted, a was kept
+	fs.read_all_text(ziopp::upath{ "/a" });
+	ASSERT_EQ(statistics.hits + 1, fs.statistics().hits);
+	fs.read_all_text(ziopp::upath{ "/b" });
+	ASSERT_EQ(statistics.misses + 1, fs.statistics().misses);
+
+	fs.clear();
+	ASSERT_EQ(0u, fs.statistics().cached_handles);
+}
+
+TEST(handle_cache_filesystem, keeps_streams_of_evicted_handles) {
+	ziopp::memory_filesystem memory{};
+	open_counting_filesystem counting{ memory };
+	ziopp::handle_cache_options options{};
+	options.max_handles = 1;
+	ziopp::handle_cache_filesystem fs{ counting, options };
+	write_text(fs, "/a", "alpha");
+	write_text(fs, "/b", "beta");
+
+	// Opening a file again closes its earlier stream
+	std::string word;
+	for (int i = 0; i < 10; i++)
+	{
+		fs.open_file(ziopp::upath{ "/a" }, ziopp::file_mode::open, ziopp::file_access::read) >> word;
+		ASSERT_EQ("alpha", word);
+	}
+	ASSERT_EQ(1, counting.open.load());
+
+	// Evicting a handle leaves the stream sharing it open
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/a" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::unique_ptr<ziopp::file_handle> other = fs.open_handle(ziopp::upath{ "/b" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(1u, fs.statistics().evictions);
+	ASSERT_EQ(2, counting.open.load());
+	stream >> word;
+	ASSERT_EQ("alpha", word);
+
+	// So does invalidating it
+	fs.invalidate(ziopp::upath{ "/a" });
+	stream.clear();
+	stream.seekg(1);
+	stream >> word;
+	ASSERT_EQ("lpha", word);
+	other.reset();
+	ASSERT_EQ(2, counting.open.load());
+
+	// Deleting the file closes its stream
+	fs.delete_file(ziopp::upath{ "/a" });
+	ASSERT_EQ(1, counting.open.load());
+	fs.clear();
+	ASSERT_EQ(0, counting.open.load());
+}
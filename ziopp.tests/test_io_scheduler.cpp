@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ziopp/executor.h>
+#include <ziopp/io_scheduler.h>
+
+namespace {
+	ziopp::io_scheduler_options single_slot()
+	{
+		ziopp::io_scheduler_options options{};
+		options.max_concurrency = 1;
+		options.reserved_concurrency = 0;
+		options.normal.deadline = std::chrono::milliseconds::zero();
+		options.background.deadline = std::chrono::milliseconds::zero();
+		return options;
+	}
+
+	void wait_for_waiting(const ziopp::io_scheduler& scheduler, size_t waiting)
+	{
+		while (scheduler.statistics().waiting < waiting)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+TEST(io_scheduler, starts_higher_priorities_first) {
+	ziopp::io_scheduler scheduler{ single_slot() };
+	std::mutex mutex;
+	std::vector<ziopp::io_priority> order;
+	std::vector<std::thread> threads;
+	{
+		ziopp::io_request held{ scheduler, ziopp::io_priority::normal, 0 };
+		size_t waiting = 0;
+		for (ziopp::io_priority priority : { ziopp::io_priority::background, ziopp::io_priority::normal, ziopp::io_priority::high })
+		{
+			threads.emplace_back([&scheduler, &mutex, &order, priority]() {
+				ziopp::io_request request{ scheduler, priority, 0 };
+				std::lock_guard<std::mutex> lock{ mutex };
+				order.push_back(priority);
+			});
+			wait_for_waiting(scheduler, ++waiting);
+		}
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_EQ((std::vector<ziopp::io_priority>{ ziopp::io_priority::high, ziopp::io_priority::normal, ziopp::io_priority::background }), order);
+
+	ziopp::io_scheduler_statistics statistics = scheduler.statistics();
+	ASSERT_EQ(2u, statistics[ziopp::io_priority::normal].requests);
+	ASSERT_EQ(1u, statistics[ziopp::io_priority::background].requests);
+	ASSERT_LT(0u, statistics[ziopp::io_priority::background].max_wait_nanoseconds);
+	ASSERT_EQ(0u, statistics.running);
+	ASSERT_EQ(0u, statistics.waiting);
+}
+
+TEST(io_scheduler, expired_requests_go_first) {
+	ziopp::io_scheduler_options options = single_slot();
+	options.background.deadline = std::chrono::milliseconds(1);
+	ziopp::io_scheduler scheduler{ options };
+	std::mutex mutex;
+	std::vector<ziopp::io_priority> order;
+	std::vector<std::thread> threads;
+	{
+		ziopp::io_request held{ scheduler, ziopp::io_priority::high, 0 };
+		size_t waiting = 0;
+		for (ziopp::io_priority priority : { ziopp::io_priority::background, ziopp::io_priority::high })
+		{
+			threads.emplace_back([&scheduler, &mutex, &order, priority]() {
+				ziopp::io_request request{ scheduler, priority, 0 };
+				std::lock_guard<std::mutex> lock{ mutex };
+				order.push_back(priority);
+			});
+			wait_for_waiting(scheduler, ++waiting);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	ASSERT_EQ((std::vector<ziopp::io_priority>{ ziopp::io_priority::background, ziopp::io_priority::high }), order);
+	ASSERT_EQ(1u, scheduler.statistics()[ziopp::io_priority::background].expired);
+}
+
+TEST(io_scheduler, reserves_slots) {
+	ziopp::io_scheduler_options options{};
+	options.max_concurrency = 2;
+	options.reserved_concurrency = 1;
+	ziopp::io_scheduler scheduler{ options };
+	std::thread background;
+	{
+		ziopp::io_request held{ scheduler, ziopp::io_priority::background, 0 };
+		// The reserved slot is free for anything but background requests
+		std::thread([&scheduler]() { ziopp::io_request request{ scheduler, ziopp::io_priority::normal, 0 }; }).join();
+		background = std::thread([&scheduler]() { ziopp::io_request request{ scheduler, ziopp::io_priority::background, 0 }; });
+		wait_for_waiting(scheduler, 1);
+		ASSERT_EQ(1u, scheduler.statistics().running);
+
+		// Requests made while running one of the same scheduler do not wait
+		ziopp::io_request nested{ scheduler, ziopp::io_priority::background, 0 };
+	}
+	background.join();
+	ASSERT_EQ(2u, scheduler.statistics()[ziopp::io_priority::background].requests);
+}
+
+TEST(io_scheduler, limits_bandwidth) {
+	ziopp::io_scheduler_options options{};
+	options.normal.max_bytes_per_second = 10 * 1000 * 1000;
+	ziopp::io_scheduler scheduler{ options };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 6; i++)
+	{
+		ziopp::io_request request{ scheduler, ziopp::io_priority::normal, 100 * 1000 };
+	}
+	// The first request starts at once, each of the others 10ms after the one before
+	ASSERT_LE(std::chrono::milliseconds(45), std::chrono::steady_clock::now() - start);
+	ASSERT_EQ(600u * 1000, scheduler.statistics()[ziopp::io_priority::normal].bytes);
+
+	// Other classes are not held back
+	start = std::chrono::steady_clock::now();
+	ziopp::io_request request{ scheduler, ziopp::io_priority::high, 100 * 1000 * 1000 };
+	ASSERT_GT(std::chrono::milliseconds(45), std::chrono::steady_clock::now() - start);
+}
+
+TEST(io_scheduler, priority_scopes) {
+	ASSERT_EQ(ziopp::io_priority::normal, ziopp::current_io_priority());
+	ziopp::thread_pool pool{ 2 };
+	std::vector<ziopp::io_priority> seen(4, ziopp::io_priority::normal);
+	{
+		ziopp::io_priority_scope background{ ziopp::io_priority::background };
+		{
+			ziopp::io_priority_scope high{ ziopp::io_priority::high };
+			ASSERT_EQ(ziopp::io_priority::high, ziopp::current_io_priority());
+		}
+		ASSERT_EQ(ziopp::io_priority::background, ziopp::current_io_priority());
+
+		// Work added to a group runs with the priority of the thread adding it
+		ziopp::work_group group{ pool, 1 };
+		for (size_t i = 0; i < seen.size(); i++)
+		{
+			group.run([&seen, i]() { seen[i] = ziopp::current_io_priority(); });
+		}
+		group.wait();
+	}
+	ASSERT_EQ(ziopp::io_priority::normal, ziopp::current_io_priority());
+	ASSERT_EQ(std::vector<ziopp::io_priority>(4, ziopp::io_priority::background), seen);
+}
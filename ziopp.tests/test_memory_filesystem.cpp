@@ -0,0 +1,355 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <system_error>
+#include <ziopp/memory_filesystem.h>
+
+namespace {
+	std::vector<std::string> collect(const ziopp::upath_iterator& begin)
+	{
+		std::vector<std::string> paths;
+		for (ziopp::upath_iterator it = begin; it != ziopp::upath_iterator{}; ++it)
+		{
+			paths.push_back(it->full_name());
+		}
+		return paths;
+	}
+
+	// Fails to set write times with a std::system_error that is not a std::ios_base::failure
+	class locked_times_filesystem : public ziopp::memory_filesystem {
+	public:
+		using memory_filesystem::write_time;
+
+		void write_time(const ziopp::upath&, const std::chrono::system_clock::time_point&) override
+		{
+			throw std::system_error(std::make_error_code(std::errc::operation_not_permitted), "write times are locked");
+		}
+	};
+}
+
+TEST(memory_filesystem, create_directory) {
+	ziopp::memory_filesystem fs{};
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/" }));
+
+	fs.create_directory(ziopp::upath{ "/a/b/c" });
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/a" }));
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/a/b" }));
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/a/b/c" }));
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/a/b" }));
+
+	ASSERT_THROW(fs.create_directory(ziopp::upath{ "a" }), std::invalid_argument);
+}
+
+TEST(memory_filesystem, write_and_read) {
+	ziopp::memory_filesystem fs{};
+	fs.create_directory(ziopp::upath{ "/dir" });
+
+	std::string content{ "hello" };
+	fs.write_all_text(ziopp::upath{ "/dir/file.txt" }, content);
+	ASSERT_TRUE(fs.file_exists(ziopp::upath{ "/dir/file.txt" }));
+	ASSERT_EQ(5u, fs.file_length(ziopp::upath{ "/dir/file.txt" }));
+	ASSERT_EQ("hello", fs.read_all_text(ziopp::upath{ "/dir/file.txt" }));
+
+	std::string more{ " world" };
+	fs.append_all_text(ziopp::upath{ "/dir/file.txt" }, more);
+	ASSERT_EQ("hello world", fs.read_all_text(ziopp::upath{ "/dir/file.txt" }));
+
+	std::vector<uint8_t> bytes{ 1, 2, 3, 4 };
+	fs.write_all_binary(ziopp::upath{ "/dir/file.bin" }, bytes);
+	ASSERT_EQ(bytes, fs.read_all_binary(ziopp::upath{ "/dir/file.bin" }));
+
+	ASSERT_THROW(fs.write_all_text(ziopp::upath{ "/missing/file.txt" }, content), std::ios_base::failure);
+	ASSERT_THROW(fs.create_file(ziopp::upath{ "/dir/file.txt" }), std::ios_base::failure);
+}
+
+TEST(memory_filesystem, copy_move_delete) {
+	ziopp::memory_filesystem fs{};
+	fs.create_directory(ziopp::upath{ "/a" });
+	std::string content{ "data" };
+	fs.write_all_text(ziopp::upath{ "/a/x" }, content);
+
+	fs.copy_file(ziopp::upath{ "/a/x" }, ziopp::upath{ "/a/y" }, false);
+	ASSERT_EQ("data", fs.read_all_text(ziopp::upath{ "/a/y" }));
+	ASSERT_THROW(fs.copy_file(ziopp::upath{ "/a/x" }, ziopp::upath{ "/a/y" }, false), std::ios_base::failure);
+
+	fs.move_file(ziopp::upath{ "/a/y" }, ziopp::upath{ "/z" });
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/a/y" }));
+	ASSERT_TRUE(fs.file_exists(ziopp::upath{ "/z" }));
+
+	fs.move_directory(ziopp::upath{ "/a" }, ziopp::upath{ "/b" });
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/a" }));
+	ASSERT_EQ("data", fs.read_all_text(ziopp::upath{ "/b/x" }));
+
+	ASSERT_THROW(fs.delete_directory(ziopp::upath{ "/b" }, false), std::ios_base::failure);
+	fs.delete_directory(ziopp::upath{ "/b" }, true);
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/b" }));
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/b/x" }));
+
+	fs.delete_file(ziopp::upath{ "/z" });
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/z" }));
+}
+
+TEST(memory_filesystem, directories_with_siblings_sorted_between) {
+	ziopp::memory_filesystem fs{};
+	fs.create_directory(ziopp::upath{ "/a/b" });
+	std::string content{ "data" };
+	std::string sibling{ "sibling" };
+	fs.write_all_text(ziopp::upath{ "/a/b/x" }, content);
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, sibling);
+	fs.write_all_text(ziopp::upath{ "/a-b" }, sibling);
+
+	fs.move_directory(ziopp::upath{ "/a" }, ziopp::upath{ "/c" });
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/a" }));
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/a/b" }));
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/c/b" }));
+	ASSERT_EQ("data", fs.read_all_text(ziopp::upath{ "/c/b/x" }));
+
+	fs.delete_directory(ziopp::upath{ "/c" }, true);
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/c/b" }));
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/c/b/x" }));
+	ASSERT_EQ("sibling", fs.read_all_text(ziopp::upath{ "/a.txt" }));
+	ASSERT_EQ("sibling", fs.read_all_text(ziopp::upath{ "/a-b" }));
+	ASSERT_THAT(collect(fs.enumerate_paths(ziopp::upath{ "/" }, "*", ziopp::search_options::all_directories, ziopp::search_target::both)), ::testing::UnorderedElementsAre("/a.txt", "/a-b"));
+}
+
+TEST(memory_filesystem, enumerate_paths) {
+	ziopp::memory_filesystem fs{};
+	fs.create_directory(ziopp::upath{ "/a/b" });
+	fs.create_directory(ziopp::upath{ "/a-b" });
+	std::string content{};
+	fs.write_all_text(ziopp::upath{ "/a/one.txt" }, content);
+	fs.write_all_text(ziopp::upath{ "/a/two.dat" }, content);
+	fs.write_all_text(ziopp::upath{ "/a/b/three.txt" }, content);
+
+	ASSERT_THAT(collect(fs.enumerate_paths(ziopp::upath{ "/a" }, "*", ziopp::search_options::top_directory_only, ziopp::search_target::both)),
+		::testing::ElementsAre("/a/b", "/a/one.txt", "/a/two.dat"));
+	ASSERT_THAT(collect(fs.enumerate_paths(ziopp::upath{ "/a" }, "*.txt", ziopp::search_options::all_directories, ziopp::search_target::file)),
+		::testing::ElementsAre("/a/b/three.txt", "/a/one.txt"));
+	ASSERT_THAT(collect(fs.enumerate_paths(ziopp::upath{ "/" }, "*", ziopp::search_options::top_directory_only, ziopp::search_target::directory)),
+		::testing::ElementsAre("/a", "/a-b"));
+	ASSERT_THAT(collect(fs.enumerate_paths(ziopp::upath{ "/a" }, "t?o.*", ziopp::search_options::all_directories, ziopp::search_target::both)),
+		::testing::ElementsAre("/a/two.dat"));
+}
+
+TEST(memory_filesystem, batch_operations) {
+	ziopp::memory_filesystem fs{};
+	fs.create_directories(std::vector<ziopp::upath>{ ziopp::upath{ "/a/b" }, ziopp::upath{ "/c" } });
+	std::string content{ "abc" };
+	fs.write_all_text(ziopp::upath{ "/a/file" }, content);
+
+	std::vector<ziopp::upath> paths{ ziopp::upath{ "/a/file" }, ziopp::upath{ "/a/b" }, ziopp::upath{ "/missing" } };
+	ASSERT_THAT(fs.exists_many(paths), ::testing::ElementsAre(true, true, false));
+
+	std::vector<ziopp::file_stat> stats = fs.stat_many(paths);
+	ASSERT_EQ(3u, stats.size());
+	ASSERT_TRUE(stats[0].exists);
+	ASSERT_FALSE(stats[0].is_directory);
+	ASSERT_EQ(3u, stats[0].length);
+	ASSERT_EQ(fs.write_time(ziopp::upath{ "/a/file" }), stats[0].write_time);
+	ASSERT_TRUE(stats[1].exists);
+	ASSERT_TRUE(stats[1].is_directory);
+	ASSERT_FALSE(stats[2].exists);
+
+	fs.delete_many(std::vector<ziopp::upath>{ ziopp::upath{ "/a/file" }, ziopp::upath{ "/missing" } });
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/a/file" }));
+	ASSERT_THROW(fs.delete_many(std::vector<ziopp::upath>{ ziopp::upath{ "/c" } }), std::ios_base::failure);
+}
+TEST(memory_filesystem, copy_directory_cross) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem dest{};
+	std::string content{ "abc" };
+	for (int i = 0; i < 4; i++)
+	{
+		std::string directory = "/tree/d" + std::to_string(i);
+		src.create_directory(ziopp::upath{ directory + "/inner" });
+		src.write_all_text(ziopp::upath{ directory + "/file.txt" }, content);
+		src.write_all_text(ziopp::upath{ directory + "/inner/file.txt" }, content);
+	}
+	src.write_time(ziopp::upath{ "/tree/d0/file.txt" }, std::chrono::system_clock::time_point(std::chrono::hours(1)));
+
+	ziopp::thread_pool pool{ 4 };
+	ziopp::tree_options options{};
+	options.work_executor = &pool;
+	options.max_concurrency = 3;
+	src.copy_directory_cross(dest, ziopp::upath{ "/tree" }, ziopp::upath{ "/copy" }, false, options);
+	ASSERT_EQ(collect(src.enumerate_paths(ziopp::upath{ "/tree" }, "*", ziopp::search_options::all_directories, ziopp::search_target::both)).size(),
+		collect(dest.enumerate_paths(ziopp::upath{ "/copy" }, "*", ziopp::search_options::all_directories, ziopp::search_target::both)).size());
+	ASSERT_EQ("abc", dest.read_all_text(ziopp::upath{ "/copy/d3/inner/file.txt" }));
+	ASSERT_EQ(std::chrono::system_clock::time_point(std::chrono::hours(1)), dest.write_time(ziopp::upath{ "/copy/d0/file.txt" }));
+
+	// Without overwrite the first existing file fails the copy
+	ASSERT_THROW(src.copy_directory_cross(dest, ziopp::upath{ "/tree" }, ziopp::upath{ "/copy" }, false, options), std::ios_base::failure);
+	src.copy_directory_cross(dest, ziopp::upath{ "/tree" }, ziopp::upath{ "/copy" }, true, options);
+
+	src.copy_directory_cross(src, ziopp::upath{ "/tree/d1" }, ziopp::upath{ "/d1" }, false, options);
+	ASSERT_EQ("abc", src.read_all_text(ziopp::upath{ "/d1/inner/file.txt" }));
+	ASSERT_THROW(src.copy_directory_cross(src, ziopp::upath{ "/tree" }, ziopp::upath{ "/tree/d0/copy" }, false, options), std::invalid_argument);
+}
+
+TEST(memory_filesystem, delete_directory_parallel) {
+	ziopp::memory_filesystem fs{};
+	std::string content{ "abc" };
+	for (int i = 0; i < 8; i++)
+	{
+		std::string directory = "/tree/d" + std::to_string(i) + "/inner";
+		fs.create_directory(ziopp::upath{ directory });
+		for (int j = 0; j < 5; j++)
+		{
+			fs.write_all_text(ziopp::upath{ directory + "/file" + std::to_string(j) }, content);
+		}
+	}
+	fs.create_directory(ziopp::upath{ "/keep" });
+
+	ziopp::thread_pool pool{ 4 };
+	ziopp::tree_options options{};
+	options.work_executor = &pool;
+	options.delete_batch_size = 2;
+	fs.delete_directory_parallel(ziopp::upath{ "/tree" }, options);
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/tree" }));
+	ASSERT_TRUE(fs.directory_exists(ziopp::upath{ "/keep" }));
+	ASSERT_THROW(fs.delete_directory_parallel(ziopp::upath{ "/tree" }, options), std::ios_base::failure);
+}
+
+TEST(memory_filesystem, read_all_lines) {
+	ziopp::memory_filesystem fs{};
+	std::string content{ "first\r\n\nthird\nlast" };
+	fs.write_all_text(ziopp::upath{ "/lines.txt" }, content);
+	ASSERT_THAT(fs.read_all_lines(ziopp::upath{ "/lines.txt" }), ::testing::ElementsAre("first", "", "third", "last"));
+
+	content = "only\n";
+	fs.write_all_text(ziopp::upath{ "/lines.txt" }, content);
+	ASSERT_THAT(fs.read_all_lines(ziopp::upath{ "/lines.txt" }), ::testing::ElementsAre("only"));
+
+	content = "";
+	fs.write_all_text(ziopp::upath{ "/lines.txt" }, content);
+	ASSERT_TRUE(fs.read_all_lines(ziopp::upath{ "/lines.txt" }).empty());
+}
+
+TEST(memory_filesystem, for_each_line) {
+	ziopp::memory_filesystem fs{};
+	std::string content;
+	std::vector<std::pair<uint64_t, std::string>> expected;
+	for (int i = 0; i < 500; i++)
+	{
+		// Some lines are longer than the blocks read
+		std::string line = std::to_string(i) + std::string(i % 7 == 0 ? 100 : i % 13, 'x');
+		expected.emplace_back(content.size(), line);
+		content += line + (i % 3 == 0 ? "\r\n" : "\n");
+	}
+	fs.write_all_text(ziopp::upath{ "/lines.txt" }, content);
+
+	ziopp::line_options options{};
+	options.block_size = 16;
+	std::vector<std::pair<uint64_t, std::string>> sequential;
+	fs.for_each_line(ziopp::upath{ "/lines.txt" }, [&sequential](const ziopp::line_view& line) {
+		sequential.emplace_back(line.offset, line.str());
+	}, options);
+	ASSERT_EQ(expected, sequential);
+
+	ziopp::thread_pool pool{ 4 };
+	options.parallel = true;
+	options.work_executor = &pool;
+	std::mutex mutex;
+	std::vector<std::pair<uint64_t, std::string>> parallel;
+	fs.for_each_line(ziopp::upath{ "/lines.txt" }, [&mutex, &parallel](const ziopp::line_view& line) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		parallel.emplace_back(line.offset, line.str());
+	}, options);
+	std::sort(parallel.begin(), parallel.end());
+	ASSERT_EQ(expected, parallel);
+}
+
+TEST(memory_filesystem, error_code_overloads) {
+	ziopp::memory_filesystem fs{};
+	std::error_code error;
+	ASSERT_EQ(0u, fs.file_length(ziopp::upath{ "/missing.txt" }, error));
+	ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+	ASSERT_EQ(nullptr, fs.open_handle(ziopp::upath{ "/missing.txt" }, ziopp::file_mode::open, ziopp::file_access::read, error));
+	ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+	ASSERT_TRUE(fs.read_all_text(ziopp::upath{ "/missing.txt" }, error).empty());
+	ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+	fs.create_directory(ziopp::upath{ "relative" }, error);
+	ASSERT_EQ(std::errc::invalid_argument, error);
+
+	fs.create_directory(ziopp::upath{ "/dir" }, error);
+	ASSERT_FALSE(error);
+	std::string content{ "abc" };
+	fs.write_all_text(ziopp::upath{ "/dir/a.txt" }, content);
+	fs.copy_file(ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/dir/b.txt" }, false, error);
+	ASSERT_FALSE(error);
+	fs.copy_file(ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/dir/b.txt" }, false, error);
+	ASSERT_EQ(std::errc::file_exists, error);
+	fs.move_file(ziopp::upath{ "/dir/b.txt" }, ziopp::upath{ "/dir/c.txt" }, error);
+	ASSERT_FALSE(error);
+	ASSERT_EQ(3u, fs.file_length(ziopp::upath{ "/dir/c.txt" }, error));
+	ASSERT_FALSE(error);
+	ASSERT_EQ("abc", fs.read_all_text(ziopp::upath{ "/dir/c.txt" }, error));
+	fs.delete_directory(ziopp::upath{ "/dir" }, false, error);
+	ASSERT_EQ(std::errc::directory_not_empty, error);
+	fs.delete_file(ziopp::upath{ "/dir" }, error);
+	ASSERT_EQ(std::errc::is_a_directory, error);
+
+	// Across filesystems, a missing source or an existing destination is found before anything is opened
+	ziopp::memory_filesystem other{};
+	fs.copy_file_cross(other, ziopp::upath{ "/dir/missing.txt" }, ziopp::upath{ "/a.txt" }, false, error);
+	ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+	fs.copy_file_cross(other, ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/a.txt" }, false, error);
+	ASSERT_FALSE(error);
+	fs.move_file_cross(other, ziopp::upath{ "/dir/c.txt" }, ziopp::upath{ "/a.txt" }, error);
+	ASSERT_EQ(std::errc::file_exists, error);
+	fs.move_file_cross(other, ziopp::upath{ "/dir/c.txt" }, ziopp::upath{ "/c.txt" }, error);
+	ASSERT_FALSE(error);
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/dir/c.txt" }));
+	ASSERT_EQ("abc", other.read_all_text(ziopp::upath{ "/c.txt" }));
+
+	locked_times_filesystem locked{};
+	fs.copy_file_cross(locked, ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/a.txt" }, false, error);
+	ASSERT_EQ(std::errc::operation_not_permitted, error);
+	ASSERT_THROW(fs.move_file_cross(other, ziopp::upath{ "/dir/a.txt" }, ziopp::upath{ "/c.txt" }), std::ios_base::failure);
+}
+
+TEST(memory_filesystem, reuses_streams) {
+	ziopp::memory_filesystem fs{};
+	std::string content{ "abcdef" };
+	std::string other{ "xyz" };
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, content);
+	fs.write_all_text(ziopp::upath{ "/b.txt" }, other);
+
+	// Opening a file the same way again rewinds the stream it returned before instead of keeping another
+	std::iostream& first = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+	char read[3] = {};
+	first.read(read, 3);
+	std::iostream& second = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(&first, &second);
+	std::string line;
+	std::getline(second, line);
+	ASSERT_EQ("abcdef", line);
+	ASSERT_NE(&first, &fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read_write));
+
+	// A file copied over gets a stream of its new contents
+	fs.copy_file(ziopp::upath{ "/b.txt" }, ziopp::upath{ "/a.txt" }, true);
+	std::getline(fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read), line);
+	ASSERT_EQ("xyz", line);
+}
+
+TEST(memory_filesystem, replace_file_checks_before_changing) {
+	ziopp::memory_filesystem fs{};
+	std::string a{ "a" };
+	std::string b{ "b" };
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, a);
+	fs.write_all_text(ziopp::upath{ "/b.txt" }, b);
+	fs.create_directory(ziopp::upath{ "/dir" });
+
+	// A failed replace leaves every file as it was
+	ASSERT_THROW(fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/a.txt" }, false), std::invalid_argument);
+	ASSERT_THROW(fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/b.txt" }, ziopp::upath{ "/a.txt" }, false), std::invalid_argument);
+	ASSERT_THROW(fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/b.txt" }, ziopp::upath{ "/b.txt" }, false), std::invalid_argument);
+	ASSERT_THROW(fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/b.txt" }, ziopp::upath{ "/dir" }, false), std::ios_base::failure);
+	ASSERT_THROW(fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/b.txt" }, ziopp::upath{ "/missing/b.bak" }, false), std::ios_base::failure);
+	ASSERT_EQ("a", fs.read_all_text(ziopp::upath{ "/a.txt" }));
+	ASSERT_EQ("b", fs.read_all_text(ziopp::upath{ "/b.txt" }));
+
+	fs.replace_file(ziopp::upath{ "/a.txt" }, ziopp::upath{ "/b.txt" }, ziopp::upath{ "/dir/b.bak" }, false);
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/a.txt" }));
+	ASSERT_EQ("a", fs.read_all_text(ziopp::upath{ "/b.txt" }));
+	ASSERT_EQ("b", fs.read_all_text(ziopp::upath{ "/dir/b.bak" }));
+}
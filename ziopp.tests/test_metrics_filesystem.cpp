@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <thread>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+
+TEST(metrics_filesystem, latency_histogram) {
+	for (uint64_t value : { 0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull, 1ull << 35 })
+	{
+		size_t index = ziopp::latency_histogram::bucket_index(value);
+		ASSERT_LE(value, ziopp::latency_histogram::bucket_upper_bound(index));
+		ASSERT_TRUE(index == 0 || value > ziopp::latency_histogram::bucket_upper_bound(index - 1));
+		ASSERT_LE(ziopp::latency_histogram::bucket_upper_bound(index) - value, value / 16);
+	}
+	ASSERT_EQ(ziopp::latency_histogram::bucket_count - 1, ziopp::latency_histogram::bucket_index(UINT64_MAX));
+
+	ziopp::latency_histogram histogram{};
+	ASSERT_EQ(0u, histogram.value_at_percentile(50));
+	for (uint64_t value = 1; value <= 100; value++)
+	{
+		histogram.record(value * 1000);
+	}
+	ASSERT_EQ(100u, histogram.count());
+	ASSERT_NEAR(50000.0, static_cast<double>(histogram.value_at_percentile(50)), 50000.0 / 16);
+	ASSERT_NEAR(99000.0, static_cast<double>(histogram.value_at_percentile(99)), 99000.0 / 16);
+}
+
+TEST(metrics_filesystem, counts_operations) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem fs{ memory };
+
+	fs.create_directory(ziopp::upath{ "/dir" });
+	std::string content{ "hello world" };
+	fs.write_all_text(ziopp::upath{ "/dir/file.txt" }, content);
+	ASSERT_EQ("hello world", fs.read_all_text(ziopp::upath{ "/dir/file.txt" }));
+	ASSERT_TRUE(fs.file_exists(ziopp::upath{ "/dir/file.txt" }));
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/dir/missing.txt" }));
+	ASSERT_THROW(fs.file_length(ziopp::upath{ "/dir/missing.txt" }), std::ios_base::failure);
+
+	std::thread other{ [&fs]() { fs.directory_exists(ziopp::upath{ "/dir" }); } };
+	other.join();
+
+	ziopp::filesystem_metrics metrics = fs.snapshot();
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::create_directory].calls);
+	ASSERT_EQ(2u, metrics[ziopp::filesystem_operation::file_exists].calls);
+	ASSERT_EQ(0u, metrics[ziopp::filesystem_operation::file_exists].errors);
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::file_length].calls);
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::file_length].errors);
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::directory_exists].calls);
+	ASSERT_EQ(0u, metrics[ziopp::filesystem_operation::open_file].calls);
+	ASSERT_EQ(2u, metrics[ziopp::filesystem_operation::open_handle].calls);
+	ASSERT_EQ(2u, metrics[ziopp::filesystem_operation::file_exists].latency.count());
+	ASSERT_EQ(11u, metrics.bytes_written);
+	ASSERT_EQ(11u, metrics.bytes_read);
+}
+
+TEST(metrics_filesystem, to_prometheus) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem fs{ memory };
+	fs.file_exists(ziopp::upath{ "/file" });
+
+	std::string text = fs.snapshot().to_prometheus();
+	ASSERT_THAT(text, ::testing::HasSubstr("# TYPE ziopp_filesystem_operations_total counter\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_operations_total{operation=\"file_exists\"} 1\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_errors_total{operation=\"file_exists\"} 0\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_operation_duration_seconds_bucket{operation=\"file_exists\",le=\"+Inf\"} 1\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_operation_duration_seconds_count{operation=\"file_exists\"} 1\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_read_bytes_total 0\n"));
+	ASSERT_THAT(text, ::testing::HasSubstr("ziopp_filesystem_open_streams 0\n"));
+}
+
+TEST(metrics_filesystem, counts_error_code_failures) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem fs{ memory };
+	std::error_code error;
+	fs.file_length(ziopp::upath{ "/missing.txt" }, error);
+	ASSERT_EQ(std::errc::no_such_file_or_directory, error);
+	ASSERT_EQ(nullptr, fs.open_handle(ziopp::upath{ "/missing.txt" }, ziopp::file_mode::open, ziopp::file_access::read, error));
+
+	ziopp::filesystem_metrics metrics = fs.snapshot();
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::file_length].calls);
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::file_length].errors);
+	ASSERT_EQ(1u, metrics[ziopp::filesystem_operation::open_handle].errors);
+}
+
+TEST(metrics_filesystem, forgets_streams_of_removed_files) {
+	ziopp::memory_filesystem memory{};
+	ziopp::metrics_filesystem fs{ memory };
+	fs.create_directory(ziopp::upath{ "/dir" });
+	std::string content{ "data" };
+	for (const char* name : { "/a", "/b", "/c", "/dir/d", "/dir/e" })
+	{
+		fs.write_all_text(ziopp::upath{ name }, content);
+		fs.open_file(ziopp::upath{ name }, ziopp::file_mode::open, ziopp::file_access::read);
+	}
+	ASSERT_EQ(5u, fs.snapshot().open_streams);
+
+	// The wrapped filesystem reuses the stream of a file opened the same way again
+	fs.open_file(ziopp::upath{ "/a" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(5u, fs.snapshot().open_streams);
+
+	// A moved file keeps its stream
+	fs.move_file(ziopp::upath{ "/a" }, ziopp::upath{ "/moved" });
+	ASSERT_EQ(5u, fs.snapshot().open_streams);
+	fs.delete_file(ziopp::upath{ "/moved" });
+	ASSERT_EQ(4u, fs.snapshot().open_streams);
+
+	// So does a replacing file, while the replaced one loses its stream
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/b" }, ziopp::file_mode::open, ziopp::file_access::read);
+	fs.replace_file(ziopp::upath{ "/b" }, ziopp::upath{ "/c" }, false);
+	ASSERT_EQ(3u, fs.snapshot().open_streams);
+	std::string word;
+	stream >> word;
+	ASSERT_EQ("data", word);
+
+	fs.delete_directory(ziopp::upath{ "/dir" }, true);
+	ASSERT_EQ(1u, fs.snapshot().open_streams);
+	fs.delete_many({ ziopp::upath{ "/c" } });
+	ASSERT_EQ(0u, fs.snapshot().open_streams);
+}
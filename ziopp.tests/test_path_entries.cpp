@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <ziopp/path_entries.h>
+
+TEST(path_entries, find_path_entries) {
+	std::map<std::string, int> entries{ { "/a", 1 }, { "/a-b", 2 }, { "/a.txt", 3 }, { "/a/b", 4 }, { "/a/b/c", 5 }, { "/ab", 6 } };
+	std::vector<std::string> found;
+	for (auto it : ziopp::find_path_entries(entries, "/a", true))
+	{
+		found.push_back(it->first);
+	}
+	ASSERT_THAT(found, ::testing::ElementsAre("/a", "/a/b", "/a/b/c"));
+	ASSERT_EQ(1u, ziopp::find_path_entries(entries, "/a", false).size());
+	ASSERT_EQ(entries.size(), ziopp::find_path_entries(entries, "/", true).size());
+
+	// Erasing some entries leaves the iterators to the others valid
+	std::set<std::string> names{ "/a", "/a.txt", "/a/b", "/a/c" };
+	for (auto it : ziopp::find_path_entries(names, "/a", true))
+	{
+		names.erase(it);
+	}
+	ASSERT_THAT(names, ::testing::ElementsAre("/a.txt"));
+}
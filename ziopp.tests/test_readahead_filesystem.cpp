@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <thread>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+#include <ziopp/readahead_filesystem.h>
+
+namespace {
+	std::vector<uint8_t> pattern(size_t size)
+	{
+		std::vector<uint8_t> content(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			content[i] = static_cast<uint8_t>(i * 31 % 251);
+		}
+		return content;
+	}
+
+	std::vector<uint8_t> read_in_pieces(ziopp::file_handle& handle, size_t piece)
+	{
+		std::vector<uint8_t> content;
+		std::vector<uint8_t> buffer(piece);
+		size_t read;
+		while ((read = handle.read_at(content.size(), buffer.data(), buffer.size())) > 0)
+		{
+			content.insert(content.end(), buffer.begin(), buffer.begin() + read);
+		}
+		return content;
+	}
+}
+
+TEST(readahead_filesystem, reads_ahead) {
+	ziopp::memory_filesystem memory{};
+	ziopp::thread_pool pool{ 2 };
+	ziopp::readahead_options options{};
+	options.block_size = 4096;
+	options.work_executor = &pool;
+	ziopp::readahead_filesystem fs{ memory, options };
+	std::vector<uint8_t> content = pattern(1024 * 1024 + 123);
+	fs.write_all_binary(ziopp::upath{ "/big.bin" }, content);
+
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/big.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(content, read_in_pieces(*handle, 1000));
+	ziopp::readahead_statistics statistics = fs.statistics();
+	ASSERT_EQ(content.size(), statistics.hits + statistics.misses);
+	ASSERT_LT(content.size() / 2, statistics.hits);
+	ASSERT_LT(0u, statistics.blocks);
+	handle.reset();
+
+	// Streams read through the same handles
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/big.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::vector<uint8_t> streamed{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+	ASSERT_EQ(content, streamed);
+	ASSERT_LT(statistics.hits, fs.statistics().hits);
+}
+
+TEST(readahead_filesystem, reads_on_the_executor) {
+	ziopp::memory_filesystem memory{};
+	ziopp::thread_pool pool{ 2 };
+	ziopp::readahead_options options{};
+	options.work_executor = &pool;
+	ziopp::readahead_filesystem fs{ memory, options };
+	std::vector<uint8_t> content = pattern(4 * 1024 * 1024);
+	fs.write_all_binary(ziopp::upath{ "/a.bin" }, content);
+	fs.write_all_binary(ziopp::upath{ "/b.bin" }, content);
+
+	// Both threads of the executor read, so no thread is free to take the blocks they queue behind their own reads
+	std::vector<std::future<std::vector<uint8_t>>> reads;
+	std::atomic<int> started{ 0 };
+	for (const char* name : { "/a.bin", "/b.bin" })
+	{
+		std::shared_ptr<std::promise<std::vector<uint8_t>>> read = std::make_shared<std::promise<std::vector<uint8_t>>>();
+		reads.push_back(read->get_future());
+		ziopp::upath path{ name };
+		pool.post([&fs, &started, path, read]() {
+			started++;
+			while (started < 2)
+			{
+				std::this_thread::yield();
+			}
+			std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(path, ziopp::file_mode::open, ziopp::file_access::read);
+			read->set_value(read_in_pieces(*handle, 64 * 1024));
+		});
+	}
+	for (std::future<std::vector<uint8_t>>& read : reads)
+	{
+		ASSERT_EQ(content, read.get());
+	}
+	ASSERT_LT(0u, fs.statistics().blocks);
+}
+
+TEST(readahead_filesystem, random_reads) {
+	ziopp::memory_filesystem memory{};
+	ziopp::inline_executor runner{};
+	ziopp::readahead_options options{};
+	options.block_size = 1024;
+	options.work_executor = &runner;
+	ziopp::readahead_filesystem fs{ memory, options };
+	std::vector<uint8_t> content = pattern(64 * 1024);
+	fs.write_all_binary(ziopp::upath{ "/file.bin" }, content);
+
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	uint8_t buffer[100];
+	for (uint64_t offset : { 60000u, 100u, 30000u, 5000u })
+	{
+		ASSERT_EQ(sizeof(buffer), handle->read_at(offset, buffer, sizeof(buffer)));
+		ASSERT_EQ(0, std::memcmp(content.data() + offset, buffer, sizeof(buffer)));
+	}
+	ASSERT_EQ(0u, fs.statistics().blocks);
+
+	// Blocks read ahead are dropped by a seek
+	for (uint64_t offset = 5100; offset < 5500; offset += sizeof(buffer))
+	{
+		ASSERT_EQ(sizeof(buffer), handle->read_at(offset, buffer, sizeof(buffer)));
+	}
+	ASSERT_LT(0u, fs.statistics().blocks);
+	ASSERT_EQ(sizeof(buffer), handle->read_at(100, buffer, sizeof(buffer)));
+	ASSERT_EQ(0, std::memcmp(content.data() + 100, buffer, sizeof(buffer)));
+	ASSERT_LT(0u, fs.statistics().wasted);
+}
+
+TEST(readahead_filesystem, writes_pass_through) {
+	ziopp::memory_filesystem memory{};
+	ziopp::readahead_filesystem fs{ memory };
+	std::string content{ "first" };
+	fs.write_all_text(ziopp::upath{ "/a.txt" }, content);
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read_write);
+	ASSERT_EQ(5u, handle->write_at(0, reinterpret_cast<const uint8_t*>("fifth"), 5));
+	handle.reset();
+
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::string word;
+	stream >> word;
+	ASSERT_EQ("fifth", word);
+	fs.delete_file(ziopp::upath{ "/a.txt" });
+	ASSERT_FALSE(fs.file_exists(ziopp::upath{ "/a.txt" }));
+	ASSERT_EQ(0u, fs.statistics().blocks);
+}
+
+TEST(readahead_filesystem, closes_streams_opened_again) {
+	ziopp::memory_filesystem memory{};
+	ziopp::inline_executor runner{};
+	ziopp::readahead_options options{};
+	options.block_size = 1024;
+	options.work_executor = &runner;
+	ziopp::readahead_filesystem fs{ memory, options };
+	std::vector<uint8_t> content = pattern(256 * 1024);
+	fs.write_all_binary(ziopp::upath{ "/file.bin" }, content);
+
+	std::vector<char> buffer(150000);
+	fs.open_file(ziopp::upath{ "/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read).read(buffer.data(), buffer.size());
+	ASSERT_LT(0u, fs.statistics().blocks);
+	ASSERT_EQ(0u, fs.statistics().wasted);
+
+	// Opening the file again closes the earlier stream, dropping the blocks it read ahead
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_LT(0u, fs.statistics().wasted);
+	stream.read(buffer.data(), buffer.size());
+	ASSERT_EQ(0, std::memcmp(content.data(), buffer.data(), buffer.size()));
+}
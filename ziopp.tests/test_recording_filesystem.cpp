@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <thread>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/recording_filesystem.h>
+
+namespace {
+	void run_workload(ziopp::filesystem& fs)
+	{
+		fs.create_directory(ziopp::upath{ "/data" });
+		std::string content(1000, 'x');
+		fs.write_all_text(ziopp::upath{ "/data/a.txt" }, content);
+		fs.read_all_text(ziopp::upath{ "/data/a.txt" });
+		fs.copy_file(ziopp::upath{ "/data/a.txt" }, ziopp::upath{ "/data/b.txt" }, false);
+		fs.write_time(ziopp::upath{ "/data/b.txt" }, std::chrono::system_clock::time_point(std::chrono::hours(1)));
+		fs.file_exists(ziopp::upath{ "/data/missing.txt" });
+		try
+		{
+			fs.file_length(ziopp::upath{ "/data/missing.txt" });
+		}
+		catch (const std::ios_base::failure&)
+		{
+		}
+		fs.enumerate_paths(ziopp::upath{ "/data" }, "*.txt", ziopp::search_options::top_directory_only, ziopp::search_target::file);
+		fs.stat_many({ ziopp::upath{ "/data/a.txt" }, ziopp::upath{ "/data/b.txt" } });
+		fs.move_file(ziopp::upath{ "/data/b.txt" }, ziopp::upath{ "/data/c.txt" });
+	}
+}
+
+TEST(recording_filesystem, record_and_replay) {
+	std::stringstream log;
+	{
+		ziopp::memory_filesystem memory{};
+		ziopp::recording_filesystem recorder{ memory, log };
+		run_workload(recorder);
+	}
+
+	ziopp::workload_replayer replayer{ log };
+	// write_all_text and read_all_text each log the open of a handle, one transfer and the close
+	ASSERT_EQ(14u, replayer.size());
+
+	ziopp::memory_filesystem target{};
+	ziopp::replay_result result = replayer.replay(target);
+	ASSERT_EQ(14u, result.operations);
+	ASSERT_EQ(0u, result.mismatched_errors);
+	ASSERT_EQ(1000u, result.bytes_read);
+	ASSERT_EQ(1000u, result.bytes_written);
+	ASSERT_EQ(14u, result.latency.count());
+	ASSERT_EQ(1u, result.filesystem_operations[static_cast<size_t>(ziopp::filesystem_operation::file_length)].errors);
+	ASSERT_GT(result.operations_per_second(), 0.0);
+
+	ASSERT_TRUE(target.file_exists(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_FALSE(target.file_exists(ziopp::upath{ "/data/b.txt" }));
+	ASSERT_EQ(1000u, target.file_length(ziopp::upath{ "/data/c.txt" }));
+	ASSERT_EQ(std::chrono::system_clock::time_point(std::chrono::hours(1)), target.write_time(ziopp::upath{ "/data/c.txt" }));
+}
+
+TEST(recording_filesystem, paced_replay) {
+	std::stringstream log;
+	{
+		ziopp::memory_filesystem memory{};
+		ziopp::recording_filesystem recorder{ memory, log };
+		recorder.create_directory(ziopp::upath{ "/a" });
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		recorder.create_directory(ziopp::upath{ "/b" });
+	}
+
+	ziopp::workload_replayer replayer{ log };
+	ziopp::memory_filesystem target{};
+	ziopp::replay_options options{};
+	options.pacing = ziopp::replay_pacing::original;
+	options.speed = 2.0;
+	ziopp::replay_result result = replayer.replay(target, options);
+	ASSERT_EQ(0u, result.mismatched_errors);
+	ASSERT_GE(result.elapsed, std::chrono::milliseconds(10));
+	ASSERT_TRUE(target.directory_exists(ziopp::upath{ "/b" }));
+}
+
+TEST(recording_filesystem, malformed_log) {
+	std::stringstream empty;
+	ASSERT_THROW(ziopp::workload_replayer{ empty }, std::invalid_argument);
+
+	std::stringstream truncated{ std::string("ZIOW\x01\x00", 6) };
+	ASSERT_THROW(ziopp::workload_replayer{ truncated }, std::invalid_argument);
+}
\ No newline at end of file
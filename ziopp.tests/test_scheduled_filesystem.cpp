@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <iterator>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/scheduled_filesystem.h>
+
+TEST(scheduled_filesystem, schedules_operations) {
+	ziopp::memory_filesystem memory{};
+	ziopp::io_scheduler_options options{};
+	options.max_request_size = 1000;
+	ziopp::io_scheduler scheduler{ options };
+	ziopp::scheduled_filesystem fs{ memory, scheduler };
+	ASSERT_EQ(&scheduler, &fs.scheduler());
+
+	std::vector<uint8_t> content(4500);
+	for (size_t i = 0; i < content.size(); i++)
+	{
+		content[i] = static_cast<uint8_t>(i);
+	}
+	fs.create_directory(ziopp::upath{ "/data" });
+	fs.write_all_binary(ziopp::upath{ "/data/file.bin" }, content);
+	ziopp::io_scheduler_statistics statistics = scheduler.statistics();
+	ASSERT_EQ(4500u, statistics[ziopp::io_priority::normal].bytes);
+	ASSERT_EQ(0u, statistics[ziopp::io_priority::high].requests);
+
+	// Reads are split into pieces of at most max_request_size bytes
+	std::unique_ptr<ziopp::file_handle> handle;
+	{
+		ziopp::io_priority_scope scope{ ziopp::io_priority::high };
+		handle = fs.open_handle(ziopp::upath{ "/data/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+		std::vector<uint8_t> read(content.size() + 10);
+		read.resize(handle->read_at(0, read.data(), read.size()));
+		ASSERT_EQ(content, read);
+	}
+	statistics = scheduler.statistics();
+	ASSERT_EQ(1u + 5, statistics[ziopp::io_priority::high].requests);
+	ASSERT_EQ(4510u, statistics[ziopp::io_priority::high].bytes);
+
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/data/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	std::vector<uint8_t> streamed{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+	ASSERT_EQ(content, streamed);
+	ASSERT_LT(statistics[ziopp::io_priority::normal].bytes + 4500, scheduler.statistics()[ziopp::io_priority::normal].bytes);
+
+	// Opening the file again closes the earlier stream and reads from the start
+	std::iostream& again = fs.open_file(ziopp::upath{ "/data/file.bin" }, ziopp::file_mode::open, ziopp::file_access::read);
+	ASSERT_EQ(content, (std::vector<uint8_t>{ std::istreambuf_iterator<char>(again), std::istreambuf_iterator<char>() }));
+
+	fs.move_file(ziopp::upath{ "/data/file.bin" }, ziopp::upath{ "/data/moved.bin" });
+	ASSERT_TRUE(fs.file_exists(ziopp::upath{ "/data/moved.bin" }));
+	fs.delete_directory(ziopp::upath{ "/data" }, true);
+	ASSERT_FALSE(memory.directory_exists(ziopp::upath{ "/data" }));
+	ASSERT_EQ(0u, scheduler.statistics().running);
+}
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <algorithm>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/sync_tree.h>
+
+namespace {
+	std::string pattern(size_t length, unsigned seed)
+	{
+		std::string content(length, '\0');
+		uint32_t state = seed;
+		for (char& c : content)
+		{
+			state = state * 1664525 + 1013904223;
+			c = static_cast<char>(state >> 24);
+		}
+		return content;
+	}
+
+	// Reads of a file behind the furthest offset already read return zeros, as if the file changed after it was first read
+	class changing_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit changing_filesystem(ziopp::filesystem& next) : compose_filesystem(next)
+		{
+		}
+
+		using compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			std::unique_ptr<ziopp::file_handle> handle = compose_filesystem::open_handle(path, mode, access);
+			if (access != ziopp::file_access::read)
+			{
+				return handle;
+			}
+			return std::unique_ptr<ziopp::file_handle>(new changing_handle(std::move(handle)));
+		}
+	private:
+		class changing_handle : public ziopp::file_handle {
+		public:
+			explicit changing_handle(std::unique_ptr<ziopp::file_handle> inner) : inner_(std::move(inner)), furthest_(0)
+			{
+			}
+
+			size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+			{
+				size_t read = inner_->read_at(offset, buffer, count);
+				if (offset < furthest_)
+				{
+					std::fill(buffer, buffer + read, static_cast<uint8_t>(0));
+				}
+				furthest_ = std::max(furthest_, offset + read);
+				return read;
+			}
+
+			size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+			{
+				return inner_->write_at(offset, buffer, count);
+			}
+
+			uint64_t size() const override
+			{
+				return inner_->size();
+			}
+
+			void sync() override
+			{
+				inner_->sync();
+			}
+		private:
+			std::unique_ptr<ziopp::file_handle> inner_;
+			uint64_t furthest_;
+		};
+	};
+
+	// Fails every replace_file, as a destination that cannot rename over files would
+	class unreplaceable_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit unreplaceable_filesystem(ziopp::filesystem& next) : compose_filesystem(next)
+		{
+		}
+
+		using compose_filesystem::replace_file;
+
+		void replace_file(const ziopp::upath&, const ziopp::upath&, bool) override
+		{
+			throw std::ios_base::failure("replace_file is not supported", std::make_error_code(std::errc::operation_not_supported));
+		}
+	};
+}
+
+TEST(sync_tree, mirrors_tree) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem dest{};
+	std::string content{ "abc" };
+	src.create_directory(ziopp::upath{ "/tree/a/inner" });
+	src.create_directory(ziopp::upath{ "/tree/b" });
+	src.write_all_text(ziopp::upath{ "/tree/a/file.txt" }, content);
+	src.write_all_text(ziopp::upath{ "/tree/a/inner/file.txt" }, content);
+	src.write_all_text(ziopp::upath{ "/tree/b/file.txt" }, content);
+
+	ziopp::sync_result result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" });
+	ASSERT_EQ(3u, result.files_copied);
+	ASSERT_EQ(4u, result.directories_created);
+	ASSERT_EQ(9u, result.bytes_transferred);
+	ASSERT_EQ("abc", dest.read_all_text(ziopp::upath{ "/copy/a/inner/file.txt" }));
+	ASSERT_EQ(src.write_time(ziopp::upath{ "/tree/b/file.txt" }), dest.write_time(ziopp::upath{ "/copy/b/file.txt" }));
+
+	result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" });
+	ASSERT_EQ(0u, result.files_copied);
+	ASSERT_EQ(3u, result.files_unchanged);
+	ASSERT_EQ(9u, result.bytes_saved());
+
+	// Same length and time but different contents is only caught when contents are compared
+	std::string other{ "xyz" };
+	dest.write_all_text(ziopp::upath{ "/copy/b/file.txt" }, other);
+	dest.write_time(ziopp::upath{ "/copy/b/file.txt" }, src.write_time(ziopp::upath{ "/tree/b/file.txt" }));
+	ziopp::sync_options options{};
+	options.compare_contents = true;
+	result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" }, options);
+	ASSERT_EQ(1u, result.files_copied);
+	ASSERT_EQ("abc", dest.read_all_text(ziopp::upath{ "/copy/b/file.txt" }));
+
+	dest.write_all_text(ziopp::upath{ "/copy/extra.txt" }, content);
+	dest.create_directory(ziopp::upath{ "/copy/extra/inner" });
+	src.delete_directory(ziopp::upath{ "/tree/a/inner" }, true);
+	result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" });
+	ASSERT_EQ(1u, result.files_deleted);
+	ASSERT_EQ(2u, result.directories_deleted);
+	ASSERT_FALSE(dest.file_exists(ziopp::upath{ "/copy/extra.txt" }));
+	ASSERT_FALSE(dest.directory_exists(ziopp::upath{ "/copy/a/inner" }));
+
+	ASSERT_THROW(ziopp::sync_tree(src, ziopp::upath{ "/tree" }, src, ziopp::upath{ "/tree/a/copy" }), std::invalid_argument);
+	ASSERT_THROW(ziopp::sync_tree(src, ziopp::upath{ "/missing" }, dest, ziopp::upath{ "/copy" }), std::ios_base::failure);
+}
+
+TEST(sync_tree, patches_changed_blocks) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem dest{};
+	src.create_directory(ziopp::upath{ "/tree" });
+	dest.create_directory(ziopp::upath{ "/copy" });
+
+	std::string original = pattern(64 * 1024, 1);
+	dest.write_all_text(ziopp::upath{ "/copy/large.bin" }, original);
+	// Bytes inserted near the start shift every later block, which the rolling checksum still finds
+	std::string changed = original.substr(0, 1000) + pattern(100, 2) + original.substr(1000, 40000) + original.substr(50000);
+	src.write_all_text(ziopp::upath{ "/tree/large.bin" }, changed);
+
+	ziopp::sync_options options{};
+	options.delta_threshold = 1024;
+	options.block_size = 1024;
+	ziopp::sync_result result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" }, options);
+	ASSERT_EQ(1u, result.files_patched);
+	ASSERT_EQ(changed.size(), result.bytes_total);
+	ASSERT_LT(result.bytes_transferred, 4u * 1024u);
+	ASSERT_EQ(changed, dest.read_all_text(ziopp::upath{ "/copy/large.bin" }));
+	ASSERT_EQ(src.write_time(ziopp::upath{ "/tree/large.bin" }), dest.write_time(ziopp::upath{ "/copy/large.bin" }));
+	ASSERT_FALSE(dest.file_exists(ziopp::upath{ "/copy/.large.bin.ziopp-sync" }));
+}
+
+TEST(sync_tree, copies_files_patched_wrongly) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem memory{};
+	changing_filesystem dest{ memory };
+	src.create_directory(ziopp::upath{ "/tree" });
+	dest.create_directory(ziopp::upath{ "/copy" });
+
+	std::string original = pattern(16 * 1024, 1);
+	dest.write_all_text(ziopp::upath{ "/copy/large.bin" }, original);
+	std::string changed = original + pattern(100, 2);
+	src.write_all_text(ziopp::upath{ "/tree/large.bin" }, changed);
+
+	// The blocks are signed on the first read of dest and copied from zeros on the second, so the patched file is caught and dropped
+	ziopp::sync_options options{};
+	options.delta_threshold = 1024;
+	options.block_size = 1024;
+	ziopp::sync_result result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" }, options);
+	ASSERT_EQ(0u, result.files_patched);
+	ASSERT_EQ(1u, result.files_copied);
+	ASSERT_EQ(changed.size(), result.bytes_transferred);
+	ASSERT_EQ(changed, memory.read_all_text(ziopp::upath{ "/copy/large.bin" }));
+	ASSERT_FALSE(memory.file_exists(ziopp::upath{ "/copy/.large.bin.ziopp-sync" }));
+}
+
+TEST(sync_tree, keeps_files_named_like_temporary_files) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem dest{};
+	src.create_directory(ziopp::upath{ "/tree" });
+	dest.create_directory(ziopp::upath{ "/copy/.large.bin.ziopp-sync-1" });
+
+	std::string original = pattern(16 * 1024, 1);
+	std::string kept{ "kept" };
+	dest.write_all_text(ziopp::upath{ "/copy/large.bin" }, original);
+	dest.write_all_text(ziopp::upath{ "/copy/.large.bin.ziopp-sync" }, kept);
+	std::string changed = original + pattern(100, 2);
+	src.write_all_text(ziopp::upath{ "/tree/large.bin" }, changed);
+
+	ziopp::sync_options options{};
+	options.delete_extraneous = false;
+	options.delta_threshold = 1024;
+	options.block_size = 1024;
+	ziopp::sync_result result = ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" }, options);
+	ASSERT_EQ(1u, result.files_patched);
+	ASSERT_EQ(changed, dest.read_all_text(ziopp::upath{ "/copy/large.bin" }));
+	ASSERT_EQ("kept", dest.read_all_text(ziopp::upath{ "/copy/.large.bin.ziopp-sync" }));
+	ASSERT_TRUE(dest.directory_exists(ziopp::upath{ "/copy/.large.bin.ziopp-sync-1" }));
+	ASSERT_FALSE(dest.file_exists(ziopp::upath{ "/copy/.large.bin.ziopp-sync-2" }));
+}
+
+TEST(sync_tree, deletes_temporary_files_of_failed_patches) {
+	ziopp::memory_filesystem src{};
+	ziopp::memory_filesystem memory{};
+	unreplaceable_filesystem dest{ memory };
+	src.create_directory(ziopp::upath{ "/tree" });
+	dest.create_directory(ziopp::upath{ "/copy" });
+
+	std::string original = pattern(16 * 1024, 1);
+	dest.write_all_text(ziopp::upath{ "/copy/large.bin" }, original);
+	std::string changed = original + pattern(100, 2);
+	src.write_all_text(ziopp::upath{ "/tree/large.bin" }, changed);
+
+	ziopp::sync_options options{};
+	options.delta_threshold = 1024;
+	options.block_size = 1024;
+	ASSERT_THROW(ziopp::sync_tree(src, ziopp::upath{ "/tree" }, dest, ziopp::upath{ "/copy" }, options), std::ios_base::failure);
+	ASSERT_EQ(original, memory.read_all_text(ziopp::upath{ "/copy/large.bin" }));
+	ASSERT_FALSE(memory.file_exists(ziopp::upath{ "/copy/.large.bin.ziopp-sync" }));
+}
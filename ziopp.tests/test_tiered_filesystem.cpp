@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/tiered_filesystem.h>
+
+namespace {
+	void write_text(ziopp::filesystem& fs, const ziopp::upath& path, std::string content)
+	{
+		fs.write_all_text(path, content);
+	}
+}
+
+TEST(tiered_filesystem, frequency_sketch) {
+	ziopp::frequency_sketch sketch{ 16 };
+	for (int i = 0; i < 5; i++)
+	{
+		sketch.increment("/hot");
+	}
+	sketch.increment("/cold");
+	ASSERT_EQ(5u, sketch.estimate("/hot"));
+	ASSERT_EQ(1u, sketch.estimate("/cold"));
+	for (int i = 0; i < 20; i++)
+	{
+		sketch.increment("/hot");
+	}
+	ASSERT_EQ(15u, sketch.estimate("/hot"));
+
+	// Counts halve after 10 increments per counter of a row
+	for (int i = 0; i < 150; i++)
+	{
+		sketch.increment("/other" + std::to_string(i % 5));
+	}
+	ASSERT_GT(15u, sketch.estimate("/hot"));
+}
+
+TEST(tiered_filesystem, promotes_hot_files) {
+	ziopp::memory_filesystem fast{};
+	ziopp::memory_filesystem slow{};
+	ziopp::tiered_filesystem fs{ fast, slow };
+	fs.create_directory(ziopp::upath{ "/data" });
+	write_text(fs, ziopp::upath{ "/data/a.txt" }, "first");
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+
+	ASSERT_EQ("first", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_EQ("first", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_TRUE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_EQ("first", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+	ziopp::tiered_statistics statistics = fs.statistics();
+	ASSERT_EQ(1u, statistics.fast_reads);
+	ASSERT_EQ(2u, statistics.slow_reads);
+	ASSERT_EQ(1u, statistics.promotions);
+	ASSERT_EQ(1u, statistics.fast_files);
+	ASSERT_EQ(5u, statistics.fast_bytes);
+
+	// Metadata and enumeration come from the slow tier
+	ASSERT_EQ(slow.write_time(ziopp::upath{ "/data/a.txt" }), fs.write_time(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_EQ(5u, fs.file_length(ziopp::upath{ "/data/a.txt" }));
+	std::vector<ziopp::upath> paths;
+	for (ziopp::upath_iterator it = fs.enumerate_paths(ziopp::upath{ "/" }, "*", ziopp::search_options::all_directories, ziopp::search_target::both); it != ziopp::upath_iterator{}; ++it)
+	{
+		paths.push_back(*it);
+	}
+	ASSERT_EQ((std::vector<ziopp::upath>{ ziopp::upath{ "/data" }, ziopp::upath{ "/data/a.txt" } }), paths);
+
+	// Writing drops the copy
+	write_text(fs, ziopp::upath{ "/data/a.txt" }, "second");
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_EQ("second", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_TRUE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/data/a.txt" }, ziopp::file_mode::open, ziopp::file_access::read_write);
+	handle->write_at(0, reinterpret_cast<const uint8_t*>("third!"), 6);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	handle.reset();
+
+	// So do changes passed to invalidate
+	ASSERT_EQ("third!", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+	write_text(slow, ziopp::upath{ "/data/a.txt" }, "fourth");
+	fs.invalidate(ziopp::upath{ "/data" });
+	ASSERT_EQ("fourth", fs.read_all_text(ziopp::upath{ "/data/a.txt" }));
+
+	fs.move_file(ziopp::upath{ "/data/a.txt" }, ziopp::upath{ "/data/b.txt" });
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/data/a.txt" }));
+	ASSERT_EQ("fourth", fs.read_all_text(ziopp::upath{ "/data/b.txt" }));
+	fs.delete_directory(ziopp::upath{ "/data" }, true);
+	ASSERT_FALSE(fs.directory_exists(ziopp::upath{ "/data" }));
+	ASSERT_EQ(0u, fs.statistics().fast_files);
+}
+
+TEST(tiered_filesystem, admits_frequent_files) {
+	ziopp::memory_filesystem fast{};
+	ziopp::memory_filesystem slow{};
+	ziopp::tiered_options options{};
+	options.max_bytes = 3000;
+	ziopp::tiered_filesystem fs{ fast, slow, options };
+	std::vector<uint8_t> content(1000, 0x5a);
+	for (const char* name : { "/hot1", "/hot2", "/hot3", "/cold", "/warm" })
+	{
+		fs.write_all_binary(ziopp::upath{ name }, content);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		for (const char* name : { "/hot1", "/hot2", "/hot3" })
+		{
+			ASSERT_EQ(content, fs.read_all_binary(ziopp::upath{ name }));
+		}
+	}
+	ASSERT_EQ(3u, fs.statistics().fast_files);
+
+	// Read less often than every file in the fast tier
+	for (int i = 0; i < 2; i++)
+	{
+		ASSERT_EQ(content, fs.read_all_binary(ziopp::upath{ "/cold" }));
+	}
+	ziopp::tiered_statistics statistics = fs.statistics();
+	ASSERT_EQ(1u, statistics.rejections);
+	ASSERT_EQ(3u, statistics.fast_files);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/cold" }));
+
+	// Read more often than the least recently read file, which is demoted
+	for (int i = 0; i < 4; i++)
+	{
+		ASSERT_EQ(content, fs.read_all_binary(ziopp::upath{ "/warm" }));
+	}
+	statistics = fs.statistics();
+	ASSERT_EQ(1u, statistics.demotions);
+	ASSERT_EQ(3000u, statistics.fast_bytes);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/hot1" }));
+	ASSERT_TRUE(fast.file_exists(ziopp::upath{ "/warm" }));
+	ASSERT_TRUE(slow.file_exists(ziopp::upath{ "/hot1" }));
+
+	fs.clear();
+	ASSERT_EQ(0u, fs.statistics().fast_bytes);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/warm" }));
+}
+
+TEST(tiered_filesystem, closes_streams_opened_again) {
+	ziopp::memory_filesystem fast{};
+	ziopp::memory_filesystem slow{};
+	ziopp::tiered_filesystem fs{ fast, slow };
+	write_text(fs, ziopp::upath{ "/log.txt" }, "");
+
+	// Opening the file again closes the earlier stream, which writes what it still buffers
+	fs.open_file(ziopp::upath{ "/log.txt" }, ziopp::file_mode::append, ziopp::file_access::write) << "first ";
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/log.txt" }, ziopp::file_mode::append, ziopp::file_access::write);
+	ASSERT_EQ("first ", slow.read_all_text(ziopp::upath{ "/log.txt" }));
+	stream << "second";
+	stream.flush();
+	ASSERT_EQ("first second", fs.read_all_text(ziopp::upath{ "/log.txt" }));
+}
+
+TEST(tiered_filesystem, keeps_streams_of_demoted_files) {
+	ziopp::memory_filesystem fast{};
+	ziopp::memory_filesystem slow{};
+	ziopp::tiered_options options{};
+	options.max_bytes = 10;
+	ziopp::tiered_filesystem fs{ fast, slow, options };
+	write_text(fs, ziopp::upath{ "/a" }, "aaaaaaaa");
+	write_text(fs, ziopp::upath{ "/b" }, "bbbbbbbb");
+	for (int i = 0; i < 2; i++)
+	{
+		ASSERT_EQ("aaaaaaaa", fs.read_all_text(ziopp::upath{ "/a" }));
+	}
+	ASSERT_TRUE(fast.file_exists(ziopp::upath{ "/a" }));
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/a" }, ziopp::file_mode::open, ziopp::file_access::read);
+
+	// Read more often than "/a", so "/a" is demoted while its stream is open
+	for (int i = 0; i < 6; i++)
+	{
+		ASSERT_EQ("bbbbbbbb", fs.read_all_text(ziopp::upath{ "/b" }));
+	}
+	ASSERT_EQ(1u, fs.statistics().demotions);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/a" }));
+	std::string content;
+	stream.seekg(0);
+	stream >> content;
+	ASSERT_EQ("aaaaaaaa", content);
+
+	// Writing another file drops only its own copy
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/b" }, ziopp::file_mode::open, ziopp::file_access::read_write);
+	handle->write_at(0, reinterpret_cast<const uint8_t*>("c"), 1);
+	ASSERT_FALSE(fast.file_exists(ziopp::upath{ "/b" }));
+	stream.clear();
+	stream.seekg(4);
+	stream >> content;
+	ASSERT_EQ("aaaa", content);
+}
@@ -1,6 +1,12 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <ziopp/path_arena.h>
 #include <ziopp/upath.h>
+#include <ziopp/upath_impl.h>
+#include <ziopp/upath_literal.h>
 
 TEST(upath, absolute_and_relative) {
 	ziopp::upath path{ std::string{ "x" } };
@@ -78,7 +84,13 @@ std::make_pair(std::string{ ".a" }, std::string{ ".a" }),
 std::make_pair(std::string{ ".a/b/.." }, std::string{ ".a" }),
 std::make_pair(std::string{ "...a/b../" }, std::string{ "...a/b.." }),
 std::make_pair(std::string{ "...a/.." }, std::string{}),
-std::make_pair(std::string{ "...a/b/.." }, std::string{ "...a" })
+std::make_pair(std::string{ "...a/b/.." }, std::string{ "...a" }),
+
+// Tests with a trailing separator after dots
+std::make_pair(std::string{ "b/./" }, std::string{ "b" }),
+std::make_pair(std::string{ "b/../" }, std::string{}),
+std::make_pair(std::string{ ".b./..\\" }, std::string{}),
+std::make_pair(std::string{ "/a/./" }, std::string{ "/a" })
 );
 
 class TestCombineFixture : public ::testing::TestWithParam<std::tuple<std::string, std::string, std::string>> {
@@ -238,6 +250,10 @@ INSTANTIATE_TEST_CASE_P(
         // Test relative paths
         std::make_tuple(std::string{ "a/b" }, std::string{ "a" }, false, true),
 
+        // Test paths that only share characters with the directory
+        std::make_tuple(std::string{ "/b/a" }, std::string{ "/a" }, false, false),
+        std::make_tuple(std::string{ "/b/a/c" }, std::string{ "/a" }, true, false),
+
         // Test exact match
         std::make_tuple(std::string{ "/a/b/" }, std::string{ "/a/b/" }, false, true),
         std::make_tuple(std::string{ "/a/b/" }, std::string{ "/a/b/" }, true, true),
@@ -245,6 +261,176 @@ INSTANTIATE_TEST_CASE_P(
         std::make_tuple(std::string{ "/a/b" }, std::string{ "/a/b" }, true, true)
 	));
 
+TEST(upath, in_directory_mixed) {
+	ASSERT_THROW(ziopp::upath{ "/a/b" }.in_directory(ziopp::upath{ "a" }, true), std::invalid_argument);
+}
+
+TEST(upath, try_parse) {
+	ziopp::upath path{ "/unchanged" };
+	ASSERT_TRUE(ziopp::upath::try_parse("/a/./b/../c/", path));
+	ASSERT_EQ("/a/c", path.full_name());
+	ASSERT_FALSE(ziopp::upath::try_parse("/..", path));
+	ASSERT_FALSE(ziopp::upath::try_parse("/a/...", path));
+	ASSERT_EQ("/a/c", path.full_name());
+}
+
+TEST(upath, policies) {
+	typedef ziopp::basic_upath<ziopp::posix_path_policy> posix_upath;
+	static_assert(!std::is_convertible<posix_upath, ziopp::upath>::value, "conversions between policies are explicit");
+
+	// On POSIX a backslash is part of a name
+	posix_upath posix{ "/a\\b//c/" };
+	ASSERT_EQ("/a\\b/c", posix.full_name());
+	ASSERT_EQ("a\\b", posix.directory().name());
+	ASSERT_EQ("/a/b/c", ziopp::upath{ posix }.full_name());
+	ASSERT_EQ("/a/b", posix_upath{ ziopp::upath{ "\\a\\b" } }.full_name());
+	ASSERT_THROW(posix_upath{ "/a/../.." }, std::invalid_argument);
+
+	// Trusted paths are kept as they are
+	ziopp::basic_upath<ziopp::trusted_posix_path_policy> trusted{ "/a/./b" };
+	ASSERT_EQ("/a/./b", trusted.full_name());
+
+	typedef ziopp::basic_upath<ziopp::case_insensitive_path_policy> insensitive_upath;
+	ASSERT_EQ(insensitive_upath{ "/Config/App.json" }, insensitive_upath{ "\\config\\app.JSON" });
+	ASSERT_NE(insensitive_upath{ "/Config/App.json" }, insensitive_upath{ "/config/app.yaml" });
+	ASSERT_NE(ziopp::upath{ "/Config" }, ziopp::upath{ "/config" });
+}
+
+TEST(upath, ordering) {
+	// `/` sorts below every other character, so a directory's entries come right after it
+	ASSERT_LT(ziopp::upath{ "a/b" }, ziopp::upath{ "a-b" });
+	ASSERT_LT(ziopp::upath{ "a" }, ziopp::upath{ "a/b" });
+	ASSERT_LT(ziopp::upath{ "a-b" }, ziopp::upath{ "a0" });
+	ASSERT_LT(ziopp::upath{ "" }, ziopp::upath{ "/" });
+	ASSERT_LT(ziopp::upath{ "/" }, ziopp::upath{ "/a" });
+	ASSERT_GT(ziopp::upath{ "/b" }, ziopp::upath{ "/a/z" });
+	ASSERT_EQ(0, ziopp::upath{ "/a/b" }.compare(ziopp::upath{ "\\a\\b" }));
+	ASSERT_LE(ziopp::upath{ "/a" }, ziopp::upath{ "/a" });
+	ASSERT_GE(ziopp::upath{ "/a" }, ziopp::upath{ "/a" });
+
+	typedef ziopp::basic_upath<ziopp::case_insensitive_path_policy> insensitive_upath;
+	ASSERT_EQ(0, insensitive_upath{ "/Config" }.compare(insensitive_upath{ "/config" }));
+	ASSERT_LT(insensitive_upath{ "/A/b" }, insensitive_upath{ "/a-B" });
+
+	std::vector<ziopp::upath> paths{ ziopp::upath{ "/srv/a-b" }, ziopp::upath{ "/srv/a/b" }, ziopp::upath{ "/srv/a" }, ziopp::upath{ "/srv" }, ziopp::upath{ "/" }, ziopp::upath{ "" } };
+	ziopp::upath::sort(paths);
+	ASSERT_EQ((std::vector<ziopp::upath>{ ziopp::upath{ "" }, ziopp::upath{ "/" }, ziopp::upath{ "/srv" }, ziopp::upath{ "/srv/a" }, ziopp::upath{ "/srv/a/b" }, ziopp::upath{ "/srv/a-b" } }), paths);
+
+	// Large enough to be sorted by buckets, with long shared prefixes and duplicates
+	std::vector<ziopp::upath> many;
+	for (int i = 0; i < 2000; i++)
+	{
+		int n = (i * 7919) % 1000;
+		many.push_back(ziopp::upath{ "/var/lib/data/" + std::to_string(n % 13) + (n % 2 == 0 ? "/" : "-") + std::to_string(n) + (n % 3 == 0 ? "" : ".bin") });
+	}
+	std::vector<ziopp::upath> expected = many;
+	std::sort(expected.begin(), expected.end());
+	ziopp::upath::sort(many);
+	ASSERT_EQ(expected, many);
+
+	std::vector<insensitive_upath> mixed{ insensitive_upath{ "/B" }, insensitive_upath{ "/a/C" }, insensitive_upath{ "/A" } };
+	insensitive_upath::sort(mixed);
+	ASSERT_EQ("/A", mixed[0].full_name());
+	ASSERT_EQ("/a/C", mixed[1].full_name());
+}
+
+namespace {
+	ziopp::arena_upath arena_path(const char* path, ziopp::path_arena& arena)
+	{
+		return ziopp::arena_upath{ path, std::strlen(path), arena };
+	}
+}
+
+TEST(upath, allocators) {
+	ziopp::inline_path_arena<4096> arena{};
+	ziopp::arena_upath site = arena_path("/srv/www/example.org/", arena);
+	ziopp::arena_upath page = ziopp::arena_upath::combine(site, arena_path("./static/../pages/index.html", arena));
+	ASSERT_EQ("/srv/www/example.org/pages/index.html", page.full_name());
+	ASSERT_EQ("/srv/www/example.org/pages", page.directory().full_name());
+	ASSERT_EQ("srv/www/example.org/pages/index.html", page.to_relative().full_name());
+	ASSERT_EQ("/srv/www/example.org/pages/index.html", page.to_relative().to_absolute().full_name());
+	ASSERT_EQ("/srv/www/example.org/pages/index.txt", page.change_extension("txt").full_name());
+	ASSERT_EQ("index.html", page.name());
+	ASSERT_TRUE(ziopp::arena_upath::try_parse("/srv/www/example.org/./pages/", site));
+	ASSERT_EQ("/srv/www/example.org/pages", site.full_name());
+	ASSERT_EQ(&arena, page.directory().get_allocator().arena());
+	ASSERT_EQ(&arena, site.get_allocator().arena());
+	ASSERT_LT(0u, arena.used());
+	ASSERT_EQ(0u, arena.overflows());
+
+	// Converting keeps the normalized path without checking it again
+	ziopp::upath kept{ page };
+	ASSERT_EQ(ziopp::upath{ "/srv/www/example.org/pages/index.html" }, kept);
+	ASSERT_EQ(page, (ziopp::arena_upath{ kept, arena }));
+
+	// A full arena falls back to the heap
+	ziopp::inline_path_arena<16> small{};
+	ziopp::arena_upath large = arena_path("/a/path/that/does/not/fit/in/sixteen/bytes", small);
+	ASSERT_EQ("/a/path/that/does/not/fit/in/sixteen/bytes", large.full_name());
+	ASSERT_LT(0u, small.overflows());
+
+#ifdef ZIOPP_HAS_PMR_UPATH
+	// Runs out of memory rather than going to the heap
+	char buffer[1024];
+	std::pmr::monotonic_buffer_resource resource{ buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+	const char* index = "/srv/www/example.org/./static/../index.html";
+	ziopp::pmr_upath pmr{ index, std::strlen(index), &resource };
+	ASSERT_EQ("/srv/www/example.org/index.html", pmr.full_name());
+	ASSERT_EQ("/srv/www/example.org/about.html", ziopp::pmr_upath::combine(pmr.directory(), ziopp::pmr_upath{ "about.html", 10, &resource }).full_name());
+#endif
+}
+
+#ifdef ZIOPP_HAS_UPATH_LITERALS
+using namespace ziopp::literals;
+
+static_assert(("/a/./b/../c/"_up).size() == 4, "literals are normalized at compile time");
+static_assert(("//a//..//"_up).size() == 1, "literals are normalized at compile time");
+
+#define ASSERT_LITERAL(PATH) ASSERT_EQ(ziopp::upath{ std::string{ PATH } }, static_cast<ziopp::upath>(PATH ## _up)) << PATH
+
+TEST(upath, literals) {
+	ASSERT_LITERAL("");
+	ASSERT_LITERAL("/");
+	ASSERT_LITERAL("\\");
+	ASSERT_LITERAL(".");
+	ASSERT_LITERAL("..");
+	ASSERT_LITERAL("./");
+	ASSERT_LITERAL("a");
+	ASSERT_LITERAL("a/");
+	ASSERT_LITERAL("/a/b/c");
+	ASSERT_LITERAL("/config/app.json");
+	ASSERT_LITERAL("a\\b\\c\\");
+	ASSERT_LITERAL("//a//b//");
+	ASSERT_LITERAL("/./a/./b/.");
+	ASSERT_LITERAL("./.");
+	ASSERT_LITERAL("a/../.");
+	ASSERT_LITERAL("./..");
+	ASSERT_LITERAL("../.");
+	ASSERT_LITERAL("../../a/..");
+	ASSERT_LITERAL("a/../c");
+	ASSERT_LITERAL("a/b/c/../..");
+	ASSERT_LITERAL("a/b/c/../../..");
+	ASSERT_LITERAL("/a/..");
+	ASSERT_LITERAL("/a/b/../../c");
+	ASSERT_LITERAL(".a/b/..");
+	ASSERT_LITERAL("...a/b../");
+	ASSERT_LITERAL("...a/..");
+	ASSERT_LITERAL("b/./");
+	ASSERT_LITERAL("b/../");
+	ASSERT_LITERAL(".b./..\\");
+	ASSERT_LITERAL("/a/./");
+	ASSERT_LITERAL("a/..\\");
+	ASSERT_LITERAL("../");
+	ASSERT_LITERAL("..\\");
+	// Fail to compile as literals
+	ASSERT_THROW(ziopp::upath{ ".../" }, std::invalid_argument);
+	ASSERT_THROW(ziopp::upath{ "/../" }, std::invalid_argument);
+
+	ziopp::upath config = "/config"_up;
+	ASSERT_EQ("/config/app.json", (config / "app.json"_up).full_name());
+}
+#endif
+
 TEST_STRING_PAIR(name, path1, expectedName, {
 	ziopp::upath path{ path1 };
 	const std::string result = path.name();
@@ -283,4 +469,4 @@ TEST(upath, split) {
 	ASSERT_THAT(ziopp::upath{ "a" }.split(), ::testing::ElementsAre("a"));
 	ASSERT_THAT(ziopp::upath{ "a/b" }.split(), ::testing::ElementsAre("a", "b"));
 	ASSERT_THAT(ziopp::upath{ "a/b/c" }.split(), ::testing::ElementsAre("a", "b", "c"));
-}
\ No newline at end of file
+}
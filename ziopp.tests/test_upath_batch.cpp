@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <ziopp/upath_batch.h>
+
+TEST(upath_batch, normalizes) {
+	std::vector<std::string> paths{ "/a/./b/../c/", "", "\\", "/..", "x\\y", "/a/...", "/config/app.json" };
+	ziopp::upath_batch batch{ paths };
+	ASSERT_EQ(7u, batch.size());
+	ASSERT_EQ(2u, batch.error_count());
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		ziopp::upath path;
+		if (ziopp::upath::try_parse(paths[i], path))
+		{
+			ASSERT_EQ(nullptr, batch.error(i)) << paths[i];
+			ASSERT_EQ(path.full_name(), static_cast<std::string>(batch[i])) << paths[i];
+			ASSERT_EQ(path, batch[i].to_upath());
+		}
+		else
+		{
+			ASSERT_NE(nullptr, batch.error(i)) << paths[i];
+			ASSERT_TRUE(batch[i].empty());
+		}
+	}
+	ASSERT_EQ(ziopp::upath_view{ ziopp::upath{ "/config/app.json" } }, batch[6]);
+	ASSERT_TRUE(batch[6].absolute());
+	ASSERT_EQ("/a/c/x/y/config/app.json", batch.data());
+	ASSERT_EQ((std::vector<size_t>{ 0, 4, 4, 5, 5, 8, 8, 24 }), batch.offsets());
+
+	std::vector<ziopp::upath> upaths = batch.to_upaths();
+	ASSERT_EQ(ziopp::upath{ "x/y" }, upaths[4]);
+	ASSERT_TRUE(upaths[3].empty());
+}
+
+TEST(upath_batch, chunks) {
+	std::vector<std::string> paths;
+	for (int i = 0; i < 1000; i++)
+	{
+		paths.push_back(i % 97 == 0 ? "/../" + std::to_string(i) : "/data/./" + std::to_string(i % 10) + "//file" + std::to_string(i) + ".bin");
+	}
+	ziopp::upath_batch whole{ paths };
+
+	ziopp::thread_pool pool{ 4 };
+	ziopp::upath_batch_options options{};
+	options.chunk_size = 64;
+	options.work_executor = &pool;
+	ziopp::upath_batch chunked{ paths, options };
+	ASSERT_EQ(whole.data(), chunked.data());
+	ASSERT_EQ(whole.offsets(), chunked.offsets());
+	ASSERT_EQ(11u, chunked.error_count());
+	ASSERT_EQ(whole.error(97), chunked.error(97));
+	ASSERT_EQ("/data/3/file13.bin", static_cast<std::string>(chunked[13]));
+}
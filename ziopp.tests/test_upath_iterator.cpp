@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <vector>
+#include <ziopp/upath_iterator.h>
+
+namespace {
+	ziopp::upath_iterator over(const std::vector<ziopp::upath>& paths)
+	{
+		std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+		return ziopp::upath_iterator{ [&paths, next]() -> const ziopp::upath* {
+			return *next < paths.size() ? &paths[(*next)++] : nullptr;
+		} };
+	}
+}
+
+TEST(upath_iterator, end) {
+	ASSERT_EQ(ziopp::upath_iterator{}, ziopp::upath_iterator{});
+	std::vector<ziopp::upath> none{};
+	ASSERT_EQ(ziopp::upath_iterator{}, over(none));
+	ASSERT_EQ(ziopp::upath_iterator{}, ziopp::upath_iterator{ std::function<const ziopp::upath*()>{} });
+}
+
+TEST(upath_iterator, iterates) {
+	std::vector<ziopp::upath> paths{ ziopp::upath{ "/a" }, ziopp::upath{ "/b" }, ziopp::upath{ "/c" } };
+	std::vector<ziopp::upath> seen;
+	for (ziopp::upath_iterator it = over(paths); it != ziopp::upath_iterator{}; ++it)
+	{
+		seen.push_back(*it);
+		ASSERT_EQ(it->full_name(), seen.back().full_name());
+	}
+	ASSERT_EQ(paths, seen);
+}
+
+TEST(upath_iterator, copies_share_the_enumeration) {
+	std::vector<ziopp::upath> paths{ ziopp::upath{ "/a" }, ziopp::upath{ "/b" }, ziopp::upath{ "/c" } };
+	ziopp::upath_iterator first = over(paths);
+	ziopp::upath_iterator second = first;
+	ASSERT_EQ(first, second);
+	++second;
+	ASSERT_EQ(ziopp::upath{ "/b" }, *first);
+
+	// The previous position is a copy, which stays valid once the enumeration moves on
+	ziopp::upath_iterator previous = first++;
+	ASSERT_EQ(ziopp::upath{ "/b" }, *previous);
+	ASSERT_EQ(ziopp::upath{ "/c" }, *second);
+	ASSERT_NE(previous, first);
+	++first;
+	ASSERT_EQ(ziopp::upath_iterator{}, second);
+	ASSERT_EQ(ziopp::upath{ "/b" }, *previous);
+}
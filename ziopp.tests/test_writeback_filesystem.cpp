@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/memory_filesystem.h>
+#include <ziopp/writeback_filesystem.h>
+
+namespace {
+	void write_text(ziopp::filesystem& fs, const ziopp::upath& path, std::string content)
+	{
+		fs.write_all_text(path, content);
+	}
+
+	void append_text(ziopp::filesystem& fs, const ziopp::upath& path, std::string content)
+	{
+		fs.append_all_text(path, content);
+	}
+
+	ziopp::writeback_options held_back()
+	{
+		ziopp::writeback_options options{};
+		options.flush_delay = std::chrono::hours(1);
+		return options;
+	}
+
+	// Counts the syncs of the files opened for writing
+	class sync_counting_filesystem : public ziopp::compose_filesystem {
+	public:
+		explicit sync_counting_filesystem(ziopp::filesystem& next) : compose_filesystem(next), syncs(0)
+		{
+		}
+
+		using compose_filesystem::open_handle;
+
+		std::unique_ptr<ziopp::file_handle> open_handle(const ziopp::upath& path, ziopp::file_mode mode, ziopp::file_access access) override
+		{
+			return std::unique_ptr<ziopp::file_handle>(new counted_handle(compose_filesystem::open_handle(path, mode, access), syncs));
+		}
+
+		std::atomic<int> syncs;
+	private:
+		class counted_handle : public ziopp::file_handle {
+		public:
+			counted_handle(std::unique_ptr<ziopp::file_handle> inner, std::atomic<int>& syncs) : inner_(std::move(inner)), syncs_(syncs)
+			{
+			}
+
+			size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+			{
+				return inner_->read_at(offset, buffer, count);
+			}
+
+			size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+			{
+				return inner_->write_at(offset, buffer, count);
+			}
+
+			uint64_t size() const override
+			{
+				return inner_->size();
+			}
+
+			void sync() override
+			{
+				syncs_++;
+				inner_->sync();
+			}
+		private:
+			std::unique_ptr<ziopp::file_handle> inner_;
+			std::atomic<int>& syncs_;
+		};
+	};
+
+	void wait_for_flushes(const ziopp::writeback_filesystem& fs, uint64_t flushes)
+	{
+		while (fs.statistics().flushes < flushes || fs.statistics().dirty_files != 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+TEST(writeback_filesystem, writes_back_on_flush) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_filesystem fs{ memory, held_back() };
+	fs.create_directory(ziopp::upath{ "/data" });
+	write_text(fs, ziopp::upath{ "/data/state.txt" }, "first");
+	write_text(fs, ziopp::upath{ "/data/state.txt" }, "second");
+	write_text(memory, ziopp::upath{ "/data/log.txt" }, "start.");
+	append_text(fs, ziopp::upath{ "/data/log.txt" }, "one.");
+	append_text(fs, ziopp::upath{ "/data/log.txt" }, "two.");
+
+	// The files exist at once, the bytes are pending
+	ASSERT_TRUE(memory.file_exists(ziopp::upath{ "/data/state.txt" }));
+	ASSERT_EQ(0u, memory.file_length(ziopp::upath{ "/data/state.txt" }));
+	ASSERT_EQ("start.", memory.read_all_text(ziopp::upath{ "/data/log.txt" }));
+	ASSERT_EQ("second", fs.read_all_text(ziopp::upath{ "/data/state.txt" }));
+	ASSERT_EQ(6u, fs.file_length(ziopp::upath{ "/data/state.txt" }));
+	ASSERT_EQ(14u, fs.file_length(ziopp::upath{ "/data/log.txt" }));
+	ASSERT_EQ(6u, fs.stat_many({ ziopp::upath{ "/data/state.txt" } })[0].length);
+	ziopp::writeback_statistics statistics = fs.statistics();
+	ASSERT_EQ(4u, statistics.writes);
+	ASSERT_EQ(2u, statistics.dirty_files);
+	ASSERT_EQ(14u, statistics.dirty_bytes);
+	ASSERT_EQ(0u, statistics.flushes);
+
+	// Each file is written back once
+	fs.flush();
+	ASSERT_EQ("second", memory.read_all_text(ziopp::upath{ "/data/state.txt" }));
+	ASSERT_EQ("start.one.two.", memory.read_all_text(ziopp::upath{ "/data/log.txt" }));
+	statistics = fs.statistics();
+	ASSERT_EQ(2u, statistics.flushes);
+	ASSERT_EQ(14u, statistics.flushed_bytes);
+	ASSERT_EQ(0u, statistics.dirty_files);
+	ASSERT_EQ(0u, statistics.dirty_bytes);
+
+	// Reading appended bytes writes them back first
+	append_text(fs, ziopp::upath{ "/data/log.txt" }, "three.");
+	ASSERT_EQ("start.one.two.three.", fs.read_all_text(ziopp::upath{ "/data/log.txt" }));
+	ASSERT_EQ("start.one.two.three.", memory.read_all_text(ziopp::upath{ "/data/log.txt" }));
+
+	// Writes through a handle are read back through it
+	std::unique_ptr<ziopp::file_handle> handle = fs.open_handle(ziopp::upath{ "/data/state.txt" }, ziopp::file_mode::open, ziopp::file_access::read_write);
+	handle->write_at(0, reinterpret_cast<const uint8_t*>("third!"), 6);
+	uint8_t read[6];
+	ASSERT_EQ(6u, handle->read_at(0, read, sizeof(read)));
+	ASSERT_EQ("third!", std::string(reinterpret_cast<const char*>(read), sizeof(read)));
+	handle->sync();
+	ASSERT_EQ("third!", memory.read_all_text(ziopp::upath{ "/data/state.txt" }));
+	handle.reset();
+
+	// Deleting drops the pending bytes, moving writes them back first
+	write_text(fs, ziopp::upath{ "/data/temp.txt" }, "scratch");
+	fs.delete_file(ziopp::upath{ "/data/temp.txt" });
+	write_text(fs, ziopp::upath{ "/data/state.txt" }, "fourth");
+	fs.move_file(ziopp::upath{ "/data/state.txt" }, ziopp::upath{ "/data/moved.txt" });
+	ASSERT_EQ("fourth", memory.read_all_text(ziopp::upath{ "/data/moved.txt" }));
+	fs.flush();
+	ASSERT_FALSE(memory.file_exists(ziopp::upath{ "/data/temp.txt" }));
+	ASSERT_EQ(5u, fs.statistics().flushes);
+
+	ASSERT_THROW(fs.open_handle(ziopp::upath{ "/data/moved.txt" }, ziopp::file_mode::create_new, ziopp::file_access::write), std::ios_base::failure);
+	ASSERT_THROW(write_text(fs, ziopp::upath{ "/missing/file.txt" }, "lost"), std::ios_base::failure);
+}
+
+TEST(writeback_filesystem, writes_back_in_the_background) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_options options{};
+	options.flush_delay = std::chrono::milliseconds(1);
+	ziopp::thread_pool pool{ 2 };
+	options.work_executor = &pool;
+	ziopp::writeback_filesystem fs{ memory, options };
+	for (const char* name : { "/a.txt", "/b.txt", "/c.txt" })
+	{
+		write_text(fs, ziopp::upath{ name }, name);
+	}
+	while (fs.statistics().dirty_files != 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ("/b.txt", memory.read_all_text(ziopp::upath{ "/b.txt" }));
+	ASSERT_LT(0u, fs.statistics().batches);
+}
+
+TEST(writeback_filesystem, syncs_files_written_back_in_the_background) {
+	ziopp::memory_filesystem memory{};
+	sync_counting_filesystem counting{ memory };
+	ziopp::writeback_options options{};
+	options.flush_delay = std::chrono::milliseconds(1);
+	ziopp::writeback_filesystem fs{ counting, options };
+	fs.create_directory(ziopp::upath{ "/data" });
+
+	write_text(fs, ziopp::upath{ "/a.txt" }, "first");
+	wait_for_flushes(fs, 1);
+	ASSERT_EQ(0, counting.syncs);
+	fs.sync(ziopp::upath{ "/a.txt" });
+	ASSERT_EQ(1, counting.syncs);
+	fs.sync(ziopp::upath{ "/a.txt" });
+	ASSERT_EQ(1, counting.syncs);
+
+	// A moved file is synced under its new name, a deleted one not at all
+	write_text(fs, ziopp::upath{ "/data/b.txt" }, "second");
+	write_text(fs, ziopp::upath{ "/data/c.txt" }, "third");
+	wait_for_flushes(fs, 3);
+	fs.move_file(ziopp::upath{ "/data/b.txt" }, ziopp::upath{ "/data/moved.txt" });
+	fs.delete_file(ziopp::upath{ "/data/c.txt" });
+	fs.sync(ziopp::upath{ "/data" });
+	ASSERT_EQ(2, counting.syncs);
+	ASSERT_EQ("second", memory.read_all_text(ziopp::upath{ "/data/moved.txt" }));
+}
+
+TEST(writeback_filesystem, limits_dirty_bytes) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_options options = held_back();
+	options.max_dirty_bytes = 1000;
+	ziopp::writeback_filesystem fs{ memory, options };
+	std::vector<uint8_t> content(400, 0x5a);
+	for (int i = 0; i < 10; i++)
+	{
+		fs.write_all_binary(ziopp::upath{ "/file" + std::to_string(i) }, content);
+		ASSERT_GE(1000u + 400, fs.statistics().dirty_bytes);
+	}
+	ziopp::writeback_statistics statistics = fs.statistics();
+	ASSERT_LT(0u, statistics.flushes);
+	fs.flush();
+	for (int i = 0; i < 10; i++)
+	{
+		ASSERT_EQ(content, memory.read_all_binary(ziopp::upath{ "/file" + std::to_string(i) }));
+	}
+}
+
+TEST(writeback_filesystem, reports_errors) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_filesystem fs{ memory, held_back() };
+	fs.create_directory(ziopp::upath{ "/data" });
+	write_text(fs, ziopp::upath{ "/data/a.txt" }, "lost");
+	write_text(fs, ziopp::upath{ "/kept.txt" }, "kept");
+	memory.delete_directory(ziopp::upath{ "/data" }, true);
+
+	ASSERT_THROW(fs.sync(ziopp::upath{ "/data" }), std::ios_base::failure);
+	fs.sync(ziopp::upath{ "/data" });
+	ASSERT_EQ(1u, fs.statistics().errors);
+	ASSERT_EQ("kept", fs.read_all_text(ziopp::upath{ "/kept.txt" }));
+	fs.flush();
+	ASSERT_EQ("kept", memory.read_all_text(ziopp::upath{ "/kept.txt" }));
+}
+
+TEST(writeback_filesystem, forgets_files_in_deleted_directories) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_filesystem fs{ memory, held_back() };
+	fs.create_directory(ziopp::upath{ "/data" });
+	write_text(fs, ziopp::upath{ "/data/a.txt" }, "lost");
+	// Sorts between "/data" and "/data/a.txt"
+	write_text(fs, ziopp::upath{ "/data.txt" }, "kept");
+
+	fs.delete_directory(ziopp::upath{ "/data" }, true);
+	ASSERT_EQ(1u, fs.statistics().dirty_files);
+	fs.flush();
+	ASSERT_EQ(0u, fs.statistics().errors);
+	ASSERT_FALSE(memory.directory_exists(ziopp::upath{ "/data" }));
+	ASSERT_EQ("kept", memory.read_all_text(ziopp::upath{ "/data.txt" }));
+}
+
+TEST(writeback_filesystem, closes_streams_opened_again) {
+	ziopp::memory_filesystem memory{};
+	ziopp::writeback_filesystem fs{ memory, held_back() };
+	write_text(fs, ziopp::upath{ "/log.txt" }, "");
+
+	// Opening the file again closes the earlier stream, which writes what it still buffers
+	fs.open_file(ziopp::upath{ "/log.txt" }, ziopp::file_mode::append, ziopp::file_access::write) << "first ";
+	std::iostream& stream = fs.open_file(ziopp::upath{ "/log.txt" }, ziopp::file_mode::append, ziopp::file_access::write);
+	fs.flush();
+	ASSERT_EQ("first ", memory.read_all_text(ziopp::upath{ "/log.txt" }));
+	stream << "second";
+	stream.flush();
+	fs.flush();
+	ASSERT_EQ("first second", memory.read_all_text(ziopp::upath{ "/log.txt" }));
+	ASSERT_EQ(0u, fs.statistics().dirty_files);
+}
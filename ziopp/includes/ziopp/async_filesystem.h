@@ -0,0 +1,123 @@
+#pragma once
+
+#include <ziopp/task.h>
+
+#ifdef ZIOPP_HAS_COROUTINES
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ziopp/executor.h>
+#include <ziopp/filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief Exposes the blocking operations of a filesystem as coroutines.
+	 *
+	 * Each operation runs on the given executor, so the coroutine calling it is never blocked by I/O.
+	 * The coroutine continues on the executor once the operation completes.
+	 * Requires C++ 20 coroutines, the rest of the library is unaffected.
+	 *
+	 */
+	class async_filesystem {
+	public:
+		/**
+		 * @brief Construct a new async_filesystem object
+		 *
+		 * @param fs The filesystem to run operations on. It must outlive the async_filesystem and every task it returns.
+		 * @param io_executor The executor that runs the blocking operations.
+		 */
+		async_filesystem(filesystem& fs, executor& io_executor) : fs_(fs), io_executor_(io_executor)
+		{
+		}
+
+		/**
+		 * @brief Gets the wrapped filesystem.
+		 *
+		 * @return filesystem& The wrapped filesystem.
+		 */
+		filesystem& fs() const
+		{
+			return fs_;
+		}
+
+		/**
+		 * @brief Gets the executor that runs the blocking operations.
+		 *
+		 * @return executor& The executor.
+		 */
+		executor& io_executor() const
+		{
+			return io_executor_;
+		}
+
+		/**
+		 * @brief Asynchronously reads the contents of a binary file.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @return task<std::vector<uint8_t>> The contents of the file.
+		 */
+		task<std::vector<uint8_t>> read_all_binary_async(upath path)
+		{
+			co_await schedule(io_executor_);
+			co_return fs_.read_all_binary(path);
+		}
+
+		/**
+		 * @brief Asynchronously reads the contents of a text file.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @return task<std::string> The contents of the file.
+		 */
+		task<std::string> read_all_text_async(upath path)
+		{
+			co_await schedule(io_executor_);
+			co_return fs_.read_all_text(path);
+		}
+
+		/**
+		 * @brief Asynchronously copies a file to another filesystem.
+		 *
+		 * @param dest_filesystem The destination filesystem.
+		 * @param src The source path of the file to copy.
+		 * @param dest The destination path of the file in the destination filesystem.
+		 * @param overwrite true to overwrite an existing destination file.
+		 * @return task<> Completes once the file has been copied.
+		 */
+		task<> copy_file_cross_async(filesystem& dest_filesystem, upath src, upath dest, bool overwrite)
+		{
+			co_await schedule(io_executor_);
+			fs_.copy_file_cross(dest_filesystem, src, dest, overwrite);
+		}
+
+		/**
+		 * @brief Asynchronously enumerates the paths matching a search pattern.
+		 *
+		 * Advancing the enumeration runs on the executor, one entry at a time.
+		 *
+		 * @param path The path to the directory to search.
+		 * @param search_pattern The search string to match against file-system entries in path.
+		 * @param options Whether the search should include only the current directory or all subdirectories.
+		 * @param target The search target either files and folders or only directories or files.
+		 * @return async_generator<upath> The matching paths.
+		 */
+		async_generator<upath> enumerate_paths_async(upath path, std::string search_pattern, search_options options, search_target target)
+		{
+			co_await schedule(io_executor_);
+			upath_iterator iterator = fs_.enumerate_paths(path, search_pattern, options, target);
+			const upath_iterator end{};
+			while (iterator != end)
+			{
+				upath current = *iterator;
+				co_yield current;
+				co_await schedule(io_executor_);
+				++iterator;
+			}
+		}
+	private:
+		filesystem& fs_;
+		executor& io_executor_;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ziopp/file_handle.h>
+
+namespace ziopp {
+	/**
+	 * @brief Controls how buffered_writer gathers writes.
+	 *
+	 */
+	struct write_options {
+		/**
+		 * @brief The number of bytes gathered before they are written to the file.
+		 *
+		 */
+		size_t buffer_size = 1024 * 1024;
+		/**
+		 * @brief When not 0, the buffer is aligned to this many bytes and written at offsets that are multiples of it,
+		 * as files opened for direct I/O require. Must be a power of two.
+		 *
+		 */
+		size_t alignment = 0;
+	};
+
+	/**
+	 * @brief Writes a file sequentially through a large buffer.
+	 *
+	 * Writes are copied into the buffer and the file is only written when the buffer fills, or when flush or sync is called,
+	 * so many small writes become a few large ones. Writes at least as large as the buffer go to the file directly.
+	 *
+	 * With an alignment, the file is written in whole blocks from offsets that are multiples of the alignment. A flush that ends
+	 * inside a block writes the bytes of that block alone, keeps them in the buffer and writes the block again whole with what
+	 * follows, and a writer starting inside a block reads the start of it, so the handle must then be readable, and not opened
+	 * with file_mode::append.
+	 *
+	 * Not safe to use from many threads, see group_appender for that.
+	 *
+	 */
+	class buffered_writer {
+	public:
+		/**
+		 * @brief Construct a new buffered_writer.
+		 *
+		 * @param handle The file to write.
+		 * @param offset The offset in the file of the first byte to write, the size of the file to append.
+		 * @param options Controls how writes are gathered.
+		 */
+		buffered_writer(std::unique_ptr<file_handle> handle, uint64_t offset, const write_options& options = write_options{});
+
+		/**
+		 * @brief Flushes what is still buffered. Errors are ignored, call flush first to see them.
+		 *
+		 */
+		~buffered_writer();
+
+		buffered_writer(const buffered_writer&) = delete;
+		buffered_writer& operator=(const buffered_writer&) = delete;
+
+		/**
+		 * @brief Writes bytes after those already written.
+		 *
+		 * @param data The bytes to write.
+		 * @param count The number of bytes to write.
+		 */
+		void write(const uint8_t* data, size_t count);
+
+		/**
+		 * @brief Writes a string after the bytes already written.
+		 *
+		 * @param content The string to write.
+		 */
+		void write(const std::string& content);
+
+		/**
+		 * @brief Writes everything buffered to the file.
+		 *
+		 */
+		void flush();
+
+		/**
+		 * @brief Writes everything buffered to the file then flushes the file to the underlying storage.
+		 *
+		 */
+		void sync();
+
+		/**
+		 * @brief Gets the offset in the file the next byte will be written at.
+		 *
+		 * @return uint64_t The offset.
+		 */
+		uint64_t position() const;
+
+		/**
+		 * @brief Gets the file being written.
+		 *
+		 * @return file_handle& The file.
+		 */
+		file_handle& handle();
+	private:
+		void write_buffer();
+
+		std::unique_ptr<file_handle> handle_;
+		const size_t alignment_;
+		std::vector<uint8_t> storage_;
+		uint8_t* buffer_;
+		size_t capacity_;
+		// The offset in the file of buffer_[0]
+		uint64_t buffer_offset_;
+		size_t filled_;
+		// The bytes at the start of the buffer already written, kept so the block they are in can be written again whole
+		size_t written_;
+	};
+
+	/**
+	 * @brief Controls how group_appender writes batches.
+	 *
+	 */
+	struct append_options {
+		/**
+		 * @brief Whether each batch is flushed to the underlying storage before the appends in it return.
+		 *
+		 */
+		bool sync = false;
+	};
+
+	/**
+	 * @brief Appends to a file from many threads, writing the appends made at the same time together.
+	 *
+	 * The first thread to append while no batch is being written writes the pending appends, its own included, in a single write.
+	 * Threads appending meanwhile queue their bytes and wait, and the next of them writes everything queued while it waited.
+	 * Each append returns once its bytes are written, and synced with append_options::sync, so concurrent appends share the cost
+	 * of a write and of a sync. Each append is written whole, appends are never interleaved.
+	 *
+	 * When a write fails, the appends of its batch throw and the next batch is written at the same offset, so the file has no hole.
+	 *
+	 */
+	class group_appender {
+	public:
+		/**
+		 * @brief Construct a new group_appender.
+		 *
+		 * @param handle The file to append to.
+		 * @param options Controls how batches are written.
+		 */
+		explicit group_appender(std::unique_ptr<file_handle> handle, const append_options& options = append_options{});
+
+		group_appender(const group_appender&) = delete;
+		group_appender& operator=(const group_appender&) = delete;
+
+		/**
+		 * @brief Appends bytes to the file, returning once they are written.
+		 *
+		 * @param data The bytes to append.
+		 * @param count The number of bytes to append.
+		 */
+		void append(const uint8_t* data, size_t count);
+
+		/**
+		 * @brief Appends a string to the file, returning once it is written.
+		 *
+		 * @param content The string to append.
+		 */
+		void append(const std::string& content);
+
+		/**
+		 * @brief Flushes the file to the underlying storage.
+		 *
+		 */
+		void sync();
+
+		/**
+		 * @brief Gets the number of writes made to the file.
+		 *
+		 * @return uint64_t The number of batches written.
+		 */
+		uint64_t batches() const;
+
+		/**
+		 * @brief Gets the number of appends made.
+		 *
+		 * @return uint64_t The number of appends.
+		 */
+		uint64_t appends() const;
+	private:
+		std::unique_ptr<file_handle> handle_;
+		const append_options options_;
+		mutable std::mutex mutex_;
+		std::condition_variable written_;
+		std::vector<uint8_t> pending_;
+		uint64_t end_;
+		// Batches are numbered from 1, the open batch is the one appends are added to
+		uint64_t open_batch_;
+		uint64_t written_batch_;
+		// Receives the failure of the open batch, shared by its appends
+		std::shared_ptr<std::exception_ptr> open_error_;
+		bool writing_;
+		uint64_t batches_;
+		uint64_t appends_;
+	};
+}
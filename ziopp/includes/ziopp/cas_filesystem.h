@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <ziopp/filesystem.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief Controls how cas_filesystem splits and caches contents.
+	 *
+	 */
+	struct cas_options {
+		/**
+		 * @brief The smallest chunk, in bytes, except for the last chunk of a file.
+		 *
+		 */
+		size_t min_chunk_size = 2 * 1024;
+		/**
+		 * @brief The size, in bytes, chunks are cut around. Must be a power of two.
+		 *
+		 */
+		size_t average_chunk_size = 8 * 1024;
+		/**
+		 * @brief The largest chunk, in bytes.
+		 *
+		 */
+		size_t max_chunk_size = 64 * 1024;
+		/**
+		 * @brief The largest number of bytes of chunks kept in memory for reads.
+		 *
+		 */
+		size_t cache_size = 64 * 1024 * 1024;
+	};
+
+	/**
+	 * @brief How much a cas_filesystem saved by storing each chunk once.
+	 *
+	 */
+	struct cas_statistics {
+		/**
+		 * @brief The number of bytes committed by writes. A file committed again through the same handles is counted at its new length.
+		 *
+		 */
+		uint64_t logical_bytes;
+		/**
+		 * @brief The number of bytes of the chunks written to the store.
+		 *
+		 */
+		uint64_t stored_bytes;
+		uint64_t chunks_written;
+		/**
+		 * @brief The number of chunks committed that the store already had.
+		 *
+		 */
+		uint64_t chunks_deduplicated;
+		uint64_t cache_hits;
+		uint64_t cache_misses;
+	};
+
+	/**
+	 * @brief A filesystem that stores each distinct piece of content once, in a directory of another filesystem.
+	 *
+	 * Contents are split into chunks at boundaries chosen by a rolling Gear hash (FastCDC), so an insertion only changes the chunks around it.
+	 * Each chunk is stored under its BLAKE3 digest in the chunks directory of the root, and each file is a small manifest listing its chunks
+	 * in the files directory of the root, which also holds the directories and times. Copying a file copies its manifest only.
+	 *
+	 * Files opened for writing are held in memory and committed, chunked and stored, when their handle or stream is synced, when a handle is
+	 * destroyed, and by flush. Reads of a file being written see the uncommitted contents. Chunks read are kept in a least recently used cache.
+	 * Chunks no manifest refers to any more are only removed by collect_garbage.
+	 *
+	 * Streams returned by open_file live until their file is opened again with the same mode and access, moved or deleted, or the filesystem
+	 * is destroyed. Opening the file again closes the earlier stream, which commits what it wrote.
+	 *
+	 */
+	class cas_filesystem : public filesystem {
+	public:
+		/**
+		 * @brief Construct a new cas_filesystem.
+		 *
+		 * @param store The filesystem chunks and manifests are kept in. It must outlive this filesystem.
+		 * @param root The directory of store to keep them in, created if it does not exist.
+		 * @param options Controls how contents are split and cached.
+		 */
+		cas_filesystem(filesystem& store, const upath& root, const cas_options& options = cas_options{});
+
+		/**
+		 * @brief Commits every file still being written.
+		 *
+		 */
+		~cas_filesystem();
+
+		cas_filesystem(const cas_filesystem&) = delete;
+		cas_filesystem& operator=(const cas_filesystem&) = delete;
+
+		/**
+		 * @brief Commits every file still being written.
+		 *
+		 */
+		void flush();
+
+		/**
+		 * @brief Deletes the chunks no manifest refers to.
+		 *
+		 * Commits wait while the store is scanned.
+		 *
+		 * @return size_t The number of chunks deleted.
+		 */
+		size_t collect_garbage();
+
+		/**
+		 * @brief Gets how much was written and how much storing each chunk once saved.
+		 *
+		 * @return cas_statistics The counters since the filesystem was constructed.
+		 */
+		cas_statistics statistics() const;
+
+		// The error_code overloads are the defaults, which catch the exceptions of the overloads below
+		using filesystem::create_directory;
+		using filesystem::delete_directory;
+		using filesystem::copy_file;
+		using filesystem::file_length;
+		using filesystem::move_file;
+		using filesystem::delete_file;
+		using filesystem::open_handle;
+
+		void create_directory(const upath& path) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void delete_file(const upath& path) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+		bool can_watch(const upath& path) const override;
+		const filesystem_watcher& watch(const upath& path) override;
+		const std::string path_to_internal(const upath& path) const override;
+		const upath& path_from_internal(const std::string& system_path) const override;
+	private:
+		struct chunk_ref {
+			std::string digest;
+			uint64_t offset;
+			size_t length;
+		};
+
+		struct manifest {
+			uint64_t length;
+			std::vector<chunk_ref> chunks;
+		};
+
+		struct pending_file;
+		class chunk_cache;
+		class chunk_handle;
+		class pending_handle;
+
+		upath manifest_path(const upath& path) const;
+		upath chunk_path(const std::string& digest) const;
+		manifest read_manifest(const upath& path) const;
+		void write_manifest(const upath& path, const manifest& contents);
+		std::shared_ptr<const std::vector<uint8_t>> load_chunk(const chunk_ref& chunk) const;
+		void write_chunk(const upath& stored, const uint8_t* data, size_t length);
+		std::shared_ptr<pending_file> find_pending(const upath& path) const;
+		void commit(pending_file& file);
+		void commit(const upath& path);
+		void forget(const upath& path, bool recursive);
+
+		filesystem& store_;
+		const upath root_;
+		const upath files_;
+		const upath chunks_;
+		const cas_options options_;
+		std::unique_ptr<chunk_cache> cache_;
+		mutable std::mutex mutex_;
+		// Checking that the chunks of a commit are stored and writing its manifest is serialized with garbage collection,
+		// so a chunk cannot be collected between being found in the store and being referred to
+		std::mutex commit_mutex_;
+		std::map<std::string, std::weak_ptr<pending_file>> pending_;
+		std::unique_ptr<detail::stream_table> streams_;
+		std::set<std::string> known_chunks_;
+		mutable std::map<std::string, upath> internal_paths_;
+		std::atomic<uint64_t> logical_bytes_;
+		std::atomic<uint64_t> stored_bytes_;
+		std::atomic<uint64_t> chunks_written_;
+		std::atomic<uint64_t> chunks_deduplicated_;
+		// Numbers the temporaries chunks are written to, so commits storing the same chunk at once do not share one
+		std::atomic<uint64_t> temporaries_;
+	};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <ziopp/filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief Base class of filesystems that wrap another filesystem.
+	 *
+	 * Every method, the batch operations, open_handle and the error_code overloads included, is forwarded unchanged to the wrapped filesystem,
+	 * so a decorator only overrides the methods it changes. A decorator changing a method with an error_code overload should override both.
+	 *
+	 */
+	class compose_filesystem : public filesystem {
+	public:
+		compose_filesystem(const compose_filesystem&) = delete;
+		compose_filesystem& operator=(const compose_filesystem&) = delete;
+
+		/**
+		 * @brief Gets the wrapped filesystem.
+		 *
+		 * @return filesystem& The wrapped filesystem.
+		 */
+		filesystem& next_filesystem() const;
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+		bool can_watch(const upath& path) const override;
+		const filesystem_watcher& watch(const upath& path) override;
+		const std::string path_to_internal(const upath& path) const override;
+		const upath& path_from_internal(const std::string& system_path) const override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	protected:
+		/**
+		 * @brief Construct a new compose_filesystem.
+		 *
+		 * @param next The filesystem to forward to. It must outlive this filesystem.
+		 */
+		explicit compose_filesystem(filesystem& next);
+	private:
+		filesystem& next_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ziopp/executor.h>
+#include <ziopp/upath.h>
+
+namespace ziopp {
+	/**
+	 * @brief The hash functions content can be hashed with.
+	 *
+	 */
+	enum class hash_algorithm {
+		/**
+		 * @brief The 64 bit xxHash, a fast non-cryptographic hash for detecting changes. Digests are 8 bytes.
+		 *
+		 */
+		xxh64,
+		/**
+		 * @brief SHA-256. Digests are 32 bytes.
+		 *
+		 */
+		sha256,
+		/**
+		 * @brief BLAKE3, a fast cryptographic hash whose tree structure lets large files be hashed by many threads. Digests are 32 bytes.
+		 *
+		 */
+		blake3
+	};
+
+	/**
+	 * @brief Gets the number of bytes in the digests of a hash function.
+	 *
+	 * @param algorithm The hash function.
+	 * @return size_t The size of its digests.
+	 */
+	size_t digest_size(hash_algorithm algorithm);
+
+	/**
+	 * @brief Formats a digest as lowercase hexadecimal.
+	 *
+	 * @param digest The digest to format.
+	 * @return std::string Two characters per byte of the digest.
+	 */
+	std::string to_hex(const std::vector<uint8_t>& digest);
+
+	/**
+	 * @brief Hashes content given a piece at a time.
+	 *
+	 * Where SSE2 is available BLAKE3 hashes four 1 KiB chunks at once.
+	 *
+	 */
+	class content_hasher {
+	public:
+		/**
+		 * @brief Construct a new content_hasher.
+		 *
+		 * @param algorithm The hash function to use.
+		 */
+		explicit content_hasher(hash_algorithm algorithm);
+
+		~content_hasher();
+
+		content_hasher(const content_hasher&) = delete;
+		content_hasher& operator=(const content_hasher&) = delete;
+
+		/**
+		 * @brief Adds bytes to the content being hashed.
+		 *
+		 * @param data The bytes to add.
+		 * @param count The number of bytes to add.
+		 */
+		void update(const uint8_t* data, size_t count);
+
+		/**
+		 * @brief Gets the digest of everything added. The hasher cannot be used afterwards.
+		 *
+		 * @return std::vector<uint8_t> The digest.
+		 */
+		std::vector<uint8_t> finish();
+
+		/**
+		 * @brief Hashes bytes held in memory.
+		 *
+		 * @param algorithm The hash function to use.
+		 * @param data The bytes to hash.
+		 * @param count The number of bytes to hash.
+		 * @return std::vector<uint8_t> The digest.
+		 */
+		static std::vector<uint8_t> hash(hash_algorithm algorithm, const uint8_t* data, size_t count);
+	private:
+		class state;
+
+		std::unique_ptr<state> state_;
+	};
+
+	/**
+	 * @brief Remembers the digests of files so unchanged files are not hashed again.
+	 *
+	 * A file is taken to be unchanged while its length and last write time are. Entries are keyed by path, so a cache should only be
+	 * used with one filesystem. Once full the least recently used entry is dropped. Safe to use from many threads.
+	 *
+	 */
+	class hash_cache {
+	public:
+		/**
+		 * @brief Construct a new hash_cache.
+		 *
+		 * @param capacity The largest number of digests kept.
+		 */
+		explicit hash_cache(size_t capacity = 65536);
+
+		/**
+		 * @brief Looks up the digest of a file.
+		 *
+		 * @param path The path of the file.
+		 * @param algorithm The hash function of the digest.
+		 * @param length The current length of the file.
+		 * @param write_time The current last write time of the file.
+		 * @param digest Receives the digest when one is found.
+		 * @return true A digest was stored for the same length and last write time.
+		 * @return false No digest is stored or the file changed since.
+		 */
+		bool find(const upath& path, hash_algorithm algorithm, uint64_t length, const std::chrono::system_clock::time_point& write_time, std::vector<uint8_t>& digest);
+
+		/**
+		 * @brief Stores the digest of a file.
+		 *
+		 * @param path The path of the file.
+		 * @param algorithm The hash function of the digest.
+		 * @param length The length of the file that was hashed.
+		 * @param write_time The last write time of the file that was hashed.
+		 * @param digest The digest.
+		 */
+		void store(const upath& path, hash_algorithm algorithm, uint64_t length, const std::chrono::system_clock::time_point& write_time, const std::vector<uint8_t>& digest);
+
+		/**
+		 * @brief Drops the digests of a file.
+		 *
+		 * @param path The path of the file.
+		 */
+		void invalidate(const upath& path);
+
+		/**
+		 * @brief Drops every digest.
+		 *
+		 */
+		void clear();
+
+		/**
+		 * @brief Gets the number of digests kept.
+		 *
+		 * @return size_t The number of digests.
+		 */
+		size_t size() const;
+	private:
+		struct entry {
+			std::string key;
+			uint64_t length;
+			std::chrono::system_clock::time_point write_time;
+			std::vector<uint8_t> digest;
+		};
+
+		const size_t capacity_;
+		mutable std::mutex mutex_;
+		// Most recently used first
+		std::list<entry> entries_;
+		std::unordered_map<std::string, std::list<entry>::iterator> index_;
+	};
+
+	/**
+	 * @brief Controls how filesystem::hash_file reads and hashes a file.
+	 *
+	 */
+	struct hash_options {
+		/**
+		 * @brief The cache to look digests up in and store them to, nullptr to always hash.
+		 *
+		 */
+		hash_cache* cache = nullptr;
+		/**
+		 * @brief The executor large files are hashed on, nullptr for thread_pool::shared().
+		 *
+		 */
+		executor* work_executor = nullptr;
+		/**
+		 * @brief The largest number of pieces of a file read and hashed at once.
+		 *
+		 */
+		size_t max_concurrency = 8;
+		/**
+		 * @brief Files at least this long are split into 1 MiB pieces hashed in parallel, when the hash function allows it.
+		 *
+		 */
+		uint64_t parallel_threshold = 4 * 1024 * 1024;
+	};
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief What a dentry_cache knows is at a path.
+	 *
+	 */
+	enum class dentry_kind {
+		missing,
+		file,
+		directory
+	};
+
+	/**
+	 * @brief The state of a dentry_cache a lookup of the filesystem started from, taken with dentry_cache::stamp.
+	 *
+	 */
+	struct dentry_stamp {
+		uint64_t epoch;
+		uint64_t generation;
+	};
+
+	/**
+	 * @brief Controls how a dentry_cache is split and how large it grows.
+	 *
+	 */
+	struct dentry_cache_options {
+		/**
+		 * @brief The number of independently locked parts of the cache, rounded up to a power of two.
+		 *
+		 */
+		size_t shard_count = 16;
+		/**
+		 * @brief The largest number of paths remembered.
+		 *
+		 */
+		size_t max_entries = 64 * 1024;
+	};
+
+	/**
+	 * @brief How many lookups a dentry_cache answered.
+	 *
+	 */
+	struct dentry_cache_statistics {
+		/**
+		 * @brief The number of lookups answered with a file or a directory.
+		 *
+		 */
+		uint64_t hits;
+		/**
+		 * @brief The number of lookups answered with dentry_kind::missing.
+		 *
+		 */
+		uint64_t negative_hits;
+		/**
+		 * @brief The number of lookups the cache could not answer.
+		 *
+		 */
+		uint64_t misses;
+		/**
+		 * @brief The number of paths remembered, stale ones included.
+		 *
+		 */
+		size_t entries;
+	};
+
+	/**
+	 * @brief Remembers what is at paths of a filesystem, whether nothing is, and how they map to system paths.
+	 *
+	 * Every directory has a generation, changed by invalidate when an entry of the directory is created, deleted or replaced,
+	 * and the cache has an epoch, changed by invalidate_all. An entry records the epoch and the generation of its directory when the
+	 * lookup of the filesystem it caches started, and is only used while both are unchanged, so invalidating a directory costs the
+	 * same however many entries it has. A lookup racing with a change is never cached past the change, as long as its stamp was taken
+	 * before asking the filesystem and the change is invalidated after it is made.
+	 *
+	 * Paths are spread over shards by hash, each with its own lock. A shard that fills is emptied. The generations of invalidated directories
+	 * are kept until invalidate_all, which is also called once a shard has as many generations as it can have entries.
+	 *
+	 */
+	class dentry_cache {
+	public:
+		/**
+		 * @brief Construct a new empty dentry_cache.
+		 *
+		 * @param options Controls how the cache is split and how large it grows.
+		 */
+		explicit dentry_cache(const dentry_cache_options& options = dentry_cache_options{});
+
+		~dentry_cache();
+
+		dentry_cache(const dentry_cache&) = delete;
+		dentry_cache& operator=(const dentry_cache&) = delete;
+
+		/**
+		 * @brief Gets the state of the cache to insert the result of a lookup with, to be taken before the filesystem is asked.
+		 *
+		 * @param path The path about to be looked up.
+		 * @return dentry_stamp The current epoch and generation of the directory of path.
+		 */
+		dentry_stamp stamp(const upath& path) const;
+
+		/**
+		 * @brief Finds what is at a path.
+		 *
+		 * @param path The path to find.
+		 * @param kind Set to what is at path when it is known.
+		 * @return true if what is at path is known.
+		 * @return false if the filesystem must be asked.
+		 */
+		bool find(const upath& path, dentry_kind& kind) const;
+
+		/**
+		 * @brief Finds the system path a path maps to.
+		 *
+		 * @param path The path to find.
+		 * @param system_path Set to the system path when it is known.
+		 * @return true if the system path is known.
+		 * @return false if the filesystem must be asked.
+		 */
+		bool find_internal(const upath& path, std::string& system_path) const;
+
+		/**
+		 * @brief Remembers what is at a path.
+		 *
+		 * @param path The path looked up.
+		 * @param stamp The stamp taken before the filesystem was asked.
+		 * @param kind What is at path.
+		 */
+		void insert(const upath& path, const dentry_stamp& stamp, dentry_kind kind);
+
+		/**
+		 * @brief Remembers the system path a path maps to.
+		 *
+		 * @param path The path looked up.
+		 * @param stamp The stamp taken before the filesystem was asked.
+		 * @param system_path The system path path maps to.
+		 */
+		void insert_internal(const upath& path, const dentry_stamp& stamp, const std::string& system_path);
+
+		/**
+		 * @brief Forgets a path and the entries of its directory, and, if it is a directory, the entries in it.
+		 *
+		 * To be called after a file or directory is created, deleted or replaced. Entries further below path are kept, use invalidate_all when a
+		 * whole tree changes.
+		 *
+		 * @param path The path that changed.
+		 */
+		void invalidate(const upath& path);
+
+		/**
+		 * @brief Forgets a file and the entries of its directory.
+		 *
+		 * Cheaper than invalidate, since nothing is remembered about path itself, which must not be a directory.
+		 *
+		 * @param path The file that changed.
+		 */
+		void invalidate_file(const upath& path);
+
+		/**
+		 * @brief Forgets every path.
+		 *
+		 */
+		void invalidate_all();
+
+		/**
+		 * @brief Gets how many lookups were answered.
+		 *
+		 * @return dentry_cache_statistics The counters since the cache was constructed.
+		 */
+		dentry_cache_statistics statistics() const;
+	private:
+		struct entry;
+		struct shard;
+
+		shard& shard_of(const std::string& name) const;
+		uint64_t generation(const std::string& directory) const;
+		dentry_stamp stamp(const std::string& name) const;
+		void bump(const std::string& directory);
+		void invalidate(const std::string& name, bool directory);
+		void store(const std::string& name, const dentry_stamp& stamp, const dentry_kind* kind, const std::string* system_path);
+
+		std::vector<std::unique_ptr<shard>> shards_;
+		size_t max_shard_entries_;
+		std::atomic<uint64_t> epoch_;
+		std::atomic<uint64_t> last_generation_;
+		mutable std::atomic<uint64_t> hits_;
+		mutable std::atomic<uint64_t> negative_hits_;
+		mutable std::atomic<uint64_t> misses_;
+	};
+
+	/**
+	 * @brief A filesystem that answers file_exists, directory_exists, exists_many and path_to_internal from a dentry_cache when it can.
+	 *
+	 * Paths found missing stay missing without asking the wrapped filesystem again until something is created at them through this filesystem.
+	 * Changes made through this filesystem invalidate what they change, moving or deleting a directory tree invalidates everything.
+	 * Changes made another way, reported by a watcher for example, must be passed to invalidate.
+	 *
+	 */
+	class dentry_cache_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new dentry_cache_filesystem.
+		 *
+		 * @param next The filesystem whose lookups are cached. It must outlive this filesystem.
+		 * @param options Controls how the cache is split and how large it grows.
+		 */
+		explicit dentry_cache_filesystem(filesystem& next, const dentry_cache_options& options = dentry_cache_options{});
+
+		/**
+		 * @brief Gets the cache of lookups.
+		 *
+		 * @return dentry_cache& The cache.
+		 */
+		dentry_cache& cache();
+
+		/**
+		 * @brief Forgets what is known of a path after it changed without going through this filesystem.
+		 *
+		 * @param path The file or directory that changed.
+		 * @param recursive true if a whole directory tree changed.
+		 */
+		void invalidate(const upath& path, bool recursive);
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::string path_to_internal(const upath& path) const override;
+
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	private:
+		class change_scope;
+
+		dentry_kind lookup(const upath& path, dentry_kind expected) const;
+		bool exists(const upath& path, dentry_kind kind) const;
+
+		mutable dentry_cache cache_;
+	};
+}
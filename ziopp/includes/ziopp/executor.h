@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ziopp {
+	/**
+	 * @brief Interface of something that runs units of work.
+	 *
+	 * Executors are the extension point used by the asynchronous and parallel operations of the library,
+	 * so callers can supply their own scheduling (an event loop, a reactor or a pool) in place of the built-ins.
+	 *
+	 */
+	class executor {
+	public:
+		virtual ~executor() = default;
+
+		/**
+		 * @brief Schedules work to be run by the executor.
+		 *
+		 * @param work The work to run.
+		 */
+		virtual void post(std::function<void()> work) = 0;
+	};
+
+	/**
+	 * @brief An executor that runs work immediately on the calling thread.
+	 *
+	 */
+	class inline_executor : public executor {
+	public:
+		void post(std::function<void()> work) override;
+	};
+
+	/**
+	 * @brief An executor that runs work on a fixed set of background threads.
+	 *
+	 * Each thread has its own queue. Work posted from a thread of the pool goes to that thread's queue and is run newest first,
+	 * so recursive work such as walking a directory tree stays on one thread, and idle threads steal the oldest work of the others.
+	 * Work posted from other threads is spread over the queues in turn.
+	 *
+	 */
+	class thread_pool : public executor {
+	public:
+		/**
+		 * @brief Construct a new thread pool.
+		 *
+		 * @param thread_count The number of threads to start, 0 to use the number of hardware threads.
+		 */
+		explicit thread_pool(size_t thread_count = 0);
+
+		/**
+		 * @brief Runs all pending work then stops the threads of the pool.
+		 *
+		 */
+		~thread_pool();
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		void post(std::function<void()> work) override;
+
+		/**
+		 * @brief Gets the number of threads in the pool.
+		 *
+		 * @return size_t The number of threads in the pool.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Gets a process wide pool sized to the number of hardware threads.
+		 *
+		 * @return thread_pool& The shared pool.
+		 */
+		static thread_pool& shared();
+	private:
+		struct worker_queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> work;
+		};
+
+		void run(size_t index);
+		bool try_take(size_t index, std::function<void()>& work);
+
+		std::vector<std::unique_ptr<worker_queue>> queues_;
+		std::atomic<size_t> pending_;
+		std::atomic<size_t> next_queue_;
+		std::mutex mutex_;
+		std::condition_variable available_;
+		std::vector<std::thread> threads_;
+		bool stopping_;
+	};
+
+	/**
+	 * @brief Runs a group of work on an executor with a limit on how much of it runs at once, then waits for all of it.
+	 *
+	 * Work is queued by the group and taken by the threads the executor runs it on, so the threads of the executor never block on the limit.
+	 * A thread waiting for the group takes queued work too, so waiting from a thread of the executor cannot deadlock when every other
+	 * thread is waiting as well. Once a piece of work throws, work not yet started is skipped and wait rethrows the first exception.
+	 *
+	 */
+	class work_group {
+	public:
+		/**
+		 * @brief Construct a new work_group.
+		 *
+		 * @param runner The executor to run the work on. It must outlive the group.
+		 * @param max_concurrency The largest number of pieces of work running at once, 0 for no limit.
+		 */
+		work_group(executor& runner, size_t max_concurrency);
+
+		/**
+		 * @brief Waits for the work of the group to finish, ignoring any exception.
+		 *
+		 */
+		~work_group();
+
+		work_group(const work_group&) = delete;
+		work_group& operator=(const work_group&) = delete;
+
+		/**
+		 * @brief Adds work to the group. Work may add more work to its own group.
+		 *
+		 * The work runs with the io_priority of the calling thread.
+		 *
+		 * @param work The work to run.
+		 */
+		void run(std::function<void()> work);
+
+		/**
+		 * @brief Waits for all the work of the group to finish, including work added while waiting.
+		 *
+		 * Work not yet started is run on the calling thread, within the concurrency limit. Must not be called from work of the group.
+		 * Throws the first exception thrown by the work.
+		 */
+		void wait();
+
+		/**
+		 * @brief Determines whether a piece of work of the group has thrown.
+		 *
+		 * @return true When a piece of work has thrown.
+		 * @return false Otherwise.
+		 */
+		bool failed() const;
+	private:
+		// Shared with the work posted to the executor, which may only run after the group is gone
+		struct state;
+
+		executor& runner_;
+		std::shared_ptr<state> state_;
+	};
+}
\ No newline at end of file
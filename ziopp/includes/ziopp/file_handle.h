@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ZIOPP_POSIX 1
+#endif
+
+namespace ziopp {
+	enum class file_mode;
+	enum class file_access;
+
+	/**
+	 * @brief A range of a file to read into a caller supplied buffer.
+	 *
+	 */
+	struct file_range {
+		/**
+		 * @brief The offset in the file of the first byte of the range.
+		 *
+		 */
+		uint64_t offset;
+		/**
+		 * @brief The number of bytes in the range.
+		 *
+		 */
+		size_t length;
+		/**
+		 * @brief The buffer receiving the bytes, at least length bytes long.
+		 *
+		 */
+		uint8_t* buffer;
+	};
+
+	/**
+	 * @brief A piece of memory filled in order by file_handle::read_vectored.
+	 *
+	 */
+	struct io_segment {
+		uint8_t* buffer;
+		size_t length;
+	};
+
+	/**
+	 * @brief How a range of a file is about to be accessed, passed to file_handle::advise.
+	 *
+	 */
+	enum class file_advice {
+		/**
+		 * @brief No particular order, the default.
+		 *
+		 */
+		normal,
+		/**
+		 * @brief From the start to the end, so the storage can read ahead further.
+		 *
+		 */
+		sequential,
+		/**
+		 * @brief In no order, so reading ahead is wasted.
+		 *
+		 */
+		random,
+		/**
+		 * @brief Soon, so the storage can start reading it now.
+		 *
+		 */
+		will_need,
+		/**
+		 * @brief Not again, so the storage can drop what it cached of it.
+		 *
+		 */
+		dont_need
+	};
+
+	/**
+	 * @brief Controls how file_handle::read_ranges combines ranges into reads.
+	 *
+	 */
+	struct read_ranges_options {
+		/**
+		 * @brief Ranges separated by at most this many bytes are read together, the bytes in between are discarded.
+		 *
+		 */
+		size_t max_gap = 4096;
+		/**
+		 * @brief The largest number of bytes, gaps included, that a single combined read may span.
+		 *
+		 */
+		size_t max_read_size = 1024 * 1024;
+	};
+
+	/**
+	 * @brief An open file accessed by position instead of through a stream.
+	 *
+	 * Every read and write names its own offset, so there is no shared seek position and
+	 * one handle can be used by many threads at once. Implementations must make read_at safe to call concurrently.
+	 *
+	 */
+	class file_handle {
+	public:
+		virtual ~file_handle() = default;
+
+		/**
+		 * @brief Reads bytes starting at the given offset.
+		 *
+		 * @param offset The offset in the file of the first byte to read.
+		 * @param buffer The buffer receiving the bytes.
+		 * @param count The number of bytes to read.
+		 * @return size_t The number of bytes read, less than count only when the end of the file is reached.
+		 */
+		virtual size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) = 0;
+
+		/**
+		 * @brief Writes bytes starting at the given offset, growing the file if needed.
+		 *
+		 * A handle opened with file_mode::append writes at the end of the file whatever the offset, so appends through different handles
+		 * do not overwrite each other.
+		 *
+		 * @param offset The offset in the file of the first byte to write.
+		 * @param buffer The bytes to write.
+		 * @param count The number of bytes to write.
+		 * @return size_t The number of bytes written.
+		 */
+		virtual size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) = 0;
+
+		/**
+		 * @brief Gets the current size, in bytes, of the file.
+		 *
+		 * @return uint64_t The size of the file.
+		 */
+		virtual uint64_t size() const = 0;
+
+		/**
+		 * @brief Flushes written bytes to the underlying storage.
+		 *
+		 */
+		virtual void sync() = 0;
+
+		/**
+		 * @brief Reads consecutive bytes starting at offset, filling each segment in turn.
+		 *
+		 * The default implementation reads into a temporary buffer with read_at then copies into the segments.
+		 *
+		 * @param offset The offset in the file of the first byte to read.
+		 * @param segments The buffers to fill, in file order.
+		 * @return size_t The number of bytes read, less than the total length of the segments only when the end of the file is reached.
+		 */
+		virtual size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments);
+
+		/**
+		 * @brief Tells the storage how a range of the file is about to be accessed.
+		 *
+		 * Only a hint, which handles are free to ignore: the default implementation does nothing, posix_file_handle calls posix_fadvise
+		 * and handles wrapping another pass the hint on.
+		 *
+		 * @param offset The offset in the file of the first byte of the range.
+		 * @param length The number of bytes of the range, 0 for up to the end of the file.
+		 * @param advice How the range is about to be accessed.
+		 */
+		virtual void advise(uint64_t offset, uint64_t length, file_advice advice);
+
+		/**
+		 * @brief Reads many ranges of the file into their buffers.
+		 *
+		 * Ranges are sorted by offset and ranges close to each other are read with a single read_vectored call,
+		 * so reading hundreds of small ranges costs a handful of reads. Overlapping ranges are read separately.
+		 *
+		 * @param ranges The ranges to read.
+		 * @param callback Called with the index of each range in ranges and the number of bytes read into its buffer, once that buffer has been filled.
+		 * @param options Controls how ranges are combined.
+		 */
+		void read_ranges(const std::vector<file_range>& ranges, const std::function<void(size_t, size_t)>& callback, const read_ranges_options& options = read_ranges_options{});
+	};
+
+	/**
+	 * @brief Adapts a stream to the file_handle interface.
+	 *
+	 * Used by filesystem::open_handle for backends that only provide streams. Operations are serialized by a lock since they share the stream position.
+	 *
+	 */
+	class stream_file_handle : public file_handle {
+	public:
+		/**
+		 * @brief Construct a new stream_file_handle object
+		 *
+		 * @param stream The stream to read and write. It must outlive the handle.
+		 * @param append Whether the stream was opened with file_mode::append, so writes go to its end whatever the offset.
+		 */
+		explicit stream_file_handle(std::iostream& stream, bool append = false);
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override;
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override;
+		uint64_t size() const override;
+		void sync() override;
+	private:
+		uint64_t size_unlocked() const;
+
+		std::iostream& stream_;
+		const bool append_;
+		mutable std::mutex mutex_;
+	};
+
+	/**
+	 * @brief Adapts a file_handle to a stream, the reverse of stream_file_handle.
+	 *
+	 * Used by filesystems that implement open_file with open_handle. Reading and writing share one position, as with a file,
+	 * and reads and writes are buffered, so the stream must not be used from many threads at once. Written bytes reach the handle
+	 * when the stream is flushed, sought, read from or destroyed.
+	 *
+	 */
+	class handle_stream : public std::iostream {
+	public:
+		/**
+		 * @brief Construct a new handle_stream.
+		 *
+		 * @param handle The file to read and write.
+		 * @param append Whether the stream starts at the end of the file and every write moves it back to the end.
+		 */
+		handle_stream(std::unique_ptr<file_handle> handle, bool append);
+
+		~handle_stream();
+	private:
+		class streambuf;
+
+		std::unique_ptr<streambuf> buffer_;
+	};
+
+#ifdef ZIOPP_POSIX
+	/**
+	 * @brief A file_handle over a POSIX file descriptor using pread, pwrite and preadv.
+	 *
+	 * Intended for physical backends to return from filesystem::open_handle.
+	 *
+	 */
+	class posix_file_handle : public file_handle {
+	public:
+		/**
+		 * @brief Construct a new posix_file_handle taking ownership of a file descriptor.
+		 *
+		 * @param descriptor The open file descriptor, closed when the handle is destroyed.
+		 */
+		explicit posix_file_handle(int descriptor);
+
+		~posix_file_handle();
+
+		posix_file_handle(const posix_file_handle&) = delete;
+		posix_file_handle& operator=(const posix_file_handle&) = delete;
+
+		/**
+		 * @brief Opens a file of the operating system.
+		 *
+		 * When mode is file_mode::append the file is opened with O_APPEND, so writes go to the end of the file whatever their offset.
+		 *
+		 * With direct the file is opened with O_DIRECT, or F_NOCACHE where that is what the system has, to bypass the page cache.
+		 * Reads and writes the system rejects as not aligned are then made through a second descriptor of the file opened without O_DIRECT.
+		 * Filesystems without direct I/O open the file normally.
+		 *
+		 * @param system_path The path of the file, as returned by filesystem::path_to_internal.
+		 * @param mode Whether a file is created if one does not exist, and whether the contents of existing files are retained or overwritten.
+		 * @param access The operations that can be performed on the file.
+		 * @param direct Whether to bypass the page cache.
+		 * @return std::unique_ptr<posix_file_handle> The open file.
+		 */
+		static std::unique_ptr<posix_file_handle> open(const std::string& system_path, file_mode mode, file_access access, bool direct = false);
+
+		/**
+		 * @brief Gets the file descriptor.
+		 *
+		 * @return int The file descriptor.
+		 */
+		int descriptor() const;
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override;
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override;
+		uint64_t size() const override;
+		void sync() override;
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override;
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override;
+	private:
+		posix_file_handle(int descriptor, int buffered_descriptor);
+
+		// Switches descriptor to buffered_descriptor_ when the transfer that failed with errno was rejected as not aligned
+		bool fall_back(int& descriptor) const;
+
+		int descriptor_;
+		// The file opened again without O_DIRECT, for the transfers descriptor_ rejects as not aligned, -1 when there is none
+		int buffered_descriptor_;
+	};
+#endif
+}
\ No newline at end of file
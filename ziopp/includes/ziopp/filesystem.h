@@ -1,9 +1,15 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <istream>
+#include <memory>
 #include <string>
+#include <system_error>
 #include <vector>
+#include <ziopp/content_hash.h>
+#include <ziopp/executor.h>
+#include <ziopp/file_handle.h>
 #include <ziopp/filesystem_watcher.h>
 #include <ziopp/upath.h>
 #include <ziopp/upath_iterator.h>
@@ -121,12 +127,135 @@ namespace ziopp {
 		directory = 2
 	};
 
+	/**
+	 * @brief The metadata of a file or directory, as returned by filesystem::stat_many.
+	 *
+	 */
+	struct file_stat {
+		/**
+		 * @brief true if a file or directory exists at the path.
+		 *
+		 */
+		bool exists;
+		/**
+		 * @brief true if the path refers to a directory.
+		 *
+		 */
+		bool is_directory;
+		/**
+		 * @brief The size, in bytes, of the file. Always 0 for directories and missing paths.
+		 *
+		 */
+		size_t length;
+		/**
+		 * @brief The creation date and time.
+		 *
+		 */
+		std::chrono::system_clock::time_point creation_time;
+		/**
+		 * @brief The last access date and time.
+		 *
+		 */
+		std::chrono::system_clock::time_point access_time;
+		/**
+		 * @brief The last write date and time.
+		 *
+		 */
+		std::chrono::system_clock::time_point write_time;
+	};
+
+	/**
+	 * @brief Controls how filesystem::copy_directory_cross and filesystem::delete_directory_parallel spread their work.
+	 *
+	 */
+	struct tree_options {
+		/**
+		 * @brief The executor the work runs on, nullptr for thread_pool::shared().
+		 *
+		 */
+		executor* work_executor = nullptr;
+		/**
+		 * @brief The largest number of files or directories worked on at once.
+		 *
+		 */
+		size_t max_concurrency = 16;
+		/**
+		 * @brief The largest number of files deleted by one call to filesystem::delete_many.
+		 *
+		 */
+		size_t delete_batch_size = 256;
+	};
+
+	/**
+	 * @brief A line of a file, pointing into a buffer owned by the reader.
+	 *
+	 * The bytes are only valid during the callback the line is given to. The line break, "\n" or "\r\n", is not included.
+	 *
+	 */
+	struct line_view {
+		/**
+		 * @brief The first character of the line.
+		 *
+		 */
+		const char* data;
+		/**
+		 * @brief The number of characters in the line.
+		 *
+		 */
+		size_t size;
+		/**
+		 * @brief The offset in the file of the first character of the line.
+		 *
+		 */
+		uint64_t offset;
+
+		/**
+		 * @brief Copies the line into a string.
+		 *
+		 * @return std::string The characters of the line.
+		 */
+		std::string str() const;
+	};
+
+	/**
+	 * @brief Controls how filesystem::for_each_line reads a file.
+	 *
+	 */
+	struct line_options {
+		/**
+		 * @brief The number of bytes read at once. Longer lines grow the buffer.
+		 *
+		 */
+		size_t block_size = 1024 * 1024;
+		/**
+		 * @brief true to split the file at line breaks into pieces read on many threads, in which case lines are not given in order
+		 * and the callback is called from many threads at once.
+		 *
+		 */
+		bool parallel = false;
+		/**
+		 * @brief With parallel, the executor the pieces are read on, nullptr for thread_pool::shared().
+		 *
+		 */
+		executor* work_executor = nullptr;
+		/**
+		 * @brief With parallel, the largest number of pieces read at once.
+		 *
+		 */
+		size_t max_concurrency = 8;
+	};
+
 	/**
 	 * @brief Interface of a file system.
 	 *
+	 * The overloads taking a std::error_code report failures through it: a std::system_error, std::ios_base::failure included, as its code
+	 * and a std::invalid_argument as std::errc::invalid_argument. Anything else, such as std::bad_alloc, is still thrown.
+	 *
 	 */
 	class filesystem {
 	public:
+		virtual ~filesystem() = default;
+
 		/**
 		 * @brief Creates all directories and subdirectories in the specified path unless they already exist.
 		 *
@@ -134,6 +263,16 @@ namespace ziopp {
 		 */
 		virtual void create_directory(const upath& path) = 0;
 
+		/**
+		 * @brief Creates all directories and subdirectories in the specified path unless they already exist, reporting failures instead of throwing.
+		 *
+		 * The default implementation calls the throwing overload and catches its exception. Backends should override it so failing costs no more than succeeding.
+		 *
+		 * @param path The directory to create.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		virtual void create_directory(const upath& path, std::error_code& error);
+
 		/**
 		 * @brief Determines whether the given path refers to an existing directory on disk.
 		 *
@@ -159,6 +298,15 @@ namespace ziopp {
 		 */
 		virtual void delete_directory(const upath& path, bool recursive) = 0;
 
+		/**
+		 * @brief Deletes the specified directory, reporting failures instead of throwing.
+		 *
+		 * @param path The path of the directory to remove.
+		 * @param recursive true to remove directories, subdirectories, and files in path; otherwise false.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		virtual void delete_directory(const upath& path, bool recursive, std::error_code& error);
+
 		/**
 		 * @brief Copies and existing file to a new file.
 		 *
@@ -170,6 +318,16 @@ namespace ziopp {
 		 */
 		virtual void copy_file(const upath& src, const upath& dest, bool overwrite) = 0;
 
+		/**
+		 * @brief Copies an existing file to a new file, reporting failures instead of throwing.
+		 *
+		 * @param src The path of the file to copy.
+		 * @param dest The path of the destination file.
+		 * @param overwrite true if the destination file can be overwritten; otherwise false.
+		 * @param error Set to the reason of the failure, such as std::errc::file_exists, cleared on success.
+		 */
+		virtual void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error);
+
 		/**
 		 * @brief Replaces the contents of a specified file with contents of another file, deleting the original file, and creating a backup of the replace file and optionally ignores merge errors.
 		 *
@@ -197,6 +355,15 @@ namespace ziopp {
 		 */
 		virtual size_t file_length(const upath& path) const = 0;
 
+		/**
+		 * @brief Gets the size, in bytes, of a file, reporting failures instead of throwing.
+		 *
+		 * @param path The path of a file.
+		 * @param error Set to the reason of the failure, such as std::errc::no_such_file_or_directory, cleared on success.
+		 * @return size_t The size, in bytes, of the file, 0 on failure.
+		 */
+		virtual size_t file_length(const upath& path, std::error_code& error) const;
+
 		/**
 		 * @brief Determines where the specified file exists.
 		 *
@@ -214,6 +381,15 @@ namespace ziopp {
 		 */
 		virtual void move_file(const upath& src, const upath& dest) = 0;
 
+		/**
+		 * @brief Moves a file to a new location, reporting failures instead of throwing.
+		 *
+		 * @param src The path of the file to move.
+		 * @param dest The new path and name for the file.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		virtual void move_file(const upath& src, const upath& dest, std::error_code& error);
+
 		/**
 		 * @brief Deletes the specified file.
 		 *
@@ -221,6 +397,14 @@ namespace ziopp {
 		 */
 		virtual void delete_file(const upath& path) = 0;
 
+		/**
+		 * @brief Deletes the specified file, reporting failures instead of throwing.
+		 *
+		 * @param path The path of the file to be deleted.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		virtual void delete_file(const upath& path, std::error_code& error);
+
 		/**
 		 * @brief Opens a file on the specifed path with the specified mode.
 		 *
@@ -231,6 +415,30 @@ namespace ziopp {
 		 */
 		virtual std::iostream& open_file(const upath& path, file_mode mode, file_access access) = 0;
 
+		/**
+		 * @brief Opens a file on the specified path for positional reads and writes.
+		 *
+		 * Unlike open_file the returned handle has no shared seek position and can be used by many threads at once.
+		 * The default implementation adapts the stream returned by open_file, backends should override it to bypass streams.
+		 *
+		 * @param path The path to the file to open.
+		 * @param mode A value that specifies whether a files is created if one does not exist, and determines whether the contents of existing files are retained or overwritten.
+		 * @param access A value that specifies the operations that can be performed on the file.
+		 * @return std::unique_ptr<file_handle> A handle to the file on the specified path.
+		 */
+		virtual std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access);
+
+		/**
+		 * @brief Opens a file on the specified path for positional reads and writes, reporting failures instead of throwing.
+		 *
+		 * @param path The path to the file to open.
+		 * @param mode A value that specifies whether a files is created if one does not exist, and determines whether the contents of existing files are retained or overwritten.
+		 * @param access A value that specifies the operations that can be performed on the file.
+		 * @param error Set to the reason of the failure, such as std::errc::no_such_file_or_directory, cleared on success.
+		 * @return std::unique_ptr<file_handle> A handle to the file, nullptr on failure.
+		 */
+		virtual std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error);
+
 		/**
 		 * @brief Returns the creation date and time of the specified file or directory.
 		 *
@@ -311,6 +519,44 @@ namespace ziopp {
 
 		virtual const upath& path_from_internal(const std::string& system_path) const = 0;
 
+		/**
+		 * @brief Gets the metadata of many files or directories at once.
+		 *
+		 * The default implementation calls the single path methods for each path. Backends where each call is a round trip should override it.
+		 *
+		 * @param paths The paths of the files or directories.
+		 * @return std::vector<file_stat> The metadata of each path, in the same order as paths. Missing paths are reported with exists set to false.
+		 */
+		virtual std::vector<file_stat> stat_many(const std::vector<upath>& paths) const;
+
+		/**
+		 * @brief Determines whether many paths refer to existing files or directories.
+		 *
+		 * The default implementation calls file_exists and directory_exists for each path.
+		 *
+		 * @param paths The paths to test.
+		 * @return std::vector<bool> For each path, in the same order as paths, true if a file or directory exists at the path.
+		 */
+		virtual std::vector<bool> exists_many(const std::vector<upath>& paths) const;
+
+		/**
+		 * @brief Deletes many files.
+		 *
+		 * The default implementation calls delete_file for each path, stopping at the first failure.
+		 *
+		 * @param paths The paths of the files to be deleted.
+		 */
+		virtual void delete_many(const std::vector<upath>& paths);
+
+		/**
+		 * @brief Creates many directories, and their parents, unless they already exist.
+		 *
+		 * The default implementation calls create_directory for each path, stopping at the first failure.
+		 *
+		 * @param paths The directories to create.
+		 */
+		virtual void create_directories(const std::vector<upath>& paths);
+
 		/**
 		 * @brief Copies a file between two filesystems.
 		 *
@@ -321,6 +567,19 @@ namespace ziopp {
 		 */
 		void copy_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite);
 
+		/**
+		 * @brief Copies a file between two filesystems, reporting failures instead of throwing.
+		 *
+		 * A missing source or an existing destination is detected before anything is opened.
+		 *
+		 * @param dest_filesystem The destination filesystem.
+		 * @param src The source path of the file to copy.
+		 * @param dest The destination path of the file in the destination filesystem.
+		 * @param overwrite true to overwrite an existing destination file.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		void copy_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite, std::error_code& error);
+
 		/**
 		 * @brief Moves a file between two filesystems.
 		 *
@@ -330,6 +589,41 @@ namespace ziopp {
 		 */
 		void move_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest);
 
+		/**
+		 * @brief Moves a file between two filesystems, reporting failures instead of throwing.
+		 *
+		 * @param dest_filesystem The destination filesystem.
+		 * @param src The source path of the file to move.
+		 * @param dest The destination path of the file in the destination filesystem.
+		 * @param error Set to the reason of the failure, cleared on success.
+		 */
+		void move_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, std::error_code& error);
+
+		/**
+		 * @brief Copies a directory and everything under it between two filesystems, or within one filesystem.
+		 *
+		 * Subdirectories are walked in parallel. A directory is always created before the files and directories under it are copied,
+		 * and files keep their last write time. Stops at the first failure, which is rethrown once the work already started is done.
+		 *
+		 * @param dest_filesystem The destination filesystem, which can be this filesystem.
+		 * @param src The directory to copy.
+		 * @param dest The directory to copy to, created if it does not exist.
+		 * @param overwrite true to overwrite existing destination files.
+		 * @param options Controls how the work is spread.
+		 */
+		void copy_directory_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite, const tree_options& options = tree_options{});
+
+		/**
+		 * @brief Deletes a directory and everything under it, working on many directories at once.
+		 *
+		 * Files are deleted in batches with delete_many and each directory is deleted once it is empty.
+		 * Stops at the first failure, which is rethrown once the work already started is done.
+		 *
+		 * @param path The directory to delete.
+		 * @param options Controls how the work is spread.
+		 */
+		void delete_directory_parallel(const upath& path, const tree_options& options = tree_options{});
+
 		/**
 		 * @brief Opens a binary file, reads the contents of the file into a vector of unsigned 8bit integers, and then closes the file.
 		 *
@@ -338,6 +632,40 @@ namespace ziopp {
 		 */
 		const std::vector<uint8_t> read_all_binary(const upath& path);
 
+		/**
+		 * @brief Reads the contents of a binary file, reporting failures instead of throwing.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @param error Set to the reason of the failure, such as std::errc::no_such_file_or_directory, cleared on success.
+		 * @return const std::vector<uint8_t> The contents of the file, empty on failure.
+		 */
+		const std::vector<uint8_t> read_all_binary(const upath& path, std::error_code& error);
+
+		/**
+		 * @brief Hashes the contents of a file without reading it all into memory.
+		 *
+		 * The file is read through a handle in fixed size pieces. With hash_algorithm::blake3, files of at least
+		 * hash_options::parallel_threshold bytes are split into pieces read and hashed on many threads and combined with the BLAKE3 tree.
+		 *
+		 * @param path The path of the file to hash.
+		 * @param algorithm The hash function to use.
+		 * @param options The cache to use and how the work is spread.
+		 * @return std::vector<uint8_t> The digest of the contents of the file.
+		 */
+		std::vector<uint8_t> hash_file(const upath& path, hash_algorithm algorithm, const hash_options& options = hash_options{});
+
+		/**
+		 * @brief Opens a file, reads many ranges of it into caller supplied buffers, and then closes the file.
+		 *
+		 * Nearby ranges are combined into single vectored reads, see file_handle::read_ranges.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @param ranges The ranges to read.
+		 * @param callback Called with the index of each range in ranges and the number of bytes read into its buffer.
+		 * @param options Controls how ranges are combined.
+		 */
+		void read_ranges(const upath& path, const std::vector<file_range>& ranges, const std::function<void(size_t, size_t)>& callback, const read_ranges_options& options = read_ranges_options{});
+
 		/**
 		 * @brief Open a file, read all the lines of the file
 		 *
@@ -346,6 +674,15 @@ namespace ziopp {
 		 */
 		const std::string read_all_text(const upath& path);
 
+		/**
+		 * @brief Reads the contents of a text file, reporting failures instead of throwing.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @param error Set to the reason of the failure, such as std::errc::no_such_file_or_directory, cleared on success.
+		 * @return const std::string The contents of the file, empty on failure.
+		 */
+		const std::string read_all_text(const upath& path, std::error_code& error);
+
 		/**
 		 * @brief Creates a new file, writes the specified vector of unsigned 8bit integers to the file, and then closes the file.
 		 *
@@ -364,6 +701,17 @@ namespace ziopp {
 		 */
 		const std::vector<std::string> read_all_lines(const upath& path);
 
+		/**
+		 * @brief Opens a file and calls a function with each of its lines, without copying them.
+		 *
+		 * The file is read in blocks and line breaks are found with memchr. A last line without a line break is included.
+		 *
+		 * @param path The path of the file to open for reading.
+		 * @param callback Called with each line, in order unless line_options::parallel is set.
+		 * @param options The size of the blocks read and whether the file is read on many threads.
+		 */
+		void for_each_line(const upath& path, const std::function<void(const line_view&)>& callback, const line_options& options = line_options{});
+
 		/**
 		 * @brief Creates a new file, writes the specified std::string to the file, and then closes the file.
 		 *
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief Controls how many handles handle_cache_filesystem keeps open.
+	 *
+	 */
+	struct handle_cache_options {
+		/**
+		 * @brief The largest number of handles kept open while no caller uses them, 0 to keep none.
+		 *
+		 */
+		size_t max_handles = 256;
+	};
+
+	/**
+	 * @brief How well a handle_cache_filesystem avoided opening files.
+	 *
+	 */
+	struct handle_cache_statistics {
+		/**
+		 * @brief The number of read only opens served by a cached handle.
+		 *
+		 */
+		uint64_t hits;
+		/**
+		 * @brief The number of read only opens that opened the file.
+		 *
+		 */
+		uint64_t misses;
+		/**
+		 * @brief The number of handles dropped because the cache was full.
+		 *
+		 */
+		uint64_t evictions;
+		/**
+		 * @brief The number of handles dropped because their file changed or invalidate was called.
+		 *
+		 */
+		uint64_t invalidations;
+		/**
+		 * @brief The number of handles in the cache.
+		 *
+		 */
+		size_t cached_handles;
+	};
+
+	/**
+	 * @brief A filesystem that keeps the files opened read only by another filesystem open, so opening them again is free.
+	 *
+	 * Opening a file with file_mode::open and file_access::read through open_handle or open_file shares one handle of the wrapped filesystem
+	 * between every caller, the least recently opened files being closed when more than handle_cache_options::max_handles are cached.
+	 * Handles are shared and not closed while a caller still uses one, so the budget bounds the handles kept for later and not those in use.
+	 * Every other open goes to the wrapped filesystem.
+	 *
+	 * Moving, deleting, replacing, copying over or opening for writing a file through this filesystem drops its cached handle,
+	 * so the next open sees the new file. Changes made another way, reported by a watcher for example, must be passed to invalidate.
+	 * A file opened for reading through open_file keeps one stream, which lives until the file is opened through open_file again,
+	 * moved, deleted or replaced through this filesystem, or the filesystem is destroyed. The stream keeps its handle open once evicted.
+	 *
+	 */
+	class handle_cache_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new handle_cache_filesystem.
+		 *
+		 * @param next The filesystem whose handles are cached. It must outlive this filesystem.
+		 * @param options Controls how many handles are kept open.
+		 */
+		explicit handle_cache_filesystem(filesystem& next, const handle_cache_options& options = handle_cache_options{});
+
+		~handle_cache_filesystem();
+
+		/**
+		 * @brief Drops the cached handles of a file, or of every file in a directory, after it changed without going through this filesystem.
+		 *
+		 * Callers still using a dropped handle keep it, later opens open the file again.
+		 *
+		 * @param path The file or directory that changed.
+		 */
+		void invalidate(const upath& path);
+
+		/**
+		 * @brief Drops every cached handle.
+		 *
+		 */
+		void clear();
+
+		/**
+		 * @brief Gets how many opens were served by the cache.
+		 *
+		 * @return handle_cache_statistics The counters since the filesystem was constructed.
+		 */
+		handle_cache_statistics statistics() const;
+
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+
+		void delete_many(const std::vector<upath>& paths) override;
+	private:
+		struct entry {
+			std::shared_ptr<file_handle> handle;
+			std::list<std::string>::iterator position;
+		};
+
+		class shared_handle;
+		class change_scope;
+
+		std::shared_ptr<file_handle> acquire(const upath& path, std::error_code* error);
+		void forget(const std::string& name, bool recursive, bool removed);
+
+		const handle_cache_options options_;
+		mutable std::mutex mutex_;
+		std::map<std::string, entry> entries_;
+		// The names of the cached files, the most recently opened first
+		std::list<std::string> order_;
+		// The streams of open_file, which share the cached handles
+		std::unique_ptr<detail::stream_table> streams_;
+		// Counts the invalidations, so a handle opened while its file changed is not cached
+		uint64_t generation_;
+		uint64_t hits_;
+		uint64_t misses_;
+		uint64_t evictions_;
+		uint64_t invalidations_;
+	};
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace ziopp {
+	/**
+	 * @brief The class of an I/O request, deciding which waiting requests an io_scheduler starts first.
+	 *
+	 */
+	enum class io_priority {
+		/**
+		 * @brief Requests a caller is waiting on, such as serving a user.
+		 *
+		 */
+		high,
+		/**
+		 * @brief The priority of threads that have not set one.
+		 *
+		 */
+		normal,
+		/**
+		 * @brief Work nobody is waiting on, such as copies, recursive deletes and scans, run with the capacity left over.
+		 *
+		 */
+		background
+	};
+
+	/**
+	 * @brief The number of values of io_priority.
+	 *
+	 */
+	const size_t io_priority_count = 3;
+
+	/**
+	 * @brief Gets the priority of the I/O requests made by the calling thread.
+	 *
+	 * Work added to a work_group runs with the priority of the thread that added it.
+	 *
+	 * @return io_priority The priority set by the innermost io_priority_scope of the thread, io_priority::normal when there is none.
+	 */
+	io_priority current_io_priority();
+
+	/**
+	 * @brief Sets the priority of the I/O requests made by the calling thread until it is destroyed.
+	 *
+	 * Scopes nest, so a single call can be given a priority by wrapping it in a scope.
+	 *
+	 */
+	class io_priority_scope {
+	public:
+		/**
+		 * @brief Construct a new io_priority_scope.
+		 *
+		 * @param priority The priority of the requests made by the thread while the scope lives.
+		 */
+		explicit io_priority_scope(io_priority priority);
+
+		/**
+		 * @brief Restores the priority the thread had before the scope.
+		 *
+		 */
+		~io_priority_scope();
+
+		io_priority_scope(const io_priority_scope&) = delete;
+		io_priority_scope& operator=(const io_priority_scope&) = delete;
+	private:
+		io_priority previous_;
+	};
+
+	/**
+	 * @brief Limits on the requests of one io_priority.
+	 *
+	 */
+	struct io_class_options {
+		/**
+		 * @brief Construct a new io_class_options.
+		 *
+		 * @param max_concurrency The largest number of requests of the class running at once, 0 for no limit.
+		 * @param max_bytes_per_second The largest number of bytes the requests of the class start per second, 0 for no limit.
+		 * @param deadline How long a request of the class waits before it goes ahead of requests of higher classes, 0 to never go ahead.
+		 */
+		io_class_options(size_t max_concurrency = 0, uint64_t max_bytes_per_second = 0, std::chrono::milliseconds deadline = std::chrono::milliseconds::zero());
+
+		/**
+		 * @brief The largest number of requests of the class running at once, 0 for no limit.
+		 *
+		 */
+		size_t max_concurrency;
+		/**
+		 * @brief The largest number of bytes the requests of the class start per second, 0 for no limit.
+		 *
+		 */
+		uint64_t max_bytes_per_second;
+		/**
+		 * @brief How long a request of the class waits before it goes ahead of requests of higher classes, 0 to never go ahead.
+		 *
+		 */
+		std::chrono::milliseconds deadline;
+	};
+
+	/**
+	 * @brief Controls how many I/O requests an io_scheduler runs at once and in which order.
+	 *
+	 */
+	struct io_scheduler_options {
+		/**
+		 * @brief The largest number of requests running at once, the queue depth of the device.
+		 *
+		 */
+		size_t max_concurrency = 8;
+		/**
+		 * @brief The number of the max_concurrency slots io_priority::background requests cannot take, so other requests find one free.
+		 *
+		 */
+		size_t reserved_concurrency = 2;
+		/**
+		 * @brief The largest number of bytes a scheduled_filesystem reads or writes in one request, larger reads and writes being split.
+		 *
+		 * Bounds how long a request of a higher class waits for the requests already running.
+		 *
+		 */
+		size_t max_request_size = 256 * 1024;
+		/**
+		 * @brief The limits of io_priority::high requests.
+		 *
+		 */
+		io_class_options high{};
+		/**
+		 * @brief The limits of io_priority::normal requests.
+		 *
+		 */
+		io_class_options normal{ 0, 0, std::chrono::milliseconds(100) };
+		/**
+		 * @brief The limits of io_priority::background requests.
+		 *
+		 */
+		io_class_options background{ 0, 0, std::chrono::milliseconds(1000) };
+	};
+
+	/**
+	 * @brief What the requests of one io_priority went through.
+	 *
+	 */
+	struct io_class_statistics {
+		/**
+		 * @brief The number of requests started.
+		 *
+		 */
+		uint64_t requests;
+		/**
+		 * @brief The number of bytes the requests started were for.
+		 *
+		 */
+		uint64_t bytes;
+		/**
+		 * @brief The number of requests started ahead of requests of higher classes because their deadline had passed.
+		 *
+		 */
+		uint64_t expired;
+		/**
+		 * @brief The total time the requests started waited, in nanoseconds.
+		 *
+		 */
+		uint64_t total_wait_nanoseconds;
+		/**
+		 * @brief The longest time a request started waited, in nanoseconds.
+		 *
+		 */
+		uint64_t max_wait_nanoseconds;
+	};
+
+	/**
+	 * @brief What the requests of an io_scheduler went through.
+	 *
+	 */
+	struct io_scheduler_statistics {
+		/**
+		 * @brief The statistics of each io_priority, indexed by the priority.
+		 *
+		 */
+		std::vector<io_class_statistics> classes;
+		/**
+		 * @brief The number of requests running.
+		 *
+		 */
+		size_t running;
+		/**
+		 * @brief The number of requests waiting.
+		 *
+		 */
+		size_t waiting;
+
+		/**
+		 * @brief Gets the statistics of one priority.
+		 *
+		 * @param priority The priority.
+		 * @return const io_class_statistics& The statistics of the requests of the priority.
+		 */
+		const io_class_statistics& operator[](io_priority priority) const;
+	};
+
+	/**
+	 * @brief Decides when I/O requests made from many threads, through any number of filesystems, start.
+	 *
+	 * At most io_scheduler_options::max_concurrency requests run at once. When one finishes, the waiting request started is the first of the
+	 * highest io_priority whose class is within its limits, except that a request waiting longer than the deadline of its class goes first.
+	 * io_priority::background requests never take the last io_scheduler_options::reserved_concurrency slots, so background work uses the capacity
+	 * left idle without making the requests of the other classes wait behind it. Requests are not preempted: large reads and writes are split by
+	 * scheduled_filesystem so a request of a higher class waits for at most one piece of each running request.
+	 *
+	 * Requests made by a thread while it runs a request of the same scheduler start at once without counting, so nested filesystems sharing a
+	 * scheduler do not deadlock.
+	 *
+	 */
+	class io_scheduler {
+	public:
+		/**
+		 * @brief Construct a new io_scheduler.
+		 *
+		 * @param options Controls how many requests run at once and in which order.
+		 */
+		explicit io_scheduler(const io_scheduler_options& options = io_scheduler_options{});
+
+		io_scheduler(const io_scheduler&) = delete;
+		io_scheduler& operator=(const io_scheduler&) = delete;
+
+		/**
+		 * @brief Gets the options of the scheduler.
+		 *
+		 * @return const io_scheduler_options& The options the scheduler was constructed with.
+		 */
+		const io_scheduler_options& options() const;
+
+		/**
+		 * @brief Gets what the requests of the scheduler went through.
+		 *
+		 * @return io_scheduler_statistics The counters since the scheduler was constructed.
+		 */
+		io_scheduler_statistics statistics() const;
+
+		/**
+		 * @brief Gets a process wide scheduler with the default options, shared by every scheduled_filesystem not given one.
+		 *
+		 * @return io_scheduler& The shared scheduler.
+		 */
+		static io_scheduler& shared();
+	private:
+		friend class io_request;
+
+		struct waiter {
+			io_priority priority;
+			uint64_t bytes;
+			std::chrono::steady_clock::time_point enqueued;
+			bool granted;
+		};
+
+		struct class_state {
+			io_class_options options;
+			std::deque<waiter*> waiting;
+			size_t running;
+			// When the bandwidth limit lets the next request of the class start
+			std::chrono::steady_clock::time_point ready;
+			io_class_statistics statistics;
+		};
+
+		void acquire(waiter& request);
+		void release(io_priority priority);
+		void dispatch(std::chrono::steady_clock::time_point now);
+		bool can_start(const class_state& state, io_priority priority, std::chrono::steady_clock::time_point now) const;
+
+		const io_scheduler_options options_;
+		mutable std::mutex mutex_;
+		std::condition_variable granted_;
+		std::vector<class_state> classes_;
+		size_t running_;
+		// The earliest time a waiting request held back by a bandwidth limit can start, or the epoch when none is
+		std::chrono::steady_clock::time_point wake_;
+	};
+
+	/**
+	 * @brief Waits for an io_scheduler to start a request, and tells it the request finished when destroyed.
+	 *
+	 */
+	class io_request {
+	public:
+		/**
+		 * @brief Waits until the scheduler starts the request.
+		 *
+		 * @param scheduler The scheduler deciding when the request starts. It must outlive the request.
+		 * @param priority The class of the request.
+		 * @param bytes The number of bytes the request reads or writes, counted against the bandwidth limit of the class.
+		 */
+		io_request(io_scheduler& scheduler, io_priority priority, uint64_t bytes);
+
+		/**
+		 * @brief Waits until the scheduler starts a request of the priority of the calling thread.
+		 *
+		 * @param scheduler The scheduler deciding when the request starts. It must outlive the request.
+		 * @param bytes The number of bytes the request reads or writes, counted against the bandwidth limit of the class.
+		 */
+		io_request(io_scheduler& scheduler, uint64_t bytes);
+
+		/**
+		 * @brief Tells the scheduler the request finished, so the next can start.
+		 *
+		 */
+		~io_request();
+
+		io_request(const io_request&) = delete;
+		io_request& operator=(const io_request&) = delete;
+	private:
+		io_scheduler& scheduler_;
+		const io_priority priority_;
+		// Whether the request was made while the thread ran another of the same scheduler, so did not wait
+		bool nested_;
+		// The scheduler of the request the thread was running before this one
+		const io_scheduler* previous_;
+	};
+}
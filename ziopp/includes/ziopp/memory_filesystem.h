@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ziopp/filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief A filesystem held entirely in memory.
+	 *
+	 * All paths must be absolute. Every operation takes a single lock, so the batch operations inspect or modify all of their paths under one acquisition.
+	 * Streams returned by open_file are owned by the filesystem and stay valid until their file is deleted or the filesystem is destroyed.
+	 * Each file keeps one stream per mode and access, which opening the file the same way again rewinds and returns, so a stream must not
+	 * be used after its file is opened again with the same mode and access. Prefer open_handle for repeated access to the same file.
+	 *
+	 */
+	class memory_filesystem : public filesystem {
+	public:
+		/**
+		 * @brief Construct a new memory_filesystem containing only the root directory.
+		 *
+		 */
+		memory_filesystem();
+
+		~memory_filesystem();
+
+		memory_filesystem(const memory_filesystem&) = delete;
+		memory_filesystem& operator=(const memory_filesystem&) = delete;
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+		bool can_watch(const upath& path) const override;
+		const filesystem_watcher& watch(const upath& path) override;
+		const std::string path_to_internal(const upath& path) const override;
+		const upath& path_from_internal(const std::string& system_path) const override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	private:
+		struct file_data {
+			std::mutex mutex;
+			std::vector<char> content;
+		};
+
+		struct node {
+			bool directory;
+			std::shared_ptr<file_data> data;
+			std::chrono::system_clock::time_point creation_time;
+			std::chrono::system_clock::time_point access_time;
+			std::chrono::system_clock::time_point write_time;
+			std::map<std::pair<file_mode, file_access>, std::shared_ptr<std::iostream>> streams;
+		};
+
+		using node_map = std::map<std::string, node>;
+
+		// The overloads taking an error_code return nullptr on success and the message of the exception to throw on failure
+		node* find(const upath& path);
+		const node* find(const upath& path) const;
+		node& find_file(const upath& path);
+		const node& find_file(const upath& path) const;
+		const char* find_file(const upath& path, const node*& entry, std::error_code& error) const;
+		node& find_entry(const upath& path);
+		const node& find_entry(const upath& path) const;
+		void require_parent_directory(const upath& path) const;
+		const char* require_parent_directory(const upath& path, std::error_code& error) const;
+		bool has_children(const std::string& directory) const;
+		void create_directory_locked(const upath& path);
+		const char* create_directory_locked(const upath& path, std::error_code& error);
+		const char* delete_directory_locked(const upath& path, bool recursive, std::error_code& error);
+		const char* copy_file_locked(const upath& src, const upath& dest, bool overwrite, std::error_code& error);
+		void delete_file_locked(const upath& path);
+		const char* delete_file_locked(const upath& path, std::error_code& error);
+		void move_file_locked(const upath& src, const upath& dest);
+		const char* move_file_locked(const upath& src, const upath& dest, std::error_code& error);
+		node& open_locked(const upath& path, file_mode mode, file_access access);
+		const char* open_locked(const upath& path, file_mode mode, file_access access, node*& entry, std::error_code& error);
+		file_stat stat_locked(const upath& path) const;
+
+		mutable std::mutex mutex_;
+		node_map nodes_;
+		mutable std::map<std::string, upath> internal_paths_;
+	};
+}
\ No newline at end of file
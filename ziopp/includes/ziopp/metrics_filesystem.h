@@ -0,0 +1,313 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief The filesystem operations measured by metrics_filesystem, one per virtual method of filesystem.
+	 *
+	 */
+	enum class filesystem_operation {
+		create_directory,
+		directory_exists,
+		move_directory,
+		delete_directory,
+		copy_file,
+		replace_file,
+		file_length,
+		file_exists,
+		move_file,
+		delete_file,
+		open_file,
+		open_handle,
+		get_creation_time,
+		set_creation_time,
+		get_access_time,
+		set_access_time,
+		get_write_time,
+		set_write_time,
+		enumerate_paths,
+		can_watch,
+		watch,
+		path_to_internal,
+		path_from_internal,
+		stat_many,
+		exists_many,
+		delete_many,
+		create_directories
+	};
+
+	/**
+	 * @brief The number of values of filesystem_operation.
+	 *
+	 */
+	const size_t filesystem_operation_count = static_cast<size_t>(filesystem_operation::create_directories) + 1;
+
+	/**
+	 * @brief Gets the name of an operation, the same as the name of its method.
+	 *
+	 * @param operation The operation.
+	 * @return const char* The name of the operation.
+	 */
+	const char* to_string(filesystem_operation operation);
+
+	/**
+	 * @brief A histogram of durations in nanoseconds with logarithmic buckets, in the style of HdrHistogram.
+	 *
+	 * Every power of two is split into 16 linear buckets, so a recorded value is known to within 6.25%.
+	 * Durations longer than about 68 seconds are counted in the last bucket.
+	 *
+	 */
+	class latency_histogram {
+	public:
+		/**
+		 * @brief The number of buckets of every histogram.
+		 *
+		 */
+		static const size_t bucket_count = 528;
+
+		/**
+		 * @brief Construct a new empty latency_histogram.
+		 *
+		 */
+		latency_histogram();
+
+		/**
+		 * @brief Gets the bucket a duration is counted in.
+		 *
+		 * @param nanoseconds The duration.
+		 * @return size_t The index of the bucket.
+		 */
+		static size_t bucket_index(uint64_t nanoseconds);
+
+		/**
+		 * @brief Gets the largest duration counted in a bucket.
+		 *
+		 * @param index The index of the bucket.
+		 * @return uint64_t The duration in nanoseconds.
+		 */
+		static uint64_t bucket_upper_bound(size_t index);
+
+		/**
+		 * @brief Counts a duration.
+		 *
+		 * @param nanoseconds The duration.
+		 */
+		void record(uint64_t nanoseconds);
+
+		/**
+		 * @brief Adds the counts of another histogram to this one.
+		 *
+		 * @param other The histogram to add.
+		 */
+		void merge(const latency_histogram& other);
+
+		/**
+		 * @brief Gets the number of durations counted.
+		 *
+		 * @return uint64_t The number of durations.
+		 */
+		uint64_t count() const;
+
+		/**
+		 * @brief Gets the number of durations counted in a bucket.
+		 *
+		 * @param index The index of the bucket.
+		 * @return uint64_t The number of durations.
+		 */
+		uint64_t bucket(size_t index) const;
+
+		/**
+		 * @brief Gets the duration at or below which a percentage of the counted durations fall.
+		 *
+		 * @param percentile The percentage, between 0 and 100.
+		 * @return uint64_t The upper bound, in nanoseconds, of the bucket holding the percentile, or 0 when nothing was counted.
+		 */
+		uint64_t value_at_percentile(double percentile) const;
+	private:
+		friend class metrics_filesystem;
+
+		std::vector<uint64_t> buckets_;
+		uint64_t count_;
+	};
+
+	/**
+	 * @brief The metrics of one operation.
+	 *
+	 */
+	struct operation_metrics {
+		/**
+		 * @brief The number of calls, failed ones included.
+		 *
+		 */
+		uint64_t calls;
+		/**
+		 * @brief The number of calls that threw an exception.
+		 *
+		 */
+		uint64_t errors;
+		/**
+		 * @brief The total time spent in the calls, in nanoseconds.
+		 *
+		 */
+		uint64_t total_nanoseconds;
+		/**
+		 * @brief The time spent in each call.
+		 *
+		 */
+		latency_histogram latency;
+	};
+
+	/**
+	 * @brief A point in time copy of the metrics of a metrics_filesystem.
+	 *
+	 */
+	struct filesystem_metrics {
+		/**
+		 * @brief The metrics of each operation, indexed by filesystem_operation.
+		 *
+		 */
+		std::vector<operation_metrics> operations;
+		/**
+		 * @brief The number of bytes read through streams and handles opened by the filesystem.
+		 *
+		 */
+		uint64_t bytes_read;
+		/**
+		 * @brief The number of bytes written through streams and handles opened by the filesystem.
+		 *
+		 */
+		uint64_t bytes_written;
+		/**
+		 * @brief The number of streams returned by open_file whose file has not been deleted or replaced through the filesystem.
+		 *
+		 */
+		uint64_t open_streams;
+
+		/**
+		 * @brief Gets the metrics of one operation.
+		 *
+		 * @param operation The operation.
+		 * @return const operation_metrics& The metrics of the operation.
+		 */
+		const operation_metrics& operator[](filesystem_operation operation) const;
+
+		/**
+		 * @brief Formats the metrics in the Prometheus text exposition format.
+		 *
+		 * Calls and errors are exported as counters labelled with the operation, latencies as histograms in seconds,
+		 * open streams as a gauge.
+		 *
+		 * @param prefix The prefix of every metric name.
+		 * @return std::string The metrics, one sample per line.
+		 */
+		std::string to_prometheus(const std::string& prefix = "ziopp") const;
+	};
+
+	/**
+	 * @brief A filesystem that measures the calls made to the filesystem it wraps.
+	 *
+	 * Every method counts its calls and failures and records its latency. Each thread records into its own
+	 * set of counters, written without atomic read-modify-write instructions, and snapshot adds the sets together,
+	 * so recording stays cheap when many threads share the filesystem. Streams returned by open_file are wrapped to count
+	 * the bytes going through them. A wrapper follows its file when it is moved through this filesystem and is destroyed when
+	 * the file is deleted or replaced through it, or when the wrapped filesystem returns the stream it wraps again.
+	 *
+	 */
+	class metrics_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new metrics_filesystem.
+		 *
+		 * @param next The filesystem to measure. It must outlive this filesystem.
+		 */
+		explicit metrics_filesystem(filesystem& next);
+
+		~metrics_filesystem();
+
+		/**
+		 * @brief Gets the metrics recorded so far.
+		 *
+		 * Counters of calls still in progress on other threads may or may not be included.
+		 *
+		 * @return filesystem_metrics The metrics.
+		 */
+		filesystem_metrics snapshot() const;
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+		bool can_watch(const upath& path) const override;
+		const filesystem_watcher& watch(const upath& path) override;
+		const std::string path_to_internal(const upath& path) const override;
+		const upath& path_from_internal(const std::string& system_path) const override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	private:
+		struct operation_counters {
+			std::atomic<uint64_t> calls;
+			std::atomic<uint64_t> errors;
+			std::atomic<uint64_t> nanoseconds;
+			std::atomic<uint64_t> buckets[latency_histogram::bucket_count];
+		};
+
+		struct shard {
+			operation_counters operations[filesystem_operation_count];
+			std::atomic<uint64_t> bytes_read;
+			std::atomic<uint64_t> bytes_written;
+		};
+
+		class operation_scope;
+		class counting_streambuf;
+		class counting_stream;
+		class counting_file_handle;
+
+		// The wrappers of the streams of a file, by the stream they wrap
+		using stream_wrappers = std::map<std::iostream*, std::unique_ptr<counting_stream>>;
+
+		shard& local_shard() const;
+		void add_bytes_read(uint64_t count) const;
+		void add_bytes_written(uint64_t count) const;
+		void forget_streams(const upath& path, bool recursive);
+		void move_streams(const upath& src, const upath& dest, bool recursive);
+
+		const uint64_t id_;
+		mutable std::mutex mutex_;
+		mutable std::vector<std::unique_ptr<shard>> shards_;
+		std::map<std::string, stream_wrappers> streams_;
+	};
+}
\ No newline at end of file
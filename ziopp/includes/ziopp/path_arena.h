@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <ziopp/upath.h>
+
+namespace ziopp {
+	/**
+	 * @brief A bump allocator over a caller owned buffer, to keep temporary paths off the heap.
+	 *
+	 * Memory is only given back when the most recent allocation is freed, or all at once by reset. Allocations that do not fit come from the heap.
+	 * Not thread safe: an arena is meant to live on the stack of one request.
+	 *
+	 */
+	class path_arena {
+	public:
+		/**
+		 * @brief Construct a new path_arena.
+		 *
+		 * @param buffer The memory to allocate from. It must outlive the arena and everything allocated from it.
+		 * @param size The size of buffer in bytes.
+		 */
+		path_arena(void* buffer, size_t size);
+
+		path_arena(const path_arena&) = delete;
+		path_arena& operator=(const path_arena&) = delete;
+
+		/**
+		 * @brief Allocates memory from the buffer, or from the heap when it is full.
+		 *
+		 * @param size The number of bytes.
+		 * @param alignment The alignment of the memory, a power of two.
+		 * @return void* The memory.
+		 */
+		void* allocate(size_t size, size_t alignment);
+
+		/**
+		 * @brief Frees memory given by allocate.
+		 *
+		 * @param pointer The memory.
+		 * @param size The number of bytes allocated.
+		 */
+		void deallocate(void* pointer, size_t size);
+
+		/**
+		 * @brief Makes the whole buffer available again. Nothing allocated from the buffer may be used after.
+		 *
+		 */
+		void reset();
+
+		/**
+		 * @brief Gets how much of the buffer is allocated.
+		 *
+		 * @return size_t The number of bytes.
+		 */
+		size_t used() const;
+
+		/**
+		 * @brief Gets how many allocations did not fit in the buffer.
+		 *
+		 * @return size_t The number of allocations made from the heap.
+		 */
+		size_t overflows() const;
+	private:
+		char* buffer_;
+		size_t size_;
+		size_t used_;
+		size_t overflows_;
+	};
+
+	/**
+	 * @brief A path_arena with its buffer inline, to be declared on the stack.
+	 *
+	 * @tparam Size The size of the buffer in bytes.
+	 */
+	template <size_t Size>
+	class inline_path_arena : public path_arena {
+	public:
+		inline_path_arena() : path_arena(storage_, Size)
+		{
+		}
+	private:
+		alignas(alignof(std::max_align_t)) char storage_[Size];
+	};
+
+	/**
+	 * @brief An allocator using a path_arena, or the heap when constructed without one.
+	 *
+	 * @tparam T The type allocated.
+	 */
+	template <typename T>
+	class arena_allocator {
+	public:
+		typedef T value_type;
+
+		arena_allocator() : arena_(nullptr)
+		{
+		}
+
+		arena_allocator(path_arena& arena) : arena_(&arena)
+		{
+		}
+
+		template <typename U>
+		arena_allocator(const arena_allocator<U>& other) : arena_(other.arena())
+		{
+		}
+
+		T* allocate(size_t count)
+		{
+			if (arena_ == nullptr)
+			{
+				return static_cast<T*>(::operator new(count * sizeof(T)));
+			}
+			return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* pointer, size_t count)
+		{
+			if (arena_ == nullptr)
+			{
+				::operator delete(pointer);
+			}
+			else
+			{
+				arena_->deallocate(pointer, count * sizeof(T));
+			}
+		}
+
+		/**
+		 * @brief Gets the arena allocated from.
+		 *
+		 * @return path_arena* The arena, nullptr for the heap.
+		 */
+		path_arena* arena() const
+		{
+			return arena_;
+		}
+
+		template <typename U>
+		bool operator==(const arena_allocator<U>& other) const
+		{
+			return arena_ == other.arena();
+		}
+
+		template <typename U>
+		bool operator!=(const arena_allocator<U>& other) const
+		{
+			return arena_ != other.arena();
+		}
+	private:
+		path_arena* arena_;
+	};
+
+	/**
+	 * @brief A upath allocated from a path_arena, for temporary paths of a request.
+	 *
+	 * Paths made from an arena_upath, by combine or directory for example, use the same arena. Convert to upath to keep a path or pass it to a filesystem.
+	 *
+	 */
+	using arena_upath = basic_upath<portable_path_policy, arena_allocator<char>>;
+
+	extern template class basic_upath<portable_path_policy, arena_allocator<char>>;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/executor.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief Controls when and how far readahead_filesystem reads ahead.
+	 *
+	 */
+	struct readahead_options {
+		/**
+		 * @brief The number of bytes read ahead by one read of the wrapped file.
+		 *
+		 */
+		size_t block_size = 128 * 1024;
+		/**
+		 * @brief The number of reads continuing the previous one after which a file is read ahead.
+		 *
+		 */
+		size_t sequential_reads = 2;
+		/**
+		 * @brief The number of blocks read ahead once a file is read sequentially, doubled by each further sequential read.
+		 *
+		 */
+		size_t initial_window = 2;
+		/**
+		 * @brief The largest number of blocks read ahead of a file.
+		 *
+		 */
+		size_t max_window = 32;
+		/**
+		 * @brief The executor blocks are read on, nullptr for thread_pool::shared().
+		 *
+		 */
+		executor* work_executor = nullptr;
+	};
+
+	/**
+	 * @brief How much a readahead_filesystem read ahead and how much of it was used.
+	 *
+	 */
+	struct readahead_statistics {
+		/**
+		 * @brief The number of bytes served from blocks read ahead.
+		 *
+		 */
+		uint64_t hits;
+		/**
+		 * @brief The number of bytes read from the wrapped file when they were asked for.
+		 *
+		 */
+		uint64_t misses;
+		/**
+		 * @brief The number of blocks read ahead.
+		 *
+		 */
+		uint64_t blocks;
+		/**
+		 * @brief The number of blocks read ahead and dropped without being used, after a seek or when the file was closed.
+		 *
+		 */
+		uint64_t wasted;
+	};
+
+	/**
+	 * @brief A filesystem that reads ahead of files read sequentially.
+	 *
+	 * Files opened with file_access::read, through open_handle or open_file, watch the offsets they are read at. Once
+	 * readahead_options::sequential_reads reads in a row each start where the previous one ended, the blocks after the last read are read
+	 * on the executor before they are asked for, the window doubling with each further sequential read up to readahead_options::max_window.
+	 * A block whose read has not started on the executor when it is asked for is read by the caller, so files can be read from the
+	 * threads of the executor. A read anywhere else drops the blocks read ahead and starts over. The wrapped handle is told of the pattern with file_handle::advise,
+	 * which posix_file_handle passes on to the system with posix_fadvise.
+	 *
+	 * Files opened for writing are not read ahead. A file opened for reading through open_file keeps one stream, which lives until the file
+	 * is opened through open_file again, moved or deleted through this filesystem, or the filesystem is destroyed.
+	 *
+	 */
+	class readahead_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new readahead_filesystem.
+		 *
+		 * @param next The filesystem whose files are read ahead. It must outlive this filesystem.
+		 * @param options Controls when and how far files are read ahead.
+		 */
+		explicit readahead_filesystem(filesystem& next, const readahead_options& options = readahead_options{});
+
+		~readahead_filesystem();
+
+		/**
+		 * @brief Gets how much was read ahead.
+		 *
+		 * @return readahead_statistics The counters since the filesystem was constructed.
+		 */
+		readahead_statistics statistics() const;
+
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+	private:
+		struct counters;
+		class readahead_handle;
+
+		void release(const upath& path, bool recursive);
+
+		const readahead_options options_;
+		std::shared_ptr<counters> counters_;
+		std::unique_ptr<detail::stream_table> streams_;
+	};
+}
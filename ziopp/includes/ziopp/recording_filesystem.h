@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/metrics_filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief A filesystem that writes a log of every call made to the filesystem it wraps, to be replayed by workload_replayer.
+	 *
+	 * Each call is logged with its arguments, when it started, how long it took and whether it threw. Reads and writes through
+	 * streams and handles are logged with their offset and size, but not their bytes, and consecutive reads or writes of a stream are merged.
+	 * Records use variable length integers and every path is written once then referred to by number, so logs stay small.
+	 * Streams and handles opened through the filesystem must not be used once it is destroyed.
+	 *
+	 */
+	class recording_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new recording_filesystem.
+		 *
+		 * @param next The filesystem to record. It must outlive this filesystem.
+		 * @param log The stream the log is written to. It must outlive this filesystem.
+		 */
+		recording_filesystem(filesystem& next, std::ostream& log);
+
+		/**
+		 * @brief Writes any merged reads and writes not yet logged then flushes the log.
+		 *
+		 */
+		~recording_filesystem();
+
+		/**
+		 * @brief Writes any merged reads and writes not yet logged then flushes the log.
+		 *
+		 */
+		void flush();
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+		bool can_watch(const upath& path) const override;
+		const filesystem_watcher& watch(const upath& path) override;
+		const std::string path_to_internal(const upath& path) const override;
+		const upath& path_from_internal(const std::string& system_path) const override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	private:
+		struct record;
+
+		class call_scope;
+		class recording_streambuf;
+		class recording_stream;
+		class recording_file_handle;
+
+		void write(const record& entry) const;
+		uint64_t elapsed() const;
+		uint64_t next_io_id();
+
+		std::ostream& log_;
+		const std::chrono::steady_clock::time_point start_;
+		mutable std::mutex mutex_;
+		mutable std::map<std::string, uint64_t> path_ids_;
+		mutable uint64_t previous_start_;
+		mutable std::atomic<uint64_t> sequence_;
+		std::atomic<uint64_t> next_io_id_;
+		std::mutex streams_mutex_;
+		std::map<std::iostream*, std::unique_ptr<recording_stream>> streams_;
+	};
+
+	/**
+	 * @brief How workload_replayer spaces out the calls it replays.
+	 *
+	 */
+	enum class replay_pacing {
+		/**
+		 * @brief Each call is made as soon as the previous one returns.
+		 *
+		 */
+		as_fast_as_possible,
+		/**
+		 * @brief Each call is made no sooner than it was made when recorded, relative to the start of the replay.
+		 *
+		 */
+		original
+	};
+
+	/**
+	 * @brief Controls how workload_replayer replays a log.
+	 *
+	 */
+	struct replay_options {
+		replay_pacing pacing = replay_pacing::as_fast_as_possible;
+		/**
+		 * @brief With replay_pacing::original, how many times faster than recorded to replay.
+		 *
+		 */
+		double speed = 1.0;
+	};
+
+	/**
+	 * @brief The outcome of replaying a log.
+	 *
+	 */
+	struct replay_result {
+		/**
+		 * @brief The number of calls replayed, reads and writes included.
+		 *
+		 */
+		uint64_t operations;
+		/**
+		 * @brief The number of calls that threw when they had not when recorded, or the reverse.
+		 *
+		 */
+		uint64_t mismatched_errors;
+		uint64_t bytes_read;
+		uint64_t bytes_written;
+		/**
+		 * @brief The time the replay took.
+		 *
+		 */
+		std::chrono::nanoseconds elapsed;
+		/**
+		 * @brief The latency of every call replayed.
+		 *
+		 */
+		latency_histogram latency;
+		/**
+		 * @brief The metrics of each filesystem method, indexed by filesystem_operation. Reads and writes are only included in latency.
+		 *
+		 */
+		std::vector<operation_metrics> filesystem_operations;
+
+		/**
+		 * @brief Gets the number of calls replayed per second.
+		 *
+		 * @return double The number of calls per second.
+		 */
+		double operations_per_second() const;
+
+		/**
+		 * @brief Gets the number of bytes read and written per second.
+		 *
+		 * @return double The number of bytes per second.
+		 */
+		double bytes_per_second() const;
+	};
+
+	/**
+	 * @brief Replays a log written by recording_filesystem against any filesystem.
+	 *
+	 * The log is decoded when the replayer is constructed so decoding is not timed. Calls are replayed in the order they were logged
+	 * from a single thread, writes use placeholder bytes of the recorded size and enumerations are run to their end.
+	 * For the replay to match the recording the filesystem must start with the contents the recorded one started with.
+	 *
+	 */
+	class workload_replayer {
+	public:
+		/**
+		 * @brief Construct a new workload_replayer.
+		 *
+		 * @param log The stream to read the log from.
+		 */
+		explicit workload_replayer(std::istream& log);
+
+		/**
+		 * @brief Gets the number of records in the log.
+		 *
+		 * @return size_t The number of records.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Replays the log.
+		 *
+		 * @param fs The filesystem to replay the log against.
+		 * @param options Controls how the log is replayed.
+		 * @return replay_result The throughput and latencies of the replay.
+		 */
+		replay_result replay(filesystem& fs, const replay_options& options = replay_options{}) const;
+	private:
+		struct record {
+			uint8_t kind;
+			bool failed;
+			uint64_t start;
+			std::vector<size_t> paths;
+			std::vector<uint64_t> values;
+			std::string text;
+		};
+
+		struct replay_state;
+
+		void execute(filesystem& fs, const record& entry, replay_state& state) const;
+
+		std::vector<upath> paths_;
+		std::vector<record> records_;
+	};
+}
\ No newline at end of file
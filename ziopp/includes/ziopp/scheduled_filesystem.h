@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/io_scheduler.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief A filesystem whose operations wait for an io_scheduler to start them.
+	 *
+	 * Every operation touching the storage of the wrapped filesystem is a request of the io_priority of the calling thread, set with io_priority_scope.
+	 * Reads and writes of handles from open_handle, and of streams from open_file for reading, are requests too, split into pieces of at most
+	 * io_scheduler_options::max_request_size bytes. Filesystems wrapping different backends that share a device should share one scheduler.
+	 * Operations that only map paths, and watching, are not scheduled.
+	 *
+	 * A file opened for reading through open_file keeps one stream, which lives until the file is opened through open_file again,
+	 * moved or deleted through this filesystem, or the filesystem is destroyed.
+	 * Streams opened for writing are those of the wrapped filesystem, only opening them being scheduled.
+	 *
+	 */
+	class scheduled_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new scheduled_filesystem.
+		 *
+		 * @param next The filesystem whose operations are scheduled. It must outlive this filesystem.
+		 * @param scheduler The scheduler deciding when operations start. It must outlive this filesystem and the handles it opened.
+		 */
+		explicit scheduled_filesystem(filesystem& next, io_scheduler& scheduler = io_scheduler::shared());
+
+		~scheduled_filesystem();
+
+		/**
+		 * @brief Gets the scheduler of the filesystem.
+		 *
+		 * @return io_scheduler& The scheduler deciding when operations start.
+		 */
+		io_scheduler& scheduler() const;
+
+		void create_directory(const upath& path) override;
+		void create_directory(const upath& path, std::error_code& error) override;
+		bool directory_exists(const upath& path) const override;
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		bool file_exists(const upath& path) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+		const std::chrono::system_clock::time_point& creation_time(const upath& path) const override;
+		void creation_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& access_time(const upath& path) const override;
+		void access_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const std::chrono::system_clock::time_point& write_time(const upath& path) const override;
+		void write_time(const upath& path, const std::chrono::system_clock::time_point& time) override;
+		const upath_iterator enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		std::vector<bool> exists_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+		void create_directories(const std::vector<upath>& paths) override;
+	private:
+		class scheduled_handle;
+
+		void release(const upath& path, bool recursive);
+
+		io_scheduler& scheduler_;
+		std::unique_ptr<detail::stream_table> streams_;
+	};
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <ziopp/filesystem.h>
+
+namespace ziopp {
+	/**
+	 * @brief Controls what sync_tree compares and how it transfers files.
+	 *
+	 */
+	struct sync_options {
+		/**
+		 * @brief true to also compare the contents of files whose length and last write time match, false to trust the metadata.
+		 *
+		 */
+		bool compare_contents = false;
+		/**
+		 * @brief true to delete files and directories of the destination that are not in the source.
+		 *
+		 */
+		bool delete_extraneous = true;
+		/**
+		 * @brief Changed files at least this long are patched by transferring only the blocks the destination does not already have.
+		 *
+		 */
+		uint64_t delta_threshold = 1024 * 1024;
+		/**
+		 * @brief The size of the blocks matched when patching a file.
+		 *
+		 */
+		size_t block_size = 8192;
+		/**
+		 * @brief Controls how the work is spread.
+		 *
+		 */
+		tree_options tree;
+	};
+
+	/**
+	 * @brief What sync_tree did.
+	 *
+	 */
+	struct sync_result {
+		/**
+		 * @brief The number of files copied whole.
+		 *
+		 */
+		uint64_t files_copied;
+		/**
+		 * @brief The number of files patched with the blocks they were missing.
+		 *
+		 */
+		uint64_t files_patched;
+		uint64_t files_unchanged;
+		uint64_t files_deleted;
+		uint64_t directories_created;
+		uint64_t directories_deleted;
+		/**
+		 * @brief The total length of the source files.
+		 *
+		 */
+		uint64_t bytes_total;
+		/**
+		 * @brief The number of bytes copied from the source to the destination.
+		 *
+		 */
+		uint64_t bytes_transferred;
+
+		/**
+		 * @brief Gets the number of bytes that copying every source file would have transferred on top of bytes_transferred.
+		 *
+		 * @return uint64_t The number of bytes not transferred.
+		 */
+		uint64_t bytes_saved() const;
+	};
+
+	/**
+	 * @brief Makes a directory of one filesystem a copy of a directory of another, transferring only what changed.
+	 *
+	 * Files are compared by length and last write time, and optionally by contents. Missing files are copied whole, as are changed files
+	 * shorter than sync_options::delta_threshold. Longer changed files are patched the way rsync does: the destination file is split into
+	 * blocks identified by a rolling checksum and a 64 bit hash, the source is scanned for those blocks, and the new file is written
+	 * from the matching blocks of the old one plus the bytes of the source that did not match. A patched file whose BLAKE3 digest differs
+	 * from the source's, because two blocks hashed the same, is copied whole instead. Directories are synchronized in parallel
+	 * and each is created before its contents. Synchronized files take the last write time of their source.
+	 * Stops at the first failure, which is rethrown once the work already started is done.
+	 *
+	 * @param src_filesystem The filesystem to copy from.
+	 * @param src The directory to copy.
+	 * @param dest_filesystem The filesystem to copy to, which can be src_filesystem.
+	 * @param dest The directory to make a copy of src, created if it does not exist.
+	 * @param options Controls what is compared and how files are transferred.
+	 * @return sync_result What was copied, patched and deleted.
+	 */
+	sync_result sync_tree(filesystem& src_filesystem, const upath& src, filesystem& dest_filesystem, const upath& dest, const sync_options& options = sync_options{});
+}
\ No newline at end of file
@@ -0,0 +1,524 @@
+#pragma once
+
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define ZIOPP_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef ZIOPP_HAS_COROUTINES
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <ziopp/executor.h>
+
+namespace ziopp {
+	template <typename T = void>
+	class task;
+
+	namespace detail {
+		class task_promise_base {
+		public:
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			auto final_suspend() noexcept
+			{
+				return final_awaiter{};
+			}
+
+			void unhandled_exception() noexcept
+			{
+				exception_ = std::current_exception();
+			}
+
+			void continuation(std::coroutine_handle<> continuation) noexcept
+			{
+				continuation_ = continuation;
+			}
+		protected:
+			void rethrow_if_failed() const
+			{
+				if (exception_)
+				{
+					std::rethrow_exception(exception_);
+				}
+			}
+		private:
+			struct final_awaiter {
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().continuation_;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			std::coroutine_handle<> continuation_;
+			std::exception_ptr exception_;
+		};
+
+		template <typename T>
+		class task_promise : public task_promise_base {
+		public:
+			task<T> get_return_object() noexcept;
+
+			template <typename U>
+			void return_value(U&& value)
+			{
+				value_.emplace(std::forward<U>(value));
+			}
+
+			T result()
+			{
+				rethrow_if_failed();
+				return std::move(*value_);
+			}
+		private:
+			std::optional<T> value_;
+		};
+
+		template <>
+		class task_promise<void> : public task_promise_base {
+		public:
+			task<void> get_return_object() noexcept;
+
+			void return_void() noexcept
+			{
+			}
+
+			void result()
+			{
+				rethrow_if_failed();
+			}
+		};
+	}
+
+	/**
+	 * @brief A lazily started coroutine producing a value of type T.
+	 *
+	 * The coroutine starts when the task is awaited and resumes the awaiting coroutine when it completes.
+	 * Exceptions thrown by the coroutine are rethrown to the awaiter.
+	 *
+	 * @tparam T The type of the result.
+	 */
+	template <typename T>
+	class task {
+	public:
+		using promise_type = detail::task_promise<T>;
+
+		explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+		{
+		}
+
+		task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		task& operator=(task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle_)
+				{
+					handle_.destroy();
+				}
+				handle_ = std::exchange(other.handle_, nullptr);
+			}
+			return *this;
+		}
+
+		task(const task&) = delete;
+		task& operator=(const task&) = delete;
+
+		~task()
+		{
+			if (handle_)
+			{
+				handle_.destroy();
+			}
+		}
+
+		auto operator co_await() && noexcept
+		{
+			struct awaiter {
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() const noexcept
+				{
+					return !handle || handle.done();
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+				{
+					handle.promise().continuation(awaiting);
+					return handle;
+				}
+
+				T await_resume()
+				{
+					return handle.promise().result();
+				}
+			};
+			return awaiter{ handle_ };
+		}
+	private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	namespace detail {
+		template <typename T>
+		task<T> task_promise<T>::get_return_object() noexcept
+		{
+			return task<T>{ std::coroutine_handle<task_promise<T>>::from_promise(*this) };
+		}
+
+		inline task<void> task_promise<void>::get_return_object() noexcept
+		{
+			return task<void>{ std::coroutine_handle<task_promise<void>>::from_promise(*this) };
+		}
+	}
+
+	/**
+	 * @brief A coroutine producing a sequence of values, where producing each value may itself suspend.
+	 *
+	 * Values are pulled with `co_await generator.next()`, which returns an empty optional once the sequence ends.
+	 *
+	 * @tparam T The type of the values.
+	 */
+	template <typename T>
+	class async_generator {
+	public:
+		class promise_type {
+		public:
+			async_generator get_return_object() noexcept
+			{
+				return async_generator{ std::coroutine_handle<promise_type>::from_promise(*this) };
+			}
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			auto final_suspend() noexcept
+			{
+				return yield_awaiter{};
+			}
+
+			auto yield_value(T& value) noexcept
+			{
+				current_ = std::addressof(value);
+				return yield_awaiter{};
+			}
+
+			auto yield_value(T&& value) noexcept
+			{
+				current_ = std::addressof(value);
+				return yield_awaiter{};
+			}
+
+			void return_void() noexcept
+			{
+				current_ = nullptr;
+			}
+
+			void unhandled_exception() noexcept
+			{
+				current_ = nullptr;
+				exception_ = std::current_exception();
+			}
+		private:
+			friend class async_generator;
+
+			struct yield_awaiter {
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					return handle.promise().consumer_;
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			T* current_ = nullptr;
+			std::coroutine_handle<> consumer_;
+			std::exception_ptr exception_;
+		};
+
+		explicit async_generator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+		{
+		}
+
+		async_generator(async_generator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		async_generator(const async_generator&) = delete;
+		async_generator& operator=(const async_generator&) = delete;
+		async_generator& operator=(async_generator&&) = delete;
+
+		~async_generator()
+		{
+			if (handle_)
+			{
+				handle_.destroy();
+			}
+		}
+
+		/**
+		 * @brief Resumes the generator until it produces its next value.
+		 *
+		 * @return An awaitable producing the next value, or an empty optional when the sequence has ended.
+		 */
+		auto next() noexcept
+		{
+			struct awaiter {
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() const noexcept
+				{
+					return !handle || handle.done();
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+				{
+					handle.promise().consumer_ = consumer;
+					return handle;
+				}
+
+				std::optional<T> await_resume()
+				{
+					if (!handle)
+					{
+						return std::nullopt;
+					}
+					promise_type& promise = handle.promise();
+					if (promise.exception_)
+					{
+						std::rethrow_exception(std::exchange(promise.exception_, nullptr));
+					}
+					if (promise.current_ == nullptr)
+					{
+						return std::nullopt;
+					}
+					return std::optional<T>{ std::move(*promise.current_) };
+				}
+			};
+			return awaiter{ handle_ };
+		}
+	private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	/**
+	 * @brief Returns an awaitable that resumes the awaiting coroutine on the given executor.
+	 *
+	 * @param target The executor to continue on.
+	 */
+	inline auto schedule(executor& target) noexcept
+	{
+		struct awaiter {
+			executor& target;
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				target.post([handle]() { handle.resume(); });
+			}
+
+			void await_resume() const noexcept
+			{
+			}
+		};
+		return awaiter{ target };
+	}
+
+	/**
+	 * @brief Runs a blocking function on the given executor and continues the awaiting coroutine there.
+	 *
+	 * @param target The executor to run the function on.
+	 * @param function The function to run.
+	 * @return task The result of the function.
+	 */
+	template <typename Function>
+	task<std::invoke_result_t<Function>> run_on(executor& target, Function function)
+	{
+		co_await schedule(target);
+		co_return function();
+	}
+
+	namespace detail {
+		class sync_wait_event {
+		public:
+			void set()
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				done_ = true;
+				condition_.notify_all();
+			}
+
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock{ mutex_ };
+				condition_.wait(lock, [this]() { return done_; });
+			}
+		private:
+			std::mutex mutex_;
+			std::condition_variable condition_;
+			bool done_ = false;
+		};
+
+		class sync_wait_task {
+		public:
+			class promise_type {
+			public:
+				sync_wait_task get_return_object() noexcept
+				{
+					return sync_wait_task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+				}
+
+				std::suspend_always initial_suspend() noexcept
+				{
+					return {};
+				}
+
+				auto final_suspend() noexcept
+				{
+					struct awaiter {
+						bool await_ready() noexcept
+						{
+							return false;
+						}
+
+						void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+						{
+							handle.promise().event->set();
+						}
+
+						void await_resume() noexcept
+						{
+						}
+					};
+					return awaiter{};
+				}
+
+				void return_void() noexcept
+				{
+				}
+
+				void unhandled_exception() noexcept
+				{
+					std::terminate();
+				}
+
+				sync_wait_event* event = nullptr;
+			};
+
+			explicit sync_wait_task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+			{
+			}
+
+			sync_wait_task(const sync_wait_task&) = delete;
+			sync_wait_task& operator=(const sync_wait_task&) = delete;
+
+			~sync_wait_task()
+			{
+				handle_.destroy();
+			}
+
+			void run(sync_wait_event& event)
+			{
+				handle_.promise().event = &event;
+				handle_.resume();
+				event.wait();
+			}
+		private:
+			std::coroutine_handle<promise_type> handle_;
+		};
+
+		template <typename T>
+		sync_wait_task make_sync_wait_task(task<T>& awaited, std::optional<T>& value, std::exception_ptr& exception)
+		{
+			try
+			{
+				value.emplace(co_await std::move(awaited));
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+		}
+
+		inline sync_wait_task make_sync_wait_task(task<void>& awaited, std::exception_ptr& exception)
+		{
+			try
+			{
+				co_await std::move(awaited);
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+		}
+	}
+
+	/**
+	 * @brief Blocks the calling thread until the task completes.
+	 *
+	 * @param awaited The task to wait for.
+	 * @return T The result of the task.
+	 */
+	template <typename T>
+	T sync_wait(task<T> awaited)
+	{
+		std::optional<T> value;
+		std::exception_ptr exception;
+		detail::sync_wait_event event;
+		detail::make_sync_wait_task(awaited, value, exception).run(event);
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+		return std::move(*value);
+	}
+
+	inline void sync_wait(task<void> awaited)
+	{
+		std::exception_ptr exception;
+		detail::sync_wait_event event;
+		detail::make_sync_wait_task(awaited, exception).run(event);
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief Estimates how often keys were seen recently, in constant memory, with a count-min sketch.
+	 *
+	 * Each key has a 4 bit counter in each of 4 rows, picked by hashing the key, and its estimate is the smallest of them, so estimates
+	 * can be too high when keys share counters but are never too low. Only the smallest counters of a key are incremented.
+	 * After 10 increments per counter of a row, every counter is halved so keys that stopped being seen are forgotten.
+	 *
+	 * Not thread safe.
+	 *
+	 */
+	class frequency_sketch {
+	public:
+		/**
+		 * @brief Construct a new frequency_sketch.
+		 *
+		 * @param width The number of counters of each row, rounded up to a power of two. About the number of keys to tell apart.
+		 */
+		explicit frequency_sketch(size_t width);
+
+		/**
+		 * @brief Records that a key was seen.
+		 *
+		 * @param key The key.
+		 */
+		void increment(const std::string& key);
+
+		/**
+		 * @brief Estimates how often a key was seen recently.
+		 *
+		 * @param key The key.
+		 * @return uint32_t The estimate, at most 15.
+		 */
+		uint32_t estimate(const std::string& key) const;
+	private:
+		void indexes(const std::string& key, size_t* result) const;
+
+		static const size_t depth = 4;
+
+		std::vector<uint8_t> counters_;
+		const size_t mask_;
+		const size_t sample_size_;
+		size_t additions_;
+	};
+
+	/**
+	 * @brief Controls which files tiered_filesystem keeps in its fast tier.
+	 *
+	 */
+	struct tiered_options {
+		/**
+		 * @brief The largest number of bytes of the files copied to the fast tier.
+		 *
+		 */
+		uint64_t max_bytes = 64 * 1024 * 1024;
+		/**
+		 * @brief The largest file copied to the fast tier.
+		 *
+		 */
+		uint64_t max_file_size = 8 * 1024 * 1024;
+		/**
+		 * @brief The number of recent reads of a file after which it is copied to the fast tier.
+		 *
+		 */
+		uint32_t promote_after = 2;
+		/**
+		 * @brief The number of counters of each row of the frequency_sketch tracking reads, about the number of files to tell apart.
+		 *
+		 */
+		size_t sketch_width = 4096;
+	};
+
+	/**
+	 * @brief What a tiered_filesystem served from its fast tier.
+	 *
+	 */
+	struct tiered_statistics {
+		/**
+		 * @brief The number of opens for reading served by the fast tier.
+		 *
+		 */
+		uint64_t fast_reads;
+		/**
+		 * @brief The number of opens for reading served by the slow tier.
+		 *
+		 */
+		uint64_t slow_reads;
+		/**
+		 * @brief The number of files copied to the fast tier.
+		 *
+		 */
+		uint64_t promotions;
+		/**
+		 * @brief The number of files dropped from the fast tier to make room for others.
+		 *
+		 */
+		uint64_t demotions;
+		/**
+		 * @brief The number of files not copied to the fast tier because the files to drop for them were read more often.
+		 *
+		 */
+		uint64_t rejections;
+		/**
+		 * @brief The number of files dropped from the fast tier because they changed or invalidate was called.
+		 *
+		 */
+		uint64_t invalidations;
+		/**
+		 * @brief The number of files in the fast tier.
+		 *
+		 */
+		size_t fast_files;
+		/**
+		 * @brief The number of bytes of the files in the fast tier.
+		 *
+		 */
+		uint64_t fast_bytes;
+	};
+
+	/**
+	 * @brief A filesystem that serves the files read most often from a fast filesystem, and everything else from a slow one.
+	 *
+	 * The slow filesystem holds every file and answers every call except opening a file for reading, so directories, enumeration,
+	 * timestamps and lengths are exactly those of the slow filesystem. Writes go to the slow filesystem too. The fast filesystem
+	 * holds copies of the files read most often, at the same paths, and files opened with file_mode::open and file_access::read
+	 * are read from it when it has them.
+	 *
+	 * Reads are counted per path in a frequency_sketch. A file read tiered_options::promote_after times recently is copied to the
+	 * fast tier when opened, if it is no larger than tiered_options::max_file_size. When the copies would exceed tiered_options::max_bytes,
+	 * the least recently read copies are dropped for it, TinyLFU style: only if each was read less often than the new file, which is
+	 * otherwise left in the slow tier, so a scan of files read once does not flush the files read often.
+	 *
+	 * Moving, deleting, replacing, copying over or opening for writing a file through this filesystem drops its copy once changed,
+	 * so reads see the new file. Changes made another way must be passed to invalidate. Reads from the fast tier do not update the access
+	 * time of the slow tier. Handles opened for writing must not outlive this filesystem. Streams returned by open_file live until their file
+	 * is opened through open_file again with the same mode and access, moved or deleted through this filesystem, or the filesystem is destroyed.
+	 * A stream reading a copy keeps reading it when the copy is dropped, like a handle does.
+	 *
+	 */
+	class tiered_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new tiered_filesystem.
+		 *
+		 * @param fast The filesystem holding the copies of the files read most often, usually a memory_filesystem. Its contents are managed by this filesystem,
+		 * and it must outlive this filesystem.
+		 * @param slow The filesystem holding every file. It must outlive this filesystem.
+		 * @param options Controls which files are copied to the fast tier.
+		 */
+		tiered_filesystem(filesystem& fast, filesystem& slow, const tiered_options& options = tiered_options{});
+
+		~tiered_filesystem();
+
+		/**
+		 * @brief Drops the copy of a file, or of every file in a directory, after it changed without going through this filesystem.
+		 *
+		 * @param path The file or directory that changed.
+		 */
+		void invalidate(const upath& path);
+
+		/**
+		 * @brief Drops every copy of the fast tier.
+		 *
+		 */
+		void clear();
+
+		/**
+		 * @brief Gets what was served from the fast tier.
+		 *
+		 * @return tiered_statistics The counters since the filesystem was constructed.
+		 */
+		tiered_statistics statistics() const;
+
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+
+		void delete_many(const std::vector<upath>& paths) override;
+	private:
+		struct entry {
+			uint64_t size;
+			std::list<std::string>::iterator position;
+		};
+
+		struct promotion {
+			uint64_t size;
+			// Whether the file changed while it was being copied, so the copy is dropped
+			bool changed;
+		};
+
+		class writing_handle;
+		class change_scope;
+
+		std::unique_ptr<file_handle> open_read(const upath& path, std::error_code* error);
+		bool promote(const upath& path);
+		bool admit(const std::string& name, uint64_t size, std::vector<std::string>& victims);
+		void forget(const std::string& name, bool recursive, bool removed);
+		void drop(const std::vector<std::string>& names);
+
+		filesystem& fast_;
+		const tiered_options options_;
+		mutable std::mutex mutex_;
+		frequency_sketch sketch_;
+		std::map<std::string, entry> entries_;
+		// The names of the files in the fast tier, the most recently read first
+		std::list<std::string> order_;
+		// The files being copied to the fast tier
+		std::map<std::string, promotion> promoting_;
+		std::unique_ptr<detail::stream_table> streams_;
+		uint64_t bytes_;
+		uint64_t fast_reads_;
+		uint64_t slow_reads_;
+		uint64_t promotions_;
+		uint64_t demotions_;
+		uint64_t rejections_;
+		uint64_t invalidations_;
+	};
+}
@@ -1,15 +1,158 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#ifdef __cpp_impl_three_way_comparison
+#include <compare>
+#define ZIOPP_HAS_THREE_WAY_COMPARISON 1
+#endif
+
 namespace ziopp {
+	template <size_t Capacity>
+	class upath_literal;
+	class upath_view;
+
+	/**
+	 * @brief The policy of upath: `/` and `\\` are both separators, names compare case sensitively, and every path is normalized.
+	 *
+	 */
+	struct portable_path_policy {
+		/**
+		 * @brief Gets whether a character separates the names of a path.
+		 *
+		 * @param c The character.
+		 * @return true if c is a separator.
+		 * @return false if c can be part of a name.
+		 */
+		static constexpr bool is_separator(char c)
+		{
+			return c == '/' || c == '\\';
+		}
+
+		/**
+		 * @brief Compares two normalized paths.
+		 *
+		 * @tparam String The string type the paths are stored in.
+		 * @param left The first path.
+		 * @param right The second path.
+		 * @return true if the paths name the same file.
+		 * @return false if they do not.
+		 */
+		template <typename String>
+		static bool equals(const String& left, const String& right)
+		{
+			return left == right;
+		}
+
+		/**
+		 * @brief Ranks a character of a normalized path to order paths by.
+		 *
+		 * `/` ranks below every other character, so the entries of a directory sort right after it, before the siblings starting with its name.
+		 *
+		 * @param c The character.
+		 * @return unsigned int The rank, from 0 to 256.
+		 */
+		static constexpr unsigned int order(char c)
+		{
+			return c == '/' ? 0u : static_cast<unsigned char>(c) + 1u;
+		}
+
+		/**
+		 * @brief Whether paths given to the constructor are already normalized and kept as they are.
+		 *
+		 */
+		static const bool trusted = false;
+	};
+
+	/**
+	 * @brief A policy for paths from POSIX systems, where `\\` is a character of names like any other.
+	 *
+	 */
+	struct posix_path_policy {
+		static constexpr bool is_separator(char c)
+		{
+			return c == '/';
+		}
+
+		template <typename String>
+		static bool equals(const String& left, const String& right)
+		{
+			return left == right;
+		}
+
+		static constexpr unsigned int order(char c)
+		{
+			return c == '/' ? 0u : static_cast<unsigned char>(c) + 1u;
+		}
+
+		static const bool trusted = false;
+	};
+
+	/**
+	 * @brief A policy for paths from POSIX systems that are known to be normalized already, such as those listed by a backend, so are never checked.
+	 *
+	 */
+	struct trusted_posix_path_policy : posix_path_policy {
+		static const bool trusted = true;
+	};
+
+	/**
+	 * @brief A policy for paths of case insensitive filesystems: `/` and `\\` are both separators and ASCII letters compare regardless of case.
+	 *
+	 */
+	struct case_insensitive_path_policy : portable_path_policy {
+		template <typename String>
+		static bool equals(const String& left, const String& right)
+		{
+			if (left.size() != right.size())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < left.size(); i++)
+			{
+				char a = left[i] >= 'A' && left[i] <= 'Z' ? static_cast<char>(left[i] - 'A' + 'a') : left[i];
+				char b = right[i] >= 'A' && right[i] <= 'Z' ? static_cast<char>(right[i] - 'A' + 'a') : right[i];
+				if (a != b)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static constexpr unsigned int order(char c)
+		{
+			return portable_path_policy::order(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+		}
+	};
+
 	/**
 	 * @brief A uniform unix like path.
 	 *
+	 * The policy decides at compile time which characters separate names, how paths compare and whether paths are normalized,
+	 * see portable_path_policy for what a policy provides. Paths of different policies are only converted explicitly.
+	 *
+	 * The full name is stored in a string using the allocator, so paths can be kept off the heap: see arena_upath in path_arena.h, and pmr_upath in
+	 * upath_impl.h from C++17. The library is built with the policies above and std::allocator, other combinations must include upath_impl.h.
+	 *
+	 * @tparam Policy The path policy.
+	 * @tparam Allocator The allocator of the full name.
 	 */
-	class upath {
+	template <typename Policy, typename Allocator = std::allocator<char>>
+	class basic_upath {
 	public:
+		/**
+		 * @brief The string the full name is stored in.
+		 *
+		 */
+		typedef std::basic_string<char, std::char_traits<char>, Allocator> string_type;
+
+		typedef Allocator allocator_type;
+
 		/**
 		 * @brief The directory separator `/`
 		 *
@@ -20,21 +163,66 @@ namespace ziopp {
 		 * @brief Construct a new upath object
 		 *
 		 */
-		explicit upath();
+		explicit basic_upath();
+
+		/**
+		 * @brief Construct a new empty upath object
+		 *
+		 * @param allocator The allocator of the full name.
+		 */
+		explicit basic_upath(const allocator_type& allocator);
 
 		/**
 		 * @brief Construct a new upath object
 		 *
 		 * @param path The path that will be normalized.
 		 */
-		upath(const std::string& path);
+		basic_upath(const std::string& path);
+
+		/**
+		 * @brief Construct a new upath object
+		 *
+		 * @param path The characters of the path that will be normalized.
+		 * @param size The number of characters.
+		 * @param allocator The allocator of the full name, also used while normalizing.
+		 */
+		basic_upath(const char* path, size_t size, const allocator_type& allocator = allocator_type());
+
+		/**
+		 * @brief Normalizes a path without throwing when it is invalid.
+		 *
+		 * @param path The path to normalize.
+		 * @param result Receives the normalized path when it is valid, unchanged otherwise. Its allocator is kept.
+		 * @return true if the path is valid.
+		 * @return false if the path is invalid, such as going to the parent of the root.
+		 */
+		static bool try_parse(const std::string& path, basic_upath& result);
+
+		/**
+		 * @brief Converts a path of another policy or allocator, normalizing it again unless the policy is the same or this policy trusts its paths.
+		 *
+		 * @param other The path to convert.
+		 * @param allocator The allocator of the full name.
+		 */
+		template <typename OtherPolicy, typename OtherAllocator>
+		explicit basic_upath(const basic_upath<OtherPolicy, OtherAllocator>& other, const allocator_type& allocator = allocator_type())
+			: basic_upath(other.full_name().data(), other.full_name().size(), allocator, Policy::trusted || std::is_same<OtherPolicy, Policy>::value)
+		{
+		}
 
 		/**
 		 * @brief Gets the full name of this path.
 		 *
-		 * @return const std::string& The full name of this path.
+		 * @return const string_type& The full name of this path.
+		 */
+		const string_type& full_name() const;
+
+		/**
+		 * @brief Gets the allocator of the full name, which the paths made from this path use too.
+		 *
+		 * @return allocator_type The allocator.
 		 */
-		const std::string& full_name() const;
+		allocator_type get_allocator() const;
 
 		/**
 		 * @brief Gets a value indicating whether this path is empty.
@@ -60,9 +248,39 @@ namespace ziopp {
 		 */
 		bool relative() const;
 
-		bool equals(const upath& other) const;
-		bool operator==(const upath& other) const;
-		bool operator!=(const upath& other) const;
+		bool equals(const basic_upath& other) const;
+		bool operator==(const basic_upath& other) const;
+		bool operator!=(const basic_upath& other) const;
+
+		/**
+		 * @brief Compares two paths name by name, so that `a/b` sorts before `a-b`, consistently with equals.
+		 *
+		 * @param other The path to compare with.
+		 * @return int Less than 0 if this path sorts first, 0 if the paths are equal, greater than 0 if other sorts first.
+		 */
+		int compare(const basic_upath& other) const;
+		bool operator<(const basic_upath& other) const;
+		bool operator<=(const basic_upath& other) const;
+		bool operator>(const basic_upath& other) const;
+		bool operator>=(const basic_upath& other) const;
+
+#ifdef ZIOPP_HAS_THREE_WAY_COMPARISON
+		std::weak_ordering operator<=>(const basic_upath& other) const
+		{
+			int result = compare(other);
+			return result < 0 ? std::weak_ordering::less : result > 0 ? std::weak_ordering::greater : std::weak_ordering::equivalent;
+		}
+#endif
+
+		/**
+		 * @brief Sorts paths in the order of compare.
+		 *
+		 * Uses a most significant digit radix sort, which skips the prefixes shared by the paths rather than comparing them again and again.
+		 * Paths that are equal may be reordered.
+		 *
+		 * @param paths The paths to sort.
+		 */
+		static void sort(std::vector<basic_upath>& paths);
 
 		/**
 		 * @brief Performs an explicit conversion from upath to std::string.
@@ -78,9 +296,9 @@ namespace ziopp {
 		 * @param path2 The second path to combine.
 		 * @return const upath The combined paths. If one of the specified paths is a zero-length string, this method returns the other path. If path2 contains an absolute path, this method returns path2.
 		 */
-		static const upath combine(const upath& path1, const upath& path2);
-		static const upath combine(const upath& path1, const upath& path2, const upath& path3);
-		static const upath combine(const upath& path1, const upath& path2, const upath& path3, const upath& path4);
+		static const basic_upath combine(const basic_upath& path1, const basic_upath& path2);
+		static const basic_upath combine(const basic_upath& path1, const basic_upath& path2, const basic_upath& path3);
+		static const basic_upath combine(const basic_upath& path1, const basic_upath& path2, const basic_upath& path3, const basic_upath& path4);
 
 		/**
 		 * @brief Implements the / operator equivalent of upath::combine()
@@ -88,28 +306,28 @@ namespace ziopp {
 		 * @param other
 		 * @return const upath
 		 */
-		const upath operator/(const upath& other);
+		const basic_upath operator/(const basic_upath& other);
 
 		/**
 		 * @brief Converts the path to a relative path (by removing the leading `/`). If the path is already relative, returns a copy.
 		 *
 		 * @return const upath A relative path.
 		 */
-		const upath to_relative() const;
+		const basic_upath to_relative() const;
 
 		/**
 		 * @brief Converts the path to an absolute path (by adding a leading `/`). If the path is already absolute, returns a copy.
 		 *
 		 * @return const upath An absolute path.
 		 */
-		const upath to_absolute() const;
+		const basic_upath to_absolute() const;
 
 		/**
 		 * @brief Gets the directory.
 		 *
 		 * @return const upath The directory of the path.
 		 */
-		const upath directory() const;
+		const basic_upath directory() const;
 
 		/**
 		 * @brief Gets the first directory.
@@ -132,8 +350,9 @@ namespace ziopp {
 		 * @param recursive True to check if it is anywhere in the directory, false to check if it is directly in the directory.
 		 * @return true The path is in the given directory.
 		 * @return false The path is not in the given directory.
+		 * @throws std::invalid_argument if one path is absolute and the other relative.
 		 */
-		bool in_directory(const upath& directory, bool recursive) const;
+		bool in_directory(const basic_upath& directory, bool recursive) const;
 
 		/**
 		 * @brief Gets the file or last directory name and extension of the specified path.
@@ -162,17 +381,32 @@ namespace ziopp {
 		 * @param extension The new extension (with or without a leading period).
 		 * @return const upath The modified path information.
 		 */
-		const upath change_extension(const std::string& extension) const;
+		const basic_upath change_extension(const std::string& extension) const;
 
 		/**
 		 * @brief Removes the extension of a path.
 		 *
 		 * @return const upath The modified path information.
 		 */
-		const upath remove_extension() const;
+		const basic_upath remove_extension() const;
 	private:
-		explicit upath(const std::string& path, bool safe);
+		template <size_t Capacity>
+		friend class upath_literal;
+		friend class upath_view;
+
+		basic_upath(const char* path, size_t size, const allocator_type& allocator, bool safe);
 
-		std::string full_name_;
+		string_type full_name_;
 	};
+
+	/**
+	 * @brief The path used throughout, accepting both separators.
+	 *
+	 */
+	using upath = basic_upath<portable_path_policy>;
+
+	extern template class basic_upath<portable_path_policy>;
+	extern template class basic_upath<posix_path_policy>;
+	extern template class basic_upath<trusted_posix_path_policy>;
+	extern template class basic_upath<case_insensitive_path_policy>;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ziopp/executor.h>
+#include <ziopp/upath.h>
+
+namespace ziopp {
+	/**
+	 * @brief A normalized path that does not own its characters, such as a path of an upath_batch.
+	 *
+	 */
+	class upath_view {
+	public:
+		/**
+		 * @brief Construct a new empty upath_view.
+		 *
+		 */
+		upath_view() : data_(nullptr), size_(0)
+		{
+		}
+
+		/**
+		 * @brief Construct a new upath_view of characters that are already normalized.
+		 *
+		 * @param data The characters of the path, which must outlive the view.
+		 * @param size The number of characters.
+		 */
+		upath_view(const char* data, size_t size) : data_(data), size_(size)
+		{
+		}
+
+		/**
+		 * @brief Construct a new upath_view of a path.
+		 *
+		 * @param path The path, which must outlive the view.
+		 */
+		upath_view(const upath& path) : data_(path.full_name().data()), size_(path.full_name().size())
+		{
+		}
+
+		/**
+		 * @brief Gets the characters of the path, which are not null terminated.
+		 *
+		 * @return const char* The characters.
+		 */
+		const char* data() const
+		{
+			return data_;
+		}
+
+		/**
+		 * @brief Gets the length of the path.
+		 *
+		 * @return size_t The number of characters.
+		 */
+		size_t size() const
+		{
+			return size_;
+		}
+
+		/**
+		 * @brief Gets a value indicating whether this path is empty.
+		 *
+		 * @return true if this path is empty.
+		 * @return false if this path is not empty.
+		 */
+		bool empty() const
+		{
+			return size_ == 0;
+		}
+
+		/**
+		 * @brief Gets a value indicating whether this path is absolute by starting with a leading `/`.
+		 *
+		 * @return true if this path is absolute.
+		 * @return false if this path is relative.
+		 */
+		bool absolute() const
+		{
+			return size_ > 0 && data_[0] == upath::directory_seperator;
+		}
+
+		/**
+		 * @brief Copies the path into a upath without normalizing it again.
+		 *
+		 * @return upath The path.
+		 */
+		upath to_upath() const
+		{
+			return upath{ data_, size_, upath::allocator_type(), true };
+		}
+
+		/**
+		 * @brief Performs an explicit conversion from upath_view to std::string.
+		 *
+		 * @return std::string
+		 */
+		explicit operator std::string() const
+		{
+			return std::string(data_, size_);
+		}
+
+		bool operator==(const upath_view& other) const
+		{
+			return size_ == other.size_ && (size_ == 0 || std::memcmp(data_, other.data_, size_) == 0);
+		}
+
+		bool operator!=(const upath_view& other) const
+		{
+			return !(*this == other);
+		}
+	private:
+		const char* data_;
+		size_t size_;
+	};
+
+	/**
+	 * @brief Controls how an upath_batch splits its work.
+	 *
+	 */
+	struct upath_batch_options {
+		/**
+		 * @brief The number of paths normalized by one piece of work. Batches of at most one chunk are normalized on the calling thread.
+		 *
+		 */
+		size_t chunk_size = 16 * 1024;
+		/**
+		 * @brief The executor chunks are normalized on, nullptr for thread_pool::shared().
+		 *
+		 */
+		executor* work_executor = nullptr;
+		/**
+		 * @brief The largest number of chunks normalized at once.
+		 *
+		 */
+		size_t max_concurrency = 8;
+	};
+
+	/**
+	 * @brief Many paths normalized at once into a single buffer, for loading manifests and other long lists of paths.
+	 *
+	 * Path i is the characters of data() from offsets()[i] to offsets()[i + 1]. An invalid path is empty and has an error rather than throwing,
+	 * so one bad entry does not fail the whole batch.
+	 *
+	 */
+	class upath_batch {
+	public:
+		/**
+		 * @brief Construct a new upath_batch, normalizing paths.
+		 *
+		 * @param paths The paths to normalize.
+		 * @param options Controls how the work is split.
+		 */
+		explicit upath_batch(const std::vector<std::string>& paths, const upath_batch_options& options = upath_batch_options{});
+
+		/**
+		 * @brief Gets the number of paths.
+		 *
+		 * @return size_t The number of paths, invalid ones included.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Gets a path.
+		 *
+		 * @param index The index of the path in the paths normalized.
+		 * @return upath_view The normalized path, empty if it is invalid. Valid as long as the batch is.
+		 */
+		upath_view operator[](size_t index) const;
+
+		/**
+		 * @brief Gets why a path is invalid.
+		 *
+		 * @param index The index of the path in the paths normalized.
+		 * @return const char* The error, nullptr if the path is valid.
+		 */
+		const char* error(size_t index) const;
+
+		/**
+		 * @brief Gets the number of invalid paths.
+		 *
+		 * @return size_t The number of paths with an error.
+		 */
+		size_t error_count() const;
+
+		/**
+		 * @brief Gets the characters of all the normalized paths, one after the other.
+		 *
+		 * @return const std::string& The characters.
+		 */
+		const std::string& data() const;
+
+		/**
+		 * @brief Gets where each path starts in data(), followed by the size of data().
+		 *
+		 * @return const std::vector<size_t>& size() + 1 offsets.
+		 */
+		const std::vector<size_t>& offsets() const;
+
+		/**
+		 * @brief Copies the paths into upaths without normalizing them again.
+		 *
+		 * @return std::vector<upath> The paths, invalid ones empty.
+		 */
+		std::vector<upath> to_upaths() const;
+	private:
+		std::string data_;
+		std::vector<size_t> offsets_;
+		// Points to static messages so checking paths never allocates for them
+		std::vector<const char*> errors_;
+		size_t error_count_;
+	};
+}
@@ -0,0 +1,812 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ziopp/upath.h>
+
+// The definitions of basic_upath, needed to use a policy or an allocator the library is not built with.
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define ZIOPP_HAS_PMR_UPATH 1
+#endif
+#endif
+
+namespace ziopp {
+	namespace detail {
+		struct text_slice {
+		public:
+			text_slice(int start, int end) : start_(start), end_(end)
+			{
+			}
+
+			int start() const {
+				return start_;
+			}
+
+			int end() const {
+				return end_;
+			}
+
+			int size() const {
+				return end_ - start_ + 1;
+			}
+		private:
+			int start_;
+			int end_;
+		};
+
+		inline bool is_dot_dot(const text_slice& slice, const char* path)
+		{
+			if (slice.size() != 2)
+			{
+				return false;
+			}
+			return path[slice.start()] == '.' && path[slice.end()] == '.';
+		}
+
+		// Copies part of a full name like substr does, whatever its allocator
+		template <typename String>
+		std::string substring(const String& text, size_t position, size_t count = std::string::npos)
+		{
+			if (position > text.size())
+			{
+				throw std::out_of_range("The position is past the end of the path");
+			}
+			return std::string(text.data() + position, std::min(count, text.size() - position));
+		}
+
+		// The separators the policy accepts are decided at compile time, so a policy accepting only `/` tests for nothing else.
+		// Normalizes into result using parts as scratch space, and returns the error or nullptr.
+		template <typename Policy, typename String, typename Parts>
+		const char* validate_and_normalize(const char* path, size_t size, String& result, Parts& parts)
+		{
+			if ((size == 1 && (path[0] == '/' || path[0] == '.')) || (size == 2 && path[0] == '.' && path[1] == '.'))
+			{
+				result.assign(path, size);
+				return nullptr;
+			}
+			if (Policy::is_separator('\\') && size == 1 && path[0] == '\\')
+			{
+				result.assign(1, '/');
+				return nullptr;
+			}
+
+			parts.clear();
+			size_t separators = 0;
+			for (size_t j = 0; j < size; j++)
+			{
+				separators += Policy::is_separator(path[j]) ? 1 : 0;
+			}
+			parts.reserve(separators + 1);
+
+			int lastIndex = 0;
+			int i = 0;
+			bool processParts = false;
+			int dotCount = 0;
+			for (; i < (int)size; i++)
+			{
+				char c = path[i];
+
+				if (c == '.')
+				{
+					dotCount++;
+				}
+
+				if (Policy::is_separator(c))
+				{
+					// optimization: If we don't expect to process the path
+					// and we only have a trailing / or \\ after a part that
+					// is not only dots, then just perform a substring on the path
+
+					if (!processParts && i + 1 == (int)size && i - lastIndex != dotCount)
+					{
+						result.assign(path, size - 1);
+						return nullptr;
+					}
+
+					if (c != '/')
+					{
+						processParts = true;
+					}
+
+					int endIndex = i - 1;
+					for (i++; i < (int)size; i++)
+					{
+						c = path[i];
+						if (Policy::is_separator(c))
+						{
+							// If we have consecutive / or \\, we need to process parts
+							processParts = true;
+							continue;
+						}
+						break;
+					}
+
+					if (endIndex >= lastIndex || endIndex == -1)
+					{
+						text_slice part{ lastIndex, endIndex };
+						parts.push_back(part);
+
+						// If the previous part had only dots, we need to process it
+						if (part.size() == dotCount)
+						{
+							processParts = true;
+						}
+					}
+					dotCount = c == '.' ? 1 : 0;
+					lastIndex = i;
+				}
+			}
+
+			if (lastIndex < (int)size)
+			{
+				text_slice part{ lastIndex, (int)size - 1 };
+				parts.push_back(part);
+
+				// If the previous part had only dots, we need to process it
+				if (part.size() == dotCount)
+				{
+					processParts = true;
+				}
+			}
+
+			// Optimized path if we don't need to compact the path
+			if (!processParts)
+			{
+				result.assign(path, size);
+				return nullptr;
+			}
+
+			// Slow path, we need to process the parts
+			for (i = 0; i < (int)parts.size(); i++)
+			{
+				text_slice& part = parts[i];
+				int partLength = part.size();
+				if (partLength < 1)
+				{
+					continue;
+				}
+
+				if (path[part.start()] != '.')
+				{
+					continue;
+				}
+
+				if (partLength == 1)
+				{
+					// We have a '.'
+					if (parts.size() > 1)
+					{
+						parts.erase(parts.begin() + i);
+						i--;
+					}
+				}
+				else
+				{
+					if (path[part.start() + 1] != '.')
+					{
+						continue;
+					}
+
+					// Throws an exception if our slice path contains only `.`  and is longer than 2 characters
+					if (partLength > 2)
+					{
+						bool isValid = false;
+						for (int j = part.start() + 2; j <= part.end(); j++)
+						{
+							if (path[j] != '.')
+							{
+								isValid = true;
+								break;
+							}
+						}
+
+						if (!isValid)
+						{
+							return "The path contains invalid dots";
+						}
+
+						continue;
+					}
+
+					if (i > 0)
+					{
+						text_slice& previousSlice = parts[i - 1];
+						if (!is_dot_dot(previousSlice, path))
+						{
+							if (previousSlice.size() == 0)
+							{
+								return "The path cannot go to the parent of a root path";
+							}
+
+							parts.erase(parts.begin() + i);
+							i--;
+							parts.erase(parts.begin() + i);
+							i--;
+						}
+					}
+				}
+			}
+
+			// If we have a single part and it is empty, it is a root
+			if (parts.size() == 1 && parts[0].start() == 0 && parts[0].end() < 0)
+			{
+				result.assign(1, '/');
+				return nullptr;
+			}
+
+			result.clear();
+			result.reserve(size);
+			for (i = 0; i < (int)parts.size(); i++)
+			{
+				const text_slice& slice = parts[i];
+				if (slice.size() > 0)
+				{
+					result.append(path + slice.start(), slice.size());
+				}
+				if (i + 1 < (int)parts.size())
+				{
+					result += '/';
+				}
+			}
+			return nullptr;
+		}
+
+		// Normalizes into result, whose allocator is used for the parts too
+		template <typename Policy, typename String>
+		const char* validate_and_normalize(const char* path, size_t size, String& result)
+		{
+			typedef typename std::allocator_traits<typename String::allocator_type>::template rebind_alloc<text_slice> slice_allocator;
+			std::vector<text_slice, slice_allocator> parts{ slice_allocator(result.get_allocator()) };
+			return validate_and_normalize<Policy>(path, size, result, parts);
+		}
+
+		// Compares the characters of two paths from position from, which they share the characters before
+		template <typename Policy>
+		int compare_names(const char* left, size_t left_size, const char* right, size_t right_size, size_t from)
+		{
+			size_t size = std::min(left_size, right_size);
+			size_t i = from;
+			// Equal characters rank the same whatever the policy, so runs of them are skipped a word at a time
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+			{
+				uint64_t a;
+				uint64_t b;
+				std::memcpy(&a, left + i, sizeof(a));
+				std::memcpy(&b, right + i, sizeof(b));
+				if (a != b)
+				{
+					break;
+				}
+			}
+			for (; i < size; i++)
+			{
+				if (left[i] == right[i])
+				{
+					continue;
+				}
+				unsigned int a = Policy::order(left[i]);
+				unsigned int b = Policy::order(right[i]);
+				if (a != b)
+				{
+					return a < b ? -1 : 1;
+				}
+			}
+			return left_size < right_size ? -1 : left_size > right_size ? 1 : 0;
+		}
+
+		struct sort_entry {
+			const char* data;
+			size_t size;
+			size_t index;
+		};
+
+		// 0 for the end of the path, then the rank of the character plus one
+		template <typename Policy>
+		size_t sort_bucket(const sort_entry& entry, size_t depth)
+		{
+			return depth < entry.size ? Policy::order(entry.data[depth]) + 1 : 0;
+		}
+
+		// Sorts by the character at depth into buckets, then each bucket by the next character, paths before depth being equal
+		template <typename Policy>
+		void radix_sort(std::vector<sort_entry>& entries)
+		{
+			const size_t bucket_count = 258;
+			const size_t small_range = 32;
+			struct range {
+				size_t begin;
+				size_t count;
+				size_t depth;
+			};
+			std::vector<sort_entry> scratch(entries.size());
+			std::vector<range> pending{ range{ 0, entries.size(), 0 } };
+			std::vector<size_t> counts(bucket_count);
+			while (!pending.empty())
+			{
+				range current = pending.back();
+				pending.pop_back();
+				sort_entry* begin = entries.data() + current.begin;
+				if (current.count < small_range)
+				{
+					size_t depth = current.depth;
+					std::sort(begin, begin + current.count, [depth](const sort_entry& left, const sort_entry& right) {
+						return compare_names<Policy>(left.data, left.size, right.data, right.size, depth) < 0;
+					});
+					continue;
+				}
+
+				std::fill(counts.begin(), counts.end(), 0);
+				for (size_t i = 0; i < current.count; i++)
+				{
+					counts[sort_bucket<Policy>(begin[i], current.depth)]++;
+				}
+				// A prefix all the paths share is skipped without moving them
+				size_t first = sort_bucket<Policy>(begin[0], current.depth);
+				if (counts[first] == current.count)
+				{
+					if (first != 0)
+					{
+						pending.push_back(range{ current.begin, current.count, current.depth + 1 });
+					}
+					continue;
+				}
+
+				size_t offset = 0;
+				for (size_t bucket = 0; bucket < bucket_count; bucket++)
+				{
+					size_t count = counts[bucket];
+					counts[bucket] = offset;
+					// Paths ending here are all equal
+					if (bucket != 0 && count > 1)
+					{
+						pending.push_back(range{ current.begin + offset, count, current.depth + 1 });
+					}
+					offset += count;
+				}
+				sort_entry* out = scratch.data() + current.begin;
+				for (size_t i = 0; i < current.count; i++)
+				{
+					out[counts[sort_bucket<Policy>(begin[i], current.depth)]++] = begin[i];
+				}
+				std::copy(out, out + current.count, begin);
+			}
+		}
+
+		template <typename String>
+		String change_extension(const String& path, const std::string* extension)
+		{
+			String s = path;
+			for (size_t i = path.size(); i-- > 0;)
+			{
+				char ch = path[i];
+				if (ch == '.')
+				{
+					s.assign(path, 0, i);
+					break;
+				}
+				if (ch == '/')
+				{
+					break;
+				}
+			}
+			if (extension != nullptr && path.size() != 0)
+			{
+				if (extension->size() == 0 || extension->at(0) != '.')
+				{
+					s += '.';
+				}
+				s.append(extension->data(), extension->size());
+			}
+			return s;
+		}
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::basic_upath() : full_name_()
+	{
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::basic_upath(const allocator_type& allocator) : full_name_(allocator)
+	{
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::basic_upath(const std::string& path) : basic_upath(path.data(), path.size(), allocator_type(), Policy::trusted)
+	{
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::basic_upath(const char* path, size_t size, const allocator_type& allocator) : basic_upath(path, size, allocator, Policy::trusted)
+	{
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::basic_upath(const char* path, size_t size, const allocator_type& allocator, bool safe) : full_name_(allocator)
+	{
+		if (safe)
+		{
+			full_name_.assign(path, size);
+		}
+		else
+		{
+			const char* error = detail::validate_and_normalize<Policy>(path, size, full_name_);
+			if (error != nullptr)
+			{
+				throw std::invalid_argument(error);
+			}
+		}
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::try_parse(const std::string& path, basic_upath& result)
+	{
+		string_type normalized{ result.full_name_.get_allocator() };
+		if (detail::validate_and_normalize<Policy>(path.data(), path.size(), normalized) != nullptr)
+		{
+			return false;
+		}
+		result.full_name_ = std::move(normalized);
+		return true;
+	}
+
+	template <typename Policy, typename Allocator>
+	const typename basic_upath<Policy, Allocator>::string_type& basic_upath<Policy, Allocator>::full_name() const
+	{
+		return full_name_;
+	}
+
+	template <typename Policy, typename Allocator>
+	typename basic_upath<Policy, Allocator>::allocator_type basic_upath<Policy, Allocator>::get_allocator() const
+	{
+		return full_name_.get_allocator();
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::empty() const
+	{
+		return full_name_.empty();
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::absolute() const
+	{
+		return !empty() && full_name_[0] == '/';
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::relative() const
+	{
+		return !absolute();
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::equals(const basic_upath& other) const
+	{
+		return Policy::equals(full_name_, other.full_name_);
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator==(const basic_upath& other) const
+	{
+		return equals(other);
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator!=(const basic_upath& other) const
+	{
+		return !equals(other);
+	}
+
+	template <typename Policy, typename Allocator>
+	int basic_upath<Policy, Allocator>::compare(const basic_upath& other) const
+	{
+		return detail::compare_names<Policy>(full_name_.data(), full_name_.size(), other.full_name_.data(), other.full_name_.size(), 0);
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator<(const basic_upath& other) const
+	{
+		return compare(other) < 0;
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator<=(const basic_upath& other) const
+	{
+		return compare(other) <= 0;
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator>(const basic_upath& other) const
+	{
+		return compare(other) > 0;
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::operator>=(const basic_upath& other) const
+	{
+		return compare(other) >= 0;
+	}
+
+	template <typename Policy, typename Allocator>
+	void basic_upath<Policy, Allocator>::sort(std::vector<basic_upath>& paths)
+	{
+		std::vector<detail::sort_entry> entries;
+		entries.reserve(paths.size());
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			entries.push_back(detail::sort_entry{ paths[i].full_name_.data(), paths[i].full_name_.size(), i });
+		}
+		detail::radix_sort<Policy>(entries);
+
+		std::vector<basic_upath> sorted;
+		sorted.reserve(paths.size());
+		for (const detail::sort_entry& entry : entries)
+		{
+			sorted.push_back(std::move(paths[entry.index]));
+		}
+		paths.swap(sorted);
+	}
+
+	template <typename Policy, typename Allocator>
+	basic_upath<Policy, Allocator>::operator std::string() const
+	{
+		return std::string(full_name_.data(), full_name_.size());
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::combine(const basic_upath& path1, const basic_upath& path2)
+	{
+		if (path1.empty() && path2.empty())
+		{
+			return basic_upath{ path1.get_allocator() };
+		}
+
+		// If the right path is absolute, it takes priority over path1
+		if (path2.absolute())
+		{
+			return path2;
+		}
+
+		string_type builder{ path1.get_allocator() };
+		builder.reserve(path1.full_name_.size() + 1 + path2.full_name_.size());
+		if (!path1.empty())
+		{
+			builder += path1.full_name_;
+			builder += '/';
+		}
+		if (!path2.empty())
+		{
+			builder += path2.full_name_;
+		}
+
+		return basic_upath{ builder.data(), builder.size(), builder.get_allocator() };
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::combine(const basic_upath& path1, const basic_upath& path2, const basic_upath& path3)
+	{
+		return combine(combine(path1, path2), path3);
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::combine(const basic_upath& path1, const basic_upath& path2, const basic_upath& path3, const basic_upath& path4)
+	{
+		return combine(combine(path1, path2), combine(path3, path4));
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::operator/(const basic_upath& other)
+	{
+		return combine(*this, other);
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::to_relative() const
+	{
+		if (relative())
+		{
+			return *this;
+		}
+		return full_name_.size() == 1 ? basic_upath{ get_allocator() } : basic_upath{ full_name_.data() + 1, full_name_.size() - 1, get_allocator(), true };
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::to_absolute() const
+	{
+		if (absolute())
+		{
+			return *this;
+		}
+		basic_upath root{ "/", 1, get_allocator(), true };
+		return empty() ? root : combine(root, *this);
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::directory() const
+	{
+		if (full_name_.size() == 1 && full_name_[0] == '/')
+		{
+			return basic_upath{ get_allocator() };
+		}
+
+		auto const last_index = full_name_.find_last_of(directory_seperator);
+		if (last_index != string_type::npos && last_index > 0)
+		{
+			return basic_upath{ full_name_.data(), last_index, get_allocator() };
+		}
+		return last_index == 0 ? basic_upath{ "/", 1, get_allocator(), true } : basic_upath{ get_allocator() };
+	}
+
+	template <typename Policy, typename Allocator>
+	const std::string basic_upath<Policy, Allocator>::first_directory() const
+	{
+		auto const index = full_name_.find_first_of(directory_seperator);
+		if (index == string_type::npos)
+		{
+			return detail::substring(full_name_, 1, full_name_.size() - 1);
+		}
+		return detail::substring(full_name_, 1, index - 1);
+	}
+
+	template <typename Policy, typename Allocator>
+	const std::vector<std::string> basic_upath<Policy, Allocator>::split() const
+	{
+		if (empty())
+		{
+			return std::vector<std::string>{};
+		}
+
+		std::vector<std::string> paths;
+		size_t previous_index = absolute() ? 1 : 0;
+		size_t next_index = 0;
+		while ((next_index = full_name_.find_first_of(directory_seperator, previous_index)) != string_type::npos)
+		{
+			if (next_index != 0)
+			{
+				paths.push_back(detail::substring(full_name_, previous_index, next_index - previous_index));
+			}
+
+			previous_index = next_index + 1;
+		}
+
+		if (previous_index < full_name_.size())
+		{
+			paths.push_back(detail::substring(full_name_, previous_index, full_name_.size() - previous_index));
+		}
+		return paths;
+	}
+
+	template <typename Policy, typename Allocator>
+	bool basic_upath<Policy, Allocator>::in_directory(const basic_upath& directory, bool recursive) const
+	{
+		if (absolute() != directory.absolute())
+		{
+			throw std::invalid_argument("Cannot mix absolute and relative paths");
+		}
+
+		const string_type& target = full_name_;
+		const string_type& dir = directory.full_name_;
+
+		if (target.size() < dir.length() || target.compare(0, dir.size(), dir) != 0)
+		{
+			return false;
+		}
+
+		if (target.size() == dir.size())
+		{
+			// exact match due to the StartsWith above
+            // the directory parameter is interpreted as a directory so trailing separator isn't important
+			return true;
+		}
+
+		bool dir_has_trailing_separator = dir.at(dir.size() - 1) == directory_seperator;
+
+		if (!recursive)
+		{
+			// need to check if the directory part terminates
+			const auto last_separator_in_target = target.find_last_of(directory_seperator);
+			const auto expected_last_separator = dir.size() - (dir_has_trailing_separator ? 1 : 0);
+
+			if (last_separator_in_target != expected_last_separator)
+			{
+				return false;
+			}
+		}
+
+		if (!dir_has_trailing_separator)
+		{
+			// directory is missing ending slash, check that target has it
+			return target.size() > dir.size() && target.at(dir.size()) == directory_seperator;
+		}
+
+		return true;
+	}
+
+	template <typename Policy, typename Allocator>
+	const std::string basic_upath<Policy, Allocator>::name() const
+	{
+		size_t length = full_name_.size();
+		for (size_t i = length; i-- > 0;)
+		{
+			char ch = full_name_[i];
+			if (ch == directory_seperator)
+			{
+				return detail::substring(full_name_, i + 1, length - i - 1);
+			}
+		}
+		return std::string(full_name_.data(), full_name_.size());
+	}
+
+	template <typename Policy, typename Allocator>
+	const std::string basic_upath<Policy, Allocator>::name_without_extension() const
+	{
+		const std::string& path = name();
+		size_t i;
+		if ((i = path.find_last_of('.')) == std::string::npos)
+		{
+			return path;
+		}
+		return path.substr(0, i);
+	}
+
+	template <typename Policy, typename Allocator>
+	const std::string basic_upath<Policy, Allocator>::extension_with_dot() const
+	{
+		size_t length = full_name_.size();
+		for (size_t i = length; i-- > 0;)
+		{
+			char ch = full_name_[i];
+			if (ch == '.')
+			{
+				if (i != length -1)
+				{
+					return detail::substring(full_name_, i, length - i);
+				}
+				else
+				{
+					return std::string{};
+				}
+			}
+			if (ch == directory_seperator)
+			{
+				break;
+			}
+		}
+		return std::string{};
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::change_extension(const std::string& extension) const
+	{
+		string_type path = detail::change_extension(full_name_, &extension);
+		return basic_upath{ path.data(), path.size(), get_allocator() };
+	}
+
+	template <typename Policy, typename Allocator>
+	const basic_upath<Policy, Allocator> basic_upath<Policy, Allocator>::remove_extension() const
+	{
+		string_type path = detail::change_extension(full_name_, nullptr);
+		return basic_upath{ path.data(), path.size(), get_allocator() };
+	}
+
+	template <typename Policy, typename Allocator>
+	const char basic_upath<Policy, Allocator>::directory_seperator;
+
+#ifdef ZIOPP_HAS_PMR_UPATH
+	/**
+	 * @brief A upath whose full name is allocated from a std::pmr::memory_resource, such as a std::pmr::monotonic_buffer_resource over a buffer on the stack.
+	 *
+	 */
+	using pmr_upath = basic_upath<portable_path_policy, std::pmr::polymorphic_allocator<char>>;
+#endif
+}
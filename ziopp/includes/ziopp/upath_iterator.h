@@ -1,6 +1,8 @@
 #pragma once
 
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <ziopp/upath.h>
 
 #ifndef _NODISCARD
@@ -12,14 +14,34 @@
 #endif
 
 namespace ziopp {
+    /**
+     * @brief A single pass iterator over the paths produced by filesystem::enumerate_paths.
+     *
+     * A default constructed iterator is the end iterator. Copies of an iterator share the
+     * underlying enumeration, so advancing one copy advances all of them.
+     *
+     */
     class upath_iterator {
     public:
+        using iterator_category = std::input_iterator_tag;
         using value_type = upath;
         using difference_type = ptrdiff_t;
         using pointer = const value_type*;
         using reference = const value_type&;
 
-        upath_iterator() = default;
+        /**
+         * @brief Constructs the end iterator.
+         *
+         */
+        upath_iterator();
+
+        /**
+         * @brief Constructs an iterator over the paths returned by next.
+         *
+         * @param next Called to produce each path in turn. The returned pointer must remain valid until the next call, and nullptr marks the end of the enumeration.
+         */
+        explicit upath_iterator(const std::function<pointer()>& next);
+
         upath_iterator(const upath_iterator&) = default;
         upath_iterator(upath_iterator&&) = default;
         upath_iterator& operator=(const upath_iterator&) = default;
@@ -31,15 +53,16 @@ namespace ziopp {
         upath_iterator& operator++();
         upath_iterator operator++(int);
 
-        upath_iterator& operator--();
-        upath_iterator operator--(int);
-
         friend bool operator==(const upath_iterator& lhs, const upath_iterator& rhs);
         friend bool operator!=(const upath_iterator& lhs, const upath_iterator& rhs);
 
     private:
-        upath_iterator(const std::function<pointer()>& begin, const std::function<pointer()>& end);
-        const std::function<pointer()>& _begin;
-        const std::function<pointer()>& _end;
+        struct state {
+            std::function<pointer()> next;
+            pointer current;
+            upath held;
+        };
+
+        std::shared_ptr<state> state_;
     };
 }
\ No newline at end of file
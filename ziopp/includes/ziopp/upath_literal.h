@@ -0,0 +1,247 @@
+#pragma once
+
+#include <ziopp/upath.h>
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+#define ZIOPP_HAS_UPATH_LITERALS 1
+#define ZIOPP_UPATH_LITERALS_NTTP 1
+#elif defined(__GNUC__) && __cplusplus >= 201402L
+#define ZIOPP_HAS_UPATH_LITERALS 1
+#endif
+
+#ifdef ZIOPP_HAS_UPATH_LITERALS
+
+#include <cstddef>
+#include <string>
+
+namespace ziopp {
+	namespace detail {
+		constexpr bool is_literal_separator(char c)
+		{
+			return c == upath::directory_seperator || c == '\\';
+		}
+
+		constexpr void append_literal_part(const char* part, size_t size, bool root_only, char* out, size_t& length)
+		{
+			if (length > 0 && !root_only)
+			{
+				out[length++] = upath::directory_seperator;
+			}
+			for (size_t i = 0; i < size; i++)
+			{
+				out[length++] = part[i];
+			}
+		}
+
+		// Normalizes like upath does, writing at most size characters to out, and returns the error or nullptr
+		constexpr const char* normalize_literal(const char* path, size_t size, char* out, size_t& length)
+		{
+			length = 0;
+			bool absolute = size > 0 && is_literal_separator(path[0]);
+			// The parts kept so far, the root counting as one
+			size_t parts = 0;
+			if (absolute)
+			{
+				out[length++] = upath::directory_seperator;
+				parts = 1;
+			}
+
+			size_t i = 0;
+			while (i < size)
+			{
+				while (i < size && is_literal_separator(path[i]))
+				{
+					i++;
+				}
+				if (i == size)
+				{
+					break;
+				}
+				size_t start = i;
+				size_t dots = 0;
+				while (i < size && !is_literal_separator(path[i]))
+				{
+					dots += path[i] == '.' ? 1 : 0;
+					i++;
+				}
+				size_t part_size = i - start;
+				bool root_only = absolute && length == 1;
+
+				if (dots != part_size)
+				{
+					append_literal_part(path + start, part_size, root_only, out, length);
+					parts++;
+					continue;
+				}
+				if (part_size > 2)
+				{
+					return "The path contains invalid dots";
+				}
+				if (part_size == 1)
+				{
+					// A `.` is only kept when it is all that is left of the path
+					bool more = false;
+					for (size_t j = i; j < size; j++)
+					{
+						more = more || !is_literal_separator(path[j]);
+					}
+					if (parts == 0 && !more)
+					{
+						append_literal_part(path + start, 1, root_only, out, length);
+						parts++;
+					}
+					continue;
+				}
+
+				// A `..` removes the part before it, unless there is none or it is a `..` too
+				size_t top = length;
+				while (top > 0 && out[top - 1] != upath::directory_seperator)
+				{
+					top--;
+				}
+				if (parts == 0 || (length - top == 2 && out[top] == '.' && out[top + 1] == '.'))
+				{
+					append_literal_part(path + start, 2, root_only, out, length);
+					parts++;
+				}
+				else if (root_only)
+				{
+					return "The path cannot go to the parent of a root path";
+				}
+				else
+				{
+					length = top == 0 ? 0 : top == 1 ? 1 : top - 1;
+					parts--;
+				}
+			}
+			return nullptr;
+		}
+	}
+
+	/**
+	 * @brief A path normalized at compile time, made by the _up literal.
+	 *
+	 * Converts to a upath without normalizing it again.
+	 *
+	 * @tparam Capacity The length of the path before it was normalized, which the normalized path never exceeds.
+	 */
+	template <size_t Capacity>
+	class upath_literal {
+	public:
+		/**
+		 * @brief Construct a new upath_literal, normalizing a path.
+		 *
+		 * @param path The path to normalize.
+		 */
+		constexpr explicit upath_literal(const char* path) : data_{}, size_(0), error_(nullptr)
+		{
+			error_ = detail::normalize_literal(path, Capacity, data_, size_);
+		}
+
+		/**
+		 * @brief Gets the normalized path, which is not null terminated.
+		 *
+		 * @return const char* The characters of the normalized path.
+		 */
+		constexpr const char* data() const
+		{
+			return data_;
+		}
+
+		/**
+		 * @brief Gets the length of the normalized path.
+		 *
+		 * @return size_t The number of characters of the normalized path.
+		 */
+		constexpr size_t size() const
+		{
+			return size_;
+		}
+
+		/**
+		 * @brief Gets why the path is invalid.
+		 *
+		 * @return const char* The error, nullptr if the path is valid.
+		 */
+		constexpr const char* error() const
+		{
+			return error_;
+		}
+
+		operator upath() const
+		{
+			return upath{ data_, size_, upath::allocator_type(), true };
+		}
+	private:
+		char data_[Capacity + 1];
+		size_t size_;
+		const char* error_;
+	};
+
+	namespace detail {
+#ifdef ZIOPP_UPATH_LITERALS_NTTP
+		template <size_t Size>
+		struct literal_chars {
+			constexpr literal_chars(const char (&chars)[Size])
+			{
+				for (size_t i = 0; i < Size; i++)
+				{
+					value[i] = chars[i];
+				}
+			}
+
+			char value[Size];
+		};
+#else
+		template <typename Char, Char... Chars>
+		struct literal_chars {
+			static constexpr char value[] = { Chars..., '\0' };
+		};
+
+		template <typename Char, Char... Chars>
+		constexpr char literal_chars<Char, Chars...>::value[];
+#endif
+	}
+
+	namespace literals {
+#ifdef ZIOPP_UPATH_LITERALS_NTTP
+		/**
+		 * @brief Makes a path normalized and validated at compile time, an invalid path failing to compile.
+		 *
+		 * @tparam Path The path.
+		 * @return upath_literal The normalized path.
+		 */
+		template <detail::literal_chars Path>
+		constexpr upath_literal<sizeof(Path.value) - 1> operator""_up()
+		{
+			constexpr upath_literal<sizeof(Path.value) - 1> result{ Path.value };
+			static_assert(result.error() == nullptr, "the path literal is not a valid upath");
+			return result;
+		}
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-string-literal-operator-template"
+#endif
+		/**
+		 * @brief Makes a path normalized and validated at compile time, an invalid path failing to compile.
+		 *
+		 * Uses the string literal operator template extension of GCC and Clang before C++20.
+		 *
+		 * @return upath_literal The normalized path.
+		 */
+		template <typename Char, Char... Chars>
+		constexpr upath_literal<sizeof...(Chars)> operator""_up()
+		{
+			static_assert(sizeof(Char) == 1, "path literals must be narrow strings");
+			constexpr upath_literal<sizeof...(Chars)> result{ detail::literal_chars<Char, Chars...>::value };
+			static_assert(result.error() == nullptr, "the path literal is not a valid upath");
+			return result;
+		}
+#pragma GCC diagnostic pop
+#endif
+	}
+}
+
+#endif
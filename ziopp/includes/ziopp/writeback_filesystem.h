@@ -0,0 +1,254 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ziopp/compose_filesystem.h>
+#include <ziopp/executor.h>
+
+namespace ziopp {
+	namespace detail {
+		class stream_table;
+	}
+
+	/**
+	 * @brief Controls when writeback_filesystem writes pending bytes back.
+	 *
+	 */
+	struct writeback_options {
+		/**
+		 * @brief The largest number of pending bytes. Writes wait for some to be written back once there are this many, 0 for no limit.
+		 *
+		 */
+		uint64_t max_dirty_bytes = 64 * 1024 * 1024;
+		/**
+		 * @brief How long a file stays pending before it is written back, so later writes to it are written back with it.
+		 *
+		 */
+		std::chrono::milliseconds flush_delay{ 100 };
+		/**
+		 * @brief The largest number of files written back at once on work_executor, 0 for no limit.
+		 *
+		 */
+		size_t max_concurrency = 4;
+		/**
+		 * @brief The executor files are written back on, nullptr to write them back one after the other on the background thread.
+		 * Writes waiting for pending bytes to be written back must not be made from its threads.
+		 *
+		 */
+		executor* work_executor = nullptr;
+	};
+
+	/**
+	 * @brief What a writeback_filesystem wrote back.
+	 *
+	 */
+	struct writeback_statistics {
+		/**
+		 * @brief The number of writes made to files opened through the filesystem.
+		 *
+		 */
+		uint64_t writes;
+		/**
+		 * @brief The number of bytes of those writes.
+		 *
+		 */
+		uint64_t written_bytes;
+		/**
+		 * @brief The number of times a file was written back to the inner filesystem.
+		 *
+		 */
+		uint64_t flushes;
+		/**
+		 * @brief The number of bytes written back to the inner filesystem.
+		 *
+		 */
+		uint64_t flushed_bytes;
+		/**
+		 * @brief The number of batches of files written back in the background.
+		 *
+		 */
+		uint64_t batches;
+		/**
+		 * @brief The number of writes that waited for pending bytes to be written back.
+		 *
+		 */
+		uint64_t throttled;
+		/**
+		 * @brief The number of files whose write back failed.
+		 *
+		 */
+		uint64_t errors;
+		/**
+		 * @brief The number of files with pending writes.
+		 *
+		 */
+		size_t dirty_files;
+		/**
+		 * @brief The number of pending bytes.
+		 *
+		 */
+		uint64_t dirty_bytes;
+	};
+
+	/**
+	 * @brief A filesystem that keeps the bytes written to files in memory and writes them to the next filesystem in the background.
+	 *
+	 * Opening a file for writing opens it on the next filesystem, which checks the mode and creates or truncates the file,
+	 * unless the file already has pending writes. Writes then only change a copy of the file in memory and return at once.
+	 * A background thread writes back the files pending for writeback_options::flush_delay, or every file once half of
+	 * writeback_options::max_dirty_bytes are pending, in batches, with io_priority::background.
+	 * A file written many times meanwhile is written back once, whole. Files opened with file_mode::append for writing only
+	 * keep the appended bytes alone, which are appended to the file when written back.
+	 *
+	 * Reads, lengths and stat_many through this filesystem see the pending writes. Timestamps are those of the next filesystem,
+	 * so the write time of a file changes when it is written back. Copying, moving or replacing a file writes it back first. Deleting a file drops
+	 * its pending writes, and later writes through handles to a moved or deleted file are dropped.
+	 *
+	 * A failed write back drops the pending writes of the file, and the error is thrown by the next flush, or sync of the file.
+	 * Changes made to a file with pending writes another way are overwritten. Handles must not outlive this filesystem.
+	 * Streams returned by open_file live until their file is opened through open_file again with the same mode and access, moved or deleted
+	 * through this filesystem, or the filesystem is destroyed. A file keeps its pending version in memory while a stream of it is open.
+	 *
+	 */
+	class writeback_filesystem : public compose_filesystem {
+	public:
+		/**
+		 * @brief Construct a new writeback_filesystem.
+		 *
+		 * @param next The filesystem the writes are written back to. It must outlive this filesystem.
+		 * @param options Controls when pending bytes are written back.
+		 */
+		explicit writeback_filesystem(filesystem& next, const writeback_options& options = writeback_options{});
+
+		/**
+		 * @brief Writes back every pending write then stops the background thread. Errors are ignored, call flush first to see them.
+		 *
+		 */
+		~writeback_filesystem();
+
+		/**
+		 * @brief Waits for every pending write to be written back.
+		 *
+		 * Throws the first error of a write back since the last flush.
+		 */
+		void flush();
+
+		/**
+		 * @brief Writes back the pending writes of a file, or of every file in a directory, on the calling thread, then flushes them to the underlying storage,
+		 * along with the files written back in the background since they were last synced.
+		 *
+		 * Throws the first error of a write back of those files since they were last synced or flushed.
+		 *
+		 * @param path The file or directory.
+		 */
+		void sync(const upath& path);
+
+		/**
+		 * @brief Gets what was written back.
+		 *
+		 * @return writeback_statistics The counters since the filesystem was constructed.
+		 */
+		writeback_statistics statistics() const;
+
+		void move_directory(const upath& src, const upath& dest) override;
+		void delete_directory(const upath& path, bool recursive) override;
+		void delete_directory(const upath& path, bool recursive, std::error_code& error) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite) override;
+		void copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error) override;
+		void replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors) override;
+		void replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors) override;
+		size_t file_length(const upath& path) const override;
+		size_t file_length(const upath& path, std::error_code& error) const override;
+		void move_file(const upath& src, const upath& dest) override;
+		void move_file(const upath& src, const upath& dest, std::error_code& error) override;
+		void delete_file(const upath& path) override;
+		void delete_file(const upath& path, std::error_code& error) override;
+		std::iostream& open_file(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access) override;
+		std::unique_ptr<file_handle> open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error) override;
+
+		std::vector<file_stat> stat_many(const std::vector<upath>& paths) const override;
+		void delete_many(const std::vector<upath>& paths) override;
+	private:
+		struct dirty_file {
+			// The whole file, or the bytes to append to it when append is set. Shared with write backs and readers, so copied before it is changed
+			std::shared_ptr<std::vector<uint8_t>> data;
+			bool append;
+			// The size of the file in the next filesystem when append is set
+			uint64_t base_size;
+			// The file is dirty while the last write back did not include the last write
+			uint64_t version;
+			uint64_t flushed_version;
+			std::chrono::steady_clock::time_point dirtied;
+			// The number of bytes counted in dirty_bytes_, and whether the file is counted in dirty_files_
+			uint64_t counted;
+			bool dirty;
+			size_t handles;
+			bool flushing;
+			// Whether the file was moved or deleted, so writes to it are dropped
+			bool removed;
+		};
+
+		struct snapshot {
+			std::shared_ptr<std::vector<uint8_t>> data;
+			bool append;
+			uint64_t version;
+		};
+
+		class dirty_handle;
+		class snapshot_handle;
+
+		static uint64_t length(const dirty_file& file);
+
+		std::unique_ptr<file_handle> open(const upath& path, file_mode mode, file_access access, std::error_code* error);
+		std::shared_ptr<dirty_file> load(const upath& path, file_mode mode, file_access access, std::error_code* error);
+		size_t write(dirty_file& file, uint64_t offset, const uint8_t* buffer, size_t count, bool append);
+		// The methods below are called with mutex_ held
+		void truncate(dirty_file& file);
+		void touch(dirty_file& file);
+		void account(dirty_file& file);
+		snapshot begin(dirty_file& file);
+		void finish(const std::string& name, const std::shared_ptr<dirty_file>& file, const snapshot& pending, bool durable, std::exception_ptr error);
+		void release(const std::string& name, const std::shared_ptr<dirty_file>& file);
+
+		void run();
+		void write_back(const std::string& name, const snapshot& pending, bool durable);
+		void settle(const std::string& name, bool recursive, bool durable);
+		void forget(const std::string& name, bool recursive, bool removed);
+		void rename_unsynced(const std::string& src, const std::string& dest, bool recursive);
+		void rethrow(const std::string& name, bool recursive);
+
+		const writeback_options options_;
+		mutable std::mutex mutex_;
+		// Wakes the background thread
+		std::condition_variable wake_;
+		// Signals that files were written back
+		std::condition_variable changed_;
+		std::map<std::string, std::shared_ptr<dirty_file>> files_;
+		std::map<std::string, std::exception_ptr> errors_;
+		// Files written back without being flushed to the underlying storage, which sync flushes
+		std::set<std::string> unsynced_;
+		std::unique_ptr<detail::stream_table> streams_;
+		uint64_t dirty_bytes_;
+		size_t dirty_files_;
+		size_t flush_requests_;
+		bool stopping_;
+		uint64_t writes_;
+		uint64_t written_bytes_;
+		uint64_t flushes_;
+		uint64_t flushed_bytes_;
+		uint64_t batches_;
+		uint64_t throttled_;
+		uint64_t error_count_;
+		std::thread flusher_;
+	};
+}
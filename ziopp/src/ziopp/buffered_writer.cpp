@@ -0,0 +1,211 @@
+#include <ziopp/buffered_writer.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace ziopp {
+	buffered_writer::buffered_writer(std::unique_ptr<file_handle> handle, uint64_t offset, const write_options& options) : handle_(std::move(handle)), alignment_(options.alignment), buffer_offset_(offset), filled_(0), written_(0)
+	{
+		if ((alignment_ & (alignment_ - 1)) != 0)
+		{
+			throw std::invalid_argument("alignment must be a power of two");
+		}
+		capacity_ = std::max<size_t>(options.buffer_size, 1);
+		if (alignment_ != 0)
+		{
+			capacity_ = (capacity_ + alignment_ - 1) & ~(alignment_ - 1);
+		}
+		storage_.resize(capacity_ + alignment_);
+		buffer_ = storage_.data();
+		if (alignment_ != 0)
+		{
+			buffer_ += (alignment_ - reinterpret_cast<uintptr_t>(buffer_) % alignment_) % alignment_;
+
+			// The start of the block the first write is in is read so the block can be written whole
+			size_t lead = static_cast<size_t>(offset % alignment_);
+			if (lead > 0)
+			{
+				buffer_offset_ = offset - lead;
+				size_t read = handle_->read_at(buffer_offset_, buffer_, lead);
+				std::memset(buffer_ + read, 0, lead - read);
+				filled_ = lead;
+				written_ = lead;
+			}
+		}
+	}
+
+	buffered_writer::~buffered_writer()
+	{
+		try
+		{
+			write_buffer();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void buffered_writer::write(const uint8_t* data, size_t count)
+	{
+		while (count > 0)
+		{
+			if (filled_ == 0 && alignment_ == 0 && count >= capacity_)
+			{
+				handle_->write_at(buffer_offset_, data, count);
+				buffer_offset_ += count;
+				return;
+			}
+
+			size_t copied = std::min(count, capacity_ - filled_);
+			std::memcpy(buffer_ + filled_, data, copied);
+			filled_ += copied;
+			data += copied;
+			count -= copied;
+			if (filled_ == capacity_)
+			{
+				write_buffer();
+			}
+		}
+	}
+
+	void buffered_writer::write(const std::string& content)
+	{
+		write(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+	}
+
+	void buffered_writer::flush()
+	{
+		write_buffer();
+	}
+
+	void buffered_writer::sync()
+	{
+		write_buffer();
+		handle_->sync();
+	}
+
+	uint64_t buffered_writer::position() const
+	{
+		return buffer_offset_ + filled_;
+	}
+
+	file_handle& buffered_writer::handle()
+	{
+		return *handle_;
+	}
+
+	void buffered_writer::write_buffer()
+	{
+		if (filled_ == written_)
+		{
+			return;
+		}
+		if (alignment_ == 0)
+		{
+			handle_->write_at(buffer_offset_, buffer_, filled_);
+			buffer_offset_ += filled_;
+			filled_ = 0;
+			return;
+		}
+
+		// The whole blocks are written aligned. The bytes of the block the buffer ends in are written alone, which direct I/O
+		// rejects so posix_file_handle writes them through the page cache, and are kept to be written again once the block is whole
+		size_t kept = filled_ & (alignment_ - 1);
+		size_t whole = filled_ - kept;
+		if (whole > 0)
+		{
+			handle_->write_at(buffer_offset_, buffer_, whole);
+		}
+		if (kept > 0)
+		{
+			handle_->write_at(buffer_offset_ + whole, buffer_ + whole, kept);
+		}
+		std::memmove(buffer_, buffer_ + whole, kept);
+		buffer_offset_ += whole;
+		filled_ = kept;
+		written_ = kept;
+	}
+
+	group_appender::group_appender(std::unique_ptr<file_handle> handle, const append_options& options) : handle_(std::move(handle)), options_(options), end_(handle_->size()), open_batch_(1), written_batch_(0),
+		open_error_(std::make_shared<std::exception_ptr>()), writing_(false), batches_(0), appends_(0)
+	{
+	}
+
+	void group_appender::append(const uint8_t* data, size_t count)
+	{
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		pending_.insert(pending_.end(), data, data + count);
+		appends_++;
+
+		uint64_t batch = open_batch_;
+		std::shared_ptr<std::exception_ptr> error = open_error_;
+		while (written_batch_ < batch)
+		{
+			if (writing_)
+			{
+				written_.wait(lock);
+				continue;
+			}
+
+			// Nothing is being written, so this thread writes everything pending, its own append included
+			writing_ = true;
+			std::vector<uint8_t> contents;
+			contents.swap(pending_);
+			uint64_t number = open_batch_++;
+			std::shared_ptr<std::exception_ptr> result = open_error_;
+			open_error_ = std::make_shared<std::exception_ptr>();
+			uint64_t offset = end_;
+			lock.unlock();
+
+			try
+			{
+				handle_->write_at(offset, contents.data(), contents.size());
+				if (options_.sync)
+				{
+					handle_->sync();
+				}
+			}
+			catch (...)
+			{
+				*result = std::current_exception();
+			}
+
+			lock.lock();
+			// A failed batch leaves no hole, the next one is written where it would have been
+			if (!*result)
+			{
+				end_ += contents.size();
+			}
+			writing_ = false;
+			written_batch_ = number;
+			batches_++;
+			written_.notify_all();
+		}
+		if (*error)
+		{
+			std::rethrow_exception(*error);
+		}
+	}
+
+	void group_appender::append(const std::string& content)
+	{
+		append(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+	}
+
+	void group_appender::sync()
+	{
+		handle_->sync();
+	}
+
+	uint64_t group_appender::batches() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return batches_;
+	}
+
+	uint64_t group_appender::appends() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return appends_;
+	}
+}
@@ -0,0 +1,907 @@
+#include <ziopp/cas_filesystem.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <ziopp/path_entries.h>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	namespace {
+		const char manifest_magic[4] = { 'Z', 'I', 'O', 'C' };
+		const uint8_t manifest_version = 1;
+		const size_t digest_length = 32;
+		const size_t stream_buffer_size = 64 * 1024;
+
+		void require_absolute(const upath& path, const char* message)
+		{
+			if (!path.absolute())
+			{
+				throw std::invalid_argument(message);
+			}
+		}
+
+		// The Gear table only has to look random, but it must never change or chunk boundaries, and so deduplication, change with it
+		const std::array<uint64_t, 256>& gear_table()
+		{
+			static const std::array<uint64_t, 256> table = []() {
+				std::array<uint64_t, 256> values;
+				uint64_t state = 0x5a696f2b2b434443ULL;
+				for (uint64_t& value : values)
+				{
+					state += 0x9e3779b97f4a7c15ULL;
+					uint64_t z = state;
+					z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+					z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+					value = z ^ (z >> 31);
+				}
+				return values;
+			}();
+			return table;
+		}
+
+		size_t log2(size_t value)
+		{
+			size_t bits = 0;
+			while (value > 1)
+			{
+				value >>= 1;
+				++bits;
+			}
+			return bits;
+		}
+
+		// FastCDC: a cut is harder to find before the average size and easier after it, which keeps chunk sizes close to the average.
+		// The Gear hash is shifted left each byte, so its high bits depend on the last 64 bytes and the masks test those.
+		size_t cut_point(const uint8_t* data, size_t size, const cas_options& options)
+		{
+			if (size <= options.min_chunk_size)
+			{
+				return size;
+			}
+			size_t bits = log2(options.average_chunk_size);
+			const uint64_t small_mask = ~0ULL << (64 - (bits + 2));
+			const uint64_t large_mask = ~0ULL << (64 - (bits - 2));
+			const std::array<uint64_t, 256>& gear = gear_table();
+			size_t end = std::min(size, options.max_chunk_size);
+			size_t normal = std::min(end, options.average_chunk_size);
+			uint64_t hash = 0;
+			size_t i = options.min_chunk_size;
+			for (; i < normal; ++i)
+			{
+				hash = (hash << 1) + gear[data[i]];
+				if ((hash & small_mask) == 0)
+				{
+					return i + 1;
+				}
+			}
+			for (; i < end; ++i)
+			{
+				hash = (hash << 1) + gear[data[i]];
+				if ((hash & large_mask) == 0)
+				{
+					return i + 1;
+				}
+			}
+			return end;
+		}
+
+		void write_varint(std::vector<uint8_t>& out, uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				out.push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		uint64_t read_varint(const std::vector<uint8_t>& in, size_t& position)
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (position >= in.size())
+				{
+					break;
+				}
+				uint8_t byte = in[position++];
+				value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+			throw std::ios_base::failure("the manifest is corrupt", std::make_error_code(std::errc::io_error));
+		}
+
+		uint8_t hex_value(char digit)
+		{
+			return static_cast<uint8_t>(digit <= '9' ? digit - '0' : digit - 'a' + 10);
+		}
+
+		std::vector<uint8_t> read_whole(file_handle& handle)
+		{
+			std::vector<uint8_t> content(static_cast<size_t>(handle.size()));
+			size_t read = 0;
+			while (read < content.size())
+			{
+				size_t count = handle.read_at(read, content.data() + read, content.size() - read);
+				if (count == 0)
+				{
+					break;
+				}
+				read += count;
+			}
+			content.resize(read);
+			return content;
+		}
+	}
+
+	struct cas_filesystem::pending_file {
+		explicit pending_file(const upath& path) : path(path), dirty(false), counted(0), detached(false)
+		{
+		}
+
+		std::mutex mutex;
+		const upath path;
+		std::vector<uint8_t> content;
+		bool dirty;
+		// The length last counted in logical_bytes_, replaced when the file is committed again
+		uint64_t counted;
+		// Set once the file is deleted, moved or replaced, so handles still open cannot commit it again
+		bool detached;
+	};
+
+	class cas_filesystem::chunk_cache {
+	public:
+		explicit chunk_cache(size_t capacity) : hits(0), misses(0), capacity_(capacity), size_(0)
+		{
+		}
+
+		std::shared_ptr<const std::vector<uint8_t>> find(const std::string& digest)
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto it = index_.find(digest);
+			if (it == index_.end())
+			{
+				misses++;
+				return nullptr;
+			}
+			hits++;
+			entries_.splice(entries_.begin(), entries_, it->second);
+			return it->second->second;
+		}
+
+		void insert(const std::string& digest, const std::shared_ptr<const std::vector<uint8_t>>& data)
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			if (data->size() > capacity_ || index_.count(digest) != 0)
+			{
+				return;
+			}
+			while (size_ + data->size() > capacity_)
+			{
+				size_ -= entries_.back().second->size();
+				index_.erase(entries_.back().first);
+				entries_.pop_back();
+			}
+			entries_.emplace_front(digest, data);
+			index_[digest] = entries_.begin();
+			size_ += data->size();
+		}
+
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+	private:
+		typedef std::list<std::pair<std::string, std::shared_ptr<const std::vector<uint8_t>>>> entry_list;
+
+		const size_t capacity_;
+		size_t size_;
+		std::mutex mutex_;
+		// Most recently used first
+		entry_list entries_;
+		std::unordered_map<std::string, entry_list::iterator> index_;
+	};
+
+	class cas_filesystem::chunk_handle : public file_handle {
+	public:
+		chunk_handle(const cas_filesystem& owner, manifest contents) : owner_(owner), contents_(std::move(contents))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			size_t read = 0;
+			// The chunk holding offset is the last one starting at or before it
+			auto chunk = std::upper_bound(contents_.chunks.begin(), contents_.chunks.end(), offset, [](uint64_t value, const chunk_ref& ref) {
+				return value < ref.offset;
+			});
+			if (chunk == contents_.chunks.begin())
+			{
+				return 0;
+			}
+			for (--chunk; chunk != contents_.chunks.end() && read < count; ++chunk)
+			{
+				std::shared_ptr<const std::vector<uint8_t>> data = owner_.load_chunk(*chunk);
+				size_t start = static_cast<size_t>(offset + read - chunk->offset);
+				if (start >= data->size())
+				{
+					continue;
+				}
+				size_t take = std::min(count - read, data->size() - start);
+				std::memcpy(buffer + read, data->data() + start, take);
+				read += take;
+			}
+			return read;
+		}
+
+		size_t write_at(uint64_t, const uint8_t*, size_t) override
+		{
+			throw std::ios_base::failure("the file is not open for writing", std::make_error_code(std::errc::bad_file_descriptor));
+		}
+
+		uint64_t size() const override
+		{
+			return contents_.length;
+		}
+
+		void sync() override
+		{
+		}
+	private:
+		const cas_filesystem& owner_;
+		const manifest contents_;
+	};
+
+	class cas_filesystem::pending_handle : public file_handle {
+	public:
+		pending_handle(cas_filesystem& owner, const std::shared_ptr<pending_file>& file, file_access access, bool append)
+			: owner_(owner), file_(file),
+			readable_((access & file_access::read) == file_access::read),
+			writable_((access & file_access::write) == file_access::write),
+			append_(append)
+		{
+		}
+
+		~pending_handle()
+		{
+			if (writable_)
+			{
+				try
+				{
+					owner_.commit(*file_);
+				}
+				catch (const std::exception&)
+				{
+				}
+			}
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			if (!readable_)
+			{
+				throw std::ios_base::failure("the file is not open for reading", std::make_error_code(std::errc::bad_file_descriptor));
+			}
+			std::lock_guard<std::mutex> lock{ file_->mutex };
+			if (offset >= file_->content.size())
+			{
+				return 0;
+			}
+			size_t read = std::min(count, static_cast<size_t>(file_->content.size() - offset));
+			std::memcpy(buffer, file_->content.data() + offset, read);
+			return read;
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			if (!writable_)
+			{
+				throw std::ios_base::failure("the file is not open for writing", std::make_error_code(std::errc::bad_file_descriptor));
+			}
+			std::lock_guard<std::mutex> lock{ file_->mutex };
+			size_t position = append_ ? file_->content.size() : static_cast<size_t>(offset);
+			if (position + count > file_->content.size())
+			{
+				file_->content.resize(position + count);
+			}
+			std::memcpy(file_->content.data() + position, buffer, count);
+			file_->dirty = true;
+			return count;
+		}
+
+		uint64_t size() const override
+		{
+			std::lock_guard<std::mutex> lock{ file_->mutex };
+			return file_->content.size();
+		}
+
+		void sync() override
+		{
+			owner_.commit(*file_);
+		}
+	private:
+		cas_filesystem& owner_;
+		std::shared_ptr<pending_file> file_;
+		bool readable_;
+		bool writable_;
+		bool append_;
+	};
+
+	cas_filesystem::cas_filesystem(filesystem& store, const upath& root, const cas_options& options)
+		: store_(store), root_(root), files_(upath::combine(root, upath{ "files" })), chunks_(upath::combine(root, upath{ "chunks" })), options_(options),
+		cache_(new chunk_cache(options.cache_size)), streams_(new detail::stream_table()), logical_bytes_(0), stored_bytes_(0), chunks_written_(0), chunks_deduplicated_(0), temporaries_(0)
+	{
+		require_absolute(root, "root must be absolute");
+		if (options.average_chunk_size < 256 || (options.average_chunk_size & (options.average_chunk_size - 1)) != 0)
+		{
+			throw std::invalid_argument("average_chunk_size must be a power of two of at least 256");
+		}
+		if (options.min_chunk_size > options.average_chunk_size || options.average_chunk_size > options.max_chunk_size)
+		{
+			throw std::invalid_argument("chunk sizes must satisfy min_chunk_size <= average_chunk_size <= max_chunk_size");
+		}
+		store_.create_directory(files_);
+		store_.create_directory(chunks_);
+	}
+
+	cas_filesystem::~cas_filesystem()
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::exception&)
+		{
+		}
+		streams_->clear();
+	}
+
+	void cas_filesystem::flush()
+	{
+		std::vector<std::shared_ptr<pending_file>> files;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it = pending_.begin(); it != pending_.end();)
+			{
+				std::shared_ptr<pending_file> file = it->second.lock();
+				if (file)
+				{
+					files.push_back(file);
+					++it;
+				}
+				else
+				{
+					it = pending_.erase(it);
+				}
+			}
+		}
+		for (const std::shared_ptr<pending_file>& file : files)
+		{
+			commit(*file);
+		}
+	}
+
+	size_t cas_filesystem::collect_garbage()
+	{
+		std::lock_guard<std::mutex> commit_lock{ commit_mutex_ };
+		std::set<std::string> referenced;
+		for (upath_iterator it = store_.enumerate_paths(files_, "*", search_options::all_directories, search_target::file); it != upath_iterator{}; ++it)
+		{
+			for (const chunk_ref& chunk : read_manifest(*it).chunks)
+			{
+				referenced.insert(chunk.digest);
+			}
+		}
+
+		std::vector<upath> unreferenced;
+		for (upath_iterator it = store_.enumerate_paths(chunks_, "*", search_options::all_directories, search_target::file); it != upath_iterator{}; ++it)
+		{
+			if (referenced.count(it->name()) == 0)
+			{
+				unreferenced.push_back(*it);
+			}
+		}
+		store_.delete_many(unreferenced);
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const upath& chunk : unreferenced)
+		{
+			known_chunks_.erase(chunk.name());
+		}
+		return unreferenced.size();
+	}
+
+	cas_statistics cas_filesystem::statistics() const
+	{
+		cas_statistics result{};
+		result.logical_bytes = logical_bytes_;
+		result.stored_bytes = stored_bytes_;
+		result.chunks_written = chunks_written_;
+		result.chunks_deduplicated = chunks_deduplicated_;
+		result.cache_hits = cache_->hits;
+		result.cache_misses = cache_->misses;
+		return result;
+	}
+
+	upath cas_filesystem::manifest_path(const upath& path) const
+	{
+		require_absolute(path, "path must be absolute");
+		return path.full_name().size() == 1 ? files_ : upath{ files_.full_name() + path.full_name() };
+	}
+
+	upath cas_filesystem::chunk_path(const std::string& digest) const
+	{
+		return upath::combine(upath::combine(chunks_, upath{ digest.substr(0, 2) }), upath{ digest });
+	}
+
+	cas_filesystem::manifest cas_filesystem::read_manifest(const upath& path) const
+	{
+		std::unique_ptr<file_handle> handle = store_.open_handle(path, file_mode::open, file_access::read);
+		std::vector<uint8_t> content = read_whole(*handle);
+		if (content.size() < sizeof(manifest_magic) + 1 || std::memcmp(content.data(), manifest_magic, sizeof(manifest_magic)) != 0 || content[sizeof(manifest_magic)] != manifest_version)
+		{
+			throw std::ios_base::failure("the manifest is corrupt", std::make_error_code(std::errc::io_error));
+		}
+
+		size_t position = sizeof(manifest_magic) + 1;
+		manifest result{};
+		result.length = read_varint(content, position);
+		uint64_t count = read_varint(content, position);
+		uint64_t offset = 0;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			chunk_ref chunk{};
+			chunk.offset = offset;
+			chunk.length = static_cast<size_t>(read_varint(content, position));
+			if (content.size() - position < digest_length)
+			{
+				throw std::ios_base::failure("the manifest is corrupt", std::make_error_code(std::errc::io_error));
+			}
+			chunk.digest = to_hex(std::vector<uint8_t>(content.begin() + position, content.begin() + position + digest_length));
+			position += digest_length;
+			offset += chunk.length;
+			result.chunks.push_back(chunk);
+		}
+		if (offset != result.length)
+		{
+			throw std::ios_base::failure("the manifest is corrupt", std::make_error_code(std::errc::io_error));
+		}
+		return result;
+	}
+
+	void cas_filesystem::write_manifest(const upath& path, const manifest& contents)
+	{
+		std::vector<uint8_t> content(manifest_magic, manifest_magic + sizeof(manifest_magic));
+		content.push_back(manifest_version);
+		write_varint(content, contents.length);
+		write_varint(content, contents.chunks.size());
+		for (const chunk_ref& chunk : contents.chunks)
+		{
+			write_varint(content, chunk.length);
+			for (size_t i = 0; i < digest_length; ++i)
+			{
+				content.push_back(static_cast<uint8_t>(hex_value(chunk.digest[i * 2]) << 4 | hex_value(chunk.digest[i * 2 + 1])));
+			}
+		}
+		std::unique_ptr<file_handle> handle = store_.open_handle(path, file_mode::create, file_access::write);
+		handle->write_at(0, content.data(), content.size());
+		handle->sync();
+	}
+
+	std::shared_ptr<const std::vector<uint8_t>> cas_filesystem::load_chunk(const chunk_ref& chunk) const
+	{
+		std::shared_ptr<const std::vector<uint8_t>> data = cache_->find(chunk.digest);
+		if (data)
+		{
+			return data;
+		}
+		std::unique_ptr<file_handle> handle = store_.open_handle(chunk_path(chunk.digest), file_mode::open, file_access::read);
+		std::shared_ptr<std::vector<uint8_t>> loaded = std::make_shared<std::vector<uint8_t>>(read_whole(*handle));
+		if (loaded->size() != chunk.length)
+		{
+			throw std::ios_base::failure("a chunk does not have the length its manifest expects", std::make_error_code(std::errc::io_error));
+		}
+		if (to_hex(content_hasher::hash(hash_algorithm::blake3, loaded->data(), loaded->size())) != chunk.digest)
+		{
+			throw std::ios_base::failure("a chunk does not match its digest", std::make_error_code(std::errc::io_error));
+		}
+		cache_->insert(chunk.digest, loaded);
+		return loaded;
+	}
+
+	std::shared_ptr<cas_filesystem::pending_file> cas_filesystem::find_pending(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		auto it = pending_.find(path.full_name());
+		return it == pending_.end() ? nullptr : it->second.lock();
+	}
+
+	void cas_filesystem::write_chunk(const upath& stored, const uint8_t* data, size_t length)
+	{
+		// Written beside the chunk then moved, so a failed write does not leave a truncated chunk under its digest.
+		// A temporary left behind is not referred to by any manifest, so collect_garbage deletes it
+		store_.create_directory(stored.directory());
+		upath temporary{ stored.full_name() + "." + std::to_string(temporaries_++) + ".tmp" };
+		{
+			std::unique_ptr<file_handle> handle = store_.open_handle(temporary, file_mode::create, file_access::write);
+			handle->write_at(0, data, length);
+			handle->sync();
+		}
+		std::error_code error;
+		store_.move_file(temporary, stored, error);
+		if (error)
+		{
+			store_.delete_file(temporary, error);
+			// Another commit stored the same chunk first
+			if (store_.file_exists(stored))
+			{
+				return;
+			}
+			throw std::ios_base::failure("a chunk could not be stored", std::make_error_code(std::errc::io_error));
+		}
+		chunks_written_++;
+		stored_bytes_ += length;
+	}
+
+	void cas_filesystem::commit(pending_file& file)
+	{
+		std::lock_guard<std::mutex> file_lock{ file.mutex };
+		if (!file.dirty || file.detached)
+		{
+			return;
+		}
+
+		// Cutting, hashing and writing new chunks take the time, so they are done before commit_mutex_ is taken
+		manifest contents{};
+		contents.length = file.content.size();
+		for (size_t offset = 0; offset < file.content.size();)
+		{
+			const uint8_t* data = file.content.data() + offset;
+			size_t length = cut_point(data, file.content.size() - offset, options_);
+			chunk_ref chunk{ to_hex(content_hasher::hash(hash_algorithm::blake3, data, length)), offset, length };
+
+			bool known;
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				known = known_chunks_.count(chunk.digest) != 0;
+			}
+			upath stored = chunk_path(chunk.digest);
+			bool present = known || store_.file_exists(stored);
+			if (present)
+			{
+				chunks_deduplicated_++;
+			}
+			else
+			{
+				try
+				{
+					write_chunk(stored, data, length);
+					present = true;
+				}
+				catch (const std::ios_base::failure&)
+				{
+					// collect_garbage may have deleted the temporary, the chunk is written again below
+				}
+			}
+			if (!known && present)
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				known_chunks_.insert(chunk.digest);
+			}
+			contents.chunks.push_back(chunk);
+			offset += length;
+		}
+
+		{
+			// collect_garbage forgets the chunks it deletes, so any chunk deleted since it was written is not known and is written again
+			std::lock_guard<std::mutex> commit_lock{ commit_mutex_ };
+			for (const chunk_ref& chunk : contents.chunks)
+			{
+				{
+					std::lock_guard<std::mutex> lock{ mutex_ };
+					if (known_chunks_.count(chunk.digest) != 0)
+					{
+						continue;
+					}
+				}
+				upath stored = chunk_path(chunk.digest);
+				if (!store_.file_exists(stored))
+				{
+					write_chunk(stored, file.content.data() + chunk.offset, chunk.length);
+				}
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				known_chunks_.insert(chunk.digest);
+			}
+			write_manifest(manifest_path(file.path), contents);
+		}
+		logical_bytes_ += contents.length;
+		logical_bytes_ -= file.counted;
+		file.counted = contents.length;
+		file.dirty = false;
+	}
+
+	void cas_filesystem::commit(const upath& path)
+	{
+		std::shared_ptr<pending_file> file = find_pending(path);
+		if (file)
+		{
+			commit(*file);
+		}
+	}
+
+	void cas_filesystem::forget(const upath& path, bool recursive)
+	{
+		std::vector<std::shared_ptr<pending_file>> files;
+		std::vector<std::shared_ptr<std::iostream>> streams;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			const std::string& name = path.full_name();
+			for (auto it : find_path_entries(pending_, name, recursive))
+			{
+				std::shared_ptr<pending_file> file = it->second.lock();
+				if (file)
+				{
+					files.push_back(file);
+				}
+				pending_.erase(it);
+			}
+			streams = streams_->take(name, recursive);
+		}
+		// Detached before the streams are destroyed, since destroying them closes their handles, which would commit
+		for (const std::shared_ptr<pending_file>& file : files)
+		{
+			std::lock_guard<std::mutex> lock{ file->mutex };
+			file->detached = true;
+		}
+	}
+
+	void cas_filesystem::create_directory(const upath& path)
+	{
+		store_.create_directory(manifest_path(path));
+	}
+
+	bool cas_filesystem::directory_exists(const upath& path) const
+	{
+		return path.absolute() && store_.directory_exists(manifest_path(path));
+	}
+
+	void cas_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		flush();
+		store_.move_directory(manifest_path(src), manifest_path(dest));
+		forget(src, true);
+	}
+
+	void cas_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		store_.delete_directory(manifest_path(path), recursive);
+		forget(path, true);
+	}
+
+	void cas_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		commit(src);
+		store_.copy_file(manifest_path(src), manifest_path(dest), overwrite);
+		forget(dest, false);
+	}
+
+	void cas_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		commit(src);
+		commit(dest);
+		store_.replace_file(manifest_path(src), manifest_path(dest), desk_backup.empty() ? upath{} : manifest_path(desk_backup), ignore_metadata_errors);
+		forget(src, false);
+		forget(dest, false);
+		if (!desk_backup.empty())
+		{
+			forget(desk_backup, false);
+		}
+	}
+
+	void cas_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		replace_file(src, dest, upath{}, ignore_metadata_errors);
+	}
+
+	size_t cas_filesystem::file_length(const upath& path) const
+	{
+		std::shared_ptr<pending_file> file = find_pending(path);
+		if (file)
+		{
+			std::lock_guard<std::mutex> lock{ file->mutex };
+			return file->content.size();
+		}
+		return static_cast<size_t>(read_manifest(manifest_path(path)).length);
+	}
+
+	bool cas_filesystem::file_exists(const upath& path) const
+	{
+		return path.absolute() && store_.file_exists(manifest_path(path));
+	}
+
+	void cas_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		commit(src);
+		store_.move_file(manifest_path(src), manifest_path(dest));
+		forget(src, false);
+		forget(dest, false);
+	}
+
+	void cas_filesystem::delete_file(const upath& path)
+	{
+		store_.delete_file(manifest_path(path));
+		forget(path, false);
+	}
+
+	std::iostream& cas_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(open_handle(path, mode, access), mode == file_mode::append));
+	}
+
+	std::unique_ptr<file_handle> cas_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		upath stored = manifest_path(path);
+		if (store_.directory_exists(stored))
+		{
+			throw std::ios_base::failure("the path is a directory", std::make_error_code(std::errc::is_a_directory));
+		}
+
+		std::shared_ptr<pending_file> file = find_pending(path);
+		bool exists = file || store_.file_exists(stored);
+		switch (mode)
+		{
+			case file_mode::create_new:
+				if (exists)
+				{
+					throw std::ios_base::failure("the file already exists", std::make_error_code(std::errc::file_exists));
+				}
+				break;
+			case file_mode::open:
+			case file_mode::truncate:
+				if (!exists)
+				{
+					throw std::ios_base::failure("the file does not exist", std::make_error_code(std::errc::no_such_file_or_directory));
+				}
+				break;
+			default:
+				break;
+		}
+		if (!exists)
+		{
+			if (!store_.directory_exists(stored.directory()))
+			{
+				throw std::ios_base::failure("the directory of the file does not exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			}
+			// Written now so the file exists while it is being written
+			std::lock_guard<std::mutex> commit_lock{ commit_mutex_ };
+			write_manifest(stored, manifest{ 0, {} });
+		}
+
+		bool truncate = exists && (mode == file_mode::create || mode == file_mode::truncate);
+		if ((access & file_access::write) != file_access::write && !truncate)
+		{
+			if (file)
+			{
+				return std::unique_ptr<file_handle>(new pending_handle(*this, file, access, false));
+			}
+			return std::unique_ptr<file_handle>(new chunk_handle(*this, read_manifest(stored)));
+		}
+
+		if (!file)
+		{
+			std::shared_ptr<pending_file> created = std::make_shared<pending_file>(path);
+			if (exists && !truncate)
+			{
+				for (const chunk_ref& chunk : read_manifest(stored).chunks)
+				{
+					std::shared_ptr<const std::vector<uint8_t>> data = load_chunk(chunk);
+					created->content.insert(created->content.end(), data->begin(), data->end());
+				}
+			}
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			std::weak_ptr<pending_file>& entry = pending_[path.full_name()];
+			file = entry.lock();
+			if (!file)
+			{
+				file = created;
+				entry = created;
+			}
+		}
+		if (truncate)
+		{
+			std::lock_guard<std::mutex> lock{ file->mutex };
+			file->content.clear();
+			file->dirty = true;
+		}
+		return std::unique_ptr<file_handle>(new pending_handle(*this, file, access, mode == file_mode::append));
+	}
+
+	const std::chrono::system_clock::time_point& cas_filesystem::creation_time(const upath& path) const
+	{
+		return store_.creation_time(manifest_path(path));
+	}
+
+	void cas_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		// Committing rewrites the manifest, so it is done first
+		commit(path);
+		store_.creation_time(manifest_path(path), time);
+	}
+
+	const std::chrono::system_clock::time_point& cas_filesystem::access_time(const upath& path) const
+	{
+		return store_.access_time(manifest_path(path));
+	}
+
+	void cas_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		commit(path);
+		store_.access_time(manifest_path(path), time);
+	}
+
+	const std::chrono::system_clock::time_point& cas_filesystem::write_time(const upath& path) const
+	{
+		return store_.write_time(manifest_path(path));
+	}
+
+	void cas_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		commit(path);
+		store_.write_time(manifest_path(path), time);
+	}
+
+	const upath_iterator cas_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		// Paths are mapped back out of the files directory up front, like memory_filesystem collects its matches
+		std::shared_ptr<std::vector<upath>> matches = std::make_shared<std::vector<upath>>();
+		size_t prefix = files_.full_name().size();
+		for (upath_iterator it = store_.enumerate_paths(manifest_path(path), search_pattern, options, target); it != upath_iterator{}; ++it)
+		{
+			matches->push_back(upath{ it->full_name().substr(prefix) });
+		}
+
+		std::shared_ptr<size_t> index = std::make_shared<size_t>(0);
+		return upath_iterator{ [matches, index]() -> const upath* {
+			return *index < matches->size() ? &matches->at((*index)++) : nullptr;
+		} };
+	}
+
+	bool cas_filesystem::can_watch(const upath&) const
+	{
+		return false;
+	}
+
+	const filesystem_watcher& cas_filesystem::watch(const upath&)
+	{
+		throw std::ios_base::failure("watching is not supported by the content addressed filesystem", std::make_error_code(std::errc::operation_not_supported));
+	}
+
+	const std::string cas_filesystem::path_to_internal(const upath& path) const
+	{
+		return store_.path_to_internal(manifest_path(path));
+	}
+
+	const upath& cas_filesystem::path_from_internal(const std::string& system_path) const
+	{
+		const upath& stored = store_.path_from_internal(system_path);
+		const std::string& files = files_.full_name();
+		if (stored.full_name().compare(0, files.size(), files) != 0 || (stored.full_name().size() > files.size() && stored.full_name()[files.size()] != upath::directory_seperator))
+		{
+			throw std::invalid_argument("system_path is not a path of this filesystem");
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		auto it = internal_paths_.find(system_path);
+		if (it == internal_paths_.end())
+		{
+			std::string name = stored.full_name().substr(files.size());
+			it = internal_paths_.insert(std::make_pair(system_path, upath{ name.empty() ? std::string(1, upath::directory_seperator) : name })).first;
+		}
+		return it->second;
+	}
+}
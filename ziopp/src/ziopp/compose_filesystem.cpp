@@ -0,0 +1,187 @@
+#include <ziopp/compose_filesystem.h>
+
+namespace ziopp {
+	compose_filesystem::compose_filesystem(filesystem& next) : next_(next)
+	{
+	}
+
+	filesystem& compose_filesystem::next_filesystem() const
+	{
+		return next_;
+	}
+
+	void compose_filesystem::create_directory(const upath& path)
+	{
+		next_.create_directory(path);
+	}
+
+	void compose_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		next_.create_directory(path, error);
+	}
+
+	bool compose_filesystem::directory_exists(const upath& path) const
+	{
+		return next_.directory_exists(path);
+	}
+
+	void compose_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		next_.move_directory(src, dest);
+	}
+
+	void compose_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		next_.delete_directory(path, recursive);
+	}
+
+	void compose_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		next_.delete_directory(path, recursive, error);
+	}
+
+	void compose_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		next_.copy_file(src, dest, overwrite);
+	}
+
+	void compose_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		next_.copy_file(src, dest, overwrite, error);
+	}
+
+	void compose_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		next_.replace_file(src, dest, desk_backup, ignore_metadata_errors);
+	}
+
+	void compose_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		next_.replace_file(src, dest, ignore_metadata_errors);
+	}
+
+	size_t compose_filesystem::file_length(const upath& path) const
+	{
+		return next_.file_length(path);
+	}
+
+	size_t compose_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		return next_.file_length(path, error);
+	}
+
+	bool compose_filesystem::file_exists(const upath& path) const
+	{
+		return next_.file_exists(path);
+	}
+
+	void compose_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		next_.move_file(src, dest);
+	}
+
+	void compose_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		next_.move_file(src, dest, error);
+	}
+
+	void compose_filesystem::delete_file(const upath& path)
+	{
+		next_.delete_file(path);
+	}
+
+	void compose_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		next_.delete_file(path, error);
+	}
+
+	std::iostream& compose_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		return next_.open_file(path, mode, access);
+	}
+
+	std::unique_ptr<file_handle> compose_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		return next_.open_handle(path, mode, access);
+	}
+
+	std::unique_ptr<file_handle> compose_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		return next_.open_handle(path, mode, access, error);
+	}
+
+	const std::chrono::system_clock::time_point& compose_filesystem::creation_time(const upath& path) const
+	{
+		return next_.creation_time(path);
+	}
+
+	void compose_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		next_.creation_time(path, time);
+	}
+
+	const std::chrono::system_clock::time_point& compose_filesystem::access_time(const upath& path) const
+	{
+		return next_.access_time(path);
+	}
+
+	void compose_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		next_.access_time(path, time);
+	}
+
+	const std::chrono::system_clock::time_point& compose_filesystem::write_time(const upath& path) const
+	{
+		return next_.write_time(path);
+	}
+
+	void compose_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		next_.write_time(path, time);
+	}
+
+	const upath_iterator compose_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		return next_.enumerate_paths(path, search_pattern, options, target);
+	}
+
+	bool compose_filesystem::can_watch(const upath& path) const
+	{
+		return next_.can_watch(path);
+	}
+
+	const filesystem_watcher& compose_filesystem::watch(const upath& path)
+	{
+		return next_.watch(path);
+	}
+
+	const std::string compose_filesystem::path_to_internal(const upath& path) const
+	{
+		return next_.path_to_internal(path);
+	}
+
+	const upath& compose_filesystem::path_from_internal(const std::string& system_path) const
+	{
+		return next_.path_from_internal(system_path);
+	}
+
+	std::vector<file_stat> compose_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		return next_.stat_many(paths);
+	}
+
+	std::vector<bool> compose_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		return next_.exists_many(paths);
+	}
+
+	void compose_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		next_.delete_many(paths);
+	}
+
+	void compose_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		next_.create_directories(paths);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,816 @@
+#include <ziopp/content_hash.h>
+#include <ziopp/filesystem.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZIOPP_BLAKE3_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ziopp {
+	namespace {
+		const size_t hash_buffer_size = 1024 * 1024;
+
+		uint32_t load32(const uint8_t* data)
+		{
+			return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+		}
+
+		uint64_t load64(const uint8_t* data)
+		{
+			return static_cast<uint64_t>(load32(data)) | static_cast<uint64_t>(load32(data + 4)) << 32;
+		}
+
+		uint32_t rotr32(uint32_t value, int count)
+		{
+			return (value >> count) | (value << (32 - count));
+		}
+
+		uint64_t rotl64(uint64_t value, int count)
+		{
+			return (value << count) | (value >> (64 - count));
+		}
+
+		const uint32_t sha256_iv[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+		};
+
+		class hash_function {
+		public:
+			virtual ~hash_function() = default;
+			virtual void update(const uint8_t* data, size_t count) = 0;
+			virtual std::vector<uint8_t> finish() = 0;
+		};
+
+		class xxh64_state : public hash_function {
+		public:
+			xxh64_state() : accumulators_{ prime1 + prime2, prime2, 0, 0 - prime1 }, buffered_(0), total_(0)
+			{
+			}
+
+			void update(const uint8_t* data, size_t count) override
+			{
+				total_ += count;
+				if (buffered_ > 0)
+				{
+					size_t take = std::min(count, sizeof(buffer_) - buffered_);
+					std::memcpy(buffer_ + buffered_, data, take);
+					buffered_ += take;
+					data += take;
+					count -= take;
+					if (buffered_ < sizeof(buffer_))
+					{
+						return;
+					}
+					consume(buffer_);
+					buffered_ = 0;
+				}
+				for (; count >= sizeof(buffer_); data += sizeof(buffer_), count -= sizeof(buffer_))
+				{
+					consume(data);
+				}
+				std::memcpy(buffer_, data, count);
+				buffered_ = count;
+			}
+
+			std::vector<uint8_t> finish() override
+			{
+				uint64_t hash;
+				if (total_ >= sizeof(buffer_))
+				{
+					hash = rotl64(accumulators_[0], 1) + rotl64(accumulators_[1], 7) + rotl64(accumulators_[2], 12) + rotl64(accumulators_[3], 18);
+					for (uint64_t accumulator : accumulators_)
+					{
+						hash = (hash ^ round(0, accumulator)) * prime1 + prime4;
+					}
+				}
+				else
+				{
+					hash = prime5;
+				}
+				hash += total_;
+
+				const uint8_t* tail = buffer_;
+				size_t count = buffered_;
+				for (; count >= 8; tail += 8, count -= 8)
+				{
+					hash = rotl64(hash ^ round(0, load64(tail)), 27) * prime1 + prime4;
+				}
+				if (count >= 4)
+				{
+					hash = rotl64(hash ^ (load32(tail) * prime1), 23) * prime2 + prime3;
+					tail += 4;
+					count -= 4;
+				}
+				for (; count > 0; ++tail, --count)
+				{
+					hash = rotl64(hash ^ (*tail * prime5), 11) * prime1;
+				}
+				hash ^= hash >> 33;
+				hash *= prime2;
+				hash ^= hash >> 29;
+				hash *= prime3;
+				hash ^= hash >> 32;
+
+				// The canonical form of the digest is big endian
+				std::vector<uint8_t> digest(8);
+				for (size_t i = 0; i < 8; ++i)
+				{
+					digest[i] = static_cast<uint8_t>(hash >> (56 - i * 8));
+				}
+				return digest;
+			}
+		private:
+			static const uint64_t prime1 = 11400714785074694791ULL;
+			static const uint64_t prime2 = 14029467366897019727ULL;
+			static const uint64_t prime3 = 1609587929392839161ULL;
+			static const uint64_t prime4 = 9650029242287828579ULL;
+			static const uint64_t prime5 = 2870177450012600261ULL;
+
+			static uint64_t round(uint64_t accumulator, uint64_t input)
+			{
+				return rotl64(accumulator + input * prime2, 31) * prime1;
+			}
+
+			void consume(const uint8_t* stripe)
+			{
+				for (size_t i = 0; i < 4; ++i)
+				{
+					accumulators_[i] = round(accumulators_[i], load64(stripe + i * 8));
+				}
+			}
+
+			uint64_t accumulators_[4];
+			uint8_t buffer_[32];
+			size_t buffered_;
+			uint64_t total_;
+		};
+
+		class sha256_state : public hash_function {
+		public:
+			sha256_state() : buffered_(0), total_(0)
+			{
+				std::memcpy(hash_, sha256_iv, sizeof(hash_));
+			}
+
+			void update(const uint8_t* data, size_t count) override
+			{
+				total_ += count;
+				if (buffered_ > 0)
+				{
+					size_t take = std::min(count, sizeof(buffer_) - buffered_);
+					std::memcpy(buffer_ + buffered_, data, take);
+					buffered_ += take;
+					data += take;
+					count -= take;
+					if (buffered_ < sizeof(buffer_))
+					{
+						return;
+					}
+					compress(buffer_);
+					buffered_ = 0;
+				}
+				for (; count >= sizeof(buffer_); data += sizeof(buffer_), count -= sizeof(buffer_))
+				{
+					compress(data);
+				}
+				std::memcpy(buffer_, data, count);
+				buffered_ = count;
+			}
+
+			std::vector<uint8_t> finish() override
+			{
+				uint64_t bits = total_ * 8;
+				uint8_t padding[72] = { 0x80 };
+				size_t padding_length = (buffered_ < 56 ? 56 : 120) - buffered_;
+				for (size_t i = 0; i < 8; ++i)
+				{
+					padding[padding_length + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+				}
+				update(padding, padding_length + 8);
+
+				std::vector<uint8_t> digest(32);
+				for (size_t i = 0; i < 32; ++i)
+				{
+					digest[i] = static_cast<uint8_t>(hash_[i / 4] >> (24 - (i % 4) * 8));
+				}
+				return digest;
+			}
+		private:
+			void compress(const uint8_t* block)
+			{
+				static const uint32_t k[64] = {
+					0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+					0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+					0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+					0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+					0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+					0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+					0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+					0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+				};
+
+				uint32_t w[64];
+				for (size_t i = 0; i < 16; ++i)
+				{
+					w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 | static_cast<uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+				}
+				for (size_t i = 16; i < 64; ++i)
+				{
+					uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+					uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+					w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+				}
+
+				uint32_t a = hash_[0], b = hash_[1], c = hash_[2], d = hash_[3], e = hash_[4], f = hash_[5], g = hash_[6], h = hash_[7];
+				for (size_t i = 0; i < 64; ++i)
+				{
+					uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+					uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+					h = g;
+					g = f;
+					f = e;
+					e = d + t1;
+					d = c;
+					c = b;
+					b = a;
+					a = t1 + t2;
+				}
+				hash_[0] += a;
+				hash_[1] += b;
+				hash_[2] += c;
+				hash_[3] += d;
+				hash_[4] += e;
+				hash_[5] += f;
+				hash_[6] += g;
+				hash_[7] += h;
+			}
+
+			uint32_t hash_[8];
+			uint8_t buffer_[64];
+			size_t buffered_;
+			uint64_t total_;
+		};
+
+		const size_t blake3_block_size = 64;
+		const size_t blake3_chunk_size = 1024;
+		const uint32_t blake3_chunk_start = 1;
+		const uint32_t blake3_chunk_end = 2;
+		const uint32_t blake3_parent = 4;
+		const uint32_t blake3_root = 8;
+		const size_t blake3_message_permutation[16] = { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 };
+
+		typedef std::array<uint32_t, 8> chaining_value;
+
+		void blake3_g(uint32_t* v, size_t a, size_t b, size_t c, size_t d, uint32_t x, uint32_t y)
+		{
+			v[a] = v[a] + v[b] + x;
+			v[d] = rotr32(v[d] ^ v[a], 16);
+			v[c] = v[c] + v[d];
+			v[b] = rotr32(v[b] ^ v[c], 12);
+			v[a] = v[a] + v[b] + y;
+			v[d] = rotr32(v[d] ^ v[a], 8);
+			v[c] = v[c] + v[d];
+			v[b] = rotr32(v[b] ^ v[c], 7);
+		}
+
+		void blake3_compress(const uint32_t* cv, const uint32_t* block, uint64_t counter, uint32_t block_length, uint32_t flags, uint32_t* out)
+		{
+			uint32_t v[16] = {
+				cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+				sha256_iv[0], sha256_iv[1], sha256_iv[2], sha256_iv[3],
+				static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), block_length, flags
+			};
+			uint32_t m[16];
+			std::memcpy(m, block, sizeof(m));
+			for (size_t round = 0; round < 7; ++round)
+			{
+				blake3_g(v, 0, 4, 8, 12, m[0], m[1]);
+				blake3_g(v, 1, 5, 9, 13, m[2], m[3]);
+				blake3_g(v, 2, 6, 10, 14, m[4], m[5]);
+				blake3_g(v, 3, 7, 11, 15, m[6], m[7]);
+				blake3_g(v, 0, 5, 10, 15, m[8], m[9]);
+				blake3_g(v, 1, 6, 11, 12, m[10], m[11]);
+				blake3_g(v, 2, 7, 8, 13, m[12], m[13]);
+				blake3_g(v, 3, 4, 9, 14, m[14], m[15]);
+				uint32_t permuted[16];
+				for (size_t i = 0; i < 16; ++i)
+				{
+					permuted[i] = m[blake3_message_permutation[i]];
+				}
+				std::memcpy(m, permuted, sizeof(m));
+			}
+			for (size_t i = 0; i < 8; ++i)
+			{
+				out[i] = v[i] ^ v[i + 8];
+				out[i + 8] = v[i + 8] ^ cv[i];
+			}
+		}
+
+		// A node of the tree whose compression has not been done yet, since the root is compressed with different flags
+		struct blake3_output {
+			uint32_t cv[8];
+			uint32_t block[16];
+			uint64_t counter;
+			uint32_t block_length;
+			uint32_t flags;
+
+			chaining_value chain() const
+			{
+				uint32_t out[16];
+				blake3_compress(cv, block, counter, block_length, flags, out);
+				chaining_value value;
+				std::copy(out, out + 8, value.begin());
+				return value;
+			}
+
+			std::vector<uint8_t> root() const
+			{
+				uint32_t out[16];
+				blake3_compress(cv, block, 0, block_length, flags | blake3_root, out);
+				std::vector<uint8_t> digest(32);
+				for (size_t i = 0; i < 32; ++i)
+				{
+					digest[i] = static_cast<uint8_t>(out[i / 4] >> ((i % 4) * 8));
+				}
+				return digest;
+			}
+		};
+
+		blake3_output blake3_parent_output(const chaining_value& left, const chaining_value& right)
+		{
+			blake3_output output;
+			std::copy(sha256_iv, sha256_iv + 8, output.cv);
+			std::copy(left.begin(), left.end(), output.block);
+			std::copy(right.begin(), right.end(), output.block + 8);
+			output.counter = 0;
+			output.block_length = blake3_block_size;
+			output.flags = blake3_parent;
+			return output;
+		}
+
+#ifdef ZIOPP_BLAKE3_SSE2
+		__m128i rotr16(__m128i x)
+		{
+			return _mm_or_si128(_mm_srli_epi32(x, 16), _mm_slli_epi32(x, 16));
+		}
+
+		__m128i rotr12(__m128i x)
+		{
+			return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20));
+		}
+
+		__m128i rotr8(__m128i x)
+		{
+			return _mm_or_si128(_mm_srli_epi32(x, 8), _mm_slli_epi32(x, 24));
+		}
+
+		__m128i rotr7(__m128i x)
+		{
+			return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25));
+		}
+
+		void blake3_g4(__m128i* v, size_t a, size_t b, size_t c, size_t d, __m128i x, __m128i y)
+		{
+			v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), x);
+			v[d] = rotr16(_mm_xor_si128(v[d], v[a]));
+			v[c] = _mm_add_epi32(v[c], v[d]);
+			v[b] = rotr12(_mm_xor_si128(v[b], v[c]));
+			v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), y);
+			v[d] = rotr8(_mm_xor_si128(v[d], v[a]));
+			v[c] = _mm_add_epi32(v[c], v[d]);
+			v[b] = rotr7(_mm_xor_si128(v[b], v[c]));
+		}
+
+		// Hashes four consecutive whole chunks at once, each lane of the vectors holding the state of one chunk
+		void blake3_hash4(const uint8_t* chunks, uint64_t counter, chaining_value* cvs)
+		{
+			__m128i h[8];
+			for (size_t i = 0; i < 8; ++i)
+			{
+				h[i] = _mm_set1_epi32(static_cast<int>(sha256_iv[i]));
+			}
+			const __m128i counter_low = _mm_set_epi32(static_cast<int>(counter + 3), static_cast<int>(counter + 2), static_cast<int>(counter + 1), static_cast<int>(counter));
+			const __m128i counter_high = _mm_set_epi32(static_cast<int>((counter + 3) >> 32), static_cast<int>((counter + 2) >> 32), static_cast<int>((counter + 1) >> 32), static_cast<int>(counter >> 32));
+			for (size_t block = 0; block < blake3_chunk_size / blake3_block_size; ++block)
+			{
+				__m128i m[16];
+				for (size_t i = 0; i < 16; ++i)
+				{
+					const uint8_t* word = chunks + block * blake3_block_size + i * 4;
+					m[i] = _mm_set_epi32(static_cast<int>(load32(word + 3 * blake3_chunk_size)), static_cast<int>(load32(word + 2 * blake3_chunk_size)),
+						static_cast<int>(load32(word + blake3_chunk_size)), static_cast<int>(load32(word)));
+				}
+				uint32_t flags = (block == 0 ? blake3_chunk_start : 0) | (block == blake3_chunk_size / blake3_block_size - 1 ? blake3_chunk_end : 0);
+				__m128i v[16] = {
+					h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+					_mm_set1_epi32(static_cast<int>(sha256_iv[0])), _mm_set1_epi32(static_cast<int>(sha256_iv[1])), _mm_set1_epi32(static_cast<int>(sha256_iv[2])), _mm_set1_epi32(static_cast<int>(sha256_iv[3])),
+					counter_low, counter_high, _mm_set1_epi32(static_cast<int>(blake3_block_size)), _mm_set1_epi32(static_cast<int>(flags))
+				};
+				for (size_t round = 0; round < 7; ++round)
+				{
+					blake3_g4(v, 0, 4, 8, 12, m[0], m[1]);
+					blake3_g4(v, 1, 5, 9, 13, m[2], m[3]);
+					blake3_g4(v, 2, 6, 10, 14, m[4], m[5]);
+					blake3_g4(v, 3, 7, 11, 15, m[6], m[7]);
+					blake3_g4(v, 0, 5, 10, 15, m[8], m[9]);
+					blake3_g4(v, 1, 6, 11, 12, m[10], m[11]);
+					blake3_g4(v, 2, 7, 8, 13, m[12], m[13]);
+					blake3_g4(v, 3, 4, 9, 14, m[14], m[15]);
+					__m128i permuted[16];
+					for (size_t i = 0; i < 16; ++i)
+					{
+						permuted[i] = m[blake3_message_permutation[i]];
+					}
+					std::copy(permuted, permuted + 16, m);
+				}
+				for (size_t i = 0; i < 8; ++i)
+				{
+					h[i] = _mm_xor_si128(v[i], v[i + 8]);
+				}
+			}
+			for (size_t i = 0; i < 8; ++i)
+			{
+				uint32_t lanes[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), h[i]);
+				for (size_t lane = 0; lane < 4; ++lane)
+				{
+					cvs[lane][i] = lanes[lane];
+				}
+			}
+		}
+#endif
+
+		class blake3_state : public hash_function {
+		public:
+			/**
+			 * @param first_chunk The index of the first chunk hashed in the whole content, when this state hashes a subtree of it.
+			 */
+			explicit blake3_state(uint64_t first_chunk = 0) : chunk_counter_(first_chunk), block_length_(0), blocks_compressed_(0), chunks_done_(0)
+			{
+				std::copy(sha256_iv, sha256_iv + 8, chunk_cv_);
+			}
+
+			void update(const uint8_t* data, size_t count) override
+			{
+				while (count > 0)
+				{
+					// A chunk is only finished once more input arrives, since the last chunk of the content is compressed differently
+					if (chunk_length() == blake3_chunk_size)
+					{
+						push_chunk(chunk_output().chain());
+						std::copy(sha256_iv, sha256_iv + 8, chunk_cv_);
+						block_length_ = 0;
+						blocks_compressed_ = 0;
+					}
+#ifdef ZIOPP_BLAKE3_SSE2
+					if (chunk_length() == 0 && count > 4 * blake3_chunk_size)
+					{
+						chaining_value cvs[4];
+						blake3_hash4(data, chunk_counter_, cvs);
+						for (const chaining_value& cv : cvs)
+						{
+							push_chunk(cv);
+						}
+						data += 4 * blake3_chunk_size;
+						count -= 4 * blake3_chunk_size;
+						continue;
+					}
+#endif
+					if (block_length_ == blake3_block_size)
+					{
+						uint32_t words[16];
+						load_block(words);
+						uint32_t out[16];
+						blake3_compress(chunk_cv_, words, chunk_counter_, blake3_block_size, blocks_compressed_ == 0 ? blake3_chunk_start : 0, out);
+						std::copy(out, out + 8, chunk_cv_);
+						++blocks_compressed_;
+						block_length_ = 0;
+					}
+					size_t take = std::min(count, blake3_block_size - block_length_);
+					std::memcpy(block_ + block_length_, data, take);
+					block_length_ += take;
+					data += take;
+					count -= take;
+				}
+			}
+
+			std::vector<uint8_t> finish() override
+			{
+				return output().root();
+			}
+
+			/**
+			 * @brief Gets the chaining value of the subtree hashed, which must be a whole subtree of the content.
+			 */
+			chaining_value subtree() const
+			{
+				return output().chain();
+			}
+		private:
+			size_t chunk_length() const
+			{
+				return blocks_compressed_ * blake3_block_size + block_length_;
+			}
+
+			void load_block(uint32_t* words) const
+			{
+				uint8_t padded[blake3_block_size] = {};
+				std::memcpy(padded, block_, block_length_);
+				for (size_t i = 0; i < 16; ++i)
+				{
+					words[i] = load32(padded + i * 4);
+				}
+			}
+
+			blake3_output chunk_output() const
+			{
+				blake3_output output;
+				std::copy(chunk_cv_, chunk_cv_ + 8, output.cv);
+				load_block(output.block);
+				output.counter = chunk_counter_;
+				output.block_length = static_cast<uint32_t>(block_length_);
+				output.flags = blake3_chunk_end | (blocks_compressed_ == 0 ? blake3_chunk_start : 0);
+				return output;
+			}
+
+			// Merges completed subtrees: after n chunks the stack holds one subtree for each bit set in n
+			void push_chunk(chaining_value cv)
+			{
+				++chunk_counter_;
+				uint64_t total = ++chunks_done_;
+				while ((total & 1) == 0)
+				{
+					cv = blake3_parent_output(stack_.back(), cv).chain();
+					stack_.pop_back();
+					total >>= 1;
+				}
+				stack_.push_back(cv);
+			}
+
+			blake3_output output() const
+			{
+				blake3_output output = chunk_output();
+				for (size_t i = stack_.size(); i > 0; --i)
+				{
+					output = blake3_parent_output(stack_[i - 1], output.chain());
+				}
+				return output;
+			}
+
+			uint32_t chunk_cv_[8];
+			uint64_t chunk_counter_;
+			uint8_t block_[blake3_block_size];
+			size_t block_length_;
+			size_t blocks_compressed_;
+			uint64_t chunks_done_;
+			std::vector<chaining_value> stack_;
+		};
+
+		// The left subtree of a BLAKE3 node holds the largest power of two of its pieces that leaves at least one for the right
+		chaining_value blake3_merge(const std::vector<chaining_value>& pieces, size_t first, size_t count)
+		{
+			if (count == 1)
+			{
+				return pieces[first];
+			}
+			size_t left = 1;
+			while (left * 2 < count)
+			{
+				left *= 2;
+			}
+			return blake3_parent_output(blake3_merge(pieces, first, left), blake3_merge(pieces, first + left, count - left)).chain();
+		}
+
+		std::unique_ptr<hash_function> create_function(hash_algorithm algorithm)
+		{
+			switch (algorithm)
+			{
+			case hash_algorithm::xxh64:
+				return std::unique_ptr<hash_function>(new xxh64_state());
+			case hash_algorithm::sha256:
+				return std::unique_ptr<hash_function>(new sha256_state());
+			case hash_algorithm::blake3:
+				return std::unique_ptr<hash_function>(new blake3_state());
+			}
+			throw std::invalid_argument("unknown hash algorithm");
+		}
+
+		size_t read_fully(file_handle& handle, uint64_t offset, uint8_t* buffer, size_t count)
+		{
+			size_t read = 0;
+			while (read < count)
+			{
+				size_t result = handle.read_at(offset + read, buffer + read, count - read);
+				if (result == 0)
+				{
+					break;
+				}
+				read += result;
+			}
+			return read;
+		}
+
+		// Pieces are whole subtrees of 1024 chunks so their chaining values combine into the same tree as hashing the file in one go
+		std::vector<uint8_t> blake3_parallel(file_handle& handle, uint64_t size, const hash_options& options)
+		{
+			size_t piece_count = static_cast<size_t>((size + hash_buffer_size - 1) / hash_buffer_size);
+			std::vector<chaining_value> pieces(piece_count);
+			work_group group{ options.work_executor != nullptr ? *options.work_executor : thread_pool::shared(), std::max<size_t>(options.max_concurrency, 1) };
+			for (size_t piece = 0; piece < piece_count; ++piece)
+			{
+				group.run([&handle, &pieces, size, piece]() {
+					uint64_t offset = static_cast<uint64_t>(piece) * hash_buffer_size;
+					size_t length = static_cast<size_t>(std::min<uint64_t>(hash_buffer_size, size - offset));
+					std::vector<uint8_t> buffer(length);
+					if (read_fully(handle, offset, buffer.data(), length) != length)
+					{
+						throw std::ios_base::failure("the file changed while it was being hashed", std::make_error_code(std::errc::io_error));
+					}
+					blake3_state state{ offset / blake3_chunk_size };
+					state.update(buffer.data(), length);
+					pieces[piece] = state.subtree();
+				});
+			}
+			group.wait();
+
+			size_t left = 1;
+			while (left * 2 < piece_count)
+			{
+				left *= 2;
+			}
+			return blake3_parent_output(blake3_merge(pieces, 0, left), blake3_merge(pieces, left, piece_count - left)).root();
+		}
+	}
+
+	size_t digest_size(hash_algorithm algorithm)
+	{
+		return algorithm == hash_algorithm::xxh64 ? 8 : 32;
+	}
+
+	std::string to_hex(const std::vector<uint8_t>& digest)
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string hex;
+		hex.reserve(digest.size() * 2);
+		for (uint8_t byte : digest)
+		{
+			hex += digits[byte >> 4];
+			hex += digits[byte & 0xf];
+		}
+		return hex;
+	}
+
+	class content_hasher::state {
+	public:
+		explicit state(std::unique_ptr<hash_function> function) : function(std::move(function))
+		{
+		}
+
+		std::unique_ptr<hash_function> function;
+	};
+
+	content_hasher::content_hasher(hash_algorithm algorithm) : state_(new state{ create_function(algorithm) })
+	{
+	}
+
+	content_hasher::~content_hasher() = default;
+
+	void content_hasher::update(const uint8_t* data, size_t count)
+	{
+		state_->function->update(data, count);
+	}
+
+	std::vector<uint8_t> content_hasher::finish()
+	{
+		return state_->function->finish();
+	}
+
+	std::vector<uint8_t> content_hasher::hash(hash_algorithm algorithm, const uint8_t* data, size_t count)
+	{
+		content_hasher hasher{ algorithm };
+		hasher.update(data, count);
+		return hasher.finish();
+	}
+
+	hash_cache::hash_cache(size_t capacity) : capacity_(std::max<size_t>(capacity, 1))
+	{
+	}
+
+	bool hash_cache::find(const upath& path, hash_algorithm algorithm, uint64_t length, const std::chrono::system_clock::time_point& write_time, std::vector<uint8_t>& digest)
+	{
+		std::string key = path.full_name();
+		key += static_cast<char>(algorithm);
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		auto it = index_.find(key);
+		if (it == index_.end() || it->second->length != length || it->second->write_time != write_time)
+		{
+			return false;
+		}
+		entries_.splice(entries_.begin(), entries_, it->second);
+		digest = it->second->digest;
+		return true;
+	}
+
+	void hash_cache::store(const upath& path, hash_algorithm algorithm, uint64_t length, const std::chrono::system_clock::time_point& write_time, const std::vector<uint8_t>& digest)
+	{
+		std::string key = path.full_name();
+		key += static_cast<char>(algorithm);
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		auto it = index_.find(key);
+		if (it != index_.end())
+		{
+			entries_.splice(entries_.begin(), entries_, it->second);
+			it->second->length = length;
+			it->second->write_time = write_time;
+			it->second->digest = digest;
+			return;
+		}
+		if (entries_.size() == capacity_)
+		{
+			index_.erase(entries_.back().key);
+			entries_.pop_back();
+		}
+		entries_.push_front(entry{ key, length, write_time, digest });
+		index_[key] = entries_.begin();
+	}
+
+	void hash_cache::invalidate(const upath& path)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (hash_algorithm algorithm : { hash_algorithm::xxh64, hash_algorithm::sha256, hash_algorithm::blake3 })
+		{
+			std::string key = path.full_name();
+			key += static_cast<char>(algorithm);
+			auto it = index_.find(key);
+			if (it != index_.end())
+			{
+				entries_.erase(it->second);
+				index_.erase(it);
+			}
+		}
+	}
+
+	void hash_cache::clear()
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		entries_.clear();
+		index_.clear();
+	}
+
+	size_t hash_cache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return entries_.size();
+	}
+
+	// Defined here rather than with the other helpers so the BLAKE3 tree stays private to this file
+	std::vector<uint8_t> filesystem::hash_file(const upath& path, hash_algorithm algorithm, const hash_options& options)
+	{
+		uint64_t length = 0;
+		std::chrono::system_clock::time_point modified{};
+		std::vector<uint8_t> digest;
+		if (options.cache != nullptr)
+		{
+			length = file_length(path);
+			modified = write_time(path);
+			if (options.cache->find(path, algorithm, length, modified, digest))
+			{
+				return digest;
+			}
+		}
+
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read);
+		uint64_t size = handle->size();
+		if (algorithm == hash_algorithm::blake3 && size >= options.parallel_threshold && size > hash_buffer_size)
+		{
+			digest = blake3_parallel(*handle, size, options);
+		}
+		else
+		{
+			content_hasher hasher{ algorithm };
+			std::vector<uint8_t> buffer(static_cast<size_t>(std::max<uint64_t>(std::min<uint64_t>(size, hash_buffer_size), 1)));
+			uint64_t offset = 0;
+			while (true)
+			{
+				size_t read = handle->read_at(offset, buffer.data(), buffer.size());
+				if (read == 0)
+				{
+					break;
+				}
+				hasher.update(buffer.data(), read);
+				offset += read;
+			}
+			digest = hasher.finish();
+		}
+
+		if (options.cache != nullptr)
+		{
+			options.cache->store(path, algorithm, length, modified, digest);
+		}
+		return digest;
+	}
+}
@@ -0,0 +1,510 @@
+#include <ziopp/dentry_cache.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace ziopp {
+	namespace {
+		// The name of the directory a path is in, empty for the root
+		std::string parent_name(const std::string& name)
+		{
+			size_t index = name.find_last_of(upath::directory_seperator);
+			if (index == std::string::npos || name.size() == 1)
+			{
+				return std::string{};
+			}
+			return index == 0 ? name.substr(0, 1) : name.substr(0, index);
+		}
+
+		bool same(const dentry_stamp& left, const dentry_stamp& right)
+		{
+			return left.epoch == right.epoch && left.generation == right.generation;
+		}
+	}
+
+	struct dentry_cache::entry {
+		dentry_stamp stamp;
+		bool has_kind;
+		dentry_kind kind;
+		bool has_system_path;
+		std::string system_path;
+	};
+
+	struct dentry_cache::shard {
+		std::mutex mutex;
+		std::unordered_map<std::string, entry> entries;
+		// Directories never invalidated have generation 0
+		std::unordered_map<std::string, uint64_t> generations;
+	};
+
+	dentry_cache::dentry_cache(const dentry_cache_options& options) : epoch_(0), last_generation_(0), hits_(0), negative_hits_(0), misses_(0)
+	{
+		size_t count = 1;
+		while (count < options.shard_count)
+		{
+			count *= 2;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			shards_.emplace_back(new shard());
+		}
+		max_shard_entries_ = std::max<size_t>(options.max_entries / count, 1);
+	}
+
+	dentry_cache::~dentry_cache()
+	{
+	}
+
+	dentry_cache::shard& dentry_cache::shard_of(const std::string& name) const
+	{
+		return *shards_[std::hash<std::string>{}(name) & (shards_.size() - 1)];
+	}
+
+	uint64_t dentry_cache::generation(const std::string& directory) const
+	{
+		shard& owner = shard_of(directory);
+		std::lock_guard<std::mutex> lock{ owner.mutex };
+		auto found = owner.generations.find(directory);
+		return found == owner.generations.end() ? 0 : found->second;
+	}
+
+	dentry_stamp dentry_cache::stamp(const std::string& name) const
+	{
+		// The epoch is read first, so a stamp taken during invalidate_all is stale
+		uint64_t epoch = epoch_.load(std::memory_order_acquire);
+		return dentry_stamp{ epoch, generation(parent_name(name)) };
+	}
+
+	dentry_stamp dentry_cache::stamp(const upath& path) const
+	{
+		return stamp(path.full_name());
+	}
+
+	bool dentry_cache::find(const upath& path, dentry_kind& kind) const
+	{
+		const std::string& name = path.full_name();
+		dentry_stamp current = stamp(name);
+		shard& owner = shard_of(name);
+		{
+			std::lock_guard<std::mutex> lock{ owner.mutex };
+			auto found = owner.entries.find(name);
+			if (found != owner.entries.end() && found->second.has_kind && same(found->second.stamp, current))
+			{
+				kind = found->second.kind;
+				(kind == dentry_kind::missing ? negative_hits_ : hits_).fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		misses_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	bool dentry_cache::find_internal(const upath& path, std::string& system_path) const
+	{
+		const std::string& name = path.full_name();
+		dentry_stamp current = stamp(name);
+		shard& owner = shard_of(name);
+		{
+			std::lock_guard<std::mutex> lock{ owner.mutex };
+			auto found = owner.entries.find(name);
+			if (found != owner.entries.end() && found->second.has_system_path && same(found->second.stamp, current))
+			{
+				system_path = found->second.system_path;
+				hits_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		misses_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void dentry_cache::insert(const upath& path, const dentry_stamp& stamp, dentry_kind kind)
+	{
+		store(path.full_name(), stamp, &kind, nullptr);
+	}
+
+	void dentry_cache::insert_internal(const upath& path, const dentry_stamp& stamp, const std::string& system_path)
+	{
+		store(path.full_name(), stamp, nullptr, &system_path);
+	}
+
+	void dentry_cache::store(const std::string& name, const dentry_stamp& stamp, const dentry_kind* kind, const std::string* system_path)
+	{
+		// A lookup overtaken by a change would never be used, and could replace a newer entry
+		if (!same(this->stamp(name), stamp))
+		{
+			return;
+		}
+
+		shard& owner = shard_of(name);
+		std::lock_guard<std::mutex> lock{ owner.mutex };
+		auto found = owner.entries.find(name);
+		if (found == owner.entries.end())
+		{
+			if (owner.entries.size() >= max_shard_entries_)
+			{
+				owner.entries.clear();
+			}
+			found = owner.entries.emplace(name, entry{ stamp, false, dentry_kind::missing, false, std::string{} }).first;
+		}
+		else if (!same(found->second.stamp, stamp))
+		{
+			found->second = entry{ stamp, false, dentry_kind::missing, false, std::string{} };
+		}
+
+		if (kind != nullptr)
+		{
+			found->second.has_kind = true;
+			found->second.kind = *kind;
+		}
+		if (system_path != nullptr)
+		{
+			found->second.has_system_path = true;
+			found->second.system_path = *system_path;
+		}
+	}
+
+	void dentry_cache::bump(const std::string& directory)
+	{
+		shard& owner = shard_of(directory);
+		bool full;
+		{
+			std::lock_guard<std::mutex> lock{ owner.mutex };
+			owner.generations[directory] = last_generation_.fetch_add(1, std::memory_order_relaxed) + 1;
+			full = owner.generations.size() > max_shard_entries_;
+		}
+		// Generations can only be forgotten along with every stamp taken from them
+		if (full)
+		{
+			invalidate_all();
+		}
+	}
+
+	void dentry_cache::invalidate(const upath& path)
+	{
+		invalidate(path.full_name(), true);
+	}
+
+	void dentry_cache::invalidate_file(const upath& path)
+	{
+		invalidate(path.full_name(), false);
+	}
+
+	void dentry_cache::invalidate(const std::string& name, bool directory)
+	{
+		bump(parent_name(name));
+		if (directory)
+		{
+			bump(name);
+		}
+
+		shard& owner = shard_of(name);
+		std::lock_guard<std::mutex> lock{ owner.mutex };
+		owner.entries.erase(name);
+	}
+
+	void dentry_cache::invalidate_all()
+	{
+		// Stamps of the previous epoch are stale whatever their generation, so the generations start over with the entries
+		epoch_.fetch_add(1, std::memory_order_acq_rel);
+		for (const std::unique_ptr<shard>& owner : shards_)
+		{
+			std::lock_guard<std::mutex> lock{ owner->mutex };
+			owner->entries.clear();
+			owner->generations.clear();
+		}
+	}
+
+	dentry_cache_statistics dentry_cache::statistics() const
+	{
+		size_t entries = 0;
+		for (const std::unique_ptr<shard>& owner : shards_)
+		{
+			std::lock_guard<std::mutex> lock{ owner->mutex };
+			entries += owner->entries.size();
+		}
+		return dentry_cache_statistics{ hits_.load(std::memory_order_relaxed), negative_hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed), entries };
+	}
+
+	// Invalidates what an operation changes once it is over, whether it failed or not
+	class dentry_cache_filesystem::change_scope {
+	public:
+		enum class extent {
+			// The path only
+			path,
+			// The path only, a file, so there are no entries in it to forget
+			file,
+			// The path and the directories above it, which the operation may have created
+			ancestors,
+			// Everything, since a directory tree changed
+			tree
+		};
+
+		change_scope(dentry_cache& cache, const upath& path, extent what) : cache_(cache), path_(path), what_(what)
+		{
+		}
+
+		~change_scope()
+		{
+			if (what_ == extent::tree)
+			{
+				cache_.invalidate_all();
+				return;
+			}
+			if (what_ == extent::file)
+			{
+				if (!path_.empty())
+				{
+					cache_.invalidate_file(path_);
+				}
+				return;
+			}
+			for (upath path = path_; !path.empty(); path = path.directory())
+			{
+				cache_.invalidate(path);
+				if (what_ == extent::path)
+				{
+					break;
+				}
+			}
+		}
+	private:
+		dentry_cache& cache_;
+		const upath path_;
+		const extent what_;
+	};
+
+	dentry_cache_filesystem::dentry_cache_filesystem(filesystem& next, const dentry_cache_options& options) : compose_filesystem(next), cache_(options)
+	{
+	}
+
+	dentry_cache& dentry_cache_filesystem::cache()
+	{
+		return cache_;
+	}
+
+	void dentry_cache_filesystem::invalidate(const upath& path, bool recursive)
+	{
+		change_scope scope{ cache_, path, recursive ? change_scope::extent::tree : change_scope::extent::ancestors };
+	}
+
+	dentry_kind dentry_cache_filesystem::lookup(const upath& path, dentry_kind expected) const
+	{
+		dentry_kind kind;
+		if (cache_.find(path, kind))
+		{
+			return kind;
+		}
+		// The kind asked about is checked first, the other only when the path is not of that kind
+		dentry_stamp stamp = cache_.stamp(path);
+		dentry_kind other = expected == dentry_kind::file ? dentry_kind::directory : dentry_kind::file;
+		if (exists(path, expected))
+		{
+			kind = expected;
+		}
+		else
+		{
+			kind = exists(path, other) ? other : dentry_kind::missing;
+		}
+		cache_.insert(path, stamp, kind);
+		return kind;
+	}
+
+	bool dentry_cache_filesystem::exists(const upath& path, dentry_kind kind) const
+	{
+		return kind == dentry_kind::file ? compose_filesystem::file_exists(path) : compose_filesystem::directory_exists(path);
+	}
+
+	void dentry_cache_filesystem::create_directory(const upath& path)
+	{
+		change_scope scope{ cache_, path, change_scope::extent::ancestors };
+		compose_filesystem::create_directory(path);
+	}
+
+	void dentry_cache_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		change_scope scope{ cache_, path, change_scope::extent::ancestors };
+		compose_filesystem::create_directory(path, error);
+	}
+
+	bool dentry_cache_filesystem::directory_exists(const upath& path) const
+	{
+		return lookup(path, dentry_kind::directory) == dentry_kind::directory;
+	}
+
+	void dentry_cache_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		change_scope scope{ cache_, src, change_scope::extent::tree };
+		compose_filesystem::move_directory(src, dest);
+	}
+
+	void dentry_cache_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		change_scope scope{ cache_, path, recursive ? change_scope::extent::tree : change_scope::extent::path };
+		compose_filesystem::delete_directory(path, recursive);
+	}
+
+	void dentry_cache_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		change_scope scope{ cache_, path, recursive ? change_scope::extent::tree : change_scope::extent::path };
+		compose_filesystem::delete_directory(path, recursive, error);
+	}
+
+	void dentry_cache_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		change_scope scope{ cache_, dest, change_scope::extent::file };
+		compose_filesystem::copy_file(src, dest, overwrite);
+	}
+
+	void dentry_cache_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		change_scope scope{ cache_, dest, change_scope::extent::file };
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+	}
+
+	void dentry_cache_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		change_scope source{ cache_, src, change_scope::extent::file };
+		change_scope destination{ cache_, dest, change_scope::extent::file };
+		change_scope backup{ cache_, desk_backup, change_scope::extent::file };
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+	}
+
+	void dentry_cache_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		change_scope source{ cache_, src, change_scope::extent::file };
+		change_scope destination{ cache_, dest, change_scope::extent::file };
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+	}
+
+	bool dentry_cache_filesystem::file_exists(const upath& path) const
+	{
+		return lookup(path, dentry_kind::file) == dentry_kind::file;
+	}
+
+	void dentry_cache_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		change_scope source{ cache_, src, change_scope::extent::file };
+		change_scope destination{ cache_, dest, change_scope::extent::file };
+		compose_filesystem::move_file(src, dest);
+	}
+
+	void dentry_cache_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		change_scope source{ cache_, src, change_scope::extent::file };
+		change_scope destination{ cache_, dest, change_scope::extent::file };
+		compose_filesystem::move_file(src, dest, error);
+	}
+
+	void dentry_cache_filesystem::delete_file(const upath& path)
+	{
+		change_scope scope{ cache_, path, change_scope::extent::file };
+		compose_filesystem::delete_file(path);
+	}
+
+	void dentry_cache_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		change_scope scope{ cache_, path, change_scope::extent::file };
+		compose_filesystem::delete_file(path, error);
+	}
+
+	std::iostream& dentry_cache_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		if (mode == file_mode::open)
+		{
+			return compose_filesystem::open_file(path, mode, access);
+		}
+		change_scope scope{ cache_, path, change_scope::extent::file };
+		return compose_filesystem::open_file(path, mode, access);
+	}
+
+	std::unique_ptr<file_handle> dentry_cache_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		if (mode == file_mode::open)
+		{
+			return compose_filesystem::open_handle(path, mode, access);
+		}
+		change_scope scope{ cache_, path, change_scope::extent::file };
+		return compose_filesystem::open_handle(path, mode, access);
+	}
+
+	std::unique_ptr<file_handle> dentry_cache_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		if (mode == file_mode::open)
+		{
+			return compose_filesystem::open_handle(path, mode, access, error);
+		}
+		change_scope scope{ cache_, path, change_scope::extent::file };
+		return compose_filesystem::open_handle(path, mode, access, error);
+	}
+
+	const std::string dentry_cache_filesystem::path_to_internal(const upath& path) const
+	{
+		std::string system_path;
+		if (cache_.find_internal(path, system_path))
+		{
+			return system_path;
+		}
+		dentry_stamp stamp = cache_.stamp(path);
+		system_path = compose_filesystem::path_to_internal(path);
+		cache_.insert_internal(path, stamp, system_path);
+		return system_path;
+	}
+
+	std::vector<bool> dentry_cache_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		std::vector<bool> exists(paths.size());
+		std::vector<size_t> unknown;
+		std::vector<upath> asked;
+		std::vector<dentry_stamp> stamps;
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			dentry_kind kind;
+			if (cache_.find(paths[i], kind))
+			{
+				exists[i] = kind != dentry_kind::missing;
+				continue;
+			}
+			unknown.push_back(i);
+			asked.push_back(paths[i]);
+			stamps.push_back(cache_.stamp(paths[i]));
+		}
+		if (asked.empty())
+		{
+			return exists;
+		}
+
+		// Only what is missing is remembered, existing paths could be files or directories
+		std::vector<bool> found = compose_filesystem::exists_many(asked);
+		for (size_t i = 0; i < unknown.size(); i++)
+		{
+			exists[unknown[i]] = found[i];
+			if (!found[i])
+			{
+				cache_.insert(asked[i], stamps[i], dentry_kind::missing);
+			}
+		}
+		return exists;
+	}
+
+	void dentry_cache_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		std::vector<std::unique_ptr<change_scope>> scopes;
+		for (const upath& path : paths)
+		{
+			scopes.emplace_back(new change_scope(cache_, path, change_scope::extent::path));
+		}
+		compose_filesystem::delete_many(paths);
+	}
+
+	void dentry_cache_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		std::vector<std::unique_ptr<change_scope>> scopes;
+		for (const upath& path : paths)
+		{
+			scopes.emplace_back(new change_scope(cache_, path, change_scope::extent::ancestors));
+		}
+		compose_filesystem::create_directories(paths);
+	}
+}
@@ -0,0 +1,286 @@
+#include <ziopp/executor.h>
+
+namespace ziopp {
+	namespace detail {
+		// Wraps work to run with the io_priority of the calling thread, defined with the priorities in io_scheduler.cpp
+		std::function<void()> with_current_io_priority(std::function<void()> work);
+	}
+
+	void inline_executor::post(std::function<void()> work)
+	{
+		work();
+	}
+
+	namespace {
+		// The pool and queue of the pool thread running on this thread, if any
+		thread_local thread_pool* current_pool = nullptr;
+		thread_local size_t current_index = 0;
+	}
+
+	thread_pool::thread_pool(size_t thread_count) : pending_(0), next_queue_(0), stopping_(false)
+	{
+		if (thread_count == 0)
+		{
+			thread_count = std::thread::hardware_concurrency();
+		}
+		if (thread_count == 0)
+		{
+			thread_count = 1;
+		}
+
+		queues_.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			queues_.emplace_back(new worker_queue());
+		}
+		threads_.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			threads_.emplace_back(&thread_pool::run, this, i);
+		}
+	}
+
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			stopping_ = true;
+		}
+		available_.notify_all();
+		for (std::thread& thread : threads_)
+		{
+			thread.join();
+		}
+	}
+
+	void thread_pool::post(std::function<void()> work)
+	{
+		if (current_pool == this)
+		{
+			worker_queue& queue = *queues_[current_index];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			queue.work.push_back(std::move(work));
+		}
+		else
+		{
+			worker_queue& queue = *queues_[next_queue_.fetch_add(1) % queues_.size()];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			queue.work.push_front(std::move(work));
+		}
+		pending_.fetch_add(1);
+
+		// Taking the lock orders the notification after a worker that saw no pending work has started waiting
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+		}
+		available_.notify_one();
+	}
+
+	size_t thread_pool::size() const
+	{
+		return threads_.size();
+	}
+
+	thread_pool& thread_pool::shared()
+	{
+		static thread_pool pool{};
+		return pool;
+	}
+
+	bool thread_pool::try_take(size_t index, std::function<void()>& work)
+	{
+		{
+			worker_queue& own = *queues_[index];
+			std::lock_guard<std::mutex> lock{ own.mutex };
+			if (!own.work.empty())
+			{
+				work = std::move(own.work.back());
+				own.work.pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < queues_.size(); i++)
+		{
+			worker_queue& other = *queues_[(index + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock{ other.mutex };
+			if (!other.work.empty())
+			{
+				work = std::move(other.work.front());
+				other.work.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void thread_pool::run(size_t index)
+	{
+		current_pool = this;
+		current_index = index;
+		for (;;)
+		{
+			std::function<void()> work;
+			if (try_take(index, work))
+			{
+				pending_.fetch_sub(1);
+				work();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			if (pending_.load() > 0)
+			{
+				// Work is being queued or was just taken by another thread
+				continue;
+			}
+			if (stopping_)
+			{
+				return;
+			}
+			available_.wait(lock, [this]() { return stopping_ || pending_.load() > 0; });
+		}
+	}
+
+	struct work_group::state {
+		explicit state(size_t max_concurrency) : max_concurrency(max_concurrency), running(0), slots(0)
+		{
+		}
+
+		// Takes the oldest queued work when the limit allows another piece to run, the lock must be held
+		bool try_take(std::function<void()>& work)
+		{
+			if (queued.empty() || (max_concurrency != 0 && running >= max_concurrency))
+			{
+				return false;
+			}
+			work = std::move(queued.front());
+			queued.pop_front();
+			running++;
+			return true;
+		}
+
+		// Runs work taken by try_take, the lock must not be held
+		void run_taken(std::function<void()>& work)
+		{
+			bool skip;
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				skip = static_cast<bool>(error);
+			}
+			if (!skip)
+			{
+				try
+				{
+					work();
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock{ mutex };
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+			work = nullptr;
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			running--;
+			changed.notify_all();
+		}
+
+		// Each slot posted to the executor keeps running queued work until there is none left, instead of posting it again
+		void drain()
+		{
+			for (;;)
+			{
+				std::function<void()> work;
+				{
+					std::lock_guard<std::mutex> lock{ mutex };
+					if (!try_take(work))
+					{
+						slots--;
+						return;
+					}
+				}
+				run_taken(work);
+			}
+		}
+
+		const size_t max_concurrency;
+		std::mutex mutex;
+		// Notified when work is queued or finishes
+		std::condition_variable changed;
+		std::deque<std::function<void()>> queued;
+		size_t running;
+		// Slots posted to the executor that have not returned, some may not have started
+		size_t slots;
+		std::exception_ptr error;
+	};
+
+	work_group::work_group(executor& runner, size_t max_concurrency) : runner_(runner), state_(std::make_shared<state>(max_concurrency))
+	{
+	}
+
+	work_group::~work_group()
+	{
+		try
+		{
+			wait();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void work_group::run(std::function<void()> work)
+	{
+		work = detail::with_current_io_priority(std::move(work));
+
+		{
+			std::lock_guard<std::mutex> lock{ state_->mutex };
+			state_->queued.push_back(std::move(work));
+			state_->changed.notify_all();
+			if (state_->max_concurrency != 0 && state_->slots >= state_->max_concurrency)
+			{
+				return;
+			}
+			state_->slots++;
+		}
+		std::shared_ptr<state> shared = state_;
+		runner_.post([shared]() { shared->drain(); });
+	}
+
+	void work_group::wait()
+	{
+		std::unique_lock<std::mutex> lock{ state_->mutex };
+		for (;;)
+		{
+			std::function<void()> work;
+			if (state_->try_take(work))
+			{
+				lock.unlock();
+				state_->run_taken(work);
+				lock.lock();
+				continue;
+			}
+			if (state_->running == 0 && state_->queued.empty())
+			{
+				break;
+			}
+			state_->changed.wait(lock);
+		}
+		if (state_->error)
+		{
+			std::exception_ptr error = state_->error;
+			state_->error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	bool work_group::failed() const
+	{
+		std::lock_guard<std::mutex> lock{ state_->mutex };
+		return static_cast<bool>(state_->error);
+	}
+}
@@ -0,0 +1,582 @@
+#include <ziopp/file_handle.h>
+#include <ziopp/filesystem.h>
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+#ifdef ZIOPP_POSIX
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace ziopp {
+	size_t file_handle::read_vectored(uint64_t offset, const std::vector<io_segment>& segments)
+	{
+		if (segments.size() == 1)
+		{
+			return read_at(offset, segments[0].buffer, segments[0].length);
+		}
+
+		size_t total = 0;
+		for (const io_segment& segment : segments)
+		{
+			total += segment.length;
+		}
+		std::vector<uint8_t> buffer(total);
+		size_t read = total == 0 ? 0 : read_at(offset, buffer.data(), total);
+
+		size_t copied = 0;
+		for (const io_segment& segment : segments)
+		{
+			if (copied >= read)
+			{
+				break;
+			}
+			size_t count = std::min(segment.length, read - copied);
+			std::memcpy(segment.buffer, buffer.data() + copied, count);
+			copied += count;
+		}
+		return read;
+	}
+
+	void file_handle::advise(uint64_t, uint64_t, file_advice)
+	{
+	}
+
+	void file_handle::read_ranges(const std::vector<file_range>& ranges, const std::function<void(size_t, size_t)>& callback, const read_ranges_options& options)
+	{
+		std::vector<size_t> order(ranges.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&ranges](size_t lhs, size_t rhs) {
+			return ranges[lhs].offset < ranges[rhs].offset;
+		});
+
+		// Gaps between ranges are read into a scratch buffer shared by every gap of a read
+		std::vector<uint8_t> scratch;
+		std::vector<io_segment> segments;
+		size_t first = 0;
+		while (first < order.size())
+		{
+			const file_range& head = ranges[order[first]];
+			uint64_t start = head.offset;
+			uint64_t end = head.offset + head.length;
+			segments.clear();
+			segments.push_back(io_segment{ head.buffer, head.length });
+
+			size_t last = first + 1;
+			for (; last < order.size(); last++)
+			{
+				const file_range& next = ranges[order[last]];
+				if (next.offset < end || next.offset - end > options.max_gap || next.offset + next.length - start > options.max_read_size)
+				{
+					break;
+				}
+				size_t gap = static_cast<size_t>(next.offset - end);
+				if (gap > 0)
+				{
+					if (scratch.size() < gap)
+					{
+						scratch.resize(options.max_gap);
+					}
+					segments.push_back(io_segment{ scratch.data(), gap });
+				}
+				segments.push_back(io_segment{ next.buffer, next.length });
+				end = next.offset + next.length;
+			}
+
+			size_t read = end > start ? read_vectored(start, segments) : 0;
+			for (size_t i = first; i < last; i++)
+			{
+				const file_range& range = ranges[order[i]];
+				uint64_t range_start = range.offset - start;
+				size_t filled = read > range_start ? std::min(range.length, static_cast<size_t>(read - range_start)) : 0;
+				callback(order[i], filled);
+			}
+			first = last;
+		}
+	}
+
+	stream_file_handle::stream_file_handle(std::iostream& stream, bool append) : stream_(stream), append_(append)
+	{
+	}
+
+	size_t stream_file_handle::read_at(uint64_t offset, uint8_t* buffer, size_t count)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		stream_.clear();
+		if (!stream_.seekg(static_cast<std::streamoff>(offset)))
+		{
+			stream_.clear();
+			return 0;
+		}
+		stream_.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(count));
+		size_t read = static_cast<size_t>(stream_.gcount());
+		stream_.clear();
+		return read;
+	}
+
+	size_t stream_file_handle::write_at(uint64_t offset, const uint8_t* buffer, size_t count)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		stream_.clear();
+
+		// Streams cannot always seek past their end, so any gap is filled with zeros
+		uint64_t end = size_unlocked();
+		if (append_)
+		{
+			offset = end;
+		}
+		bool written = static_cast<bool>(stream_.seekp(static_cast<std::streamoff>(std::min(offset, end))));
+		for (uint64_t gap = offset > end ? offset - end : 0; written && gap > 0; gap--)
+		{
+			written = static_cast<bool>(stream_.put('\0'));
+		}
+		if (!written || !stream_.write(reinterpret_cast<const char*>(buffer), static_cast<std::streamsize>(count)))
+		{
+			stream_.clear();
+			throw std::ios_base::failure("failed to write to the stream", std::make_error_code(std::errc::io_error));
+		}
+		return count;
+	}
+
+	uint64_t stream_file_handle::size() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return size_unlocked();
+	}
+
+	uint64_t stream_file_handle::size_unlocked() const
+	{
+		std::streambuf* buffer = stream_.rdbuf();
+		std::streampos end = buffer->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+		if (end == std::streampos(std::streamoff(-1)))
+		{
+			end = buffer->pubseekoff(0, std::ios_base::end, std::ios_base::out);
+		}
+		return end == std::streampos(std::streamoff(-1)) ? 0 : static_cast<uint64_t>(std::streamoff(end));
+	}
+
+	void stream_file_handle::sync()
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (!stream_.flush())
+		{
+			stream_.clear();
+			throw std::ios_base::failure("failed to flush the stream", std::make_error_code(std::errc::io_error));
+		}
+	}
+
+	// Reading and writing share one position, like a file. The buffer holds either the bytes read ahead or the bytes not yet written
+	class handle_stream::streambuf : public std::streambuf {
+	public:
+		streambuf(std::unique_ptr<file_handle> handle, bool append) : handle_(std::move(handle)), base_(0), append_(append)
+		{
+			setg(buffer_, buffer_, buffer_);
+			if (append_)
+			{
+				base_ = handle_->size();
+			}
+		}
+
+		~streambuf()
+		{
+			try
+			{
+				write_pending();
+			}
+			catch (const std::exception&)
+			{
+			}
+		}
+	protected:
+		int_type underflow() override
+		{
+			write_pending();
+			if (gptr() < egptr())
+			{
+				return traits_type::to_int_type(*gptr());
+			}
+			base_ += gptr() - eback();
+			size_t read = handle_->read_at(base_, reinterpret_cast<uint8_t*>(buffer_), sizeof(buffer_));
+			setg(buffer_, buffer_, buffer_ + read);
+			return read == 0 ? traits_type::eof() : traits_type::to_int_type(*gptr());
+		}
+
+		std::streamsize xsputn(const char_type* s, std::streamsize count) override
+		{
+			if (pbase() != nullptr && epptr() - pptr() >= count)
+			{
+				std::memcpy(pptr(), s, static_cast<size_t>(count));
+				pbump(static_cast<int>(count));
+				return count;
+			}
+			write_pending();
+			if (static_cast<size_t>(count) < sizeof(buffer_))
+			{
+				start_writing();
+				std::memcpy(pptr(), s, static_cast<size_t>(count));
+				pbump(static_cast<int>(count));
+				return count;
+			}
+
+			// Writes at least as large as the buffer are not copied
+			uint64_t position = tell();
+			setg(buffer_, buffer_, buffer_);
+			handle_->write_at(position, reinterpret_cast<const uint8_t*>(s), static_cast<size_t>(count));
+			base_ = append_ ? handle_->size() : position + static_cast<uint64_t>(count);
+			return count;
+		}
+
+		int_type overflow(int_type c) override
+		{
+			write_pending();
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				return traits_type::not_eof(c);
+			}
+			start_writing();
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+			return c;
+		}
+
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override
+		{
+			write_pending();
+			int64_t origin = direction == std::ios_base::beg ? 0 : direction == std::ios_base::cur ? static_cast<int64_t>(tell()) : static_cast<int64_t>(handle_->size());
+			if (origin + offset < 0)
+			{
+				return pos_type(off_type(-1));
+			}
+			base_ = static_cast<uint64_t>(origin + offset);
+			setg(buffer_, buffer_, buffer_);
+			return pos_type(static_cast<off_type>(base_));
+		}
+
+		pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+		{
+			return seekoff(off_type(position), std::ios_base::beg, which);
+		}
+
+		int sync() override
+		{
+			try
+			{
+				write_pending();
+				handle_->sync();
+				return 0;
+			}
+			catch (const std::exception&)
+			{
+				return -1;
+			}
+		}
+	private:
+		uint64_t tell() const
+		{
+			return pbase() != nullptr ? base_ + static_cast<uint64_t>(pptr() - pbase()) : base_ + static_cast<uint64_t>(gptr() - eback());
+		}
+
+		// Drops what was read ahead and starts buffering writes at the position
+		void start_writing()
+		{
+			base_ = append_ ? handle_->size() : tell();
+			setg(buffer_, buffer_, buffer_);
+			setp(buffer_, buffer_ + sizeof(buffer_));
+		}
+
+		// Writes the buffered bytes, leaving the buffer empty for reads or writes
+		void write_pending()
+		{
+			if (pbase() == nullptr)
+			{
+				return;
+			}
+			size_t count = static_cast<size_t>(pptr() - pbase());
+			setp(nullptr, nullptr);
+			if (count != 0)
+			{
+				handle_->write_at(base_, reinterpret_cast<const uint8_t*>(buffer_), count);
+				base_ = append_ ? handle_->size() : base_ + count;
+			}
+		}
+
+		std::unique_ptr<file_handle> handle_;
+		// The offset in the file of the start of the buffer
+		uint64_t base_;
+		bool append_;
+		char buffer_[64 * 1024];
+	};
+
+	handle_stream::handle_stream(std::unique_ptr<file_handle> handle, bool append) : std::iostream(nullptr), buffer_(new streambuf(std::move(handle), append))
+	{
+		rdbuf(buffer_.get());
+	}
+
+	handle_stream::~handle_stream() = default;
+
+#ifdef ZIOPP_POSIX
+	namespace {
+		[[noreturn]] void throw_errno(const char* message)
+		{
+			throw std::ios_base::failure(message, std::error_code(errno, std::generic_category()));
+		}
+	}
+
+	posix_file_handle::posix_file_handle(int descriptor) : posix_file_handle(descriptor, -1)
+	{
+	}
+
+	posix_file_handle::posix_file_handle(int descriptor, int buffered_descriptor) : descriptor_(descriptor), buffered_descriptor_(buffered_descriptor)
+	{
+	}
+
+	posix_file_handle::~posix_file_handle()
+	{
+		if (descriptor_ >= 0)
+		{
+			::close(descriptor_);
+		}
+		if (buffered_descriptor_ >= 0)
+		{
+			::close(buffered_descriptor_);
+		}
+	}
+
+	std::unique_ptr<posix_file_handle> posix_file_handle::open(const std::string& system_path, file_mode mode, file_access access, bool direct)
+	{
+		int flags = O_CLOEXEC;
+		switch (access)
+		{
+			case file_access::read:
+				flags |= O_RDONLY;
+				break;
+			case file_access::write:
+				flags |= O_WRONLY;
+				break;
+			default:
+				flags |= O_RDWR;
+				break;
+		}
+		switch (mode)
+		{
+			case file_mode::create_new:
+				flags |= O_CREAT | O_EXCL;
+				break;
+			case file_mode::create:
+				flags |= O_CREAT | O_TRUNC;
+				break;
+			case file_mode::open:
+				break;
+			case file_mode::open_or_create:
+				flags |= O_CREAT;
+				break;
+			case file_mode::truncate:
+				flags |= O_TRUNC;
+				break;
+			case file_mode::append:
+				flags |= O_CREAT | O_APPEND;
+				break;
+		}
+
+		int descriptor;
+#ifdef O_DIRECT
+		if (direct)
+		{
+			do
+			{
+				descriptor = ::open(system_path.c_str(), flags | O_DIRECT, 0666);
+			} while (descriptor < 0 && errno == EINTR);
+			if (descriptor >= 0 || errno != EINVAL)
+			{
+				if (descriptor < 0)
+				{
+					throw_errno("failed to open the file");
+				}
+
+				// The file exists now, so the descriptor for transfers that are not aligned neither creates nor truncates it
+				int buffered;
+				do
+				{
+					buffered = ::open(system_path.c_str(), flags & ~(O_CREAT | O_EXCL | O_TRUNC), 0666);
+				} while (buffered < 0 && errno == EINTR);
+				if (buffered < 0)
+				{
+					int error = errno;
+					::close(descriptor);
+					errno = error;
+					throw_errno("failed to open the file");
+				}
+				return std::unique_ptr<posix_file_handle>(new posix_file_handle(descriptor, buffered));
+			}
+		}
+#endif
+		do
+		{
+			descriptor = ::open(system_path.c_str(), flags, 0666);
+		} while (descriptor < 0 && errno == EINTR);
+		if (descriptor < 0)
+		{
+			throw_errno("failed to open the file");
+		}
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+		if (direct)
+		{
+			::fcntl(descriptor, F_NOCACHE, 1);
+		}
+#else
+		(void)direct;
+#endif
+		return std::unique_ptr<posix_file_handle>(new posix_file_handle(descriptor));
+	}
+
+	int posix_file_handle::descriptor() const
+	{
+		return descriptor_;
+	}
+
+	bool posix_file_handle::fall_back(int& descriptor) const
+	{
+		if (errno != EINVAL || descriptor != descriptor_ || buffered_descriptor_ < 0)
+		{
+			return false;
+		}
+		descriptor = buffered_descriptor_;
+		return true;
+	}
+
+	size_t posix_file_handle::read_at(uint64_t offset, uint8_t* buffer, size_t count)
+	{
+		int descriptor = descriptor_;
+		size_t total = 0;
+		while (total < count)
+		{
+			ssize_t read = ::pread(descriptor, buffer + total, count - total, static_cast<off_t>(offset + total));
+			if (read < 0)
+			{
+				if (errno == EINTR || fall_back(descriptor))
+				{
+					continue;
+				}
+				throw_errno("failed to read from the file");
+			}
+			if (read == 0)
+			{
+				break;
+			}
+			total += static_cast<size_t>(read);
+		}
+		return total;
+	}
+
+	size_t posix_file_handle::write_at(uint64_t offset, const uint8_t* buffer, size_t count)
+	{
+		int descriptor = descriptor_;
+		size_t total = 0;
+		while (total < count)
+		{
+			ssize_t written = ::pwrite(descriptor, buffer + total, count - total, static_cast<off_t>(offset + total));
+			if (written < 0)
+			{
+				if (errno == EINTR || fall_back(descriptor))
+				{
+					continue;
+				}
+				throw_errno("failed to write to the file");
+			}
+			total += static_cast<size_t>(written);
+		}
+		return total;
+	}
+
+	uint64_t posix_file_handle::size() const
+	{
+		struct stat status;
+		if (::fstat(descriptor_, &status) != 0)
+		{
+			throw_errno("failed to get the size of the file");
+		}
+		return static_cast<uint64_t>(status.st_size);
+	}
+
+	void posix_file_handle::sync()
+	{
+		if (::fsync(descriptor_) != 0)
+		{
+			throw_errno("failed to sync the file");
+		}
+	}
+
+	size_t posix_file_handle::read_vectored(uint64_t offset, const std::vector<io_segment>& segments)
+	{
+#ifdef IOV_MAX
+		const size_t max_segments = IOV_MAX;
+#else
+		const size_t max_segments = 1024;
+#endif
+		int descriptor = descriptor_;
+		std::vector<iovec> vectors;
+		size_t total = 0;
+		size_t index = 0;
+		size_t consumed = 0;
+		while (index < segments.size())
+		{
+			vectors.clear();
+			for (size_t i = index; i < segments.size() && vectors.size() < max_segments; i++)
+			{
+				size_t skip = i == index ? consumed : 0;
+				iovec vector;
+				vector.iov_base = segments[i].buffer + skip;
+				vector.iov_len = segments[i].length - skip;
+				vectors.push_back(vector);
+			}
+
+			ssize_t read = ::preadv(descriptor, vectors.data(), static_cast<int>(vectors.size()), static_cast<off_t>(offset + total));
+			if (read < 0)
+			{
+				if (errno == EINTR || fall_back(descriptor))
+				{
+					continue;
+				}
+				throw_errno("failed to read from the file");
+			}
+			if (read == 0)
+			{
+				break;
+			}
+			total += static_cast<size_t>(read);
+
+			// Skip the segments the read filled, remembering how far into a partially filled one it got
+			size_t remaining = static_cast<size_t>(read);
+			while (index < segments.size() && remaining >= segments[index].length - consumed)
+			{
+				remaining -= segments[index].length - consumed;
+				consumed = 0;
+				index++;
+			}
+			consumed += remaining;
+		}
+		return total;
+	}
+
+	void posix_file_handle::advise(uint64_t offset, uint64_t length, file_advice advice)
+	{
+#ifdef POSIX_FADV_NORMAL
+		static const int advices[] = { POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+		// A hint the system rejects changes nothing, so failures are ignored
+		::posix_fadvise(descriptor_, static_cast<off_t>(offset), static_cast<off_t>(length), advices[static_cast<int>(advice)]);
+#else
+		(void)offset;
+		(void)length;
+		(void)advice;
+#endif
+	}
+#endif
+}
\ No newline at end of file
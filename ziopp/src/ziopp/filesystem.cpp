@@ -1,7 +1,267 @@
 #include <ziopp/filesystem.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <system_error>
 #include <type_traits>
 
 namespace ziopp {
+	namespace {
+		const size_t copy_buffer_size = 1024 * 1024;
+
+		void copy_contents(filesystem& src_filesystem, const upath& src, filesystem& dest_filesystem, const upath& dest)
+		{
+			std::unique_ptr<file_handle> source = src_filesystem.open_handle(src, file_mode::open, file_access::read);
+			std::unique_ptr<file_handle> destination = dest_filesystem.open_handle(dest, file_mode::create, file_access::write);
+			std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(source->size(), copy_buffer_size)));
+			uint64_t offset = 0;
+			while (!buffer.empty())
+			{
+				size_t read = source->read_at(offset, buffer.data(), buffer.size());
+				if (read == 0)
+				{
+					break;
+				}
+				destination->write_at(offset, buffer.data(), read);
+				offset += read;
+			}
+		}
+
+		std::vector<upath> list(const filesystem& fs, const upath& directory, search_target target)
+		{
+			std::vector<upath> paths;
+			for (upath_iterator it = fs.enumerate_paths(directory, "*", search_options::top_directory_only, target); it != upath_iterator{}; ++it)
+			{
+				paths.push_back(*it);
+			}
+			return paths;
+		}
+
+		void copy_directory_contents(filesystem& src_filesystem, filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite, work_group& group)
+		{
+			// Each subdirectory is created here, before the work copying its contents is added
+			for (const upath& directory : list(src_filesystem, src, search_target::directory))
+			{
+				upath target = upath::combine(dest, upath{ directory.name() });
+				dest_filesystem.create_directory(target);
+				group.run([&src_filesystem, &dest_filesystem, directory, target, overwrite, &group]() {
+					copy_directory_contents(src_filesystem, dest_filesystem, directory, target, overwrite, group);
+				});
+			}
+			for (const upath& file : list(src_filesystem, src, search_target::file))
+			{
+				upath target = upath::combine(dest, upath{ file.name() });
+				group.run([&src_filesystem, &dest_filesystem, file, target, overwrite]() {
+					src_filesystem.copy_file_cross(dest_filesystem, file, target, overwrite);
+				});
+			}
+		}
+
+		struct delete_node {
+			delete_node(const upath& path, const std::shared_ptr<delete_node>& parent) : path(path), parent(parent), pending(1)
+			{
+			}
+
+			upath path;
+			std::shared_ptr<delete_node> parent;
+			// The work still to finish before the directory is empty: its listing, its batches of files and its subdirectories
+			std::atomic<size_t> pending;
+		};
+
+		void finish(filesystem& fs, std::shared_ptr<delete_node> node, work_group& group)
+		{
+			while (node && --node->pending == 0)
+			{
+				if (group.failed())
+				{
+					return;
+				}
+				fs.delete_directory(node->path, false);
+				node = node->parent;
+			}
+		}
+
+		void delete_directory_contents(filesystem& fs, const std::shared_ptr<delete_node>& node, size_t batch_size, work_group& group)
+		{
+			std::vector<upath> files = list(fs, node->path, search_target::file);
+			std::vector<upath> directories = list(fs, node->path, search_target::directory);
+			for (size_t first = 0; first < files.size(); first += batch_size)
+			{
+				std::vector<upath> batch(files.begin() + first, files.begin() + std::min(files.size(), first + batch_size));
+				node->pending++;
+				group.run([&fs, node, batch, &group]() {
+					fs.delete_many(batch);
+					finish(fs, node, group);
+				});
+			}
+			for (const upath& directory : directories)
+			{
+				std::shared_ptr<delete_node> child = std::make_shared<delete_node>(directory, node);
+				node->pending++;
+				group.run([&fs, child, batch_size, &group]() {
+					delete_directory_contents(fs, child, batch_size, group);
+				});
+			}
+			finish(fs, node, group);
+		}
+
+		void emit_line(const char* data, size_t size, uint64_t offset, const std::function<void(const line_view&)>& callback)
+		{
+			if (size > 0 && data[size - 1] == '\r')
+			{
+				size--;
+			}
+			callback(line_view{ data, size, offset });
+		}
+
+		// Calls callback with each line starting before end, reading from start, which must be the first character of a line
+		void scan_lines(file_handle& handle, uint64_t start, uint64_t end, size_t block_size, const std::function<void(const line_view&)>& callback)
+		{
+			std::vector<char> buffer(std::max<size_t>(block_size, 1));
+			// buffer[0] is at buffer_offset in the file, buffer[line_start, filled) is the line being read and buffer[line_start, searched) has no line break
+			uint64_t buffer_offset = start;
+			size_t filled = 0;
+			size_t line_start = 0;
+			size_t searched = 0;
+			bool end_of_file = false;
+			while (buffer_offset + line_start < end)
+			{
+				const char* found = searched < filled ? static_cast<const char*>(std::memchr(buffer.data() + searched, '\n', filled - searched)) : nullptr;
+				if (found != nullptr)
+				{
+					size_t length = static_cast<size_t>(found - buffer.data()) - line_start;
+					emit_line(buffer.data() + line_start, length, buffer_offset + line_start, callback);
+					line_start += length + 1;
+					searched = line_start;
+					continue;
+				}
+				if (end_of_file)
+				{
+					if (filled > line_start)
+					{
+						emit_line(buffer.data() + line_start, filled - line_start, buffer_offset + line_start, callback);
+					}
+					break;
+				}
+
+				// The partial line is moved to the front, and the buffer grown when the line fills it
+				std::memmove(buffer.data(), buffer.data() + line_start, filled - line_start);
+				filled -= line_start;
+				buffer_offset += line_start;
+				line_start = 0;
+				searched = filled;
+				if (filled == buffer.size())
+				{
+					buffer.resize(buffer.size() * 2);
+				}
+				size_t read = handle.read_at(buffer_offset + filled, reinterpret_cast<uint8_t*>(buffer.data()) + filled, buffer.size() - filled);
+				end_of_file = read == 0;
+				filled += read;
+			}
+		}
+
+		// Gets the offset of the first line starting after offset, or the largest offset when there is none
+		uint64_t next_line_start(file_handle& handle, uint64_t offset, size_t block_size)
+		{
+			std::vector<char> buffer(std::max<size_t>(block_size, 1));
+			while (true)
+			{
+				size_t read = handle.read_at(offset, reinterpret_cast<uint8_t*>(buffer.data()), buffer.size());
+				if (read == 0)
+				{
+					return std::numeric_limits<uint64_t>::max();
+				}
+				const char* found = static_cast<const char*>(std::memchr(buffer.data(), '\n', read));
+				if (found != nullptr)
+				{
+					return offset + static_cast<uint64_t>(found - buffer.data()) + 1;
+				}
+				offset += read;
+			}
+		}
+
+		// Runs a throwing operation, reporting the failure through error instead
+		template <typename Operation>
+		void capture(std::error_code& error, Operation operation)
+		{
+			try
+			{
+				operation();
+				error.clear();
+			}
+			catch (const std::ios_base::failure& failure)
+			{
+				error = failure.code();
+			}
+			catch (const std::system_error& failure)
+			{
+				error = failure.code();
+			}
+			catch (const std::invalid_argument&)
+			{
+				error = std::make_error_code(std::errc::invalid_argument);
+			}
+		}
+
+		// Throws the exception the throwing overloads use for the failure
+		[[noreturn]] void raise(const char* message, const std::error_code& error)
+		{
+			if (error == std::errc::invalid_argument)
+			{
+				throw std::invalid_argument(message);
+			}
+			throw std::ios_base::failure(message, error);
+		}
+
+		const char* fail(std::error_code& error, std::errc reason, const char* message)
+		{
+			error = std::make_error_code(reason);
+			return message;
+		}
+
+		// Checks what copy_file_cross and move_file_cross need before anything is opened, returning the message of the first failure
+		const char* check_cross(const filesystem& src_filesystem, const upath& src, const filesystem& dest_filesystem, const upath& dest, bool overwrite, std::error_code& error)
+		{
+			if (!src.absolute())
+			{
+				return fail(error, std::errc::invalid_argument, "src must be absolute");
+			}
+			if (!src_filesystem.file_exists(src))
+			{
+				return fail(error, std::errc::no_such_file_or_directory, "src file must exist");
+			}
+			if (!dest.absolute())
+			{
+				return fail(error, std::errc::invalid_argument, "dest must be absolute");
+			}
+			if (!dest_filesystem.directory_exists(dest.directory()))
+			{
+				return fail(error, std::errc::no_such_file_or_directory, "dest directory must exist");
+			}
+			if (!overwrite && dest_filesystem.file_exists(dest))
+			{
+				return fail(error, std::errc::file_exists, "the destination file path already exists and overwrite is false");
+			}
+			error.clear();
+			return nullptr;
+		}
+
+		template <typename Container>
+		void read_contents(file_handle& handle, Container& contents)
+		{
+			contents.resize(static_cast<size_t>(handle.size()));
+			if (!contents.empty())
+			{
+				contents.resize(handle.read_at(0, reinterpret_cast<uint8_t*>(&contents[0]), contents.size()));
+			}
+		}
+
+		executor& tree_executor(const tree_options& options)
+		{
+			return options.work_executor != nullptr ? *options.work_executor : thread_pool::shared();
+		}
+	}
 
 	file_access operator | (file_access lhs, file_access rhs)
 	{
@@ -27,6 +287,120 @@ namespace ziopp {
 		return lhs;
 	}
 
+	std::unique_ptr<file_handle> filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		return std::unique_ptr<file_handle>(new stream_file_handle(open_file(path, mode, access), mode == file_mode::append));
+	}
+
+	void filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		capture(error, [this, &path]() {
+			create_directory(path);
+		});
+	}
+
+	void filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		capture(error, [this, &path, recursive]() {
+			delete_directory(path, recursive);
+		});
+	}
+
+	void filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		capture(error, [this, &src, &dest, overwrite]() {
+			copy_file(src, dest, overwrite);
+		});
+	}
+
+	size_t filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		size_t length = 0;
+		capture(error, [this, &path, &length]() {
+			length = file_length(path);
+		});
+		return length;
+	}
+
+	void filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		capture(error, [this, &src, &dest]() {
+			move_file(src, dest);
+		});
+	}
+
+	void filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		capture(error, [this, &path]() {
+			delete_file(path);
+		});
+	}
+
+	std::unique_ptr<file_handle> filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		std::unique_ptr<file_handle> handle;
+		capture(error, [this, &path, mode, access, &handle]() {
+			handle = open_handle(path, mode, access);
+		});
+		return handle;
+	}
+
+	std::vector<file_stat> filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		std::vector<file_stat> stats;
+		stats.reserve(paths.size());
+		for (const upath& path : paths)
+		{
+			file_stat stat{};
+			if (file_exists(path))
+			{
+				stat.exists = true;
+				stat.length = file_length(path);
+			}
+			else if (directory_exists(path))
+			{
+				stat.exists = true;
+				stat.is_directory = true;
+			}
+
+			if (stat.exists)
+			{
+				stat.creation_time = creation_time(path);
+				stat.access_time = access_time(path);
+				stat.write_time = write_time(path);
+			}
+			stats.push_back(stat);
+		}
+		return stats;
+	}
+
+	std::vector<bool> filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		std::vector<bool> exists;
+		exists.reserve(paths.size());
+		for (const upath& path : paths)
+		{
+			exists.push_back(file_exists(path) || directory_exists(path));
+		}
+		return exists;
+	}
+
+	void filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		for (const upath& path : paths)
+		{
+			delete_file(path);
+		}
+	}
+
+	void filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		for (const upath& path : paths)
+		{
+			create_directory(path);
+		}
+	}
+
 	void filesystem::copy_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite)
 	{
 		if (this == &dest_filesystem)
@@ -35,54 +409,83 @@ namespace ziopp {
 			return;
 		}
 
-		if (!src.absolute())
+		std::error_code error;
+		if (const char* message = check_cross(*this, src, dest_filesystem, dest, overwrite, error))
 		{
-			throw std::invalid_argument("src must be absolute");
+			raise(message, error);
 		}
 
-		if (!file_exists(src))
+		copy_contents(*this, src, dest_filesystem, dest);
+		dest_filesystem.write_time(dest, write_time(src));
+	}
+
+	void filesystem::copy_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		if (this == &dest_filesystem)
 		{
-			throw std::ios_base::failure("src file must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			copy_file(src, dest, overwrite, error);
+			return;
 		}
 
-		if (!dest.absolute())
+		if (check_cross(*this, src, dest_filesystem, dest, overwrite, error) != nullptr)
 		{
-			throw std::invalid_argument("dest must be absolute");
+			return;
 		}
 
-		upath dest_directory = dest.directory();
-		if (!dest_filesystem.directory_exists(dest_directory))
+		capture(error, [this, &dest_filesystem, &src, &dest]() {
+			copy_contents(*this, src, dest_filesystem, dest);
+			dest_filesystem.write_time(dest, write_time(src));
+		});
+	}
+
+	void filesystem::move_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest)
+	{
+		if (this == &dest_filesystem)
 		{
-			throw std::ios_base::failure("dest directory must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			move_file(src, dest);
+			return;
 		}
 
-		if (dest_filesystem.file_exists(dest) && !overwrite)
+		std::error_code error;
+		if (const char* message = check_cross(*this, src, dest_filesystem, dest, false, error))
 		{
-			throw std::ios_base::failure("the destination file path already exists and overwrite is false", std::make_error_code(std::errc::file_exists));
+			raise(message, error);
 		}
 
-		std::iostream& source_stream = open_file(src, file_mode::open, file_access::read);
-		std::iostream& dest_stream = dest_filesystem.open_file(dest, file_mode::create, file_access::write);
-		dest_stream << source_stream.rdbuf();
+		copy_contents(*this, src, dest_filesystem, dest);
+		dest_filesystem.creation_time(dest, creation_time(src));
+		dest_filesystem.access_time(dest, access_time(src));
 		dest_filesystem.write_time(dest, write_time(src));
+		delete_file(src);
 	}
 
-	void filesystem::move_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest)
+	void filesystem::move_file_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, std::error_code& error)
 	{
 		if (this == &dest_filesystem)
 		{
-			move_file(src, dest);
+			move_file(src, dest, error);
 			return;
 		}
 
-		if (!src.absolute())
+		if (check_cross(*this, src, dest_filesystem, dest, false, error) != nullptr)
 		{
-			throw std::invalid_argument("src must be absolute");
+			return;
 		}
 
-		if (!file_exists(src))
+		capture(error, [this, &dest_filesystem, &src, &dest]() {
+			copy_contents(*this, src, dest_filesystem, dest);
+			dest_filesystem.creation_time(dest, creation_time(src));
+			dest_filesystem.access_time(dest, access_time(src));
+			dest_filesystem.write_time(dest, write_time(src));
+			delete_file(src);
+		});
+	}
+
+	void filesystem::copy_directory_cross(filesystem& dest_filesystem, const upath& src, const upath& dest, bool overwrite, const tree_options& options)
+	{
+		if (!src.absolute())
 		{
-			throw std::ios_base::failure("src file must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			throw std::invalid_argument("src must be absolute");
 		}
 
 		if (!dest.absolute())
@@ -90,76 +493,165 @@ namespace ziopp {
 			throw std::invalid_argument("dest must be absolute");
 		}
 
-		upath dest_directory = dest.directory();
-		if (!dest_filesystem.directory_exists(dest_directory))
+		if (!directory_exists(src))
 		{
-			throw std::ios_base::failure("dest directory must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			throw std::ios_base::failure("src directory must exist", std::make_error_code(std::errc::no_such_file_or_directory));
 		}
 
-		if (dest_filesystem.file_exists(dest))
+		const std::string& src_name = src.full_name();
+		const std::string& dest_name = dest.full_name();
+		if (this == &dest_filesystem && dest_name.compare(0, src_name.size(), src_name) == 0 && (dest_name.size() == src_name.size() || dest_name[src_name.size()] == upath::directory_seperator || src_name.size() == 1))
 		{
-			throw std::ios_base::failure("the destination file path already exists and overwrite is false", std::make_error_code(std::errc::file_exists));
+			throw std::invalid_argument("dest cannot be src or inside src");
 		}
 
-		std::iostream& source_stream = open_file(src, file_mode::open, file_access::read);
-		std::iostream& dest_stream = dest_filesystem.open_file(dest, file_mode::create, file_access::write);
-		dest_stream << source_stream.rdbuf();
-		dest_filesystem.creation_time(dest, creation_time(src));
-		dest_filesystem.access_time(dest, access_time(src));
-		dest_filesystem.write_time(dest, write_time(src));
-		delete_file(src);
+		dest_filesystem.create_directory(dest);
+		work_group group{ tree_executor(options), options.max_concurrency };
+		group.run([this, &dest_filesystem, &src, &dest, overwrite, &group]() {
+			copy_directory_contents(*this, dest_filesystem, src, dest, overwrite, group);
+		});
+		group.wait();
+	}
+
+	void filesystem::delete_directory_parallel(const upath& path, const tree_options& options)
+	{
+		if (!path.absolute())
+		{
+			throw std::invalid_argument("path must be absolute");
+		}
+
+		if (!directory_exists(path))
+		{
+			throw std::ios_base::failure("path must be an existing directory", std::make_error_code(std::errc::no_such_file_or_directory));
+		}
+
+		size_t batch_size = std::max<size_t>(options.delete_batch_size, 1);
+		std::shared_ptr<delete_node> root = std::make_shared<delete_node>(path, nullptr);
+		work_group group{ tree_executor(options), options.max_concurrency };
+		group.run([this, root, batch_size, &group]() {
+			delete_directory_contents(*this, root, batch_size, group);
+		});
+		group.wait();
+	}
+
+	std::string line_view::str() const
+	{
+		return std::string(data, size);
 	}
 
 	const std::vector<uint8_t> filesystem::read_all_binary(const upath& path)
 	{
-		//source_stream.seekg(0, std::ios_base::end);
-		//std::streampos stream_length = source_stream.tellg();
-		//source_stream.seekg(0, std::ios_base::beg);
-		std::iostream& source_stream = open_file(path, file_mode::open, file_access::read);
-		size_t stream_length = file_length(path);
-		std::vector<uint8_t> bytes(stream_length);
-		source_stream.read((char*)& bytes[0], stream_length);
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read);
+		std::vector<uint8_t> bytes;
+		read_contents(*handle, bytes);
 		return bytes;
 	}
 
+	const std::vector<uint8_t> filesystem::read_all_binary(const upath& path, std::error_code& error)
+	{
+		std::vector<uint8_t> bytes;
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read, error);
+		if (handle)
+		{
+			capture(error, [&handle, &bytes]() {
+				read_contents(*handle, bytes);
+			});
+		}
+		return bytes;
+	}
+
+	void filesystem::read_ranges(const upath& path, const std::vector<file_range>& ranges, const std::function<void(size_t, size_t)>& callback, const read_ranges_options& options)
+	{
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read);
+		handle->read_ranges(ranges, callback, options);
+	}
+
 	const std::string filesystem::read_all_text(const upath& path)
 	{
-		std::iostream& source_stream = open_file(path, file_mode::open, file_access::read);
-		std::string str{ std::istreambuf_iterator<std::iostream::char_type>(source_stream), {} };
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read);
+		std::string str;
+		read_contents(*handle, str);
+		return str;
+	}
+
+	const std::string filesystem::read_all_text(const upath& path, std::error_code& error)
+	{
+		std::string str;
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read, error);
+		if (handle)
+		{
+			capture(error, [&handle, &str]() {
+				read_contents(*handle, str);
+			});
+		}
 		return str;
 	}
 
 	void filesystem::write_all_binary(const upath& path, const std::vector<uint8_t>& content)
 	{
-		std::iostream& destination_stream = open_file(path, file_mode::create, file_access::write);
-		size_t content_length = content.size();
-		destination_stream.write((char*)& content[0], content_length);
+		// The content is already in memory, so it is written in one go instead of through the buffer of a stream
+		std::unique_ptr<file_handle> destination = open_handle(path, file_mode::create, file_access::write);
+		if (!content.empty())
+		{
+			destination->write_at(0, content.data(), content.size());
+		}
 	}
 
 	const std::vector<std::string> filesystem::read_all_lines(const upath& path)
 	{
 		std::vector<std::string> lines{};
-		std::iostream& source_stream = open_file(path, file_mode::open, file_access::read);
-		std::string line;
-		while (!std::getline(source_stream, line).eof())
+		for_each_line(path, [&lines](const line_view& line) {
+			lines.push_back(line.str());
+		});
+		return lines;
+	}
+
+	void filesystem::for_each_line(const upath& path, const std::function<void(const line_view&)>& callback, const line_options& options)
+	{
+		std::unique_ptr<file_handle> handle = open_handle(path, file_mode::open, file_access::read);
+		uint64_t size = handle->size();
+		if (!options.parallel || size <= options.block_size)
 		{
-			lines.push_back(line);
+			scan_lines(*handle, 0, std::numeric_limits<uint64_t>::max(), options.block_size, callback);
+			return;
 		}
-		return lines;
+
+		// Each piece reads the lines starting inside it, finishing its last line past its end
+		size_t max_concurrency = std::max<size_t>(options.max_concurrency, 1);
+		uint64_t piece_size = std::max<uint64_t>(options.block_size, (size + max_concurrency * 4 - 1) / (max_concurrency * 4));
+		work_group group{ options.work_executor != nullptr ? *options.work_executor : thread_pool::shared(), max_concurrency };
+		file_handle& source = *handle;
+		for (uint64_t first = 0; first < size; first += piece_size)
+		{
+			uint64_t end = first + piece_size >= size ? std::numeric_limits<uint64_t>::max() : first + piece_size;
+			group.run([&source, &callback, &options, first, end]() {
+				uint64_t start = first == 0 ? 0 : next_line_start(source, first - 1, options.block_size);
+				if (start < end)
+				{
+					scan_lines(source, start, end, options.block_size, callback);
+				}
+			});
+		}
+		group.wait();
 	}
 
 	void filesystem::write_all_text(const upath& path, std::string& content)
 	{
-		std::iostream& destination_stream = open_file(path, file_mode::create, file_access::write);
-		size_t content_length = content.length();
-		destination_stream.write(content.c_str(), content_length);
+		std::unique_ptr<file_handle> destination = open_handle(path, file_mode::create, file_access::write);
+		if (!content.empty())
+		{
+			destination->write_at(0, reinterpret_cast<const uint8_t*>(content.data()), content.size());
+		}
 	}
 
 	void filesystem::append_all_text(const upath& path, std::string& content)
 	{
-		std::iostream& destination_stream = open_file(path, file_mode::append, file_access::write);
-		size_t content_length = content.length();
-		destination_stream.write(content.c_str(), content_length);
+		std::unique_ptr<file_handle> destination = open_handle(path, file_mode::append, file_access::write);
+		if (!content.empty())
+		{
+			// The handle writes at the end of the file whatever the offset, so a size that is stale by the time it writes loses nothing
+			destination->write_at(destination->size(), reinterpret_cast<const uint8_t*>(content.data()), content.size());
+		}
 	}
 
 	std::iostream& filesystem::create_file(const upath& path)
@@ -0,0 +1,283 @@
+#include <ziopp/handle_cache_filesystem.h>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	namespace {
+		bool cacheable(file_mode mode, file_access access)
+		{
+			return mode == file_mode::open && access == file_access::read;
+		}
+	}
+
+	// A caller's share of a cached handle
+	class handle_cache_filesystem::shared_handle : public file_handle {
+	public:
+		explicit shared_handle(const std::shared_ptr<file_handle>& inner) : inner_(inner)
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			return inner_->write_at(offset, buffer, count);
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+		{
+			return inner_->read_vectored(offset, segments);
+		}
+
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			inner_->advise(offset, length, advice);
+		}
+	private:
+		std::shared_ptr<file_handle> inner_;
+	};
+
+	// Drops the handles of a path once the operation changing it is over, whether it failed or not
+	class handle_cache_filesystem::change_scope {
+	public:
+		change_scope(handle_cache_filesystem& owner, const upath& path, bool recursive, bool removed) : owner_(owner), name_(path.full_name()), recursive_(recursive), removed_(removed)
+		{
+		}
+
+		~change_scope()
+		{
+			owner_.forget(name_, recursive_, removed_);
+		}
+	private:
+		handle_cache_filesystem& owner_;
+		const std::string name_;
+		const bool recursive_;
+		const bool removed_;
+	};
+
+	handle_cache_filesystem::handle_cache_filesystem(filesystem& next, const handle_cache_options& options) : compose_filesystem(next), options_(options), streams_(new detail::stream_table()), generation_(0), hits_(0), misses_(0), evictions_(0), invalidations_(0)
+	{
+	}
+
+	handle_cache_filesystem::~handle_cache_filesystem()
+	{
+	}
+
+	void handle_cache_filesystem::invalidate(const upath& path)
+	{
+		forget(path.full_name(), true, false);
+	}
+
+	void handle_cache_filesystem::clear()
+	{
+		forget(std::string(1, upath::directory_seperator), true, false);
+	}
+
+	handle_cache_statistics handle_cache_filesystem::statistics() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return handle_cache_statistics{ hits_, misses_, evictions_, invalidations_, entries_.size() };
+	}
+
+	std::shared_ptr<file_handle> handle_cache_filesystem::acquire(const upath& path, std::error_code* error)
+	{
+		const std::string& name = path.full_name();
+		uint64_t generation;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto found = entries_.find(name);
+			if (found != entries_.end())
+			{
+				hits_++;
+				order_.splice(order_.begin(), order_, found->second.position);
+				return found->second.handle;
+			}
+			misses_++;
+			generation = generation_;
+		}
+
+		// Opened without the lock, so a slow open does not hold up hits on other files
+		std::shared_ptr<file_handle> handle{ error == nullptr ? compose_filesystem::open_handle(path, file_mode::open, file_access::read) : compose_filesystem::open_handle(path, file_mode::open, file_access::read, *error) };
+		if (!handle)
+		{
+			return nullptr;
+		}
+
+		// Streams sharing an evicted handle keep it open, the cache only gives up its own share
+		std::vector<std::shared_ptr<file_handle>> evicted;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (generation != generation_ || options_.max_handles == 0)
+		{
+			return handle;
+		}
+		auto found = entries_.find(name);
+		if (found != entries_.end())
+		{
+			// Another thread opened the file meanwhile, its handle is shared and this one closed
+			return found->second.handle;
+		}
+		order_.push_front(name);
+		entries_[name] = entry{ handle, order_.begin() };
+		while (entries_.size() > options_.max_handles)
+		{
+			auto oldest = entries_.find(order_.back());
+			evicted.push_back(std::move(oldest->second.handle));
+			entries_.erase(oldest);
+			order_.pop_back();
+			evictions_++;
+		}
+		return handle;
+	}
+
+	void handle_cache_filesystem::forget(const std::string& name, bool recursive, bool removed)
+	{
+		// Destroyed once the lock is released, since closing a file may be slow
+		std::vector<std::shared_ptr<file_handle>> handles;
+		std::vector<std::shared_ptr<std::iostream>> streams;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		generation_++;
+		for (auto it : find_path_entries(entries_, name, recursive))
+		{
+			handles.push_back(std::move(it->second.handle));
+			order_.erase(it->second.position);
+			entries_.erase(it);
+			invalidations_++;
+		}
+		if (removed)
+		{
+			streams = streams_->take(name, recursive);
+		}
+	}
+
+	void handle_cache_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		change_scope source{ *this, src, true, true };
+		change_scope destination{ *this, dest, true, false };
+		compose_filesystem::move_directory(src, dest);
+	}
+
+	void handle_cache_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		change_scope scope{ *this, path, true, true };
+		compose_filesystem::delete_directory(path, recursive);
+	}
+
+	void handle_cache_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		change_scope scope{ *this, path, true, true };
+		compose_filesystem::delete_directory(path, recursive, error);
+	}
+
+	void handle_cache_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		change_scope scope{ *this, dest, false, false };
+		compose_filesystem::copy_file(src, dest, overwrite);
+	}
+
+	void handle_cache_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		change_scope scope{ *this, dest, false, false };
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+	}
+
+	void handle_cache_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, true };
+		change_scope backup{ *this, desk_backup, false, true };
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+	}
+
+	void handle_cache_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, true };
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+	}
+
+	void handle_cache_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		compose_filesystem::move_file(src, dest);
+	}
+
+	void handle_cache_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		compose_filesystem::move_file(src, dest, error);
+	}
+
+	void handle_cache_filesystem::delete_file(const upath& path)
+	{
+		change_scope scope{ *this, path, false, true };
+		compose_filesystem::delete_file(path);
+	}
+
+	void handle_cache_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		change_scope scope{ *this, path, false, true };
+		compose_filesystem::delete_file(path, error);
+	}
+
+	std::iostream& handle_cache_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		if (!cacheable(mode, access))
+		{
+			change_scope scope{ *this, path, false, false };
+			return compose_filesystem::open_file(path, mode, access);
+		}
+
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(std::unique_ptr<file_handle>(new shared_handle(acquire(path, nullptr))), false));
+	}
+
+	std::unique_ptr<file_handle> handle_cache_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		if (!cacheable(mode, access))
+		{
+			change_scope scope{ *this, path, false, false };
+			return compose_filesystem::open_handle(path, mode, access);
+		}
+		return std::unique_ptr<file_handle>(new shared_handle(acquire(path, nullptr)));
+	}
+
+	std::unique_ptr<file_handle> handle_cache_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		if (!cacheable(mode, access))
+		{
+			change_scope scope{ *this, path, false, false };
+			return compose_filesystem::open_handle(path, mode, access, error);
+		}
+		std::shared_ptr<file_handle> handle = acquire(path, &error);
+		if (!handle)
+		{
+			return nullptr;
+		}
+		error.clear();
+		return std::unique_ptr<file_handle>(new shared_handle(handle));
+	}
+
+	void handle_cache_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		std::vector<std::unique_ptr<change_scope>> scopes;
+		for (const upath& path : paths)
+		{
+			scopes.emplace_back(new change_scope(*this, path, true, true));
+		}
+		compose_filesystem::delete_many(paths);
+	}
+}
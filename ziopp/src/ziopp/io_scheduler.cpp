@@ -0,0 +1,244 @@
+#include <ziopp/io_scheduler.h>
+#include <algorithm>
+#include <functional>
+
+namespace ziopp {
+	namespace {
+		thread_local io_priority thread_priority = io_priority::normal;
+
+		// The scheduler of the request the thread is running, if any
+		thread_local const io_scheduler* running_scheduler = nullptr;
+
+		uint64_t nanoseconds_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		}
+	}
+
+	io_priority current_io_priority()
+	{
+		return thread_priority;
+	}
+
+	io_priority_scope::io_priority_scope(io_priority priority) : previous_(thread_priority)
+	{
+		thread_priority = priority;
+	}
+
+	io_priority_scope::~io_priority_scope()
+	{
+		thread_priority = previous_;
+	}
+
+	namespace detail {
+		// Declared where work_group uses it, so the executor does not depend on the scheduler
+		std::function<void()> with_current_io_priority(std::function<void()> work)
+		{
+			io_priority priority = thread_priority;
+			if (priority == io_priority::normal)
+			{
+				return work;
+			}
+			return [priority, work]() {
+				io_priority_scope scope{ priority };
+				work();
+			};
+		}
+	}
+
+	io_class_options::io_class_options(size_t max_concurrency, uint64_t max_bytes_per_second, std::chrono::milliseconds deadline)
+		: max_concurrency(max_concurrency), max_bytes_per_second(max_bytes_per_second), deadline(deadline)
+	{
+	}
+
+	const io_class_statistics& io_scheduler_statistics::operator[](io_priority priority) const
+	{
+		return classes[static_cast<size_t>(priority)];
+	}
+
+	io_scheduler::io_scheduler(const io_scheduler_options& options) : options_(options), classes_(io_priority_count), running_(0), wake_()
+	{
+		classes_[static_cast<size_t>(io_priority::high)].options = options.high;
+		classes_[static_cast<size_t>(io_priority::normal)].options = options.normal;
+		classes_[static_cast<size_t>(io_priority::background)].options = options.background;
+		for (class_state& state : classes_)
+		{
+			state.running = 0;
+			state.statistics = io_class_statistics{};
+		}
+	}
+
+	const io_scheduler_options& io_scheduler::options() const
+	{
+		return options_;
+	}
+
+	io_scheduler_statistics io_scheduler::statistics() const
+	{
+		io_scheduler_statistics statistics{};
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		statistics.running = running_;
+		statistics.waiting = 0;
+		for (const class_state& state : classes_)
+		{
+			statistics.classes.push_back(state.statistics);
+			statistics.waiting += state.waiting.size();
+		}
+		return statistics;
+	}
+
+	io_scheduler& io_scheduler::shared()
+	{
+		static io_scheduler scheduler{};
+		return scheduler;
+	}
+
+	bool io_scheduler::can_start(const class_state& state, io_priority priority, std::chrono::steady_clock::time_point now) const
+	{
+		size_t limit = std::max<size_t>(options_.max_concurrency, 1);
+		if (priority == io_priority::background)
+		{
+			limit = limit > options_.reserved_concurrency ? limit - options_.reserved_concurrency : 1;
+		}
+		return running_ < limit
+			&& (state.options.max_concurrency == 0 || state.running < state.options.max_concurrency)
+			&& (state.options.max_bytes_per_second == 0 || state.ready <= now);
+	}
+
+	void io_scheduler::dispatch(std::chrono::steady_clock::time_point now)
+	{
+		bool granted = false;
+		for (;;)
+		{
+			// The oldest request of a class has the earliest deadline of the class, so only the oldest of each is looked at
+			class_state* first = nullptr;
+			class_state* chosen = nullptr;
+			bool expired = false;
+			std::chrono::steady_clock::time_point chosen_deadline;
+			for (size_t i = 0; i < classes_.size(); i++)
+			{
+				class_state& state = classes_[i];
+				if (state.waiting.empty() || !can_start(state, static_cast<io_priority>(i), now))
+				{
+					continue;
+				}
+				if (first == nullptr)
+				{
+					first = &state;
+					chosen = &state;
+				}
+				if (state.options.deadline != std::chrono::milliseconds::zero())
+				{
+					std::chrono::steady_clock::time_point deadline = state.waiting.front()->enqueued + state.options.deadline;
+					if (deadline <= now && (!expired || deadline < chosen_deadline))
+					{
+						chosen = &state;
+						chosen_deadline = deadline;
+						expired = true;
+					}
+				}
+			}
+			if (chosen == nullptr)
+			{
+				break;
+			}
+
+			waiter* next = chosen->waiting.front();
+			chosen->waiting.pop_front();
+			next->granted = true;
+			granted = true;
+			running_++;
+			chosen->running++;
+			if (chosen->options.max_bytes_per_second != 0)
+			{
+				std::chrono::duration<double> cost{ static_cast<double>(next->bytes) / static_cast<double>(chosen->options.max_bytes_per_second) };
+				chosen->ready = std::max(chosen->ready, now) + std::chrono::duration_cast<std::chrono::steady_clock::duration>(cost);
+			}
+
+			io_class_statistics& statistics = chosen->statistics;
+			uint64_t waited = nanoseconds_between(next->enqueued, now);
+			statistics.requests++;
+			statistics.bytes += next->bytes;
+			statistics.total_wait_nanoseconds += waited;
+			statistics.max_wait_nanoseconds = std::max(statistics.max_wait_nanoseconds, waited);
+			if (chosen != first)
+			{
+				statistics.expired++;
+			}
+		}
+
+		// Nothing finishing wakes a request held back only by a bandwidth limit, so its waiter wakes itself when the limit allows it
+		wake_ = std::chrono::steady_clock::time_point{};
+		for (const class_state& state : classes_)
+		{
+			if (!state.waiting.empty() && state.options.max_bytes_per_second != 0 && state.ready > now && (wake_ == std::chrono::steady_clock::time_point{} || state.ready < wake_))
+			{
+				wake_ = state.ready;
+			}
+		}
+		if (granted)
+		{
+			granted_.notify_all();
+		}
+	}
+
+	void io_scheduler::acquire(waiter& request)
+	{
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		request.enqueued = std::chrono::steady_clock::now();
+		classes_[static_cast<size_t>(request.priority)].waiting.push_back(&request);
+		dispatch(request.enqueued);
+		while (!request.granted)
+		{
+			if (wake_ == std::chrono::steady_clock::time_point{})
+			{
+				granted_.wait(lock);
+			}
+			else
+			{
+				granted_.wait_until(lock, wake_);
+			}
+			if (!request.granted)
+			{
+				dispatch(std::chrono::steady_clock::now());
+			}
+		}
+	}
+
+	void io_scheduler::release(io_priority priority)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		running_--;
+		classes_[static_cast<size_t>(priority)].running--;
+		dispatch(std::chrono::steady_clock::now());
+	}
+
+	io_request::io_request(io_scheduler& scheduler, io_priority priority, uint64_t bytes)
+		: scheduler_(scheduler), priority_(priority), nested_(running_scheduler == &scheduler), previous_(running_scheduler)
+	{
+		if (nested_)
+		{
+			return;
+		}
+		io_scheduler::waiter request{};
+		request.priority = priority;
+		request.bytes = bytes;
+		request.granted = false;
+		scheduler.acquire(request);
+		running_scheduler = &scheduler;
+	}
+
+	io_request::io_request(io_scheduler& scheduler, uint64_t bytes) : io_request(scheduler, current_io_priority(), bytes)
+	{
+	}
+
+	io_request::~io_request()
+	{
+		if (nested_)
+		{
+			return;
+		}
+		running_scheduler = previous_;
+		scheduler_.release(priority_);
+	}
+}
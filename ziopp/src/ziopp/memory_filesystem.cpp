@@ -0,0 +1,1077 @@
+#include <ziopp/memory_filesystem.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <streambuf>
+
+namespace ziopp {
+	namespace {
+		using time_point = std::chrono::system_clock::time_point;
+
+		void require_absolute(const upath& path, const char* message)
+		{
+			if (!path.absolute())
+			{
+				throw std::invalid_argument(message);
+			}
+		}
+
+		const char* fail(std::error_code& error, std::errc reason, const char* message)
+		{
+			error = std::make_error_code(reason);
+			return message;
+		}
+
+		// Throws the exception the throwing overloads report a failure with, when there is one
+		void raise(const char* message, const std::error_code& error)
+		{
+			if (message == nullptr)
+			{
+				return;
+			}
+			if (error == std::errc::invalid_argument)
+			{
+				throw std::invalid_argument(message);
+			}
+			throw std::ios_base::failure(message, error);
+		}
+
+		std::string directory_prefix(const std::string& directory)
+		{
+			return directory == "/" ? directory : directory + '/';
+		}
+
+		bool starts_with(const std::string& value, const std::string& prefix)
+		{
+			return value.size() >= prefix.size() && value.compare(0, prefix.size(), prefix) == 0;
+		}
+
+		bool matches_pattern(const char* pattern, const char* name)
+		{
+			const char* star = nullptr;
+			const char* resume = nullptr;
+			while (*name != '\0')
+			{
+				if (*pattern == '*')
+				{
+					star = pattern++;
+					resume = name;
+				}
+				else if (*pattern == '?' || *pattern == *name)
+				{
+					pattern++;
+					name++;
+				}
+				else if (star != nullptr)
+				{
+					pattern = star + 1;
+					name = ++resume;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			while (*pattern == '*')
+			{
+				pattern++;
+			}
+			return *pattern == '\0';
+		}
+
+		class memory_streambuf : public std::streambuf {
+		public:
+			template <typename Data>
+			memory_streambuf(const std::shared_ptr<Data>& data, std::vector<char>& content, std::mutex& mutex, file_access access, bool append)
+				: owner_(data), content_(content), mutex_(mutex), position_(0),
+				readable_((access & file_access::read) == file_access::read),
+				writable_((access & file_access::write) == file_access::write),
+				append_(append)
+			{
+				if (append_)
+				{
+					std::lock_guard<std::mutex> lock{ mutex_ };
+					position_ = content_.size();
+				}
+			}
+
+			const void* owner() const
+			{
+				return owner_.get();
+			}
+		protected:
+			int_type underflow() override
+			{
+				if (gptr() < egptr())
+				{
+					return traits_type::to_int_type(*gptr());
+				}
+				if (!readable_)
+				{
+					return traits_type::eof();
+				}
+
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				if (position_ >= content_.size())
+				{
+					return traits_type::eof();
+				}
+				size_t count = std::min(sizeof(buffer_), content_.size() - position_);
+				std::memcpy(buffer_, content_.data() + position_, count);
+				position_ += count;
+				setg(buffer_, buffer_, buffer_ + count);
+				return traits_type::to_int_type(*gptr());
+			}
+
+			std::streamsize xsgetn(char_type* s, std::streamsize count) override
+			{
+				if (!readable_ || count <= 0)
+				{
+					return 0;
+				}
+
+				// Drain what is left in the get area, then copy the rest straight from the content
+				std::streamsize buffered = std::min<std::streamsize>(egptr() - gptr(), count);
+				if (buffered > 0)
+				{
+					std::memcpy(s, gptr(), static_cast<size_t>(buffered));
+					gbump(static_cast<int>(buffered));
+				}
+				if (buffered == count)
+				{
+					return count;
+				}
+
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				size_t available = position_ < content_.size() ? content_.size() - position_ : 0;
+				size_t direct = std::min(available, static_cast<size_t>(count - buffered));
+				if (direct > 0)
+				{
+					std::memcpy(s + buffered, content_.data() + position_, direct);
+					position_ += direct;
+					setg(buffer_, buffer_, buffer_);
+				}
+				return buffered + static_cast<std::streamsize>(direct);
+			}
+
+			std::streamsize showmanyc() override
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				size_t position = logical_position();
+				return position < content_.size() ? static_cast<std::streamsize>(content_.size() - position) : -1;
+			}
+
+			int_type overflow(int_type c) override
+			{
+				if (traits_type::eq_int_type(c, traits_type::eof()))
+				{
+					return traits_type::not_eof(c);
+				}
+				char_type ch = traits_type::to_char_type(c);
+				return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+			}
+
+			std::streamsize xsputn(const char_type* s, std::streamsize count) override
+			{
+				if (!writable_ || count <= 0)
+				{
+					return 0;
+				}
+
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				size_t position = append_ ? content_.size() : logical_position();
+				size_t end = position + static_cast<size_t>(count);
+				if (end > content_.size())
+				{
+					content_.resize(end);
+				}
+				std::memcpy(content_.data() + position, s, static_cast<size_t>(count));
+				position_ = end;
+				setg(buffer_, buffer_, buffer_);
+				return count;
+			}
+
+			pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				off_type base;
+				switch (direction)
+				{
+					case std::ios_base::beg:
+						base = 0;
+						break;
+					case std::ios_base::cur:
+						base = static_cast<off_type>(logical_position());
+						break;
+					default:
+						base = static_cast<off_type>(content_.size());
+						break;
+				}
+				off_type target = base + offset;
+				if (target < 0)
+				{
+					return pos_type(off_type(-1));
+				}
+				position_ = static_cast<size_t>(target);
+				setg(buffer_, buffer_, buffer_);
+				return pos_type(target);
+			}
+
+			pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+			{
+				return seekoff(off_type(position), std::ios_base::beg, which);
+			}
+		private:
+			size_t logical_position() const
+			{
+				return position_ - static_cast<size_t>(egptr() - gptr());
+			}
+
+			std::shared_ptr<void> owner_;
+			std::vector<char>& content_;
+			std::mutex& mutex_;
+			size_t position_;
+			bool readable_;
+			bool writable_;
+			bool append_;
+			char buffer_[4096];
+		};
+
+		class memory_stream : public std::iostream {
+		public:
+			template <typename Data>
+			memory_stream(const std::shared_ptr<Data>& data, file_access access, bool append)
+				: std::iostream(nullptr), buffer_(data, data->content, data->mutex, access, append)
+			{
+				rdbuf(&buffer_);
+			}
+
+			// The contents the stream reads and writes
+			const void* owner() const
+			{
+				return buffer_.owner();
+			}
+		private:
+			memory_streambuf buffer_;
+		};
+
+		class memory_file_handle : public file_handle {
+		public:
+			template <typename Data>
+			memory_file_handle(const std::shared_ptr<Data>& data, file_access access, bool append)
+				: owner_(data), content_(data->content), mutex_(data->mutex),
+				readable_((access & file_access::read) == file_access::read),
+				writable_((access & file_access::write) == file_access::write),
+				append_(append)
+			{
+			}
+
+			size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+			{
+				if (!readable_)
+				{
+					throw std::ios_base::failure("the file is not open for reading", std::make_error_code(std::errc::bad_file_descriptor));
+				}
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				if (offset >= content_.size())
+				{
+					return 0;
+				}
+				size_t read = std::min(count, static_cast<size_t>(content_.size() - offset));
+				std::memcpy(buffer, content_.data() + offset, read);
+				return read;
+			}
+
+			size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+			{
+				if (!readable_)
+				{
+					throw std::ios_base::failure("the file is not open for reading", std::make_error_code(std::errc::bad_file_descriptor));
+				}
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				size_t total = 0;
+				for (const io_segment& segment : segments)
+				{
+					if (offset + total >= content_.size())
+					{
+						break;
+					}
+					size_t read = std::min(segment.length, static_cast<size_t>(content_.size() - offset - total));
+					std::memcpy(segment.buffer, content_.data() + offset + total, read);
+					total += read;
+				}
+				return total;
+			}
+
+			size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+			{
+				if (!writable_)
+				{
+					throw std::ios_base::failure("the file is not open for writing", std::make_error_code(std::errc::bad_file_descriptor));
+				}
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				size_t position = append_ ? content_.size() : static_cast<size_t>(offset);
+				if (position + count > content_.size())
+				{
+					content_.resize(position + count);
+				}
+				std::memcpy(content_.data() + position, buffer, count);
+				return count;
+			}
+
+			uint64_t size() const override
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				return content_.size();
+			}
+
+			void sync() override
+			{
+			}
+		private:
+			std::shared_ptr<void> owner_;
+			std::vector<char>& content_;
+			std::mutex& mutex_;
+			bool readable_;
+			bool writable_;
+			bool append_;
+		};
+	}
+
+	memory_filesystem::memory_filesystem()
+	{
+		time_point now = std::chrono::system_clock::now();
+		node& root = nodes_["/"];
+		root.directory = true;
+		root.creation_time = now;
+		root.access_time = now;
+		root.write_time = now;
+	}
+
+	memory_filesystem::~memory_filesystem()
+	{
+	}
+
+	memory_filesystem::node* memory_filesystem::find(const upath& path)
+	{
+		node_map::iterator it = nodes_.find(path.full_name());
+		return it == nodes_.end() ? nullptr : &it->second;
+	}
+
+	const memory_filesystem::node* memory_filesystem::find(const upath& path) const
+	{
+		node_map::const_iterator it = nodes_.find(path.full_name());
+		return it == nodes_.end() ? nullptr : &it->second;
+	}
+
+	memory_filesystem::node& memory_filesystem::find_file(const upath& path)
+	{
+		return const_cast<node&>(static_cast<const memory_filesystem*>(this)->find_file(path));
+	}
+
+	const memory_filesystem::node& memory_filesystem::find_file(const upath& path) const
+	{
+		const node* entry = nullptr;
+		std::error_code error;
+		raise(find_file(path, entry, error), error);
+		return *entry;
+	}
+
+	const char* memory_filesystem::find_file(const upath& path, const node*& entry, std::error_code& error) const
+	{
+		if (!path.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "path must be absolute");
+		}
+		entry = find(path);
+		if (entry == nullptr)
+		{
+			return fail(error, std::errc::no_such_file_or_directory, "the file does not exist");
+		}
+		if (entry->directory)
+		{
+			return fail(error, std::errc::is_a_directory, "the path is a directory");
+		}
+		error.clear();
+		return nullptr;
+	}
+
+	memory_filesystem::node& memory_filesystem::find_entry(const upath& path)
+	{
+		return const_cast<node&>(static_cast<const memory_filesystem*>(this)->find_entry(path));
+	}
+
+	const memory_filesystem::node& memory_filesystem::find_entry(const upath& path) const
+	{
+		require_absolute(path, "path must be absolute");
+		const node* entry = find(path);
+		if (entry == nullptr)
+		{
+			throw std::ios_base::failure("the file or directory does not exist", std::make_error_code(std::errc::no_such_file_or_directory));
+		}
+		return *entry;
+	}
+
+	void memory_filesystem::require_parent_directory(const upath& path) const
+	{
+		std::error_code error;
+		raise(require_parent_directory(path, error), error);
+	}
+
+	const char* memory_filesystem::require_parent_directory(const upath& path, std::error_code& error) const
+	{
+		const node* parent = find(path.directory());
+		if (parent == nullptr || !parent->directory)
+		{
+			return fail(error, std::errc::no_such_file_or_directory, "the parent directory does not exist");
+		}
+		error.clear();
+		return nullptr;
+	}
+
+	bool memory_filesystem::has_children(const std::string& directory) const
+	{
+		std::string prefix = directory_prefix(directory);
+		node_map::const_iterator it = nodes_.lower_bound(prefix);
+		if (it != nodes_.end() && it->first == prefix)
+		{
+			++it;
+		}
+		return it != nodes_.end() && starts_with(it->first, prefix);
+	}
+
+	void memory_filesystem::create_directory_locked(const upath& path)
+	{
+		std::error_code error;
+		raise(create_directory_locked(path, error), error);
+	}
+
+	const char* memory_filesystem::create_directory_locked(const upath& path, std::error_code& error)
+	{
+		if (!path.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "path must be absolute");
+		}
+		time_point now = std::chrono::system_clock::now();
+		std::string current{};
+		for (const std::string& part : path.split())
+		{
+			current += '/';
+			current += part;
+			node_map::iterator it = nodes_.find(current);
+			if (it == nodes_.end())
+			{
+				node& created = nodes_[current];
+				created.directory = true;
+				created.creation_time = now;
+				created.access_time = now;
+				created.write_time = now;
+			}
+			else if (!it->second.directory)
+			{
+				return fail(error, std::errc::not_a_directory, "a file exists with the same name as the directory");
+			}
+		}
+		error.clear();
+		return nullptr;
+	}
+
+	void memory_filesystem::delete_file_locked(const upath& path)
+	{
+		std::error_code error;
+		raise(delete_file_locked(path, error), error);
+	}
+
+	const char* memory_filesystem::delete_file_locked(const upath& path, std::error_code& error)
+	{
+		if (!path.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "path must be absolute");
+		}
+		node_map::iterator it = nodes_.find(path.full_name());
+		if (it != nodes_.end())
+		{
+			if (it->second.directory)
+			{
+				return fail(error, std::errc::is_a_directory, "the path is a directory");
+			}
+			nodes_.erase(it);
+		}
+		error.clear();
+		return nullptr;
+	}
+
+	void memory_filesystem::move_file_locked(const upath& src, const upath& dest)
+	{
+		std::error_code error;
+		raise(move_file_locked(src, dest, error), error);
+	}
+
+	const char* memory_filesystem::move_file_locked(const upath& src, const upath& dest, std::error_code& error)
+	{
+		if (!dest.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "dest must be absolute");
+		}
+		const node* source;
+		if (const char* message = find_file(src, source, error))
+		{
+			return message;
+		}
+		if (find(dest) != nullptr)
+		{
+			return fail(error, std::errc::file_exists, "the destination path already exists");
+		}
+		if (const char* message = require_parent_directory(dest, error))
+		{
+			return message;
+		}
+
+		node moved = std::move(*const_cast<node*>(source));
+		nodes_.erase(src.full_name());
+		nodes_.insert(std::make_pair(dest.full_name(), std::move(moved)));
+		return nullptr;
+	}
+
+	file_stat memory_filesystem::stat_locked(const upath& path) const
+	{
+		file_stat stat{};
+		const node* entry = path.absolute() ? find(path) : nullptr;
+		if (entry != nullptr)
+		{
+			stat.exists = true;
+			stat.is_directory = entry->directory;
+			if (!entry->directory)
+			{
+				std::lock_guard<std::mutex> lock{ entry->data->mutex };
+				stat.length = entry->data->content.size();
+			}
+			stat.creation_time = entry->creation_time;
+			stat.access_time = entry->access_time;
+			stat.write_time = entry->write_time;
+		}
+		return stat;
+	}
+
+	void memory_filesystem::create_directory(const upath& path)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		create_directory_locked(path);
+	}
+
+	void memory_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		create_directory_locked(path, error);
+	}
+
+	bool memory_filesystem::directory_exists(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const node* entry = path.absolute() ? find(path) : nullptr;
+		return entry != nullptr && entry->directory;
+	}
+
+	void memory_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		require_absolute(src, "src must be absolute");
+		require_absolute(dest, "dest must be absolute");
+		if (src.full_name() == "/")
+		{
+			throw std::ios_base::failure("cannot move the root directory", std::make_error_code(std::errc::permission_denied));
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const node* source = find(src);
+		if (source == nullptr || !source->directory)
+		{
+			throw std::ios_base::failure("src directory must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+		}
+		if (find(dest) != nullptr)
+		{
+			throw std::ios_base::failure("the destination path already exists", std::make_error_code(std::errc::file_exists));
+		}
+		const std::string& source_name = src.full_name();
+		std::string source_prefix = directory_prefix(source_name);
+		if (starts_with(dest.full_name(), source_prefix))
+		{
+			throw std::invalid_argument("cannot move a directory into itself");
+		}
+		require_parent_directory(dest);
+
+		// Siblings such as "/a.txt" sort between "/a" and "/a/", so the entries below the directory are found from its prefix
+		std::vector<std::pair<std::string, node>> moved;
+		node_map::iterator found = nodes_.find(source_name);
+		moved.push_back(std::make_pair(dest.full_name(), std::move(found->second)));
+		nodes_.erase(found);
+		node_map::iterator it = nodes_.lower_bound(source_prefix);
+		while (it != nodes_.end() && starts_with(it->first, source_prefix))
+		{
+			moved.push_back(std::make_pair(dest.full_name() + it->first.substr(source_name.size()), std::move(it->second)));
+			it = nodes_.erase(it);
+		}
+		for (std::pair<std::string, node>& entry : moved)
+		{
+			nodes_.insert(std::move(entry));
+		}
+	}
+
+	void memory_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		std::error_code error;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		raise(delete_directory_locked(path, recursive, error), error);
+	}
+
+	void memory_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		delete_directory_locked(path, recursive, error);
+	}
+
+	const char* memory_filesystem::delete_directory_locked(const upath& path, bool recursive, std::error_code& error)
+	{
+		if (!path.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "path must be absolute");
+		}
+		if (path.full_name() == "/")
+		{
+			return fail(error, std::errc::permission_denied, "cannot delete the root directory");
+		}
+
+		const node* entry = find(path);
+		if (entry == nullptr || !entry->directory)
+		{
+			return fail(error, std::errc::no_such_file_or_directory, "the directory does not exist");
+		}
+		if (!recursive && has_children(path.full_name()))
+		{
+			return fail(error, std::errc::directory_not_empty, "the directory is not empty");
+		}
+
+		std::string prefix = directory_prefix(path.full_name());
+		nodes_.erase(nodes_.find(path.full_name()));
+		node_map::iterator it = nodes_.lower_bound(prefix);
+		while (it != nodes_.end() && starts_with(it->first, prefix))
+		{
+			it = nodes_.erase(it);
+		}
+		error.clear();
+		return nullptr;
+	}
+
+	void memory_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		std::error_code error;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		raise(copy_file_locked(src, dest, overwrite, error), error);
+	}
+
+	void memory_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		copy_file_locked(src, dest, overwrite, error);
+	}
+
+	const char* memory_filesystem::copy_file_locked(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		if (!dest.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "dest must be absolute");
+		}
+		const node* source;
+		if (const char* message = find_file(src, source, error))
+		{
+			return message;
+		}
+		if (const char* message = require_parent_directory(dest, error))
+		{
+			return message;
+		}
+
+		node* existing = find(dest);
+		if (existing != nullptr)
+		{
+			if (existing->directory)
+			{
+				return fail(error, std::errc::is_a_directory, "the destination path is a directory");
+			}
+			if (!overwrite)
+			{
+				return fail(error, std::errc::file_exists, "the destination file path already exists and overwrite is false");
+			}
+		}
+		if (existing == source)
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<file_data> data = std::make_shared<file_data>();
+		{
+			std::lock_guard<std::mutex> data_lock{ source->data->mutex };
+			data->content = source->data->content;
+		}
+
+		time_point now = std::chrono::system_clock::now();
+		node& copy = nodes_[dest.full_name()];
+		copy.directory = false;
+		copy.data = data;
+		copy.creation_time = now;
+		copy.access_time = now;
+		copy.write_time = source->write_time;
+		return nullptr;
+	}
+
+	void memory_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		// Everything is checked before anything changes, so a replace that fails leaves every file as it was
+		find_file(src);
+		find_file(dest);
+		std::error_code error;
+		if (src.full_name() == dest.full_name())
+		{
+			raise(fail(error, std::errc::invalid_argument, "src and dest must be different files"), error);
+		}
+		if (!desk_backup.empty())
+		{
+			require_absolute(desk_backup, "desk_backup must be absolute");
+			if (desk_backup.full_name() == src.full_name() || desk_backup.full_name() == dest.full_name())
+			{
+				raise(fail(error, std::errc::invalid_argument, "desk_backup must differ from src and dest"), error);
+			}
+			const node* backup = find(desk_backup);
+			if (backup != nullptr && backup->directory)
+			{
+				raise(fail(error, std::errc::is_a_directory, "desk_backup is a directory"), error);
+			}
+			require_parent_directory(desk_backup);
+
+			delete_file_locked(desk_backup);
+			move_file_locked(dest, desk_backup);
+		}
+		else
+		{
+			nodes_.erase(dest.full_name());
+		}
+		move_file_locked(src, dest);
+	}
+
+	void memory_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		replace_file(src, dest, upath{}, ignore_metadata_errors);
+	}
+
+	size_t memory_filesystem::file_length(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const node& entry = find_file(path);
+		std::lock_guard<std::mutex> data_lock{ entry.data->mutex };
+		return entry.data->content.size();
+	}
+
+	size_t memory_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const node* entry = nullptr;
+		if (find_file(path, entry, error) != nullptr)
+		{
+			return 0;
+		}
+		std::lock_guard<std::mutex> data_lock{ entry->data->mutex };
+		return entry->data->content.size();
+	}
+
+	bool memory_filesystem::file_exists(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const node* entry = path.absolute() ? find(path) : nullptr;
+		return entry != nullptr && !entry->directory;
+	}
+
+	void memory_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		move_file_locked(src, dest);
+	}
+
+	void memory_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		move_file_locked(src, dest, error);
+	}
+
+	void memory_filesystem::delete_file(const upath& path)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		delete_file_locked(path);
+	}
+
+	void memory_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		delete_file_locked(path, error);
+	}
+
+	memory_filesystem::node& memory_filesystem::open_locked(const upath& path, file_mode mode, file_access access)
+	{
+		node* entry;
+		std::error_code error;
+		raise(open_locked(path, mode, access, entry, error), error);
+		return *entry;
+	}
+
+	const char* memory_filesystem::open_locked(const upath& path, file_mode mode, file_access access, node*& entry, std::error_code& error)
+	{
+		if (!path.absolute())
+		{
+			return fail(error, std::errc::invalid_argument, "path must be absolute");
+		}
+		entry = find(path);
+		if (entry != nullptr && entry->directory)
+		{
+			return fail(error, std::errc::is_a_directory, "the path is a directory");
+		}
+
+		bool create = false;
+		bool truncate = false;
+		switch (mode)
+		{
+			case file_mode::create_new:
+				if (entry != nullptr)
+				{
+					return fail(error, std::errc::file_exists, "the file already exists");
+				}
+				create = true;
+				break;
+			case file_mode::create:
+				create = entry == nullptr;
+				truncate = entry != nullptr;
+				break;
+			case file_mode::open:
+			case file_mode::truncate:
+				if (entry == nullptr)
+				{
+					return fail(error, std::errc::no_such_file_or_directory, "the file does not exist");
+				}
+				truncate = mode == file_mode::truncate;
+				break;
+			case file_mode::open_or_create:
+			case file_mode::append:
+				create = entry == nullptr;
+				break;
+		}
+
+		time_point now = std::chrono::system_clock::now();
+		if (create)
+		{
+			if (const char* message = require_parent_directory(path, error))
+			{
+				return message;
+			}
+			entry = &nodes_[path.full_name()];
+			entry->directory = false;
+			entry->data = std::make_shared<file_data>();
+			entry->creation_time = now;
+			entry->write_time = now;
+		}
+		if (truncate)
+		{
+			std::lock_guard<std::mutex> data_lock{ entry->data->mutex };
+			entry->data->content.clear();
+		}
+		if ((access & file_access::write) == file_access::write)
+		{
+			entry->write_time = now;
+		}
+		entry->access_time = now;
+		error.clear();
+		return nullptr;
+	}
+
+	std::iostream& memory_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		node& entry = open_locked(path, mode, access);
+		std::shared_ptr<std::iostream>& stream = entry.streams[std::make_pair(mode, access)];
+		// A file copied over has new contents, which the stream of an earlier open does not see
+		if (stream && static_cast<const memory_stream&>(*stream).owner() == entry.data.get())
+		{
+			// There is no close, so the stream of an earlier open is reused rather than kept alongside
+			stream->clear();
+			stream->seekg(0, mode == file_mode::append ? std::ios_base::end : std::ios_base::beg);
+		}
+		else
+		{
+			stream = std::make_shared<memory_stream>(entry.data, access, mode == file_mode::append);
+		}
+		return *stream;
+	}
+
+	std::unique_ptr<file_handle> memory_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		node& entry = open_locked(path, mode, access);
+		return std::unique_ptr<file_handle>(new memory_file_handle(entry.data, access, mode == file_mode::append));
+	}
+
+	std::unique_ptr<file_handle> memory_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		node* entry;
+		if (open_locked(path, mode, access, entry, error) != nullptr)
+		{
+			return nullptr;
+		}
+		return std::unique_ptr<file_handle>(new memory_file_handle(entry->data, access, mode == file_mode::append));
+	}
+
+	const std::chrono::system_clock::time_point& memory_filesystem::creation_time(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return find_entry(path).creation_time;
+	}
+
+	void memory_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		find_entry(path).creation_time = time;
+	}
+
+	const std::chrono::system_clock::time_point& memory_filesystem::access_time(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return find_entry(path).access_time;
+	}
+
+	void memory_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		find_entry(path).access_time = time;
+	}
+
+	const std::chrono::system_clock::time_point& memory_filesystem::write_time(const upath& path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return find_entry(path).write_time;
+	}
+
+	void memory_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		find_entry(path).write_time = time;
+	}
+
+	const upath_iterator memory_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		require_absolute(path, "path must be absolute");
+
+		// Matches are collected up front so the enumeration does not hold the lock
+		std::shared_ptr<std::vector<upath>> matches = std::make_shared<std::vector<upath>>();
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			const node* directory = find(path);
+			if (directory == nullptr || !directory->directory)
+			{
+				throw std::ios_base::failure("the directory does not exist", std::make_error_code(std::errc::no_such_file_or_directory));
+			}
+
+			const char* pattern = search_pattern.empty() ? "*" : search_pattern.c_str();
+			std::string prefix = directory_prefix(path.full_name());
+			for (node_map::const_iterator it = nodes_.lower_bound(prefix); it != nodes_.end() && starts_with(it->first, prefix); ++it)
+			{
+				if (it->first.size() == prefix.size())
+				{
+					continue;
+				}
+				size_t name_start = it->first.find_last_of(upath::directory_seperator) + 1;
+				if (options == search_options::top_directory_only && name_start != prefix.size())
+				{
+					continue;
+				}
+				if ((target == search_target::file && it->second.directory) || (target == search_target::directory && !it->second.directory))
+				{
+					continue;
+				}
+				if (matches_pattern(pattern, it->first.c_str() + name_start))
+				{
+					matches->push_back(upath{ it->first });
+				}
+			}
+		}
+
+		std::shared_ptr<size_t> index = std::make_shared<size_t>(0);
+		return upath_iterator{ [matches, index]() -> const upath* {
+			return *index < matches->size() ? &matches->at((*index)++) : nullptr;
+		} };
+	}
+
+	bool memory_filesystem::can_watch(const upath&) const
+	{
+		return false;
+	}
+
+	const filesystem_watcher& memory_filesystem::watch(const upath&)
+	{
+		throw std::ios_base::failure("watching is not supported by the memory filesystem", std::make_error_code(std::errc::operation_not_supported));
+	}
+
+	const std::string memory_filesystem::path_to_internal(const upath& path) const
+	{
+		return path.full_name();
+	}
+
+	const upath& memory_filesystem::path_from_internal(const std::string& system_path) const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		std::map<std::string, upath>::iterator it = internal_paths_.find(system_path);
+		if (it == internal_paths_.end())
+		{
+			it = internal_paths_.insert(std::make_pair(system_path, upath{ system_path })).first;
+		}
+		return it->second;
+	}
+
+	std::vector<file_stat> memory_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		std::vector<file_stat> stats;
+		stats.reserve(paths.size());
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const upath& path : paths)
+		{
+			stats.push_back(stat_locked(path));
+		}
+		return stats;
+	}
+
+	std::vector<bool> memory_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		std::vector<bool> exists;
+		exists.reserve(paths.size());
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const upath& path : paths)
+		{
+			exists.push_back(path.absolute() && find(path) != nullptr);
+		}
+		return exists;
+	}
+
+	void memory_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const upath& path : paths)
+		{
+			delete_file_locked(path);
+		}
+	}
+
+	void memory_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const upath& path : paths)
+		{
+			create_directory_locked(path);
+		}
+	}
+}
\ No newline at end of file
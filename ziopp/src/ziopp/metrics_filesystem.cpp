@@ -0,0 +1,823 @@
+#include <ziopp/metrics_filesystem.h>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <streambuf>
+#include <unordered_map>
+#include <ziopp/path_entries.h>
+
+namespace ziopp {
+	namespace {
+		const unsigned sub_bucket_bits = 4;
+		const uint64_t sub_bucket_count = 1u << sub_bucket_bits;
+		const unsigned max_shift = static_cast<unsigned>(latency_histogram::bucket_count / sub_bucket_count) - 2;
+
+		std::atomic<uint64_t> next_id{ 1 };
+
+		// The shard last used by the thread, checked before the map of all the shards the thread has used
+		thread_local uint64_t cached_id = 0;
+		thread_local void* cached_shard = nullptr;
+		thread_local std::unordered_map<uint64_t, void*> thread_shards;
+
+		// Every counter of a shard is only written by its thread, so a plain load and store is enough
+		inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		unsigned highest_bit(uint64_t value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return value == 0 ? 0 : 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+			unsigned bit = 0;
+			while (value >>= 1)
+			{
+				bit++;
+			}
+			return bit;
+#endif
+		}
+
+		std::string format_seconds(double seconds)
+		{
+			std::ostringstream stream;
+			stream << std::setprecision(10) << seconds;
+			return stream.str();
+		}
+	}
+
+	const char* to_string(filesystem_operation operation)
+	{
+		switch (operation)
+		{
+			case filesystem_operation::create_directory: return "create_directory";
+			case filesystem_operation::directory_exists: return "directory_exists";
+			case filesystem_operation::move_directory: return "move_directory";
+			case filesystem_operation::delete_directory: return "delete_directory";
+			case filesystem_operation::copy_file: return "copy_file";
+			case filesystem_operation::replace_file: return "replace_file";
+			case filesystem_operation::file_length: return "file_length";
+			case filesystem_operation::file_exists: return "file_exists";
+			case filesystem_operation::move_file: return "move_file";
+			case filesystem_operation::delete_file: return "delete_file";
+			case filesystem_operation::open_file: return "open_file";
+			case filesystem_operation::open_handle: return "open_handle";
+			case filesystem_operation::get_creation_time: return "get_creation_time";
+			case filesystem_operation::set_creation_time: return "set_creation_time";
+			case filesystem_operation::get_access_time: return "get_access_time";
+			case filesystem_operation::set_access_time: return "set_access_time";
+			case filesystem_operation::get_write_time: return "get_write_time";
+			case filesystem_operation::set_write_time: return "set_write_time";
+			case filesystem_operation::enumerate_paths: return "enumerate_paths";
+			case filesystem_operation::can_watch: return "can_watch";
+			case filesystem_operation::watch: return "watch";
+			case filesystem_operation::path_to_internal: return "path_to_internal";
+			case filesystem_operation::path_from_internal: return "path_from_internal";
+			case filesystem_operation::stat_many: return "stat_many";
+			case filesystem_operation::exists_many: return "exists_many";
+			case filesystem_operation::delete_many: return "delete_many";
+			case filesystem_operation::create_directories: return "create_directories";
+		}
+		return "unknown";
+	}
+
+	latency_histogram::latency_histogram() : buckets_(bucket_count, 0), count_(0)
+	{
+	}
+
+	size_t latency_histogram::bucket_index(uint64_t nanoseconds)
+	{
+		// Values below 2 * sub_bucket_count have a bucket each, above that every power of two has sub_bucket_count buckets
+		unsigned bit = highest_bit(nanoseconds);
+		unsigned shift = bit > sub_bucket_bits ? bit - sub_bucket_bits : 0;
+		if (shift > max_shift)
+		{
+			return bucket_count - 1;
+		}
+		return static_cast<size_t>(shift * sub_bucket_count + (nanoseconds >> shift));
+	}
+
+	uint64_t latency_histogram::bucket_upper_bound(size_t index)
+	{
+		if (index < 2 * sub_bucket_count)
+		{
+			return index;
+		}
+		uint64_t shift = index / sub_bucket_count - 1;
+		uint64_t mantissa = index - shift * sub_bucket_count;
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+	void latency_histogram::record(uint64_t nanoseconds)
+	{
+		buckets_[bucket_index(nanoseconds)]++;
+		count_++;
+	}
+
+	void latency_histogram::merge(const latency_histogram& other)
+	{
+		for (size_t i = 0; i < bucket_count; i++)
+		{
+			buckets_[i] += other.buckets_[i];
+		}
+		count_ += other.count_;
+	}
+
+	uint64_t latency_histogram::count() const
+	{
+		return count_;
+	}
+
+	uint64_t latency_histogram::bucket(size_t index) const
+	{
+		return buckets_[index];
+	}
+
+	uint64_t latency_histogram::value_at_percentile(double percentile) const
+	{
+		if (count_ == 0)
+		{
+			return 0;
+		}
+		uint64_t target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count_) + 0.5);
+		target = target == 0 ? 1 : (target > count_ ? count_ : target);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < bucket_count; i++)
+		{
+			seen += buckets_[i];
+			if (seen >= target)
+			{
+				return bucket_upper_bound(i);
+			}
+		}
+		return bucket_upper_bound(bucket_count - 1);
+	}
+
+	const operation_metrics& filesystem_metrics::operator[](filesystem_operation operation) const
+	{
+		return operations[static_cast<size_t>(operation)];
+	}
+
+	std::string filesystem_metrics::to_prometheus(const std::string& prefix) const
+	{
+		std::ostringstream out;
+		std::string calls_name = prefix + "_filesystem_operations_total";
+		out << "# HELP " << calls_name << " Number of filesystem operations.\n";
+		out << "# TYPE " << calls_name << " counter\n";
+		for (size_t i = 0; i < operations.size(); i++)
+		{
+			out << calls_name << "{operation=\"" << to_string(static_cast<filesystem_operation>(i)) << "\"} " << operations[i].calls << '\n';
+		}
+
+		std::string errors_name = prefix + "_filesystem_errors_total";
+		out << "# HELP " << errors_name << " Number of filesystem operations that failed.\n";
+		out << "# TYPE " << errors_name << " counter\n";
+		for (size_t i = 0; i < operations.size(); i++)
+		{
+			out << errors_name << "{operation=\"" << to_string(static_cast<filesystem_operation>(i)) << "\"} " << operations[i].errors << '\n';
+		}
+
+		// Exported buckets grow by a factor of 4 from 1024ns, each boundary is also a boundary of latency_histogram
+		std::string latency_name = prefix + "_filesystem_operation_duration_seconds";
+		out << "# HELP " << latency_name << " Duration of filesystem operations.\n";
+		out << "# TYPE " << latency_name << " histogram\n";
+		for (size_t i = 0; i < operations.size(); i++)
+		{
+			const operation_metrics& metrics = operations[i];
+			const char* operation = to_string(static_cast<filesystem_operation>(i));
+			uint64_t cumulative = 0;
+			size_t bucket = 0;
+			for (unsigned bit = 10; bit <= 32; bit += 2)
+			{
+				uint64_t boundary = uint64_t(1) << bit;
+				for (; bucket < latency_histogram::bucket_count && latency_histogram::bucket_upper_bound(bucket) < boundary; bucket++)
+				{
+					cumulative += metrics.latency.bucket(bucket);
+				}
+				out << latency_name << "_bucket{operation=\"" << operation << "\",le=\"" << format_seconds(static_cast<double>(boundary) / 1e9) << "\"} " << cumulative << '\n';
+			}
+			out << latency_name << "_bucket{operation=\"" << operation << "\",le=\"+Inf\"} " << metrics.latency.count() << '\n';
+			out << latency_name << "_sum{operation=\"" << operation << "\"} " << format_seconds(static_cast<double>(metrics.total_nanoseconds) / 1e9) << '\n';
+			out << latency_name << "_count{operation=\"" << operation << "\"} " << metrics.latency.count() << '\n';
+		}
+
+		out << "# HELP " << prefix << "_filesystem_read_bytes_total Number of bytes read from files.\n";
+		out << "# TYPE " << prefix << "_filesystem_read_bytes_total counter\n";
+		out << prefix << "_filesystem_read_bytes_total " << bytes_read << '\n';
+		out << "# HELP " << prefix << "_filesystem_written_bytes_total Number of bytes written to files.\n";
+		out << "# TYPE " << prefix << "_filesystem_written_bytes_total counter\n";
+		out << prefix << "_filesystem_written_bytes_total " << bytes_written << '\n';
+		out << "# HELP " << prefix << "_filesystem_open_streams Number of streams returned by open_file and still tracked.\n";
+		out << "# TYPE " << prefix << "_filesystem_open_streams gauge\n";
+		out << prefix << "_filesystem_open_streams " << open_streams << '\n';
+		return out.str();
+	}
+
+	/**
+	 * @brief Records one call, as a failure unless complete is called before it is destroyed.
+	 *
+	 */
+	class metrics_filesystem::operation_scope {
+	public:
+		operation_scope(const metrics_filesystem& fs, filesystem_operation operation)
+			: counters_(fs.local_shard().operations[static_cast<size_t>(operation)]), start_(std::chrono::steady_clock::now()), completed_(false)
+		{
+		}
+
+		~operation_scope()
+		{
+			uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+			add(counters_.calls, 1);
+			add(counters_.nanoseconds, nanoseconds);
+			add(counters_.buckets[latency_histogram::bucket_index(nanoseconds)], 1);
+			if (!completed_)
+			{
+				add(counters_.errors, 1);
+			}
+		}
+
+		operation_scope(const operation_scope&) = delete;
+		operation_scope& operator=(const operation_scope&) = delete;
+
+		void complete()
+		{
+			completed_ = true;
+		}
+	private:
+		operation_counters& counters_;
+		std::chrono::steady_clock::time_point start_;
+		bool completed_;
+	};
+
+	/**
+	 * @brief Forwards to the buffer of another stream, counting the bytes going through it.
+	 *
+	 */
+	class metrics_filesystem::counting_streambuf : public std::streambuf {
+	public:
+		counting_streambuf(const metrics_filesystem& fs, std::streambuf* inner) : fs_(fs), inner_(inner)
+		{
+		}
+	protected:
+		int_type underflow() override
+		{
+			return inner_->sgetc();
+		}
+
+		int_type uflow() override
+		{
+			int_type c = inner_->sbumpc();
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				fs_.add_bytes_read(1);
+			}
+			return c;
+		}
+
+		std::streamsize xsgetn(char_type* s, std::streamsize count) override
+		{
+			std::streamsize read = inner_->sgetn(s, count);
+			fs_.add_bytes_read(static_cast<uint64_t>(read));
+			return read;
+		}
+
+		std::streamsize showmanyc() override
+		{
+			return inner_->in_avail();
+		}
+
+		int_type pbackfail(int_type c) override
+		{
+			return traits_type::eq_int_type(c, traits_type::eof()) ? inner_->sungetc() : inner_->sputbackc(traits_type::to_char_type(c));
+		}
+
+		int_type overflow(int_type c) override
+		{
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				return traits_type::not_eof(c);
+			}
+			int_type result = inner_->sputc(traits_type::to_char_type(c));
+			if (!traits_type::eq_int_type(result, traits_type::eof()))
+			{
+				fs_.add_bytes_written(1);
+			}
+			return result;
+		}
+
+		std::streamsize xsputn(const char_type* s, std::streamsize count) override
+		{
+			std::streamsize written = inner_->sputn(s, count);
+			fs_.add_bytes_written(static_cast<uint64_t>(written));
+			return written;
+		}
+
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override
+		{
+			return inner_->pubseekoff(offset, direction, which);
+		}
+
+		pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+		{
+			return inner_->pubseekpos(position, which);
+		}
+
+		int sync() override
+		{
+			return inner_->pubsync();
+		}
+	private:
+		const metrics_filesystem& fs_;
+		std::streambuf* inner_;
+	};
+
+	class metrics_filesystem::counting_stream : public std::iostream {
+	public:
+		counting_stream(const metrics_filesystem& fs, std::iostream& inner) : std::iostream(nullptr), buffer_(fs, inner.rdbuf())
+		{
+			rdbuf(&buffer_);
+		}
+	private:
+		counting_streambuf buffer_;
+	};
+
+	class metrics_filesystem::counting_file_handle : public file_handle {
+	public:
+		counting_file_handle(const metrics_filesystem& fs, std::unique_ptr<file_handle> inner) : fs_(fs), inner_(std::move(inner))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			size_t read = inner_->read_at(offset, buffer, count);
+			fs_.add_bytes_read(read);
+			return read;
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			size_t written = inner_->write_at(offset, buffer, count);
+			fs_.add_bytes_written(written);
+			return written;
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+		{
+			size_t read = inner_->read_vectored(offset, segments);
+			fs_.add_bytes_read(read);
+			return read;
+		}
+
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			inner_->advise(offset, length, advice);
+		}
+	private:
+		const metrics_filesystem& fs_;
+		std::unique_ptr<file_handle> inner_;
+	};
+
+	metrics_filesystem::metrics_filesystem(filesystem& next) : compose_filesystem(next), id_(next_id.fetch_add(1))
+	{
+	}
+
+	metrics_filesystem::~metrics_filesystem()
+	{
+		if (cached_id == id_)
+		{
+			cached_id = 0;
+			cached_shard = nullptr;
+		}
+		thread_shards.erase(id_);
+	}
+
+	metrics_filesystem::shard& metrics_filesystem::local_shard() const
+	{
+		if (cached_id == id_)
+		{
+			return *static_cast<shard*>(cached_shard);
+		}
+
+		void*& found = thread_shards[id_];
+		if (found == nullptr)
+		{
+			std::unique_ptr<shard> created{ new shard() };
+			found = created.get();
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			shards_.push_back(std::move(created));
+		}
+		cached_id = id_;
+		cached_shard = found;
+		return *static_cast<shard*>(found);
+	}
+
+	void metrics_filesystem::add_bytes_read(uint64_t count) const
+	{
+		add(local_shard().bytes_read, count);
+	}
+
+	void metrics_filesystem::add_bytes_written(uint64_t count) const
+	{
+		add(local_shard().bytes_written, count);
+	}
+
+	void metrics_filesystem::forget_streams(const upath& path, bool recursive)
+	{
+		// Destroyed once the lock is released
+		std::vector<stream_wrappers> forgotten;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (auto it : find_path_entries(streams_, path.full_name(), recursive))
+		{
+			forgotten.push_back(std::move(it->second));
+			streams_.erase(it);
+		}
+	}
+
+	void metrics_filesystem::move_streams(const upath& src, const upath& dest, bool recursive)
+	{
+		// The streams of a file move with it, so their wrappers are kept under its new name
+		std::vector<stream_wrappers> replaced;
+		std::vector<std::pair<std::string, stream_wrappers>> moved;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		const std::string& from = src.full_name();
+		for (auto it : find_path_entries(streams_, from, recursive))
+		{
+			moved.emplace_back(dest.full_name() + it->first.substr(from.size()), std::move(it->second));
+			streams_.erase(it);
+		}
+		for (auto& file : moved)
+		{
+			stream_wrappers& wrappers = streams_[file.first];
+			replaced.push_back(std::move(wrappers));
+			wrappers = std::move(file.second);
+		}
+	}
+
+	filesystem_metrics metrics_filesystem::snapshot() const
+	{
+		filesystem_metrics metrics;
+		metrics.operations.resize(filesystem_operation_count);
+		for (operation_metrics& operation : metrics.operations)
+		{
+			operation.calls = 0;
+			operation.errors = 0;
+			operation.total_nanoseconds = 0;
+		}
+		metrics.bytes_read = 0;
+		metrics.bytes_written = 0;
+		metrics.open_streams = 0;
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (const auto& file : streams_)
+		{
+			metrics.open_streams += file.second.size();
+		}
+		for (const std::unique_ptr<shard>& shard : shards_)
+		{
+			for (size_t i = 0; i < filesystem_operation_count; i++)
+			{
+				const operation_counters& counters = shard->operations[i];
+				operation_metrics& operation = metrics.operations[i];
+				operation.calls += counters.calls.load(std::memory_order_relaxed);
+				operation.errors += counters.errors.load(std::memory_order_relaxed);
+				operation.total_nanoseconds += counters.nanoseconds.load(std::memory_order_relaxed);
+				for (size_t bucket = 0; bucket < latency_histogram::bucket_count; bucket++)
+				{
+					uint64_t count = counters.buckets[bucket].load(std::memory_order_relaxed);
+					operation.latency.buckets_[bucket] += count;
+					operation.latency.count_ += count;
+				}
+			}
+			metrics.bytes_read += shard->bytes_read.load(std::memory_order_relaxed);
+			metrics.bytes_written += shard->bytes_written.load(std::memory_order_relaxed);
+		}
+		return metrics;
+	}
+
+	void metrics_filesystem::create_directory(const upath& path)
+	{
+		operation_scope scope{ *this, filesystem_operation::create_directory };
+		compose_filesystem::create_directory(path);
+		scope.complete();
+	}
+
+	void metrics_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::create_directory };
+		compose_filesystem::create_directory(path, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	bool metrics_filesystem::directory_exists(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::directory_exists };
+		bool result = compose_filesystem::directory_exists(path);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		operation_scope scope{ *this, filesystem_operation::move_directory };
+		compose_filesystem::move_directory(src, dest);
+		move_streams(src, dest, true);
+		scope.complete();
+	}
+
+	void metrics_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		operation_scope scope{ *this, filesystem_operation::delete_directory };
+		compose_filesystem::delete_directory(path, recursive);
+		forget_streams(path, true);
+		scope.complete();
+	}
+
+	void metrics_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::delete_directory };
+		compose_filesystem::delete_directory(path, recursive, error);
+		if (!error)
+		{
+			forget_streams(path, true);
+			scope.complete();
+		}
+	}
+
+	void metrics_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		operation_scope scope{ *this, filesystem_operation::copy_file };
+		compose_filesystem::copy_file(src, dest, overwrite);
+		scope.complete();
+	}
+
+	void metrics_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::copy_file };
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	void metrics_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		operation_scope scope{ *this, filesystem_operation::replace_file };
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+		// The replaced file becomes the backup, when there is one
+		if (desk_backup.empty())
+		{
+			forget_streams(dest, false);
+		}
+		else
+		{
+			move_streams(dest, desk_backup, false);
+		}
+		move_streams(src, dest, false);
+		scope.complete();
+	}
+
+	void metrics_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		operation_scope scope{ *this, filesystem_operation::replace_file };
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+		forget_streams(dest, false);
+		move_streams(src, dest, false);
+		scope.complete();
+	}
+
+	size_t metrics_filesystem::file_length(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::file_length };
+		size_t result = compose_filesystem::file_length(path);
+		scope.complete();
+		return result;
+	}
+
+	size_t metrics_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		operation_scope scope{ *this, filesystem_operation::file_length };
+		size_t result = compose_filesystem::file_length(path, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+		return result;
+	}
+
+	bool metrics_filesystem::file_exists(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::file_exists };
+		bool result = compose_filesystem::file_exists(path);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		operation_scope scope{ *this, filesystem_operation::move_file };
+		compose_filesystem::move_file(src, dest);
+		move_streams(src, dest, false);
+		scope.complete();
+	}
+
+	void metrics_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::move_file };
+		compose_filesystem::move_file(src, dest, error);
+		if (!error)
+		{
+			move_streams(src, dest, false);
+			scope.complete();
+		}
+	}
+
+	void metrics_filesystem::delete_file(const upath& path)
+	{
+		operation_scope scope{ *this, filesystem_operation::delete_file };
+		compose_filesystem::delete_file(path);
+		forget_streams(path, false);
+		scope.complete();
+	}
+
+	void metrics_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::delete_file };
+		compose_filesystem::delete_file(path, error);
+		if (!error)
+		{
+			forget_streams(path, false);
+			scope.complete();
+		}
+	}
+
+	std::iostream& metrics_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		operation_scope scope{ *this, filesystem_operation::open_file };
+		std::iostream& inner = compose_filesystem::open_file(path, mode, access);
+
+		// A stream at the same address as one wrapped before means the earlier one was reused or destroyed by the wrapped filesystem
+		std::unique_ptr<counting_stream> wrapper{ new counting_stream(*this, inner) };
+		std::iostream& result = *wrapper;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			streams_[path.full_name()][&inner].swap(wrapper);
+		}
+		scope.complete();
+		return result;
+	}
+
+	std::unique_ptr<file_handle> metrics_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		operation_scope scope{ *this, filesystem_operation::open_handle };
+		std::unique_ptr<file_handle> result{ new counting_file_handle(*this, compose_filesystem::open_handle(path, mode, access)) };
+		scope.complete();
+		return result;
+	}
+
+	std::unique_ptr<file_handle> metrics_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		operation_scope scope{ *this, filesystem_operation::open_handle };
+		std::unique_ptr<file_handle> inner = compose_filesystem::open_handle(path, mode, access, error);
+		if (!inner)
+		{
+			return nullptr;
+		}
+		std::unique_ptr<file_handle> result{ new counting_file_handle(*this, std::move(inner)) };
+		scope.complete();
+		return result;
+	}
+
+	const std::chrono::system_clock::time_point& metrics_filesystem::creation_time(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::get_creation_time };
+		const std::chrono::system_clock::time_point& result = compose_filesystem::creation_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		operation_scope scope{ *this, filesystem_operation::set_creation_time };
+		compose_filesystem::creation_time(path, time);
+		scope.complete();
+	}
+
+	const std::chrono::system_clock::time_point& metrics_filesystem::access_time(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::get_access_time };
+		const std::chrono::system_clock::time_point& result = compose_filesystem::access_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		operation_scope scope{ *this, filesystem_operation::set_access_time };
+		compose_filesystem::access_time(path, time);
+		scope.complete();
+	}
+
+	const std::chrono::system_clock::time_point& metrics_filesystem::write_time(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::get_write_time };
+		const std::chrono::system_clock::time_point& result = compose_filesystem::write_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		operation_scope scope{ *this, filesystem_operation::set_write_time };
+		compose_filesystem::write_time(path, time);
+		scope.complete();
+	}
+
+	const upath_iterator metrics_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		operation_scope scope{ *this, filesystem_operation::enumerate_paths };
+		upath_iterator result = compose_filesystem::enumerate_paths(path, search_pattern, options, target);
+		scope.complete();
+		return result;
+	}
+
+	bool metrics_filesystem::can_watch(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::can_watch };
+		bool result = compose_filesystem::can_watch(path);
+		scope.complete();
+		return result;
+	}
+
+	const filesystem_watcher& metrics_filesystem::watch(const upath& path)
+	{
+		operation_scope scope{ *this, filesystem_operation::watch };
+		const filesystem_watcher& result = compose_filesystem::watch(path);
+		scope.complete();
+		return result;
+	}
+
+	const std::string metrics_filesystem::path_to_internal(const upath& path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::path_to_internal };
+		std::string result = compose_filesystem::path_to_internal(path);
+		scope.complete();
+		return result;
+	}
+
+	const upath& metrics_filesystem::path_from_internal(const std::string& system_path) const
+	{
+		operation_scope scope{ *this, filesystem_operation::path_from_internal };
+		const upath& result = compose_filesystem::path_from_internal(system_path);
+		scope.complete();
+		return result;
+	}
+
+	std::vector<file_stat> metrics_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		operation_scope scope{ *this, filesystem_operation::stat_many };
+		std::vector<file_stat> result = compose_filesystem::stat_many(paths);
+		scope.complete();
+		return result;
+	}
+
+	std::vector<bool> metrics_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		operation_scope scope{ *this, filesystem_operation::exists_many };
+		std::vector<bool> result = compose_filesystem::exists_many(paths);
+		scope.complete();
+		return result;
+	}
+
+	void metrics_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		operation_scope scope{ *this, filesystem_operation::delete_many };
+		compose_filesystem::delete_many(paths);
+		for (const upath& path : paths)
+		{
+			forget_streams(path, true);
+		}
+		scope.complete();
+	}
+
+	void metrics_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		operation_scope scope{ *this, filesystem_operation::create_directories };
+		compose_filesystem::create_directories(paths);
+		scope.complete();
+	}
+}
\ No newline at end of file
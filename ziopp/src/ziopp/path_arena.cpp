@@ -0,0 +1,53 @@
+#include <ziopp/path_arena.h>
+#include <cstdint>
+#include <new>
+
+namespace ziopp {
+	path_arena::path_arena(void* buffer, size_t size) : buffer_(static_cast<char*>(buffer)), size_(size), used_(0), overflows_(0)
+	{
+	}
+
+	void* path_arena::allocate(size_t size, size_t alignment)
+	{
+		uintptr_t start = reinterpret_cast<uintptr_t>(buffer_ + used_);
+		size_t padding = (alignment - start % alignment) % alignment;
+		if (size_ - used_ >= padding && size_ - used_ - padding >= size)
+		{
+			void* pointer = buffer_ + used_ + padding;
+			used_ += padding + size;
+			return pointer;
+		}
+		overflows_++;
+		return ::operator new(size);
+	}
+
+	void path_arena::deallocate(void* pointer, size_t size)
+	{
+		char* memory = static_cast<char*>(pointer);
+		if (memory < buffer_ || memory >= buffer_ + size_)
+		{
+			::operator delete(pointer);
+			return;
+		}
+		// Only the most recent allocation can be given back
+		if (memory + size == buffer_ + used_)
+		{
+			used_ -= size;
+		}
+	}
+
+	void path_arena::reset()
+	{
+		used_ = 0;
+	}
+
+	size_t path_arena::used() const
+	{
+		return used_;
+	}
+
+	size_t path_arena::overflows() const
+	{
+		return overflows_;
+	}
+}
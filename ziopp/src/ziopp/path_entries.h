@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <ziopp/upath.h>
+
+namespace ziopp {
+	namespace detail {
+		inline const std::string& path_key(const std::string& key)
+		{
+			return key;
+		}
+
+		template <typename Value>
+		const std::string& path_key(const std::pair<const std::string, Value>& entry)
+		{
+			return entry.first;
+		}
+	}
+
+	/**
+	 * @brief Finds the entries of a sorted map or set keyed by upath::full_name for a path, and for the paths below it.
+	 *
+	 * The paths below a directory do not directly follow it in such a container, "/a.txt" sorts between "/a" and "/a/b",
+	 * so the entry of the path is found on its own and those below it from the start of their prefix. Erasing some of the
+	 * entries found leaves the iterators to the others valid.
+	 *
+	 * @param entries The map or set.
+	 * @param name The full name of the path.
+	 * @param recursive Whether the entries of the paths below name are found too.
+	 * @return The iterators to the entries, in order.
+	 */
+	template <typename Container>
+	auto find_path_entries(Container& entries, const std::string& name, bool recursive) -> std::vector<decltype(entries.begin())>
+	{
+		std::vector<decltype(entries.begin())> found;
+		std::string prefix = name.size() == 1 ? name : name + upath::directory_seperator;
+		// The prefix of the root is its name, so the root is found with the paths below it
+		if (!recursive || prefix != name)
+		{
+			auto exact = entries.find(name);
+			if (exact != entries.end())
+			{
+				found.push_back(exact);
+			}
+		}
+		if (recursive)
+		{
+			for (auto it = entries.lower_bound(prefix); it != entries.end() && detail::path_key(*it).compare(0, prefix.size(), prefix) == 0; ++it)
+			{
+				found.push_back(it);
+			}
+		}
+		return found;
+	}
+}
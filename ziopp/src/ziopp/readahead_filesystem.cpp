@@ -0,0 +1,380 @@
+#include <ziopp/readahead_filesystem.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	// Shared with the handles, which can outlive the filesystem
+	struct readahead_filesystem::counters {
+		std::atomic<uint64_t> hits{ 0 };
+		std::atomic<uint64_t> misses{ 0 };
+		std::atomic<uint64_t> blocks{ 0 };
+		std::atomic<uint64_t> wasted{ 0 };
+	};
+
+	class readahead_filesystem::readahead_handle : public file_handle {
+	public:
+		readahead_handle(std::unique_ptr<file_handle> inner, const readahead_options& options, const std::shared_ptr<counters>& totals) : state_(std::make_shared<state>())
+		{
+			state_->inner = std::move(inner);
+			state_->options = options;
+			state_->options.block_size = std::max<size_t>(options.block_size, 1);
+			state_->options.initial_window = std::max<size_t>(options.initial_window, 1);
+			state_->options.max_window = std::max(options.max_window, state_->options.initial_window);
+			state_->totals = totals;
+			state_->size = state_->inner->size();
+		}
+
+		~readahead_handle()
+		{
+			std::lock_guard<std::mutex> lock{ state_->mutex };
+			state_->drop();
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			state& s = *state_;
+			const uint64_t block_size = s.options.block_size;
+			std::unique_lock<std::mutex> lock{ s.mutex };
+			// A first read from the start counts as continuing
+			if (offset == s.expected)
+			{
+				s.streak++;
+				if (s.streak >= s.options.sequential_reads)
+				{
+					if (s.window == 0)
+					{
+						s.window = s.options.initial_window;
+						s.inner->advise(0, 0, file_advice::sequential);
+					}
+					else
+					{
+						s.window = std::min(s.window * 2, s.options.max_window);
+					}
+				}
+			}
+			else
+			{
+				s.streak = 0;
+				if (s.window != 0)
+				{
+					s.window = 0;
+					s.drop();
+					s.inner->advise(0, 0, file_advice::normal);
+				}
+			}
+
+			// Serve what was read ahead, waiting for blocks being read
+			size_t done = 0;
+			while (done < count)
+			{
+				uint64_t position = offset + done;
+				auto found = s.blocks.find(position / block_size);
+				if (found == s.blocks.end())
+				{
+					break;
+				}
+				std::shared_ptr<block> current = found->second;
+				if (!current->started)
+				{
+					// Its read is still queued, maybe behind this very call on a thread of the executor, so it is read here instead
+					current->started = true;
+					lock.unlock();
+					s.fill(*current);
+					lock.lock();
+				}
+				s.loaded.wait(lock, [&current]() { return current->ready; });
+				if (current->error)
+				{
+					// Read again below, so a lasting error is thrown to the caller
+					s.blocks.erase(current->index);
+					break;
+				}
+				size_t start = static_cast<size_t>(position - current->index * block_size);
+				if (start >= current->size)
+				{
+					break;
+				}
+				size_t length = std::min(count - done, current->size - start);
+				std::memcpy(buffer + done, current->data.data() + start, length);
+				current->used = true;
+				done += length;
+				s.totals->hits += length;
+				if (current->size < block_size)
+				{
+					break;
+				}
+			}
+			s.blocks.erase(s.blocks.begin(), s.blocks.lower_bound((offset + done) / block_size));
+
+			if (done < count)
+			{
+				lock.unlock();
+				size_t read = s.inner->read_at(offset + done, buffer + done, count - done);
+				s.totals->misses += read;
+				done += read;
+				lock.lock();
+			}
+			s.expected = offset + done;
+
+			std::vector<std::shared_ptr<block>> scheduled = s.schedule();
+			lock.unlock();
+			if (!scheduled.empty())
+			{
+				uint64_t first = scheduled.front()->index * block_size;
+				s.inner->advise(first, scheduled.back()->index * block_size + block_size - first, file_advice::will_need);
+			}
+			executor& runner = s.options.work_executor != nullptr ? *s.options.work_executor : thread_pool::shared();
+			for (const std::shared_ptr<block>& next : scheduled)
+			{
+				std::shared_ptr<state> owner = state_;
+				runner.post([owner, next]() {
+					owner->load(*next);
+				});
+			}
+			return done;
+		}
+
+		size_t write_at(uint64_t, const uint8_t*, size_t) override
+		{
+			throw std::ios_base::failure("the file is open for reading", std::make_error_code(std::errc::bad_file_descriptor));
+		}
+
+		uint64_t size() const override
+		{
+			return state_->inner->size();
+		}
+
+		void sync() override
+		{
+			state_->inner->sync();
+		}
+
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			state_->inner->advise(offset, length, advice);
+		}
+	private:
+		struct block {
+			uint64_t index = 0;
+			std::vector<uint8_t> data;
+			size_t size = 0;
+			// Set once a read of the block started, on the executor or by a read_at that could not wait for it
+			bool started = false;
+			bool ready = false;
+			bool used = false;
+			std::exception_ptr error;
+		};
+
+		// Shared with the reads running on the executor, which can finish after the handle is closed
+		struct state {
+			std::unique_ptr<file_handle> inner;
+			readahead_options options;
+			std::shared_ptr<counters> totals;
+			uint64_t size = 0;
+			std::mutex mutex;
+			std::condition_variable loaded;
+			std::map<uint64_t, std::shared_ptr<block>> blocks;
+			uint64_t expected = 0;
+			size_t streak = 0;
+			size_t window = 0;
+
+			// Adds the blocks of the window missing after the expected offset, for the caller to read
+			std::vector<std::shared_ptr<block>> schedule()
+			{
+				std::vector<std::shared_ptr<block>> scheduled;
+				if (expected >= size)
+				{
+					return scheduled;
+				}
+				uint64_t first = expected / options.block_size;
+				uint64_t end = std::min<uint64_t>(first + window, (size + options.block_size - 1) / options.block_size);
+				for (uint64_t index = first; index < end; index++)
+				{
+					std::shared_ptr<block>& slot = blocks[index];
+					if (!slot)
+					{
+						slot = std::make_shared<block>();
+						slot->index = index;
+						scheduled.push_back(slot);
+					}
+				}
+				totals->blocks += scheduled.size();
+				return scheduled;
+			}
+
+			void load(block& target)
+			{
+				{
+					std::lock_guard<std::mutex> lock{ mutex };
+					if (target.started)
+					{
+						return;
+					}
+					target.started = true;
+				}
+				fill(target);
+			}
+
+			// Reads a block already marked started, called without mutex held
+			void fill(block& target)
+			{
+				std::vector<uint8_t> data(options.block_size);
+				size_t read = 0;
+				std::exception_ptr error;
+				try
+				{
+					read = inner->read_at(target.index * options.block_size, data.data(), data.size());
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				std::lock_guard<std::mutex> lock{ mutex };
+				target.data.swap(data);
+				target.size = read;
+				target.error = error;
+				target.ready = true;
+				loaded.notify_all();
+			}
+
+			// Blocks still being read are dropped too, their reads finishing into nothing
+			void drop()
+			{
+				for (const auto& entry : blocks)
+				{
+					if (!entry.second->used)
+					{
+						totals->wasted++;
+					}
+				}
+				blocks.clear();
+			}
+		};
+
+		std::shared_ptr<state> state_;
+	};
+
+	readahead_filesystem::readahead_filesystem(filesystem& next, const readahead_options& options) : compose_filesystem(next), options_(options), counters_(std::make_shared<counters>()), streams_(new detail::stream_table())
+	{
+	}
+
+	readahead_filesystem::~readahead_filesystem() = default;
+
+	readahead_statistics readahead_filesystem::statistics() const
+	{
+		readahead_statistics statistics{};
+		statistics.hits = counters_->hits;
+		statistics.misses = counters_->misses;
+		statistics.blocks = counters_->blocks;
+		statistics.wasted = counters_->wasted;
+		return statistics;
+	}
+
+	void readahead_filesystem::release(const upath& path, bool recursive)
+	{
+		// Closed at once, which drops the blocks they read ahead
+		streams_->take(path.full_name(), recursive);
+	}
+
+	void readahead_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		compose_filesystem::move_directory(src, dest);
+		release(src, true);
+	}
+
+	void readahead_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		compose_filesystem::delete_directory(path, recursive);
+		release(path, true);
+	}
+
+	void readahead_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		compose_filesystem::delete_directory(path, recursive, error);
+		if (!error)
+		{
+			release(path, true);
+		}
+	}
+
+	void readahead_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+		release(src, false);
+		release(dest, false);
+	}
+
+	void readahead_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+		release(src, false);
+		release(dest, false);
+	}
+
+	void readahead_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		compose_filesystem::move_file(src, dest);
+		release(src, false);
+	}
+
+	void readahead_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		compose_filesystem::move_file(src, dest, error);
+		if (!error)
+		{
+			release(src, false);
+		}
+	}
+
+	void readahead_filesystem::delete_file(const upath& path)
+	{
+		compose_filesystem::delete_file(path);
+		release(path, false);
+	}
+
+	void readahead_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		compose_filesystem::delete_file(path, error);
+		if (!error)
+		{
+			release(path, false);
+		}
+	}
+
+	std::iostream& readahead_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		if (access != file_access::read)
+		{
+			return compose_filesystem::open_file(path, mode, access);
+		}
+
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(open_handle(path, mode, access), false));
+	}
+
+	std::unique_ptr<file_handle> readahead_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		std::unique_ptr<file_handle> handle = compose_filesystem::open_handle(path, mode, access);
+		if (access != file_access::read)
+		{
+			return handle;
+		}
+		return std::unique_ptr<file_handle>(new readahead_handle(std::move(handle), options_, counters_));
+	}
+
+	std::unique_ptr<file_handle> readahead_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		std::unique_ptr<file_handle> handle = compose_filesystem::open_handle(path, mode, access, error);
+		if (!handle || access != file_access::read)
+		{
+			return handle;
+		}
+		return std::unique_ptr<file_handle>(new readahead_handle(std::move(handle), options_, counters_));
+	}
+}
@@ -0,0 +1,1185 @@
+#include <ziopp/recording_filesystem.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+
+namespace ziopp {
+	namespace {
+		const char log_magic[] = { 'Z', 'I', 'O', 'W', 1 };
+
+		// Operations on streams and handles, numbered after filesystem_operation
+		enum io_kind : uint8_t {
+			stream_read = 64,
+			stream_write,
+			handle_read,
+			handle_write,
+			handle_sync,
+			handle_close
+		};
+
+		void put_varint(std::string& out, uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				out += static_cast<char>(static_cast<uint8_t>(value) | 0x80);
+				value >>= 7;
+			}
+			out += static_cast<char>(value);
+		}
+
+		uint64_t zigzag(int64_t value)
+		{
+			return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+		}
+
+		int64_t unzigzag(uint64_t value)
+		{
+			return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+		}
+
+		uint64_t time_value(const std::chrono::system_clock::time_point& time)
+		{
+			return zigzag(static_cast<int64_t>(time.time_since_epoch().count()));
+		}
+
+		std::chrono::system_clock::time_point value_time(uint64_t value)
+		{
+			return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(unzigzag(value)));
+		}
+
+		class log_reader {
+		public:
+			explicit log_reader(const std::string& data) : data_(data), position_(0)
+			{
+			}
+
+			bool done() const
+			{
+				return position_ >= data_.size();
+			}
+
+			uint8_t byte()
+			{
+				if (done())
+				{
+					throw std::invalid_argument("the workload log is truncated");
+				}
+				return static_cast<uint8_t>(data_[position_++]);
+			}
+
+			uint64_t varint()
+			{
+				uint64_t value = 0;
+				for (unsigned shift = 0; shift < 64; shift += 7)
+				{
+					uint8_t next = byte();
+					value |= static_cast<uint64_t>(next & 0x7f) << shift;
+					if ((next & 0x80) == 0)
+					{
+						return value;
+					}
+				}
+				throw std::invalid_argument("the workload log has an invalid integer");
+			}
+
+			std::string text()
+			{
+				uint64_t length = varint();
+				if (length > data_.size() - position_)
+				{
+					throw std::invalid_argument("the workload log is truncated");
+				}
+				std::string value = data_.substr(position_, static_cast<size_t>(length));
+				position_ += static_cast<size_t>(length);
+				return value;
+			}
+		private:
+			const std::string& data_;
+			size_t position_;
+		};
+	}
+
+	struct recording_filesystem::record {
+		uint8_t kind;
+		bool failed;
+		uint64_t start;
+		uint64_t duration;
+		std::vector<const upath*> paths;
+		std::vector<uint64_t> values;
+		std::string text;
+	};
+
+	/**
+	 * @brief Logs one call when destroyed, as a failure unless complete was called.
+	 *
+	 */
+	class recording_filesystem::call_scope {
+	public:
+		call_scope(const recording_filesystem& fs, uint8_t kind) : fs_(fs)
+		{
+			entry_.kind = kind;
+			entry_.failed = true;
+			entry_.start = fs.elapsed();
+			fs.sequence_++;
+		}
+
+		call_scope(const recording_filesystem& fs, filesystem_operation operation) : call_scope(fs, static_cast<uint8_t>(operation))
+		{
+		}
+
+		~call_scope()
+		{
+			entry_.duration = fs_.elapsed() - entry_.start;
+			fs_.write(entry_);
+		}
+
+		call_scope(const call_scope&) = delete;
+		call_scope& operator=(const call_scope&) = delete;
+
+		call_scope& path(const upath& path)
+		{
+			entry_.paths.push_back(&path);
+			return *this;
+		}
+
+		call_scope& value(uint64_t value)
+		{
+			entry_.values.push_back(value);
+			return *this;
+		}
+
+		call_scope& text(const std::string& text)
+		{
+			entry_.text = text;
+			return *this;
+		}
+
+		void complete()
+		{
+			entry_.failed = false;
+		}
+	private:
+		const recording_filesystem& fs_;
+		record entry_;
+	};
+
+	/**
+	 * @brief Forwards to the buffer of another stream, logging reads and writes and merging the ones that follow each other.
+	 *
+	 * A single position is tracked for reads and writes, as file streams have.
+	 *
+	 */
+	class recording_filesystem::recording_streambuf : public std::streambuf {
+	public:
+		recording_streambuf(const recording_filesystem& fs, std::streambuf* inner, uint64_t id)
+			: fs_(fs), inner_(inner), id_(id), position_known_(false), position_(0), pending_(false), pending_kind_(0), pending_offset_(0), pending_size_(0), pending_start_(0), pending_duration_(0), pending_sequence_(0)
+		{
+		}
+
+		void flush_pending()
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			write_pending();
+		}
+	protected:
+		int_type underflow() override
+		{
+			return inner_->sgetc();
+		}
+
+		int_type uflow() override
+		{
+			uint64_t offset = position();
+			uint64_t start = fs_.elapsed();
+			int_type c = inner_->sbumpc();
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				transferred(stream_read, offset, 1, start);
+			}
+			return c;
+		}
+
+		std::streamsize xsgetn(char_type* s, std::streamsize count) override
+		{
+			uint64_t offset = position();
+			uint64_t start = fs_.elapsed();
+			std::streamsize read = inner_->sgetn(s, count);
+			if (read > 0)
+			{
+				transferred(stream_read, offset, static_cast<uint64_t>(read), start);
+			}
+			return read;
+		}
+
+		std::streamsize showmanyc() override
+		{
+			return inner_->in_avail();
+		}
+
+		int_type pbackfail(int_type c) override
+		{
+			int_type result = traits_type::eq_int_type(c, traits_type::eof()) ? inner_->sungetc() : inner_->sputbackc(traits_type::to_char_type(c));
+			if (!traits_type::eq_int_type(result, traits_type::eof()))
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				position_ = position_ > 0 ? position_ - 1 : 0;
+			}
+			return result;
+		}
+
+		int_type overflow(int_type c) override
+		{
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				return traits_type::not_eof(c);
+			}
+			uint64_t offset = position();
+			uint64_t start = fs_.elapsed();
+			int_type result = inner_->sputc(traits_type::to_char_type(c));
+			if (!traits_type::eq_int_type(result, traits_type::eof()))
+			{
+				transferred(stream_write, offset, 1, start);
+			}
+			return result;
+		}
+
+		std::streamsize xsputn(const char_type* s, std::streamsize count) override
+		{
+			uint64_t offset = position();
+			uint64_t start = fs_.elapsed();
+			std::streamsize written = inner_->sputn(s, count);
+			if (written > 0)
+			{
+				transferred(stream_write, offset, static_cast<uint64_t>(written), start);
+			}
+			return written;
+		}
+
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override
+		{
+			return moved(inner_->pubseekoff(offset, direction, which));
+		}
+
+		pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+		{
+			return moved(inner_->pubseekpos(position, which));
+		}
+
+		int sync() override
+		{
+			return inner_->pubsync();
+		}
+	private:
+		uint64_t position()
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			if (!position_known_)
+			{
+				pos_type current = inner_->pubseekoff(0, std::ios_base::cur, std::ios_base::in | std::ios_base::out);
+				position_ = current == pos_type(off_type(-1)) ? 0 : static_cast<uint64_t>(off_type(current));
+				position_known_ = true;
+			}
+			return position_;
+		}
+
+		pos_type moved(pos_type result)
+		{
+			if (result != pos_type(off_type(-1)))
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				position_ = static_cast<uint64_t>(off_type(result));
+				position_known_ = true;
+			}
+			return result;
+		}
+
+		void transferred(uint8_t kind, uint64_t offset, uint64_t count, uint64_t start)
+		{
+			uint64_t duration = fs_.elapsed() - start;
+			std::lock_guard<std::mutex> lock{ mutex_ };
+
+			// Only merge with the previous transfer when nothing else was logged in between, so merged records keep the order of calls
+			if (pending_ && pending_kind_ == kind && pending_offset_ + pending_size_ == offset && fs_.sequence_.load() == pending_sequence_)
+			{
+				pending_size_ += count;
+				pending_duration_ += duration;
+			}
+			else
+			{
+				write_pending();
+				pending_ = true;
+				pending_kind_ = kind;
+				pending_offset_ = offset;
+				pending_size_ = count;
+				pending_start_ = start;
+				pending_duration_ = duration;
+				pending_sequence_ = ++fs_.sequence_;
+			}
+			position_ = offset + count;
+		}
+
+		void write_pending()
+		{
+			if (!pending_)
+			{
+				return;
+			}
+			record entry;
+			entry.kind = pending_kind_;
+			entry.failed = false;
+			entry.start = pending_start_;
+			entry.duration = pending_duration_;
+			entry.values = { id_, pending_offset_, pending_size_ };
+			fs_.write(entry);
+			pending_ = false;
+		}
+
+		const recording_filesystem& fs_;
+		std::streambuf* inner_;
+		const uint64_t id_;
+		std::mutex mutex_;
+		bool position_known_;
+		uint64_t position_;
+		bool pending_;
+		uint8_t pending_kind_;
+		uint64_t pending_offset_;
+		uint64_t pending_size_;
+		uint64_t pending_start_;
+		uint64_t pending_duration_;
+		uint64_t pending_sequence_;
+	};
+
+	class recording_filesystem::recording_stream : public std::iostream {
+	public:
+		recording_stream(const recording_filesystem& fs, std::iostream& inner, uint64_t id) : std::iostream(nullptr), buffer_(fs, inner.rdbuf(), id)
+		{
+			rdbuf(&buffer_);
+		}
+
+		void flush_pending()
+		{
+			buffer_.flush_pending();
+		}
+	private:
+		recording_streambuf buffer_;
+	};
+
+	class recording_filesystem::recording_file_handle : public file_handle {
+	public:
+		recording_file_handle(const recording_filesystem& fs, std::unique_ptr<file_handle> inner, uint64_t id) : fs_(fs), inner_(std::move(inner)), id_(id)
+		{
+		}
+
+		~recording_file_handle()
+		{
+			call_scope scope{ fs_, handle_close };
+			scope.value(id_).complete();
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			call_scope scope{ fs_, handle_read };
+			scope.value(id_).value(offset).value(count);
+			size_t read = inner_->read_at(offset, buffer, count);
+			scope.complete();
+			return read;
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			call_scope scope{ fs_, handle_write };
+			scope.value(id_).value(offset).value(count);
+			size_t written = inner_->write_at(offset, buffer, count);
+			scope.complete();
+			return written;
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			call_scope scope{ fs_, handle_sync };
+			scope.value(id_);
+			inner_->sync();
+			scope.complete();
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+		{
+			size_t total = 0;
+			for (const io_segment& segment : segments)
+			{
+				total += segment.length;
+			}
+			call_scope scope{ fs_, handle_read };
+			scope.value(id_).value(offset).value(total);
+			size_t read = inner_->read_vectored(offset, segments);
+			scope.complete();
+			return read;
+		}
+
+		// Hints change no data, so they are passed on without being recorded
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			inner_->advise(offset, length, advice);
+		}
+	private:
+		const recording_filesystem& fs_;
+		std::unique_ptr<file_handle> inner_;
+		const uint64_t id_;
+	};
+
+	recording_filesystem::recording_filesystem(filesystem& next, std::ostream& log)
+		: compose_filesystem(next), log_(log), start_(std::chrono::steady_clock::now()), previous_start_(0), sequence_(0), next_io_id_(0)
+	{
+		log_.write(log_magic, sizeof(log_magic));
+	}
+
+	recording_filesystem::~recording_filesystem()
+	{
+		flush();
+	}
+
+	void recording_filesystem::flush()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ streams_mutex_ };
+			for (auto& stream : streams_)
+			{
+				stream.second->flush_pending();
+			}
+		}
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		log_.flush();
+	}
+
+	uint64_t recording_filesystem::elapsed() const
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+	}
+
+	uint64_t recording_filesystem::next_io_id()
+	{
+		return next_io_id_++;
+	}
+
+	void recording_filesystem::write(const record& entry) const
+	{
+		std::string out;
+		std::lock_guard<std::mutex> lock{ mutex_ };
+
+		// Records are written when calls end, so starts are not always increasing
+		out += static_cast<char>(entry.kind);
+		out += static_cast<char>(entry.failed ? 1 : 0);
+		put_varint(out, zigzag(static_cast<int64_t>(entry.start - previous_start_)));
+		put_varint(out, entry.duration);
+		previous_start_ = entry.start;
+
+		put_varint(out, entry.paths.size());
+		for (const upath* path : entry.paths)
+		{
+			auto found = path_ids_.find(path->full_name());
+			if (found != path_ids_.end())
+			{
+				put_varint(out, found->second + 1);
+			}
+			else
+			{
+				put_varint(out, 0);
+				put_varint(out, path->full_name().size());
+				out += path->full_name();
+				path_ids_.emplace(path->full_name(), path_ids_.size());
+			}
+		}
+		put_varint(out, entry.values.size());
+		for (uint64_t value : entry.values)
+		{
+			put_varint(out, value);
+		}
+		put_varint(out, entry.text.size());
+		out += entry.text;
+		log_.write(out.data(), static_cast<std::streamsize>(out.size()));
+	}
+
+	void recording_filesystem::create_directory(const upath& path)
+	{
+		call_scope scope{ *this, filesystem_operation::create_directory };
+		scope.path(path);
+		compose_filesystem::create_directory(path);
+		scope.complete();
+	}
+
+	void recording_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::create_directory };
+		scope.path(path);
+		compose_filesystem::create_directory(path, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	bool recording_filesystem::directory_exists(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::directory_exists };
+		scope.path(path);
+		bool result = compose_filesystem::directory_exists(path);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		call_scope scope{ *this, filesystem_operation::move_directory };
+		scope.path(src).path(dest);
+		compose_filesystem::move_directory(src, dest);
+		scope.complete();
+	}
+
+	void recording_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		call_scope scope{ *this, filesystem_operation::delete_directory };
+		scope.path(path).value(recursive ? 1 : 0);
+		compose_filesystem::delete_directory(path, recursive);
+		scope.complete();
+	}
+
+	void recording_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::delete_directory };
+		scope.path(path).value(recursive ? 1 : 0);
+		compose_filesystem::delete_directory(path, recursive, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	void recording_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		call_scope scope{ *this, filesystem_operation::copy_file };
+		scope.path(src).path(dest).value(overwrite ? 1 : 0);
+		compose_filesystem::copy_file(src, dest, overwrite);
+		scope.complete();
+	}
+
+	void recording_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::copy_file };
+		scope.path(src).path(dest).value(overwrite ? 1 : 0);
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	void recording_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		call_scope scope{ *this, filesystem_operation::replace_file };
+		scope.path(src).path(dest).path(desk_backup).value(ignore_metadata_errors ? 1 : 0);
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+		scope.complete();
+	}
+
+	void recording_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		call_scope scope{ *this, filesystem_operation::replace_file };
+		scope.path(src).path(dest).value(ignore_metadata_errors ? 1 : 0);
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+		scope.complete();
+	}
+
+	size_t recording_filesystem::file_length(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::file_length };
+		scope.path(path);
+		size_t result = compose_filesystem::file_length(path);
+		scope.complete();
+		return result;
+	}
+
+	size_t recording_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		call_scope scope{ *this, filesystem_operation::file_length };
+		scope.path(path);
+		size_t result = compose_filesystem::file_length(path, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+		return result;
+	}
+
+	bool recording_filesystem::file_exists(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::file_exists };
+		scope.path(path);
+		bool result = compose_filesystem::file_exists(path);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		call_scope scope{ *this, filesystem_operation::move_file };
+		scope.path(src).path(dest);
+		compose_filesystem::move_file(src, dest);
+		scope.complete();
+	}
+
+	void recording_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::move_file };
+		scope.path(src).path(dest);
+		compose_filesystem::move_file(src, dest, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	void recording_filesystem::delete_file(const upath& path)
+	{
+		call_scope scope{ *this, filesystem_operation::delete_file };
+		scope.path(path);
+		compose_filesystem::delete_file(path);
+		scope.complete();
+	}
+
+	void recording_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::delete_file };
+		scope.path(path);
+		compose_filesystem::delete_file(path, error);
+		if (!error)
+		{
+			scope.complete();
+		}
+	}
+
+	std::iostream& recording_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		call_scope scope{ *this, filesystem_operation::open_file };
+		scope.path(path).value(static_cast<uint64_t>(mode)).value(static_cast<uint64_t>(access));
+		std::iostream& inner = compose_filesystem::open_file(path, mode, access);
+
+		// A stream at the same address as one wrapped before means the earlier one was destroyed by the wrapped filesystem
+		uint64_t id = next_io_id();
+		std::unique_ptr<recording_stream> wrapper{ new recording_stream(*this, inner, id) };
+		std::iostream& result = *wrapper;
+		{
+			std::lock_guard<std::mutex> lock{ streams_mutex_ };
+			std::unique_ptr<recording_stream>& slot = streams_[&inner];
+			if (slot)
+			{
+				slot->flush_pending();
+			}
+			slot = std::move(wrapper);
+		}
+		scope.value(id).complete();
+		return result;
+	}
+
+	std::unique_ptr<file_handle> recording_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		call_scope scope{ *this, filesystem_operation::open_handle };
+		scope.path(path).value(static_cast<uint64_t>(mode)).value(static_cast<uint64_t>(access));
+		std::unique_ptr<file_handle> inner = compose_filesystem::open_handle(path, mode, access);
+		uint64_t id = next_io_id();
+		scope.value(id).complete();
+		return std::unique_ptr<file_handle>(new recording_file_handle(*this, std::move(inner), id));
+	}
+
+	std::unique_ptr<file_handle> recording_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		call_scope scope{ *this, filesystem_operation::open_handle };
+		scope.path(path).value(static_cast<uint64_t>(mode)).value(static_cast<uint64_t>(access));
+		std::unique_ptr<file_handle> inner = compose_filesystem::open_handle(path, mode, access, error);
+		if (!inner)
+		{
+			return nullptr;
+		}
+		uint64_t id = next_io_id();
+		scope.value(id).complete();
+		return std::unique_ptr<file_handle>(new recording_file_handle(*this, std::move(inner), id));
+	}
+
+	const std::chrono::system_clock::time_point& recording_filesystem::creation_time(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::get_creation_time };
+		scope.path(path);
+		const std::chrono::system_clock::time_point& result = compose_filesystem::creation_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		call_scope scope{ *this, filesystem_operation::set_creation_time };
+		scope.path(path).value(time_value(time));
+		compose_filesystem::creation_time(path, time);
+		scope.complete();
+	}
+
+	const std::chrono::system_clock::time_point& recording_filesystem::access_time(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::get_access_time };
+		scope.path(path);
+		const std::chrono::system_clock::time_point& result = compose_filesystem::access_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		call_scope scope{ *this, filesystem_operation::set_access_time };
+		scope.path(path).value(time_value(time));
+		compose_filesystem::access_time(path, time);
+		scope.complete();
+	}
+
+	const std::chrono::system_clock::time_point& recording_filesystem::write_time(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::get_write_time };
+		scope.path(path);
+		const std::chrono::system_clock::time_point& result = compose_filesystem::write_time(path);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		call_scope scope{ *this, filesystem_operation::set_write_time };
+		scope.path(path).value(time_value(time));
+		compose_filesystem::write_time(path, time);
+		scope.complete();
+	}
+
+	const upath_iterator recording_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		call_scope scope{ *this, filesystem_operation::enumerate_paths };
+		scope.path(path).value(static_cast<uint64_t>(options)).value(static_cast<uint64_t>(target)).text(search_pattern);
+		upath_iterator result = compose_filesystem::enumerate_paths(path, search_pattern, options, target);
+		scope.complete();
+		return result;
+	}
+
+	bool recording_filesystem::can_watch(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::can_watch };
+		scope.path(path);
+		bool result = compose_filesystem::can_watch(path);
+		scope.complete();
+		return result;
+	}
+
+	const filesystem_watcher& recording_filesystem::watch(const upath& path)
+	{
+		call_scope scope{ *this, filesystem_operation::watch };
+		scope.path(path);
+		const filesystem_watcher& result = compose_filesystem::watch(path);
+		scope.complete();
+		return result;
+	}
+
+	const std::string recording_filesystem::path_to_internal(const upath& path) const
+	{
+		call_scope scope{ *this, filesystem_operation::path_to_internal };
+		scope.path(path);
+		std::string result = compose_filesystem::path_to_internal(path);
+		scope.complete();
+		return result;
+	}
+
+	const upath& recording_filesystem::path_from_internal(const std::string& system_path) const
+	{
+		call_scope scope{ *this, filesystem_operation::path_from_internal };
+		scope.text(system_path);
+		const upath& result = compose_filesystem::path_from_internal(system_path);
+		scope.complete();
+		return result;
+	}
+
+	std::vector<file_stat> recording_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		call_scope scope{ *this, filesystem_operation::stat_many };
+		for (const upath& path : paths)
+		{
+			scope.path(path);
+		}
+		std::vector<file_stat> result = compose_filesystem::stat_many(paths);
+		scope.complete();
+		return result;
+	}
+
+	std::vector<bool> recording_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		call_scope scope{ *this, filesystem_operation::exists_many };
+		for (const upath& path : paths)
+		{
+			scope.path(path);
+		}
+		std::vector<bool> result = compose_filesystem::exists_many(paths);
+		scope.complete();
+		return result;
+	}
+
+	void recording_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		call_scope scope{ *this, filesystem_operation::delete_many };
+		for (const upath& path : paths)
+		{
+			scope.path(path);
+		}
+		compose_filesystem::delete_many(paths);
+		scope.complete();
+	}
+
+	void recording_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		call_scope scope{ *this, filesystem_operation::create_directories };
+		for (const upath& path : paths)
+		{
+			scope.path(path);
+		}
+		compose_filesystem::create_directories(paths);
+		scope.complete();
+	}
+
+	double replay_result::operations_per_second() const
+	{
+		return elapsed.count() > 0 ? static_cast<double>(operations) * 1e9 / static_cast<double>(elapsed.count()) : 0.0;
+	}
+
+	double replay_result::bytes_per_second() const
+	{
+		return elapsed.count() > 0 ? static_cast<double>(bytes_read + bytes_written) * 1e9 / static_cast<double>(elapsed.count()) : 0.0;
+	}
+
+	workload_replayer::workload_replayer(std::istream& log)
+	{
+		std::string data{ std::istreambuf_iterator<char>(log), std::istreambuf_iterator<char>() };
+		if (data.compare(0, sizeof(log_magic), log_magic, sizeof(log_magic)) != 0)
+		{
+			throw std::invalid_argument("the stream does not contain a workload log");
+		}
+		std::string body = data.substr(sizeof(log_magic));
+
+		log_reader reader{ body };
+		uint64_t start = 0;
+		while (!reader.done())
+		{
+			record entry;
+			entry.kind = reader.byte();
+			entry.failed = reader.byte() != 0;
+			start += static_cast<uint64_t>(unzigzag(reader.varint()));
+			entry.start = start;
+			reader.varint();
+
+			uint64_t path_count = reader.varint();
+			for (uint64_t i = 0; i < path_count; i++)
+			{
+				uint64_t reference = reader.varint();
+				if (reference == 0)
+				{
+					paths_.push_back(upath{ reader.text() });
+					reference = paths_.size();
+				}
+				if (reference > paths_.size())
+				{
+					throw std::invalid_argument("the workload log refers to an unknown path");
+				}
+				entry.paths.push_back(static_cast<size_t>(reference - 1));
+			}
+			uint64_t value_count = reader.varint();
+			for (uint64_t i = 0; i < value_count; i++)
+			{
+				entry.values.push_back(reader.varint());
+			}
+			entry.text = reader.text();
+			records_.push_back(entry);
+		}
+
+		// Records are logged when calls end, and merged reads and writes later still, so they are put back in the order calls started
+		std::stable_sort(records_.begin(), records_.end(), [](const record& lhs, const record& rhs) {
+			return lhs.start < rhs.start;
+		});
+	}
+
+	size_t workload_replayer::size() const
+	{
+		return records_.size();
+	}
+
+	struct workload_replayer::replay_state {
+		std::map<uint64_t, std::iostream*> streams;
+		std::map<uint64_t, uint64_t> positions;
+		std::map<uint64_t, std::unique_ptr<file_handle>> handles;
+		std::vector<uint8_t> buffer;
+		uint64_t bytes_read = 0;
+		uint64_t bytes_written = 0;
+	};
+
+	replay_result workload_replayer::replay(filesystem& fs, const replay_options& options) const
+	{
+		replay_result result;
+		result.operations = 0;
+		result.mismatched_errors = 0;
+		result.filesystem_operations.resize(filesystem_operation_count);
+		for (operation_metrics& operation : result.filesystem_operations)
+		{
+			operation.calls = 0;
+			operation.errors = 0;
+			operation.total_nanoseconds = 0;
+		}
+
+		replay_state state;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (const record& entry : records_)
+		{
+			if (options.pacing == replay_pacing::original)
+			{
+				std::this_thread::sleep_until(begin + std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(entry.start) / options.speed)));
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool failed = false;
+			try
+			{
+				execute(fs, entry, state);
+			}
+			catch (...)
+			{
+				failed = true;
+			}
+			uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+			result.operations++;
+			result.latency.record(nanoseconds);
+			if (failed != entry.failed)
+			{
+				result.mismatched_errors++;
+			}
+			if (entry.kind < filesystem_operation_count)
+			{
+				operation_metrics& operation = result.filesystem_operations[entry.kind];
+				operation.calls++;
+				operation.errors += failed ? 1 : 0;
+				operation.total_nanoseconds += nanoseconds;
+				operation.latency.record(nanoseconds);
+			}
+		}
+		result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+		result.bytes_read = state.bytes_read;
+		result.bytes_written = state.bytes_written;
+		return result;
+	}
+
+	void workload_replayer::execute(filesystem& fs, const record& entry, replay_state& state) const
+	{
+		auto path = [&](size_t index) -> const upath& {
+			if (index >= entry.paths.size())
+			{
+				throw std::invalid_argument("the workload log record is missing a path");
+			}
+			return paths_[entry.paths[index]];
+		};
+		auto value = [&](size_t index) -> uint64_t {
+			if (index >= entry.values.size())
+			{
+				throw std::invalid_argument("the workload log record is missing a value");
+			}
+			return entry.values[index];
+		};
+		auto all_paths = [&]() {
+			std::vector<upath> paths;
+			for (size_t index : entry.paths)
+			{
+				paths.push_back(paths_[index]);
+			}
+			return paths;
+		};
+		auto reserve = [&](uint64_t size) -> uint8_t* {
+			if (state.buffer.size() < size)
+			{
+				state.buffer.resize(static_cast<size_t>(size));
+			}
+			return state.buffer.data();
+		};
+
+		switch (entry.kind)
+		{
+			case static_cast<uint8_t>(filesystem_operation::create_directory):
+				fs.create_directory(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::directory_exists):
+				fs.directory_exists(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::move_directory):
+				fs.move_directory(path(0), path(1));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::delete_directory):
+				fs.delete_directory(path(0), value(0) != 0);
+				break;
+			case static_cast<uint8_t>(filesystem_operation::copy_file):
+				fs.copy_file(path(0), path(1), value(0) != 0);
+				break;
+			case static_cast<uint8_t>(filesystem_operation::replace_file):
+				if (entry.paths.size() == 3)
+				{
+					fs.replace_file(path(0), path(1), path(2), value(0) != 0);
+				}
+				else
+				{
+					fs.replace_file(path(0), path(1), value(0) != 0);
+				}
+				break;
+			case static_cast<uint8_t>(filesystem_operation::file_length):
+				fs.file_length(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::file_exists):
+				fs.file_exists(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::move_file):
+				fs.move_file(path(0), path(1));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::delete_file):
+				fs.delete_file(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::open_file):
+			{
+				// Later reads and writes of a stream that failed to open fail as well
+				uint64_t id = entry.values.size() > 2 ? value(2) : UINT64_MAX;
+				std::iostream*& stream = state.streams[id];
+				stream = nullptr;
+				state.positions.erase(id);
+				stream = &fs.open_file(path(0), static_cast<file_mode>(value(0)), static_cast<file_access>(value(1)));
+				break;
+			}
+			case static_cast<uint8_t>(filesystem_operation::open_handle):
+			{
+				std::unique_ptr<file_handle>& handle = state.handles[entry.values.size() > 2 ? value(2) : UINT64_MAX];
+				handle.reset();
+				handle = fs.open_handle(path(0), static_cast<file_mode>(value(0)), static_cast<file_access>(value(1)));
+				break;
+			}
+			case static_cast<uint8_t>(filesystem_operation::get_creation_time):
+				fs.creation_time(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::set_creation_time):
+				fs.creation_time(path(0), value_time(value(0)));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::get_access_time):
+				fs.access_time(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::set_access_time):
+				fs.access_time(path(0), value_time(value(0)));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::get_write_time):
+				fs.write_time(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::set_write_time):
+				fs.write_time(path(0), value_time(value(0)));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::enumerate_paths):
+			{
+				upath_iterator paths = fs.enumerate_paths(path(0), entry.text, static_cast<search_options>(value(0)), static_cast<search_target>(value(1)));
+				for (upath_iterator end{}; paths != end; ++paths)
+				{
+				}
+				break;
+			}
+			case static_cast<uint8_t>(filesystem_operation::can_watch):
+				fs.can_watch(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::watch):
+				fs.watch(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::path_to_internal):
+				fs.path_to_internal(path(0));
+				break;
+			case static_cast<uint8_t>(filesystem_operation::path_from_internal):
+				fs.path_from_internal(entry.text);
+				break;
+			case static_cast<uint8_t>(filesystem_operation::stat_many):
+				fs.stat_many(all_paths());
+				break;
+			case static_cast<uint8_t>(filesystem_operation::exists_many):
+				fs.exists_many(all_paths());
+				break;
+			case static_cast<uint8_t>(filesystem_operation::delete_many):
+				fs.delete_many(all_paths());
+				break;
+			case static_cast<uint8_t>(filesystem_operation::create_directories):
+				fs.create_directories(all_paths());
+				break;
+			case stream_read:
+			case stream_write:
+			{
+				auto found = state.streams.find(value(0));
+				if (found == state.streams.end() || found->second == nullptr)
+				{
+					throw std::ios_base::failure("the stream was not opened");
+				}
+				std::iostream& stream = *found->second;
+				uint64_t offset = value(1);
+				uint64_t size = value(2);
+				auto position = state.positions.find(value(0));
+				if (position == state.positions.end() || position->second != offset)
+				{
+					stream.clear();
+					stream.rdbuf()->pubseekpos(static_cast<std::streamoff>(offset));
+				}
+				uint8_t* buffer = reserve(size);
+				if (entry.kind == stream_read)
+				{
+					state.bytes_read += static_cast<uint64_t>(stream.rdbuf()->sgetn(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size)));
+				}
+				else
+				{
+					state.bytes_written += static_cast<uint64_t>(stream.rdbuf()->sputn(reinterpret_cast<const char*>(buffer), static_cast<std::streamsize>(size)));
+				}
+				state.positions[value(0)] = offset + size;
+				break;
+			}
+			case handle_read:
+			case handle_write:
+			case handle_sync:
+			case handle_close:
+			{
+				auto found = state.handles.find(value(0));
+				if (found == state.handles.end() || !found->second)
+				{
+					throw std::ios_base::failure("the handle was not opened");
+				}
+				file_handle& handle = *found->second;
+				if (entry.kind == handle_read)
+				{
+					state.bytes_read += handle.read_at(value(1), reserve(value(2)), static_cast<size_t>(value(2)));
+				}
+				else if (entry.kind == handle_write)
+				{
+					state.bytes_written += handle.write_at(value(1), reserve(value(2)), static_cast<size_t>(value(2)));
+				}
+				else if (entry.kind == handle_sync)
+				{
+					handle.sync();
+				}
+				else
+				{
+					state.handles.erase(found);
+				}
+				break;
+			}
+			default:
+				throw std::invalid_argument("the workload log has an unknown record");
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include <ziopp/scheduled_filesystem.h>
+#include <algorithm>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	class scheduled_filesystem::scheduled_handle : public file_handle {
+	public:
+		scheduled_handle(io_scheduler& scheduler, std::unique_ptr<file_handle> inner)
+			: scheduler_(scheduler), inner_(std::move(inner)), piece_(std::max<size_t>(scheduler.options().max_request_size, 1))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			size_t done = 0;
+			while (done < count)
+			{
+				size_t length = std::min(count - done, piece_);
+				size_t read;
+				{
+					io_request request{ scheduler_, length };
+					read = inner_->read_at(offset + done, buffer + done, length);
+				}
+				done += read;
+				if (read < length)
+				{
+					break;
+				}
+			}
+			return done;
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			size_t done = 0;
+			while (done < count)
+			{
+				size_t length = std::min(count - done, piece_);
+				size_t written;
+				{
+					io_request request{ scheduler_, length };
+					written = inner_->write_at(offset + done, buffer + done, length);
+				}
+				done += written;
+				if (written < length)
+				{
+					break;
+				}
+			}
+			return done;
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			io_request request{ scheduler_, 0 };
+			inner_->sync();
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+		{
+			size_t total = 0;
+			for (const io_segment& segment : segments)
+			{
+				total += segment.length;
+			}
+			if (total > piece_)
+			{
+				// Read into one buffer through read_at, which splits it
+				return file_handle::read_vectored(offset, segments);
+			}
+			io_request request{ scheduler_, total };
+			return inner_->read_vectored(offset, segments);
+		}
+
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			inner_->advise(offset, length, advice);
+		}
+	private:
+		io_scheduler& scheduler_;
+		std::unique_ptr<file_handle> inner_;
+		const size_t piece_;
+	};
+
+	scheduled_filesystem::scheduled_filesystem(filesystem& next, io_scheduler& scheduler) : compose_filesystem(next), scheduler_(scheduler), streams_(new detail::stream_table())
+	{
+	}
+
+	scheduled_filesystem::~scheduled_filesystem() = default;
+
+	io_scheduler& scheduled_filesystem::scheduler() const
+	{
+		return scheduler_;
+	}
+
+	void scheduled_filesystem::release(const upath& path, bool recursive)
+	{
+		// Closed at once, which drops their scheduled handles
+		streams_->take(path.full_name(), recursive);
+	}
+
+	void scheduled_filesystem::create_directory(const upath& path)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::create_directory(path);
+	}
+
+	void scheduled_filesystem::create_directory(const upath& path, std::error_code& error)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::create_directory(path, error);
+	}
+
+	bool scheduled_filesystem::directory_exists(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::directory_exists(path);
+	}
+
+	void scheduled_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::move_directory(src, dest);
+		}
+		release(src, true);
+	}
+
+	void scheduled_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::delete_directory(path, recursive);
+		}
+		release(path, true);
+	}
+
+	void scheduled_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::delete_directory(path, recursive, error);
+		}
+		if (!error)
+		{
+			release(path, true);
+		}
+	}
+
+	void scheduled_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		// The copy is one request, counted against the bandwidth limit for the length of the file
+		std::error_code ignored;
+		uint64_t length = compose_filesystem::file_length(src, ignored);
+		io_request request{ scheduler_, length };
+		compose_filesystem::copy_file(src, dest, overwrite);
+	}
+
+	void scheduled_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		std::error_code ignored;
+		uint64_t length = compose_filesystem::file_length(src, ignored);
+		io_request request{ scheduler_, length };
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+	}
+
+	void scheduled_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+		}
+		release(src, false);
+		release(dest, false);
+	}
+
+	void scheduled_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+		}
+		release(src, false);
+		release(dest, false);
+	}
+
+	size_t scheduled_filesystem::file_length(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::file_length(path);
+	}
+
+	size_t scheduled_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::file_length(path, error);
+	}
+
+	bool scheduled_filesystem::file_exists(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::file_exists(path);
+	}
+
+	void scheduled_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::move_file(src, dest);
+		}
+		release(src, false);
+	}
+
+	void scheduled_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::move_file(src, dest, error);
+		}
+		if (!error)
+		{
+			release(src, false);
+		}
+	}
+
+	void scheduled_filesystem::delete_file(const upath& path)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::delete_file(path);
+		}
+		release(path, false);
+	}
+
+	void scheduled_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::delete_file(path, error);
+		}
+		if (!error)
+		{
+			release(path, false);
+		}
+	}
+
+	std::iostream& scheduled_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		if (access != file_access::read)
+		{
+			io_request request{ scheduler_, 0 };
+			return compose_filesystem::open_file(path, mode, access);
+		}
+
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(open_handle(path, mode, access), false));
+	}
+
+	std::unique_ptr<file_handle> scheduled_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		std::unique_ptr<file_handle> handle;
+		{
+			io_request request{ scheduler_, 0 };
+			handle = compose_filesystem::open_handle(path, mode, access);
+		}
+		return std::unique_ptr<file_handle>(new scheduled_handle(scheduler_, std::move(handle)));
+	}
+
+	std::unique_ptr<file_handle> scheduled_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		std::unique_ptr<file_handle> handle;
+		{
+			io_request request{ scheduler_, 0 };
+			handle = compose_filesystem::open_handle(path, mode, access, error);
+		}
+		if (!handle)
+		{
+			return nullptr;
+		}
+		return std::unique_ptr<file_handle>(new scheduled_handle(scheduler_, std::move(handle)));
+	}
+
+	const std::chrono::system_clock::time_point& scheduled_filesystem::creation_time(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::creation_time(path);
+	}
+
+	void scheduled_filesystem::creation_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::creation_time(path, time);
+	}
+
+	const std::chrono::system_clock::time_point& scheduled_filesystem::access_time(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::access_time(path);
+	}
+
+	void scheduled_filesystem::access_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::access_time(path, time);
+	}
+
+	const std::chrono::system_clock::time_point& scheduled_filesystem::write_time(const upath& path) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::write_time(path);
+	}
+
+	void scheduled_filesystem::write_time(const upath& path, const std::chrono::system_clock::time_point& time)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::write_time(path, time);
+	}
+
+	const upath_iterator scheduled_filesystem::enumerate_paths(const upath& path, const std::string& search_pattern, search_options options, search_target target) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::enumerate_paths(path, search_pattern, options, target);
+	}
+
+	std::vector<file_stat> scheduled_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::stat_many(paths);
+	}
+
+	std::vector<bool> scheduled_filesystem::exists_many(const std::vector<upath>& paths) const
+	{
+		io_request request{ scheduler_, 0 };
+		return compose_filesystem::exists_many(paths);
+	}
+
+	void scheduled_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		{
+			io_request request{ scheduler_, 0 };
+			compose_filesystem::delete_many(paths);
+		}
+		for (const upath& path : paths)
+		{
+			release(path, false);
+		}
+	}
+
+	void scheduled_filesystem::create_directories(const std::vector<upath>& paths)
+	{
+		io_request request{ scheduler_, 0 };
+		compose_filesystem::create_directories(paths);
+	}
+}
@@ -0,0 +1,63 @@
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	namespace detail {
+		void stream_table::close(const std::string& name, file_mode mode, file_access access)
+		{
+			take(name, false, mode, access);
+		}
+
+		std::iostream& stream_table::keep(const std::string& name, file_mode mode, file_access access, std::shared_ptr<std::iostream> stream)
+		{
+			std::iostream& kept = *stream;
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				streams_[name][key{ mode, access }].swap(stream);
+			}
+			return kept;
+		}
+
+		std::vector<std::shared_ptr<std::iostream>> stream_table::take(const std::string& name, bool recursive)
+		{
+			std::vector<std::shared_ptr<std::iostream>> streams;
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it : find_path_entries(streams_, name, recursive))
+			{
+				for (auto& stream : it->second)
+				{
+					streams.push_back(std::move(stream.second));
+				}
+				streams_.erase(it);
+			}
+			return streams;
+		}
+
+		std::vector<std::shared_ptr<std::iostream>> stream_table::take(const std::string& name, bool recursive, file_mode mode, file_access access)
+		{
+			std::vector<std::shared_ptr<std::iostream>> streams;
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it : find_path_entries(streams_, name, recursive))
+			{
+				auto found = it->second.find(key{ mode, access });
+				if (found == it->second.end())
+				{
+					continue;
+				}
+				streams.push_back(std::move(found->second));
+				it->second.erase(found);
+				if (it->second.empty())
+				{
+					streams_.erase(it);
+				}
+			}
+			return streams;
+		}
+
+		void stream_table::clear()
+		{
+			std::map<std::string, std::map<key, std::shared_ptr<std::iostream>>> streams;
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			streams.swap(streams_);
+		}
+	}
+}
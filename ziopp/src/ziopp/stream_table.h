@@ -0,0 +1,46 @@
+#pragma once
+
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ziopp/filesystem.h>
+#include <ziopp/path_entries.h>
+
+namespace ziopp {
+	namespace detail {
+		// The streams open_file returned, which the filesystem owns since open_file has no matching close.
+		// A file keeps one stream per mode and access, closed when the file is opened the same way again.
+		// Streams are destroyed without the lock held, since destroying one writes what it still buffers.
+		class stream_table {
+		public:
+			stream_table() = default;
+
+			stream_table(const stream_table&) = delete;
+			stream_table& operator=(const stream_table&) = delete;
+
+			// Closes the stream the file was last opened with the same way, before it is opened again, so what it buffers is written first
+			void close(const std::string& name, file_mode mode, file_access access);
+
+			// Keeps the stream of a file opened with mode and access, closing one another thread kept meanwhile
+			std::iostream& keep(const std::string& name, file_mode mode, file_access access, std::shared_ptr<std::iostream> stream);
+
+			// Removes the streams of a file, and of every file below it when recursive, for the caller to destroy once its own locks are released
+			std::vector<std::shared_ptr<std::iostream>> take(const std::string& name, bool recursive);
+
+			// Removes only the streams opened with mode and access
+			std::vector<std::shared_ptr<std::iostream>> take(const std::string& name, bool recursive, file_mode mode, file_access access);
+
+			// Closes every stream
+			void clear();
+		private:
+			using key = std::pair<file_mode, file_access>;
+
+			std::mutex mutex_;
+			std::map<std::string, std::map<key, std::shared_ptr<std::iostream>>> streams_;
+		};
+	}
+}
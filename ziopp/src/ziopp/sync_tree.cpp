@@ -0,0 +1,478 @@
+#include <ziopp/sync_tree.h>
+#include <ziopp/content_hash.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+
+namespace ziopp {
+	namespace {
+		const size_t sync_buffer_size = 1024 * 1024;
+
+		struct sync_context {
+			sync_context(filesystem& src_filesystem, filesystem& dest_filesystem, const sync_options& options) : src_filesystem(src_filesystem), dest_filesystem(dest_filesystem), options(options),
+				files_copied(0), files_patched(0), files_unchanged(0), files_deleted(0), directories_created(0), directories_deleted(0), bytes_total(0), bytes_transferred(0)
+			{
+			}
+
+			filesystem& src_filesystem;
+			filesystem& dest_filesystem;
+			const sync_options& options;
+			std::atomic<uint64_t> files_copied;
+			std::atomic<uint64_t> files_patched;
+			std::atomic<uint64_t> files_unchanged;
+			std::atomic<uint64_t> files_deleted;
+			std::atomic<uint64_t> directories_created;
+			std::atomic<uint64_t> directories_deleted;
+			std::atomic<uint64_t> bytes_total;
+			std::atomic<uint64_t> bytes_transferred;
+		};
+
+		std::set<std::string> list_names(const filesystem& fs, const upath& directory, search_target target)
+		{
+			std::set<std::string> names;
+			for (upath_iterator it = fs.enumerate_paths(directory, "*", search_options::top_directory_only, target); it != upath_iterator{}; ++it)
+			{
+				names.insert((*it).name());
+			}
+			return names;
+		}
+
+		bool same_contents(filesystem& src_filesystem, const upath& src, filesystem& dest_filesystem, const upath& dest)
+		{
+			std::unique_ptr<file_handle> source = src_filesystem.open_handle(src, file_mode::open, file_access::read);
+			std::unique_ptr<file_handle> destination = dest_filesystem.open_handle(dest, file_mode::open, file_access::read);
+			std::vector<uint8_t> source_buffer(sync_buffer_size);
+			std::vector<uint8_t> destination_buffer(sync_buffer_size);
+			uint64_t offset = 0;
+			while (true)
+			{
+				size_t read = source->read_at(offset, source_buffer.data(), source_buffer.size());
+				size_t compared = 0;
+				while (compared < read)
+				{
+					size_t other = destination->read_at(offset + compared, destination_buffer.data(), read - compared);
+					if (other == 0 || std::memcmp(source_buffer.data() + compared, destination_buffer.data(), other) != 0)
+					{
+						return false;
+					}
+					compared += other;
+				}
+				if (read == 0)
+				{
+					return true;
+				}
+				offset += read;
+			}
+		}
+
+		// The rolling checksum rsync uses to find blocks at any offset: a is the sum of the bytes and b the sum of the running values of a, both modulo 2^16
+		struct rolling_checksum {
+			uint32_t a;
+			uint32_t b;
+
+			void reset(const uint8_t* data, size_t count)
+			{
+				a = 0;
+				b = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					a += data[i];
+					b += a;
+				}
+				a &= 0xffff;
+				b &= 0xffff;
+			}
+
+			void roll(uint8_t out, uint8_t in, size_t count)
+			{
+				a = (a - out + in) & 0xffff;
+				b = (b - static_cast<uint32_t>(count) * out + a) & 0xffff;
+			}
+
+			uint32_t value() const
+			{
+				return a | (b << 16);
+			}
+		};
+
+		uint64_t strong_hash(const uint8_t* data, size_t count)
+		{
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < count; ++i)
+			{
+				hash ^= data[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		struct block_signatures {
+			// Rules out most offsets before the map is searched
+			std::vector<bool> filter;
+			std::unordered_map<uint32_t, std::vector<std::pair<uint64_t, uint64_t>>> blocks;
+
+			static size_t filter_index(uint32_t weak)
+			{
+				return (weak ^ (weak >> 16)) & 0xffff;
+			}
+		};
+
+		block_signatures sign(file_handle& file, size_t block_size)
+		{
+			block_signatures signatures{};
+			signatures.filter.resize(0x10000);
+			std::vector<uint8_t> block(block_size);
+			rolling_checksum checksum{};
+			uint64_t length = file.size();
+			// Only whole blocks are signed, a shorter last block is sent as literal bytes if it is still needed
+			for (uint64_t index = 0; (index + 1) * block_size <= length; ++index)
+			{
+				size_t read = 0;
+				while (read < block_size)
+				{
+					size_t count = file.read_at(index * block_size + read, block.data() + read, block_size - read);
+					if (count == 0)
+					{
+						return signatures;
+					}
+					read += count;
+				}
+				checksum.reset(block.data(), block_size);
+				signatures.filter[block_signatures::filter_index(checksum.value())] = true;
+				signatures.blocks[checksum.value()].emplace_back(strong_hash(block.data(), block_size), index);
+			}
+			return signatures;
+		}
+
+		std::vector<uint8_t> digest_file(filesystem& fs, const upath& path)
+		{
+			std::unique_ptr<file_handle> file = fs.open_handle(path, file_mode::open, file_access::read);
+			content_hasher hasher{ hash_algorithm::blake3 };
+			std::vector<uint8_t> buffer(sync_buffer_size);
+			uint64_t offset = 0;
+			while (size_t read = file->read_at(offset, buffer.data(), buffer.size()))
+			{
+				hasher.update(buffer.data(), read);
+				offset += read;
+			}
+			return hasher.finish();
+		}
+
+		// Creates a file next to dest whose name no other file or directory has, as the directory can hold anything when extraneous files are kept
+		// temporary is only set once the file is created, so a failure never names a file someone else owns
+		std::unique_ptr<file_handle> create_temporary(filesystem& fs, const upath& dest, upath& temporary)
+		{
+			for (unsigned attempt = 0; ; ++attempt)
+			{
+				std::string name = "." + dest.name() + ".ziopp-sync";
+				if (attempt != 0)
+				{
+					name += "-" + std::to_string(attempt);
+				}
+				upath candidate = upath::combine(dest.directory(), upath{ name });
+				if (fs.file_exists(candidate) || fs.directory_exists(candidate))
+				{
+					continue;
+				}
+				std::error_code error;
+				std::unique_ptr<file_handle> file = fs.open_handle(candidate, file_mode::create_new, file_access::write, error);
+				if (file)
+				{
+					temporary = candidate;
+					return file;
+				}
+				if (error != std::errc::file_exists)
+				{
+					throw std::ios_base::failure("could not create a temporary file next to dest", error);
+				}
+			}
+		}
+
+		// Deletes the temporary file of a patch on every exit, unless it replaced dest
+		class temporary_scope {
+		public:
+			explicit temporary_scope(filesystem& fs) : fs_(fs), kept_(false)
+			{
+			}
+
+			~temporary_scope()
+			{
+				if (!kept_ && !path.empty())
+				{
+					std::error_code ignored;
+					fs_.delete_file(path, ignored);
+				}
+			}
+
+			void keep()
+			{
+				kept_ = true;
+			}
+
+			upath path;
+		private:
+			filesystem& fs_;
+			bool kept_;
+		};
+
+		// Writes a new version of dest next to it from the blocks of dest found in src and the bytes of src that matched none, then replaces dest with it.
+		// Blocks are matched by 64 bit hashes, so the new version is checked against the BLAKE3 digest of src and dropped when a collision corrupted it.
+		bool patch_file(filesystem& src_filesystem, const upath& src, filesystem& dest_filesystem, const upath& dest, size_t block_size, uint64_t& transferred)
+		{
+			// Destroyed after the handles of the block below, so the file is closed before it is deleted
+			temporary_scope temporary{ dest_filesystem };
+			transferred = 0;
+			content_hasher source_hasher{ hash_algorithm::blake3 };
+			{
+				std::unique_ptr<file_handle> old_file = dest_filesystem.open_handle(dest, file_mode::open, file_access::read);
+				block_signatures signatures = sign(*old_file, block_size);
+				std::unique_ptr<file_handle> source = src_filesystem.open_handle(src, file_mode::open, file_access::read);
+				std::unique_ptr<file_handle> new_file = create_temporary(dest_filesystem, dest, temporary.path);
+
+				std::vector<uint8_t> buffer(std::max(sync_buffer_size, block_size * 2));
+				std::vector<uint8_t> block(block_size);
+				uint64_t source_offset = 0;
+				uint64_t output_offset = 0;
+				bool end_of_file = false;
+				// buffer[literal, position) has matched no block, buffer[position, end) is still to be scanned
+				size_t literal = 0;
+				size_t position = 0;
+				size_t end = 0;
+				rolling_checksum checksum{};
+				bool checksum_valid = false;
+
+				auto flush_literal = [&]() {
+					if (position > literal)
+					{
+						new_file->write_at(output_offset, buffer.data() + literal, position - literal);
+						output_offset += position - literal;
+						transferred += position - literal;
+					}
+					literal = position;
+				};
+
+				while (true)
+				{
+					if (end - position <= block_size && !end_of_file)
+					{
+						flush_literal();
+						std::memmove(buffer.data(), buffer.data() + position, end - position);
+						end -= position;
+						position = 0;
+						literal = 0;
+						while (end < buffer.size() && !end_of_file)
+						{
+							size_t read = source->read_at(source_offset, buffer.data() + end, buffer.size() - end);
+							source_hasher.update(buffer.data() + end, read);
+							end_of_file = read == 0;
+							end += read;
+							source_offset += read;
+						}
+						checksum_valid = false;
+					}
+					if (end - position < block_size)
+					{
+						break;
+					}
+					if (!checksum_valid)
+					{
+						checksum.reset(buffer.data() + position, block_size);
+						checksum_valid = true;
+					}
+
+					uint32_t weak = checksum.value();
+					if (signatures.filter[block_signatures::filter_index(weak)])
+					{
+						auto candidates = signatures.blocks.find(weak);
+						if (candidates != signatures.blocks.end())
+						{
+							uint64_t strong = strong_hash(buffer.data() + position, block_size);
+							auto match = std::find_if(candidates->second.begin(), candidates->second.end(), [strong](const std::pair<uint64_t, uint64_t>& candidate) {
+								return candidate.first == strong;
+							});
+							if (match != candidates->second.end())
+							{
+								flush_literal();
+								size_t read = 0;
+								while (read < block_size)
+								{
+									size_t count = old_file->read_at(match->second * block_size + read, block.data() + read, block_size - read);
+									if (count == 0)
+									{
+										throw std::ios_base::failure("dest changed while it was being synchronized", std::make_error_code(std::errc::io_error));
+									}
+									read += count;
+								}
+								new_file->write_at(output_offset, block.data(), block_size);
+								output_offset += block_size;
+								position += block_size;
+								literal = position;
+								checksum_valid = false;
+								continue;
+							}
+						}
+					}
+
+					if (end - position == block_size)
+					{
+						break;
+					}
+					checksum.roll(buffer[position], buffer[position + block_size], block_size);
+					++position;
+				}
+				position = end;
+				flush_literal();
+			}
+			if (digest_file(dest_filesystem, temporary.path) != source_hasher.finish())
+			{
+				return false;
+			}
+			dest_filesystem.replace_file(temporary.path, dest, true);
+			temporary.keep();
+			return true;
+		}
+
+		void sync_file(sync_context& context, const upath& src, const upath& dest, bool dest_exists)
+		{
+			uint64_t length = context.src_filesystem.file_length(src);
+			context.bytes_total += length;
+			const std::chrono::system_clock::time_point write_time = context.src_filesystem.write_time(src);
+			if (dest_exists)
+			{
+				uint64_t dest_length = context.dest_filesystem.file_length(dest);
+				if (dest_length == length && context.dest_filesystem.write_time(dest) == write_time &&
+					(!context.options.compare_contents || same_contents(context.src_filesystem, src, context.dest_filesystem, dest)))
+				{
+					context.files_unchanged++;
+					return;
+				}
+
+				uint64_t transferred = 0;
+				if (length >= context.options.delta_threshold && dest_length >= context.options.block_size &&
+					patch_file(context.src_filesystem, src, context.dest_filesystem, dest, context.options.block_size, transferred))
+				{
+					context.bytes_transferred += transferred;
+					context.dest_filesystem.write_time(dest, write_time);
+					context.files_patched++;
+					return;
+				}
+			}
+
+			context.src_filesystem.copy_file_cross(context.dest_filesystem, src, dest, true);
+			context.dest_filesystem.write_time(dest, write_time);
+			context.bytes_transferred += length;
+			context.files_copied++;
+		}
+
+		void sync_directory(sync_context& context, const upath& src, const upath& dest, work_group& group)
+		{
+			std::set<std::string> src_files = list_names(context.src_filesystem, src, search_target::file);
+			std::set<std::string> src_directories = list_names(context.src_filesystem, src, search_target::directory);
+			std::set<std::string> dest_files = list_names(context.dest_filesystem, dest, search_target::file);
+			std::set<std::string> dest_directories = list_names(context.dest_filesystem, dest, search_target::directory);
+
+			// A file where the source has a directory, or the reverse, is always removed
+			for (const std::string& name : dest_files)
+			{
+				if (src_directories.count(name) != 0 || (context.options.delete_extraneous && src_files.count(name) == 0))
+				{
+					context.dest_filesystem.delete_file(upath::combine(dest, upath{ name }));
+					context.files_deleted++;
+				}
+			}
+			for (const std::string& name : dest_directories)
+			{
+				if (src_files.count(name) != 0 || (context.options.delete_extraneous && src_directories.count(name) == 0))
+				{
+					context.dest_filesystem.delete_directory(upath::combine(dest, upath{ name }), true);
+					context.directories_deleted++;
+				}
+			}
+
+			for (const std::string& name : src_directories)
+			{
+				upath source = upath::combine(src, upath{ name });
+				upath target = upath::combine(dest, upath{ name });
+				if (dest_directories.count(name) == 0)
+				{
+					context.dest_filesystem.create_directory(target);
+					context.directories_created++;
+				}
+				group.run([&context, source, target, &group]() {
+					sync_directory(context, source, target, group);
+				});
+			}
+			for (const std::string& name : src_files)
+			{
+				upath source = upath::combine(src, upath{ name });
+				upath target = upath::combine(dest, upath{ name });
+				bool exists = dest_files.count(name) != 0;
+				group.run([&context, source, target, exists]() {
+					sync_file(context, source, target, exists);
+				});
+			}
+		}
+	}
+
+	uint64_t sync_result::bytes_saved() const
+	{
+		return bytes_total - bytes_transferred;
+	}
+
+	sync_result sync_tree(filesystem& src_filesystem, const upath& src, filesystem& dest_filesystem, const upath& dest, const sync_options& options)
+	{
+		if (!src.absolute())
+		{
+			throw std::invalid_argument("src must be absolute");
+		}
+
+		if (!dest.absolute())
+		{
+			throw std::invalid_argument("dest must be absolute");
+		}
+
+		if (options.block_size == 0)
+		{
+			throw std::invalid_argument("block_size must be greater than zero");
+		}
+
+		if (!src_filesystem.directory_exists(src))
+		{
+			throw std::ios_base::failure("src directory must exist", std::make_error_code(std::errc::no_such_file_or_directory));
+		}
+
+		const std::string& src_name = src.full_name();
+		const std::string& dest_name = dest.full_name();
+		bool dest_in_src = dest_name.compare(0, src_name.size(), src_name) == 0 && (dest_name.size() == src_name.size() || dest_name[src_name.size()] == upath::directory_seperator || src_name.size() == 1);
+		bool src_in_dest = src_name.compare(0, dest_name.size(), dest_name) == 0 && (src_name[dest_name.size()] == upath::directory_seperator || dest_name.size() == 1);
+		if (&src_filesystem == &dest_filesystem && (dest_in_src || src_in_dest))
+		{
+			throw std::invalid_argument("dest cannot be src, inside src or contain src");
+		}
+
+		sync_context context{ src_filesystem, dest_filesystem, options };
+		if (!dest_filesystem.directory_exists(dest))
+		{
+			dest_filesystem.create_directory(dest);
+			context.directories_created++;
+		}
+		work_group group{ options.tree.work_executor != nullptr ? *options.tree.work_executor : thread_pool::shared(), options.tree.max_concurrency };
+		group.run([&context, &src, &dest, &group]() {
+			sync_directory(context, src, dest, group);
+		});
+		group.wait();
+
+		sync_result result{};
+		result.files_copied = context.files_copied;
+		result.files_patched = context.files_patched;
+		result.files_unchanged = context.files_unchanged;
+		result.files_deleted = context.files_deleted;
+		result.directories_created = context.directories_created;
+		result.directories_deleted = context.directories_deleted;
+		result.bytes_total = context.bytes_total;
+		result.bytes_transferred = context.bytes_transferred;
+		return result;
+	}
+}
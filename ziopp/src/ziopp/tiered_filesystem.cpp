@@ -0,0 +1,468 @@
+#include <ziopp/tiered_filesystem.h>
+#include <algorithm>
+#include <functional>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	namespace {
+		const uint8_t max_count = 15;
+
+		uint64_t mix(uint64_t value)
+		{
+			value += 0x9e3779b97f4a7c15ull;
+			value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+			value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+			return value ^ (value >> 31);
+		}
+
+		size_t round_up_to_power_of_two(size_t value)
+		{
+			size_t result = 1;
+			while (result < value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		bool cacheable(file_mode mode, file_access access)
+		{
+			return mode == file_mode::open && access == file_access::read;
+		}
+	}
+
+	frequency_sketch::frequency_sketch(size_t width)
+		: counters_(depth * round_up_to_power_of_two(std::max<size_t>(width, 16))), mask_(counters_.size() / depth - 1), sample_size_(10 * (mask_ + 1)), additions_(0)
+	{
+	}
+
+	void frequency_sketch::indexes(const std::string& key, size_t* result) const
+	{
+		// Each row is indexed by a different combination of two hashes of the key
+		uint64_t first = mix(std::hash<std::string>{}(key));
+		uint64_t second = mix(first) | 1;
+		for (size_t row = 0; row < depth; row++)
+		{
+			result[row] = row * (mask_ + 1) + static_cast<size_t>((first + row * second) & mask_);
+		}
+	}
+
+	void frequency_sketch::increment(const std::string& key)
+	{
+		size_t positions[depth];
+		indexes(key, positions);
+		uint8_t smallest = max_count;
+		for (size_t position : positions)
+		{
+			smallest = std::min(smallest, counters_[position]);
+		}
+		if (smallest < max_count)
+		{
+			for (size_t position : positions)
+			{
+				if (counters_[position] == smallest)
+				{
+					counters_[position]++;
+				}
+			}
+		}
+
+		if (++additions_ >= sample_size_)
+		{
+			for (uint8_t& counter : counters_)
+			{
+				counter >>= 1;
+			}
+			additions_ /= 2;
+		}
+	}
+
+	uint32_t frequency_sketch::estimate(const std::string& key) const
+	{
+		size_t positions[depth];
+		indexes(key, positions);
+		uint8_t smallest = max_count;
+		for (size_t position : positions)
+		{
+			smallest = std::min(smallest, counters_[position]);
+		}
+		return smallest;
+	}
+
+	// Drops the copy of a file written through it after each write, so a copy made meanwhile is not kept
+	class tiered_filesystem::writing_handle : public file_handle {
+	public:
+		writing_handle(tiered_filesystem& owner, const upath& path, std::unique_ptr<file_handle> inner) : owner_(owner), name_(path.full_name()), inner_(std::move(inner))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			return inner_->read_at(offset, buffer, count);
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			size_t written = inner_->write_at(offset, buffer, count);
+			owner_.forget(name_, false, false);
+			return written;
+		}
+
+		uint64_t size() const override
+		{
+			return inner_->size();
+		}
+
+		void sync() override
+		{
+			inner_->sync();
+		}
+
+		size_t read_vectored(uint64_t offset, const std::vector<io_segment>& segments) override
+		{
+			return inner_->read_vectored(offset, segments);
+		}
+
+		void advise(uint64_t offset, uint64_t length, file_advice advice) override
+		{
+			inner_->advise(offset, length, advice);
+		}
+	private:
+		tiered_filesystem& owner_;
+		const std::string name_;
+		std::unique_ptr<file_handle> inner_;
+	};
+
+	// Drops the copies of a path once the operation changing it is over, whether it failed or not
+	class tiered_filesystem::change_scope {
+	public:
+		change_scope(tiered_filesystem& owner, const upath& path, bool recursive, bool removed) : owner_(owner), name_(path.full_name()), recursive_(recursive), removed_(removed)
+		{
+		}
+
+		~change_scope()
+		{
+			owner_.forget(name_, recursive_, removed_);
+		}
+	private:
+		tiered_filesystem& owner_;
+		const std::string name_;
+		const bool recursive_;
+		const bool removed_;
+	};
+
+	tiered_filesystem::tiered_filesystem(filesystem& fast, filesystem& slow, const tiered_options& options)
+		: compose_filesystem(slow), fast_(fast), options_(options), sketch_(options.sketch_width), streams_(new detail::stream_table()), bytes_(0),
+		fast_reads_(0), slow_reads_(0), promotions_(0), demotions_(0), rejections_(0), invalidations_(0)
+	{
+	}
+
+	tiered_filesystem::~tiered_filesystem()
+	{
+	}
+
+	void tiered_filesystem::invalidate(const upath& path)
+	{
+		forget(path.full_name(), true, false);
+	}
+
+	void tiered_filesystem::clear()
+	{
+		forget(std::string(1, upath::directory_seperator), true, false);
+	}
+
+	tiered_statistics tiered_filesystem::statistics() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		uint64_t promoting = 0;
+		for (const auto& reserved : promoting_)
+		{
+			promoting += reserved.second.size;
+		}
+		return tiered_statistics{ fast_reads_, slow_reads_, promotions_, demotions_, rejections_, invalidations_, entries_.size(), bytes_ - promoting };
+	}
+
+	std::unique_ptr<file_handle> tiered_filesystem::open_read(const upath& path, std::error_code* error)
+	{
+		const std::string& name = path.full_name();
+		bool cached;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			sketch_.increment(name);
+			auto found = entries_.find(name);
+			cached = found != entries_.end();
+			if (cached)
+			{
+				order_.splice(order_.begin(), order_, found->second.position);
+			}
+		}
+
+		if (cached || promote(path))
+		{
+			std::error_code ignored;
+			std::unique_ptr<file_handle> handle = fast_.open_handle(path, file_mode::open, file_access::read, ignored);
+			if (handle)
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				(cached ? fast_reads_ : slow_reads_)++;
+				return handle;
+			}
+			// The copy is gone, so the file is read from the slow tier
+			forget(name, false, false);
+		}
+
+		std::unique_ptr<file_handle> handle = error == nullptr ? compose_filesystem::open_handle(path, file_mode::open, file_access::read) : compose_filesystem::open_handle(path, file_mode::open, file_access::read, *error);
+		if (handle)
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			slow_reads_++;
+		}
+		return handle;
+	}
+
+	bool tiered_filesystem::promote(const upath& path)
+	{
+		const std::string& name = path.full_name();
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			if (sketch_.estimate(name) < options_.promote_after || promoting_.count(name) != 0)
+			{
+				return false;
+			}
+		}
+
+		std::error_code error;
+		uint64_t size = compose_filesystem::file_length(path, error);
+		if (error || size > options_.max_file_size || size > options_.max_bytes)
+		{
+			return false;
+		}
+
+		std::vector<std::string> victims;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			if (promoting_.count(name) != 0 || entries_.count(name) != 0)
+			{
+				return false;
+			}
+			if (!admit(name, size, victims))
+			{
+				rejections_++;
+				return false;
+			}
+		}
+		drop(victims);
+
+		// Copied without the lock, so reads of other files are not held up
+		fast_.create_directory(path.directory(), error);
+		if (!error)
+		{
+			next_filesystem().copy_file_cross(fast_, path, path, true, error);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto found = promoting_.find(name);
+			bool changed = found->second.changed;
+			promoting_.erase(found);
+			if (!error && !changed)
+			{
+				order_.push_front(name);
+				entries_[name] = entry{ size, order_.begin() };
+				promotions_++;
+				return true;
+			}
+			bytes_ -= size;
+		}
+		fast_.delete_file(path, error);
+		return false;
+	}
+
+	bool tiered_filesystem::admit(const std::string& name, uint64_t size, std::vector<std::string>& victims)
+	{
+		// A copy is only dropped for a file read more often than it, oldest first
+		uint32_t frequency = sketch_.estimate(name);
+		uint64_t freed = 0;
+		std::vector<std::list<std::string>::iterator> dropped;
+		for (auto it = order_.end(); bytes_ + size - freed > options_.max_bytes;)
+		{
+			if (it == order_.begin())
+			{
+				return false;
+			}
+			--it;
+			if (sketch_.estimate(*it) >= frequency)
+			{
+				return false;
+			}
+			freed += entries_[*it].size;
+			dropped.push_back(it);
+		}
+
+		for (std::list<std::string>::iterator it : dropped)
+		{
+			victims.push_back(*it);
+			entries_.erase(*it);
+			order_.erase(it);
+		}
+		demotions_ += dropped.size();
+		bytes_ += size - freed;
+		promoting_[name] = promotion{ size, false };
+		return true;
+	}
+
+	void tiered_filesystem::forget(const std::string& name, bool recursive, bool removed)
+	{
+		// Destroyed once the lock is released
+		std::vector<std::shared_ptr<std::iostream>> streams;
+		std::vector<std::string> names;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it : find_path_entries(promoting_, name, recursive))
+			{
+				it->second.changed = true;
+			}
+			for (auto it : find_path_entries(entries_, name, recursive))
+			{
+				names.push_back(it->first);
+				bytes_ -= it->second.size;
+				order_.erase(it->second.position);
+				entries_.erase(it);
+				invalidations_++;
+			}
+			if (removed)
+			{
+				streams = streams_->take(name, recursive);
+			}
+		}
+		drop(names);
+	}
+
+	void tiered_filesystem::drop(const std::vector<std::string>& names)
+	{
+		std::error_code ignored;
+		for (const std::string& name : names)
+		{
+			// A stream reading the copy keeps its handle, so it lives until its own file is reopened, moved or deleted
+			fast_.delete_file(upath{ name }, ignored);
+		}
+	}
+
+	void tiered_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		change_scope source{ *this, src, true, true };
+		change_scope destination{ *this, dest, true, false };
+		compose_filesystem::move_directory(src, dest);
+	}
+
+	void tiered_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		change_scope scope{ *this, path, true, true };
+		compose_filesystem::delete_directory(path, recursive);
+	}
+
+	void tiered_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		change_scope scope{ *this, path, true, true };
+		compose_filesystem::delete_directory(path, recursive, error);
+	}
+
+	void tiered_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		change_scope scope{ *this, dest, false, false };
+		compose_filesystem::copy_file(src, dest, overwrite);
+	}
+
+	void tiered_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		change_scope scope{ *this, dest, false, false };
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+	}
+
+	void tiered_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		change_scope backup{ *this, desk_backup, false, false };
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+	}
+
+	void tiered_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+	}
+
+	void tiered_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		compose_filesystem::move_file(src, dest);
+	}
+
+	void tiered_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		change_scope source{ *this, src, false, true };
+		change_scope destination{ *this, dest, false, false };
+		compose_filesystem::move_file(src, dest, error);
+	}
+
+	void tiered_filesystem::delete_file(const upath& path)
+	{
+		change_scope scope{ *this, path, false, true };
+		compose_filesystem::delete_file(path);
+	}
+
+	void tiered_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		change_scope scope{ *this, path, false, true };
+		compose_filesystem::delete_file(path, error);
+	}
+
+	std::iostream& tiered_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(open_handle(path, mode, access), mode == file_mode::append));
+	}
+
+	std::unique_ptr<file_handle> tiered_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		if (!cacheable(mode, access))
+		{
+			change_scope scope{ *this, path, false, false };
+			return std::unique_ptr<file_handle>(new writing_handle(*this, path, compose_filesystem::open_handle(path, mode, access)));
+		}
+		return open_read(path, nullptr);
+	}
+
+	std::unique_ptr<file_handle> tiered_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		if (!cacheable(mode, access))
+		{
+			change_scope scope{ *this, path, false, false };
+			std::unique_ptr<file_handle> handle = compose_filesystem::open_handle(path, mode, access, error);
+			if (!handle)
+			{
+				return nullptr;
+			}
+			return std::unique_ptr<file_handle>(new writing_handle(*this, path, std::move(handle)));
+		}
+		std::unique_ptr<file_handle> handle = open_read(path, &error);
+		if (handle)
+		{
+			error.clear();
+		}
+		return handle;
+	}
+
+	void tiered_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		std::vector<std::unique_ptr<change_scope>> scopes;
+		for (const upath& path : paths)
+		{
+			scopes.emplace_back(new change_scope(*this, path, true, true));
+		}
+		compose_filesystem::delete_many(paths);
+	}
+}
@@ -0,0 +1,123 @@
+#include <ziopp/upath_batch.h>
+#include <ziopp/upath_impl.h>
+#include <algorithm>
+
+namespace ziopp {
+	namespace {
+		// Normalizes paths [begin, end) into data, storing where each ends relative to data in ends
+		size_t normalize_chunk(const std::vector<std::string>& paths, size_t begin, size_t end, std::string& data, size_t* ends, const char** errors)
+		{
+			size_t capacity = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				capacity += paths[i].size();
+			}
+			// Normalizing never makes a path longer
+			data.reserve(capacity);
+
+			std::string normalized;
+			std::vector<detail::text_slice> parts;
+			size_t error_count = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				const char* error = detail::validate_and_normalize<portable_path_policy>(paths[i].data(), paths[i].size(), normalized, parts);
+				if (error == nullptr)
+				{
+					data += normalized;
+				}
+				else
+				{
+					errors[i] = error;
+					error_count++;
+				}
+				ends[i] = data.size();
+			}
+			return error_count;
+		}
+	}
+
+	upath_batch::upath_batch(const std::vector<std::string>& paths, const upath_batch_options& options) : offsets_(paths.size() + 1), errors_(paths.size()), error_count_(0)
+	{
+		size_t* ends = offsets_.data() + 1;
+		size_t chunk_size = std::max<size_t>(options.chunk_size, 1);
+		if (paths.size() <= chunk_size)
+		{
+			error_count_ = normalize_chunk(paths, 0, paths.size(), data_, ends, errors_.data());
+			return;
+		}
+
+		size_t chunk_count = (paths.size() + chunk_size - 1) / chunk_size;
+		std::vector<std::string> chunks(chunk_count);
+		std::vector<size_t> error_counts(chunk_count);
+		{
+			work_group group{ options.work_executor != nullptr ? *options.work_executor : thread_pool::shared(), std::max<size_t>(options.max_concurrency, 1) };
+			for (size_t chunk = 0; chunk < chunk_count; chunk++)
+			{
+				group.run([&paths, &chunks, &error_counts, this, ends, chunk, chunk_size]() {
+					size_t begin = chunk * chunk_size;
+					error_counts[chunk] = normalize_chunk(paths, begin, std::min(begin + chunk_size, paths.size()), chunks[chunk], ends, errors_.data());
+				});
+			}
+			group.wait();
+		}
+
+		size_t total = 0;
+		for (const std::string& chunk : chunks)
+		{
+			total += chunk.size();
+		}
+		data_.reserve(total);
+		for (size_t chunk = 0; chunk < chunk_count; chunk++)
+		{
+			size_t base = data_.size();
+			size_t end = std::min((chunk + 1) * chunk_size, paths.size());
+			for (size_t i = chunk * chunk_size; i < end; i++)
+			{
+				ends[i] += base;
+			}
+			data_ += chunks[chunk];
+			error_count_ += error_counts[chunk];
+		}
+	}
+
+	size_t upath_batch::size() const
+	{
+		return errors_.size();
+	}
+
+	upath_view upath_batch::operator[](size_t index) const
+	{
+		return upath_view{ data_.data() + offsets_[index], offsets_[index + 1] - offsets_[index] };
+	}
+
+	const char* upath_batch::error(size_t index) const
+	{
+		return errors_[index];
+	}
+
+	size_t upath_batch::error_count() const
+	{
+		return error_count_;
+	}
+
+	const std::string& upath_batch::data() const
+	{
+		return data_;
+	}
+
+	const std::vector<size_t>& upath_batch::offsets() const
+	{
+		return offsets_;
+	}
+
+	std::vector<upath> upath_batch::to_upaths() const
+	{
+		std::vector<upath> paths;
+		paths.reserve(size());
+		for (size_t i = 0; i < size(); i++)
+		{
+			paths.push_back((*this)[i].to_upath());
+		}
+		return paths;
+	}
+}
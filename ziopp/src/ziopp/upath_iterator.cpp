@@ -0,0 +1,62 @@
+#include <ziopp/upath_iterator.h>
+
+namespace ziopp {
+	upath_iterator::upath_iterator() : state_()
+	{
+	}
+
+	upath_iterator::upath_iterator(const std::function<pointer()>& next) : state_(std::make_shared<state>())
+	{
+		state_->next = next;
+		state_->current = next ? next() : nullptr;
+	}
+
+	upath_iterator::reference upath_iterator::operator*() const noexcept
+	{
+		return *state_->current;
+	}
+
+	upath_iterator::pointer upath_iterator::operator->() const noexcept
+	{
+		return state_->current;
+	}
+
+	upath_iterator& upath_iterator::operator++()
+	{
+		if (state_ && state_->current != nullptr)
+		{
+			state_->current = state_->next ? state_->next() : nullptr;
+		}
+		return *this;
+	}
+
+	upath_iterator upath_iterator::operator++(int)
+	{
+		// The enumeration is shared, so the returned iterator owns a copy of the current path
+		upath_iterator previous{};
+		if (state_ && state_->current != nullptr)
+		{
+			previous.state_ = std::make_shared<state>();
+			previous.state_->held = *state_->current;
+			previous.state_->current = &previous.state_->held;
+		}
+		++*this;
+		return previous;
+	}
+
+	bool operator==(const upath_iterator& lhs, const upath_iterator& rhs)
+	{
+		upath_iterator::pointer left = lhs.state_ ? lhs.state_->current : nullptr;
+		upath_iterator::pointer right = rhs.state_ ? rhs.state_->current : nullptr;
+		if (left == nullptr || right == nullptr)
+		{
+			return left == right;
+		}
+		return lhs.state_ == rhs.state_ && left == right;
+	}
+
+	bool operator!=(const upath_iterator& lhs, const upath_iterator& rhs)
+	{
+		return !(lhs == rhs);
+	}
+}
\ No newline at end of file
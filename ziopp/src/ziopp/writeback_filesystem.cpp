@@ -0,0 +1,871 @@
+#include <ziopp/writeback_filesystem.h>
+#include <algorithm>
+#include <cstring>
+#include <ziopp/io_scheduler.h>
+#include <ziopp/stream_table.h>
+
+namespace ziopp {
+	namespace {
+		std::nullptr_t fail(std::error_code* error, std::errc reason, const char* message)
+		{
+			if (error == nullptr)
+			{
+				throw std::ios_base::failure(message, std::make_error_code(reason));
+			}
+			*error = std::make_error_code(reason);
+			return nullptr;
+		}
+	}
+
+	// Reads a pending version of a file, which later writes do not change
+	class writeback_filesystem::snapshot_handle : public file_handle {
+	public:
+		explicit snapshot_handle(std::shared_ptr<std::vector<uint8_t>> data) : data_(std::move(data))
+		{
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			if (offset >= data_->size())
+			{
+				return 0;
+			}
+			size_t read = std::min(count, static_cast<size_t>(data_->size() - offset));
+			std::memcpy(buffer, data_->data() + offset, read);
+			return read;
+		}
+
+		size_t write_at(uint64_t, const uint8_t*, size_t) override
+		{
+			throw std::ios_base::failure("the file is not open for writing", std::make_error_code(std::errc::bad_file_descriptor));
+		}
+
+		uint64_t size() const override
+		{
+			return data_->size();
+		}
+
+		void sync() override
+		{
+		}
+	private:
+		const std::shared_ptr<std::vector<uint8_t>> data_;
+	};
+
+	// Reads and writes the pending version of a file
+	class writeback_filesystem::dirty_handle : public file_handle {
+	public:
+		dirty_handle(writeback_filesystem& owner, const std::string& name, std::shared_ptr<dirty_file> file, bool append, bool readable)
+			: owner_(owner), name_(name), file_(std::move(file)), append_(append), readable_(readable)
+		{
+		}
+
+		~dirty_handle()
+		{
+			std::lock_guard<std::mutex> lock{ owner_.mutex_ };
+			file_->handles--;
+			owner_.release(name_, file_);
+		}
+
+		size_t read_at(uint64_t offset, uint8_t* buffer, size_t count) override
+		{
+			if (!readable_)
+			{
+				throw std::ios_base::failure("the file is not open for reading", std::make_error_code(std::errc::bad_file_descriptor));
+			}
+			std::lock_guard<std::mutex> lock{ owner_.mutex_ };
+			const std::vector<uint8_t>& data = *file_->data;
+			if (offset >= data.size())
+			{
+				return 0;
+			}
+			size_t read = std::min(count, static_cast<size_t>(data.size() - offset));
+			std::memcpy(buffer, data.data() + offset, read);
+			return read;
+		}
+
+		size_t write_at(uint64_t offset, const uint8_t* buffer, size_t count) override
+		{
+			return owner_.write(*file_, offset, buffer, count, append_);
+		}
+
+		uint64_t size() const override
+		{
+			std::lock_guard<std::mutex> lock{ owner_.mutex_ };
+			return length(*file_);
+		}
+
+		void sync() override
+		{
+			owner_.sync(upath{ name_ });
+		}
+	private:
+		writeback_filesystem& owner_;
+		const std::string name_;
+		const std::shared_ptr<dirty_file> file_;
+		const bool append_;
+		const bool readable_;
+	};
+
+	writeback_filesystem::writeback_filesystem(filesystem& next, const writeback_options& options)
+		: compose_filesystem(next), options_(options), streams_(new detail::stream_table()), dirty_bytes_(0), dirty_files_(0), flush_requests_(0), stopping_(false),
+		writes_(0), written_bytes_(0), flushes_(0), flushed_bytes_(0), batches_(0), throttled_(0), error_count_(0)
+	{
+		flusher_ = std::thread([this]() { run(); });
+	}
+
+	writeback_filesystem::~writeback_filesystem()
+	{
+		// Closed first, so what the streams still buffer is written back too
+		streams_->clear();
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		changed_.notify_all();
+		flusher_.join();
+	}
+
+	void writeback_filesystem::flush()
+	{
+		std::exception_ptr error;
+		{
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			flush_requests_++;
+			wake_.notify_one();
+			changed_.wait(lock, [this]() { return dirty_files_ == 0 || stopping_; });
+			flush_requests_--;
+			if (!errors_.empty())
+			{
+				error = errors_.begin()->second;
+				errors_.clear();
+			}
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	void writeback_filesystem::sync(const upath& path)
+	{
+		const std::string& name = path.full_name();
+		settle(name, true, true);
+
+		// Files written back in the background, or by another thread meanwhile, are written but not flushed yet
+		std::vector<std::string> unsynced;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it : find_path_entries(unsynced_, name, true))
+			{
+				unsynced.push_back(*it);
+				unsynced_.erase(it);
+			}
+		}
+		for (const std::string& file : unsynced)
+		{
+			try
+			{
+				compose_filesystem::open_handle(upath{ file }, file_mode::open, file_access::write)->sync();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				errors_.emplace(file, std::current_exception());
+				error_count_++;
+			}
+		}
+		rethrow(name, true);
+	}
+
+	writeback_statistics writeback_filesystem::statistics() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		return writeback_statistics{ writes_, written_bytes_, flushes_, flushed_bytes_, batches_, throttled_, error_count_, dirty_files_, dirty_bytes_ };
+	}
+
+	uint64_t writeback_filesystem::length(const dirty_file& file)
+	{
+		return (file.append ? file.base_size : 0) + file.data->size();
+	}
+
+	std::unique_ptr<file_handle> writeback_filesystem::open(const upath& path, file_mode mode, file_access access, std::error_code* error)
+	{
+		const std::string& name = path.full_name();
+		bool readable = (access & file_access::read) == file_access::read;
+		bool writable = (access & file_access::write) == file_access::write;
+		if (!writable && (mode == file_mode::open || mode == file_mode::open_or_create))
+		{
+			bool appended;
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				auto found = files_.find(name);
+				if (found != files_.end() && !found->second->append)
+				{
+					return std::unique_ptr<file_handle>(new snapshot_handle(found->second->data));
+				}
+				appended = found != files_.end() && (found->second->dirty || found->second->flushing);
+			}
+			// Only the appended bytes are in memory, so they are written back for the file to be read whole
+			if (appended)
+			{
+				settle(name, false, false);
+			}
+			return error == nullptr ? compose_filesystem::open_handle(path, mode, access) : compose_filesystem::open_handle(path, mode, access, *error);
+		}
+
+		std::shared_ptr<dirty_file> file = load(path, mode, access, error);
+		if (!file)
+		{
+			return nullptr;
+		}
+		return std::unique_ptr<file_handle>(new dirty_handle(*this, name, std::move(file), mode == file_mode::append, readable));
+	}
+
+	std::shared_ptr<writeback_filesystem::dirty_file> writeback_filesystem::load(const upath& path, file_mode mode, file_access access, std::error_code* error)
+	{
+		const std::string& name = path.full_name();
+		bool append_only = mode == file_mode::append && access == file_access::write;
+		bool emptied = mode == file_mode::create || mode == file_mode::truncate;
+		for (;;)
+		{
+			bool appended = false;
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				auto found = files_.find(name);
+				if (found != files_.end())
+				{
+					const std::shared_ptr<dirty_file>& file = found->second;
+					if (mode == file_mode::create_new)
+					{
+						return fail(error, std::errc::file_exists, "the file already exists");
+					}
+					if (append_only || !file->append)
+					{
+						file->handles++;
+						if (emptied)
+						{
+							truncate(*file);
+						}
+						return file;
+					}
+					appended = file->dirty || file->flushing;
+				}
+			}
+			if (appended && !emptied)
+			{
+				settle(name, false, false);
+			}
+
+			// Opened on the next filesystem, which checks the mode and creates or truncates the file
+			file_access inner_access = append_only || emptied || mode == file_mode::create_new ? access : access | file_access::read;
+			std::unique_ptr<file_handle> inner = error == nullptr ? compose_filesystem::open_handle(path, mode, inner_access) : compose_filesystem::open_handle(path, mode, inner_access, *error);
+			if (!inner)
+			{
+				return nullptr;
+			}
+			std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+			uint64_t base_size = 0;
+			if (append_only)
+			{
+				base_size = inner->size();
+			}
+			else if (!emptied && mode != file_mode::create_new)
+			{
+				data->resize(static_cast<size_t>(inner->size()));
+				size_t offset = 0;
+				size_t read;
+				while (offset < data->size() && (read = inner->read_at(offset, data->data() + offset, data->size() - offset)) > 0)
+				{
+					offset += read;
+				}
+				data->resize(offset);
+			}
+			inner.reset();
+
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto found = files_.find(name);
+			if (found == files_.end())
+			{
+				std::shared_ptr<dirty_file> file = std::make_shared<dirty_file>();
+				file->data = std::move(data);
+				file->append = append_only;
+				file->base_size = base_size;
+				file->version = 0;
+				file->flushed_version = 0;
+				file->counted = 0;
+				file->handles = 1;
+				file->dirty = false;
+				file->flushing = false;
+				file->removed = false;
+				files_.emplace(name, file);
+				return file;
+			}
+
+			// Opened meanwhile by another thread
+			const std::shared_ptr<dirty_file>& file = found->second;
+			if (append_only || !file->append)
+			{
+				file->handles++;
+				if (emptied)
+				{
+					truncate(*file);
+				}
+				return file;
+			}
+			// Only the appended bytes are in memory, which become the whole file once they are written back and nothing was appended since the file was read
+			if (emptied || (!file->dirty && !file->flushing && file->base_size == data->size()))
+			{
+				file->append = false;
+				file->data = std::move(data);
+				file->handles++;
+				if (emptied)
+				{
+					truncate(*file);
+				}
+				return file;
+			}
+		}
+	}
+
+	void writeback_filesystem::truncate(dirty_file& file)
+	{
+		if (file.data.use_count() > 1)
+		{
+			file.data = std::make_shared<std::vector<uint8_t>>();
+		}
+		file.data->clear();
+		file.base_size = 0;
+		file.append = false;
+		touch(file);
+	}
+
+	size_t writeback_filesystem::write(dirty_file& file, uint64_t offset, const uint8_t* buffer, size_t count, bool append)
+	{
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		if (options_.max_dirty_bytes != 0 && dirty_bytes_ >= options_.max_dirty_bytes && !file.removed)
+		{
+			throttled_++;
+			do
+			{
+				wake_.notify_one();
+				changed_.wait(lock);
+			} while (dirty_bytes_ >= options_.max_dirty_bytes && !file.removed && !stopping_);
+		}
+		writes_++;
+		written_bytes_ += count;
+		if (file.removed)
+		{
+			return count;
+		}
+
+		// Copied when a write back or a reader still has the previous version
+		if (file.data.use_count() > 1)
+		{
+			file.data = std::make_shared<std::vector<uint8_t>>(*file.data);
+		}
+		std::vector<uint8_t>& data = *file.data;
+		size_t position = file.append || append ? data.size() : static_cast<size_t>(offset);
+		if (position + count > data.size())
+		{
+			data.resize(position + count);
+		}
+		std::memcpy(data.data() + position, buffer, count);
+		touch(file);
+		return count;
+	}
+
+	void writeback_filesystem::touch(dirty_file& file)
+	{
+		if (!file.dirty)
+		{
+			file.dirtied = std::chrono::steady_clock::now();
+			wake_.notify_one();
+		}
+		file.version++;
+		account(file);
+	}
+
+	void writeback_filesystem::account(dirty_file& file)
+	{
+		bool dirty = !file.removed && file.version != file.flushed_version;
+		uint64_t counted = dirty ? file.data->size() : 0;
+		bool urgent = options_.max_dirty_bytes != 0 && dirty_bytes_ * 2 < options_.max_dirty_bytes;
+		dirty_bytes_ = dirty_bytes_ - file.counted + counted;
+		dirty_files_ = dirty_files_ - (file.dirty ? 1 : 0) + (dirty ? 1 : 0);
+		file.counted = counted;
+		file.dirty = dirty;
+		// Half the budget is pending, so the background thread stops waiting for flush_delay
+		if (urgent && dirty_bytes_ * 2 >= options_.max_dirty_bytes)
+		{
+			wake_.notify_one();
+		}
+	}
+
+	void writeback_filesystem::run()
+	{
+		io_priority_scope priority{ io_priority::background };
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		for (;;)
+		{
+			bool urgent = stopping_ || flush_requests_ != 0 || (options_.max_dirty_bytes != 0 && dirty_bytes_ * 2 >= options_.max_dirty_bytes);
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+			std::vector<std::pair<std::string, std::shared_ptr<dirty_file>>> batch;
+			for (const auto& file : files_)
+			{
+				if (!file.second->dirty || file.second->flushing)
+				{
+					continue;
+				}
+				std::chrono::steady_clock::time_point due = file.second->dirtied + options_.flush_delay;
+				if (urgent || due <= now)
+				{
+					batch.push_back(file);
+				}
+				else
+				{
+					next = std::min(next, due);
+				}
+			}
+
+			if (batch.empty())
+			{
+				if (stopping_)
+				{
+					break;
+				}
+				if (next == std::chrono::steady_clock::time_point::max())
+				{
+					wake_.wait(lock);
+				}
+				else
+				{
+					wake_.wait_until(lock, next);
+				}
+				continue;
+			}
+
+			std::vector<snapshot> pending;
+			for (const auto& file : batch)
+			{
+				pending.push_back(begin(*file.second));
+			}
+			std::vector<std::exception_ptr> errors(batch.size());
+			lock.unlock();
+			if (options_.work_executor == nullptr)
+			{
+				for (size_t i = 0; i < batch.size(); i++)
+				{
+					try
+					{
+						write_back(batch[i].first, pending[i], false);
+					}
+					catch (...)
+					{
+						errors[i] = std::current_exception();
+					}
+				}
+			}
+			else
+			{
+				work_group group{ *options_.work_executor, options_.max_concurrency };
+				for (size_t i = 0; i < batch.size(); i++)
+				{
+					group.run([this, &batch, &pending, &errors, i]() {
+						try
+						{
+							write_back(batch[i].first, pending[i], false);
+						}
+						catch (...)
+						{
+							errors[i] = std::current_exception();
+						}
+					});
+				}
+				group.wait();
+			}
+			lock.lock();
+
+			for (size_t i = 0; i < batch.size(); i++)
+			{
+				finish(batch[i].first, batch[i].second, pending[i], false, errors[i]);
+			}
+			batches_++;
+			changed_.notify_all();
+		}
+	}
+
+	writeback_filesystem::snapshot writeback_filesystem::begin(dirty_file& file)
+	{
+		file.flushing = true;
+		return snapshot{ file.data, file.append, file.version };
+	}
+
+	void writeback_filesystem::write_back(const std::string& name, const snapshot& pending, bool durable)
+	{
+		std::unique_ptr<file_handle> handle = compose_filesystem::open_handle(upath{ name }, pending.append ? file_mode::append : file_mode::create, file_access::write);
+		const std::vector<uint8_t>& data = *pending.data;
+		if (!data.empty())
+		{
+			handle->write_at(pending.append ? handle->size() : 0, data.data(), data.size());
+		}
+		if (durable)
+		{
+			handle->sync();
+		}
+	}
+
+	void writeback_filesystem::finish(const std::string& name, const std::shared_ptr<dirty_file>& file, const snapshot& pending, bool durable, std::exception_ptr error)
+	{
+		file->flushing = false;
+		if (error)
+		{
+			// Kept until reported, the pending writes are dropped like those written back
+			errors_.emplace(name, error);
+			error_count_++;
+		}
+		else
+		{
+			flushes_++;
+			flushed_bytes_ += pending.data->size();
+			if (durable)
+			{
+				unsynced_.erase(name);
+			}
+			else
+			{
+				unsynced_.insert(name);
+			}
+		}
+
+		if (pending.append && file->append)
+		{
+			size_t written = pending.data->size();
+			if (file->data == pending.data)
+			{
+				file->data = std::make_shared<std::vector<uint8_t>>();
+			}
+			else
+			{
+				// A copy made by a write since, which starts with the bytes written back
+				file->data->erase(file->data->begin(), file->data->begin() + written);
+			}
+			file->base_size += written;
+		}
+		file->flushed_version = pending.version;
+		account(*file);
+		if (file->dirty)
+		{
+			// Written to meanwhile, so written back again once pending for flush_delay
+			file->dirtied = std::chrono::steady_clock::now();
+			wake_.notify_one();
+		}
+		release(name, file);
+	}
+
+	void writeback_filesystem::settle(const std::string& name, bool recursive, bool durable)
+	{
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		for (;;)
+		{
+			std::string found_name;
+			std::shared_ptr<dirty_file> file;
+			bool busy = false;
+			for (auto it : find_path_entries(files_, name, recursive))
+			{
+				if (it->second->flushing)
+				{
+					busy = true;
+				}
+				else if (it->second->dirty)
+				{
+					found_name = it->first;
+					file = it->second;
+					break;
+				}
+			}
+
+			if (file)
+			{
+				snapshot pending = begin(*file);
+				std::exception_ptr error;
+				lock.unlock();
+				try
+				{
+					write_back(found_name, pending, durable);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				lock.lock();
+				finish(found_name, file, pending, durable, error);
+				changed_.notify_all();
+			}
+			else if (busy)
+			{
+				changed_.wait(lock);
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	void writeback_filesystem::forget(const std::string& name, bool recursive, bool removed)
+	{
+		// Destroyed once the lock is released
+		std::vector<std::shared_ptr<std::iostream>> streams;
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		for (;;)
+		{
+			bool busy = false;
+			for (auto it : find_path_entries(files_, name, recursive))
+			{
+				dirty_file& file = *it->second;
+				if (file.flushing)
+				{
+					busy = true;
+					continue;
+				}
+				file.removed = true;
+				file.data = std::make_shared<std::vector<uint8_t>>();
+				account(file);
+				files_.erase(it);
+			}
+			if (!busy)
+			{
+				break;
+			}
+			// Waits for the write back, which would bring the file back otherwise
+			changed_.wait(lock);
+		}
+		changed_.notify_all();
+
+		if (removed)
+		{
+			for (auto it : find_path_entries(unsynced_, name, recursive))
+			{
+				unsynced_.erase(it);
+			}
+			streams = streams_->take(name, recursive);
+		}
+	}
+
+	void writeback_filesystem::release(const std::string& name, const std::shared_ptr<dirty_file>& file)
+	{
+		if (file->dirty || file->flushing || file->handles != 0)
+		{
+			return;
+		}
+		auto found = files_.find(name);
+		if (found != files_.end() && found->second == file)
+		{
+			files_.erase(found);
+		}
+	}
+
+	void writeback_filesystem::rename_unsynced(const std::string& src, const std::string& dest, bool recursive)
+	{
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		std::vector<std::string> moved;
+		for (auto it : find_path_entries(unsynced_, src, recursive))
+		{
+			moved.push_back(dest + it->substr(src.size()));
+			unsynced_.erase(it);
+		}
+		unsynced_.insert(moved.begin(), moved.end());
+	}
+
+	void writeback_filesystem::rethrow(const std::string& name, bool recursive)
+	{
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto it : find_path_entries(errors_, name, recursive))
+			{
+				if (!error)
+				{
+					error = it->second;
+				}
+				errors_.erase(it);
+			}
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	void writeback_filesystem::move_directory(const upath& src, const upath& dest)
+	{
+		settle(src.full_name(), true, false);
+		compose_filesystem::move_directory(src, dest);
+		rename_unsynced(src.full_name(), dest.full_name(), true);
+		forget(src.full_name(), true, true);
+	}
+
+	void writeback_filesystem::delete_directory(const upath& path, bool recursive)
+	{
+		forget(path.full_name(), true, true);
+		compose_filesystem::delete_directory(path, recursive);
+	}
+
+	void writeback_filesystem::delete_directory(const upath& path, bool recursive, std::error_code& error)
+	{
+		forget(path.full_name(), true, true);
+		compose_filesystem::delete_directory(path, recursive, error);
+	}
+
+	void writeback_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite)
+	{
+		settle(src.full_name(), false, false);
+		settle(dest.full_name(), false, false);
+		compose_filesystem::copy_file(src, dest, overwrite);
+		forget(dest.full_name(), false, false);
+	}
+
+	void writeback_filesystem::copy_file(const upath& src, const upath& dest, bool overwrite, std::error_code& error)
+	{
+		settle(src.full_name(), false, false);
+		settle(dest.full_name(), false, false);
+		compose_filesystem::copy_file(src, dest, overwrite, error);
+		if (!error)
+		{
+			forget(dest.full_name(), false, false);
+		}
+	}
+
+	void writeback_filesystem::replace_file(const upath& src, const upath& dest, const upath& desk_backup, bool ignore_metadata_errors)
+	{
+		settle(src.full_name(), false, false);
+		settle(dest.full_name(), false, false);
+		compose_filesystem::replace_file(src, dest, desk_backup, ignore_metadata_errors);
+		if (!desk_backup.empty())
+		{
+			rename_unsynced(dest.full_name(), desk_backup.full_name(), false);
+		}
+		rename_unsynced(src.full_name(), dest.full_name(), false);
+		forget(src.full_name(), false, true);
+		forget(dest.full_name(), false, false);
+		forget(desk_backup.full_name(), false, false);
+	}
+
+	void writeback_filesystem::replace_file(const upath& src, const upath& dest, bool ignore_metadata_errors)
+	{
+		settle(src.full_name(), false, false);
+		settle(dest.full_name(), false, false);
+		compose_filesystem::replace_file(src, dest, ignore_metadata_errors);
+		rename_unsynced(src.full_name(), dest.full_name(), false);
+		forget(src.full_name(), false, true);
+		forget(dest.full_name(), false, false);
+	}
+
+	size_t writeback_filesystem::file_length(const upath& path) const
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto found = files_.find(path.full_name());
+			if (found != files_.end())
+			{
+				return static_cast<size_t>(length(*found->second));
+			}
+		}
+		return compose_filesystem::file_length(path);
+	}
+
+	size_t writeback_filesystem::file_length(const upath& path, std::error_code& error) const
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			auto found = files_.find(path.full_name());
+			if (found != files_.end())
+			{
+				error.clear();
+				return static_cast<size_t>(length(*found->second));
+			}
+		}
+		return compose_filesystem::file_length(path, error);
+	}
+
+	void writeback_filesystem::move_file(const upath& src, const upath& dest)
+	{
+		settle(src.full_name(), false, false);
+		compose_filesystem::move_file(src, dest);
+		rename_unsynced(src.full_name(), dest.full_name(), false);
+		forget(src.full_name(), false, true);
+	}
+
+	void writeback_filesystem::move_file(const upath& src, const upath& dest, std::error_code& error)
+	{
+		settle(src.full_name(), false, false);
+		compose_filesystem::move_file(src, dest, error);
+		if (!error)
+		{
+			rename_unsynced(src.full_name(), dest.full_name(), false);
+			forget(src.full_name(), false, true);
+		}
+	}
+
+	void writeback_filesystem::delete_file(const upath& path)
+	{
+		forget(path.full_name(), false, true);
+		compose_filesystem::delete_file(path);
+	}
+
+	void writeback_filesystem::delete_file(const upath& path, std::error_code& error)
+	{
+		forget(path.full_name(), false, true);
+		compose_filesystem::delete_file(path, error);
+	}
+
+	std::iostream& writeback_filesystem::open_file(const upath& path, file_mode mode, file_access access)
+	{
+		// The earlier stream holds the pending version, which is released once written back when no handle is left
+		streams_->close(path.full_name(), mode, access);
+		return streams_->keep(path.full_name(), mode, access, std::make_shared<handle_stream>(open_handle(path, mode, access), mode == file_mode::append));
+	}
+
+	std::unique_ptr<file_handle> writeback_filesystem::open_handle(const upath& path, file_mode mode, file_access access)
+	{
+		return open(path, mode, access, nullptr);
+	}
+
+	std::unique_ptr<file_handle> writeback_filesystem::open_handle(const upath& path, file_mode mode, file_access access, std::error_code& error)
+	{
+		std::unique_ptr<file_handle> handle = open(path, mode, access, &error);
+		if (handle)
+		{
+			error.clear();
+		}
+		return handle;
+	}
+
+	std::vector<file_stat> writeback_filesystem::stat_many(const std::vector<upath>& paths) const
+	{
+		std::vector<file_stat> stats = compose_filesystem::stat_many(paths);
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			auto found = files_.find(paths[i].full_name());
+			if (found != files_.end() && stats[i].exists && !stats[i].is_directory)
+			{
+				stats[i].length = static_cast<size_t>(length(*found->second));
+			}
+		}
+		return stats;
+	}
+
+	void writeback_filesystem::delete_many(const std::vector<upath>& paths)
+	{
+		for (const upath& path : paths)
+		{
+			forget(path.full_name(), true, true);
+		}
+		compose_filesystem::delete_many(paths);
+	}
+}